@@ -0,0 +1,604 @@
+/*
+ * bench.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ *
+ * Compile-time scaling benchmark. Built by `make bench` in place of
+ * doproc.cc. When the compiler is run on any input file, the first
+ * procedure is replaced by synthetic procedures of growing size, and each
+ * analysis and pass is timed on its own for each size. The input file
+ * itself is left unchanged.
+ *
+ * Synthetic procedures are random, but are the same for the same seed and
+ * size. They are nested loops and if/else regions of straight-line blocks
+ * of arithmetic, copies, loads and stores. The environment variables below
+ * control them; the defaults are in parentheses.
+ *
+ *      ECE540_BENCH_SEED           random seed (1)
+ *      ECE540_BENCH_MIN_BLOCKS     smallest procedure, in blocks (100)
+ *      ECE540_BENCH_MAX_BLOCKS     largest procedure, in blocks (100000)
+ *      ECE540_BENCH_BLOCK_SIZE     instructions per block, roughly (6)
+ *      ECE540_BENCH_REGS           pseudo registers (16)
+ *      ECE540_BENCH_LOOP_DEPTH     deepest loop nesting (3)
+ *      ECE540_BENCH_LOOPS          percent of regions that are loops (10)
+ *      ECE540_BENCH_BRANCHES       percent of regions that are if/else (25)
+ *      ECE540_BENCH_MAX_MS         longest time to spend on one size (10000)
+ *      ECE540_BENCH_ONLY           only time this analysis or pass
+ *
+ * Sizes double from the smallest to the largest. For each size, the
+ * report has the time (CPU milliseconds) and the slope of the scaling
+ * curve since the last size: about 1 for linear time, 2 for quadratic
+ * time. Sizes that would take longer than ECE540_BENCH_MAX_MS (going by
+ * the slope so far) are skipped.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include "include/optimizer.h"
+#include "include/summary.h"
+#include "include/opt/cf.h"
+#include "include/opt/cp.h"
+#include "include/opt/dce.h"
+#include "include/opt/cse.h"
+#include "include/opt/rle.h"
+#include "include/opt/dse.h"
+#include "include/opt/licm.h"
+#include "include/opt/sr.h"
+#include "include/opt/eval.h"
+#include "include/opt/coalesce.h"
+#include "include/opt/sb.h"
+#include "include/opt/ns.h"
+#include "include/opt/bp.h"
+
+enum {
+    /// largest arm of an if/else, in blocks
+    MAX_ARM_SIZE = 8U,
+
+    /// repeat measurements of small procedures until they add up to this
+    /// much time (in milliseconds), and report the average
+    MIN_SAMPLE_MS = 20U,
+    MAX_SAMPLES = 100U
+};
+
+/// the analyses and passes that are timed
+enum bench_item {
+    BENCH_CFG,
+    BENCH_DOMS,
+    BENCH_LOOPS,
+    BENCH_VAR_DEFS,
+    BENCH_VAR_USES,
+    BENCH_UD,
+    BENCH_DU,
+    BENCH_AE,
+    BENCH_ALIASES,
+    BENCH_SB,
+    BENCH_CP,
+    BENCH_CF,
+    BENCH_DCE,
+    BENCH_CSE,
+    BENCH_RLE,
+    BENCH_DSE,
+    BENCH_NS,
+    BENCH_LICM,
+    BENCH_SR,
+    BENCH_EVAL,
+    BENCH_COALESCE,
+    BENCH_BP,
+    NUM_BENCH_ITEMS
+};
+
+static const char *BENCH_ITEM_NAMES[] = {
+    "cfg", "doms", "loops", "var_defs", "var_uses", "ud", "du", "ae",
+    "aliases", "sb", "cp", "cf", "dce", "cse", "rle", "dse", "ns", "licm",
+    "sr", "eval", "coalesce", "bp"
+};
+
+/// what synthetic procedures look like
+struct bench_config {
+public:
+    uint32_t seed;
+    unsigned min_blocks;
+    unsigned max_blocks;
+    unsigned block_size;
+    unsigned num_regs;
+    unsigned loop_depth;
+    unsigned loop_percent;
+    unsigned branch_percent;
+    unsigned max_ms;
+    const char *only;
+};
+
+/// state for making a synthetic procedure
+struct generator {
+public:
+    const bench_config *config;
+    uint32_t state;
+
+    simple_instr *first;
+    simple_instr *last;
+    unsigned num_instrs;
+
+    /// registers, temporaries and labels are made once and reused by every
+    /// procedure, as they can't be freed. Temporaries are reused by every
+    /// block, as they are local to blocks: two signed ones and an address.
+    /// The first loop_depth registers are the induction variables of loops.
+    std::vector<simple_reg *> regs;
+    std::vector<simple_reg *> temps;
+    std::vector<simple_sym *> labels;
+    simple_reg *base;
+    unsigned next_label;
+};
+
+/// summaries for the passes that use them; no procedures are summarized
+static summary_map SUMMARIES;
+
+/// get a setting from the environment
+static unsigned get_setting(const char *flag, unsigned default_val) throw() {
+    const char *val(getenv(flag));
+    if(0 == val) {
+        return default_val;
+    }
+    return static_cast<unsigned>(strtoul(val, 0, 10));
+}
+
+/// a random number in [0, n)
+static unsigned random_below(generator &g, unsigned n) throw() {
+    g.state = g.state * 1103515245U + 12345U;
+    return (g.state >> 8) % n;
+}
+
+static simple_instr *add_instr(generator &g, simple_op op, simple_type *type) throw() {
+    simple_instr *in(new_instr(op, type));
+    if(0 == g.last) {
+        g.first = in;
+    } else {
+        g.last->next = in;
+        in->prev = g.last;
+    }
+    g.last = in;
+    ++g.num_instrs;
+    return in;
+}
+
+static simple_reg *random_reg(generator &g) throw() {
+    return g.regs[random_below(g, static_cast<unsigned>(g.regs.size()))];
+}
+
+/// a register that isn't the induction variable of a loop
+static simple_reg *random_dst_reg(generator &g) throw() {
+    const unsigned num_vars(g.config->loop_depth);
+    const unsigned num_regs(static_cast<unsigned>(g.regs.size()));
+    return g.regs[num_vars + random_below(g, num_regs - num_vars)];
+}
+
+static simple_sym *get_label(generator &g) throw() {
+    if(g.labels.size() <= g.next_label) {
+        g.labels.push_back(new_label());
+    }
+    return g.labels[g.next_label++];
+}
+
+static void add_label(generator &g, simple_sym *label) throw() {
+    simple_instr *in(add_instr(g, LABEL_OP, simple_type_void));
+    in->u.label.lab = label;
+}
+
+static void add_ldc(generator &g, simple_reg *dst, int val) throw() {
+    simple_instr *in(add_instr(g, LDC_OP, dst->var->type));
+    in->u.ldc.dst = dst;
+    in->u.ldc.value.format = IMMED_INT;
+    in->u.ldc.value.u.ival = val;
+}
+
+static void add_base(
+    generator &g,
+    simple_op op,
+    simple_reg *dst,
+    simple_reg *src1,
+    simple_reg *src2
+) throw() {
+    simple_type *type(0 != dst ? dst->var->type : src2->var->type);
+    simple_instr *in(add_instr(g, op, type));
+    in->u.base.dst = dst;
+    in->u.base.src1 = src1;
+    in->u.base.src2 = src2;
+}
+
+static void add_branch(
+    generator &g,
+    simple_op op,
+    simple_reg *src,
+    simple_sym *target
+) throw() {
+    simple_instr *in(add_instr(g, op, simple_type_void));
+    in->u.bj.src = src;
+    in->u.bj.target = target;
+}
+
+/// add some random instruction. Few registers and operators are used, so
+/// that there are common sub-expressions, copies to propagate, and
+/// redundant loads and stores.
+static void add_random_instr(generator &g) throw() {
+    static const simple_op OPS[] = {ADD_OP, SUB_OP, MUL_OP, AND_OP};
+    simple_reg *t0(g.temps[0]);
+    simple_reg *t1(g.temps[1]);
+
+    switch(random_below(g, 8U)) {
+    case 0: // constant operand
+        add_ldc(g, t0, static_cast<int>(random_below(g, 16U)));
+        add_base(g, OPS[random_below(g, 4U)], random_dst_reg(g), random_reg(g), t0);
+        break;
+
+    case 1: // copy
+        add_base(g, CPY_OP, random_dst_reg(g), random_reg(g), 0);
+        break;
+
+    case 2: // load
+        add_ldc(g, t0, static_cast<int>(4U * random_below(g, 8U)));
+        add_base(g, ADD_OP, t1, g.base, t0);
+        add_base(g, LOAD_OP, random_dst_reg(g), t1, 0);
+        break;
+
+    case 3: // store
+        add_ldc(g, t0, static_cast<int>(4U * random_below(g, 8U)));
+        add_base(g, ADD_OP, t1, g.base, t0);
+        add_base(g, STR_OP, 0, t1, random_reg(g));
+        break;
+
+    default:
+        add_base(g, OPS[random_below(g, 4U)], random_dst_reg(g), random_reg(g), random_reg(g));
+        break;
+    }
+}
+
+/// add a straight-line block, which falls through to the next
+static void add_block(generator &g) throw() {
+    add_label(g, get_label(g));
+    for(unsigned i(0U); i < g.config->block_size; i += 2U) {
+        add_random_instr(g);
+    }
+}
+
+static void add_region(generator &, unsigned, unsigned) throw();
+
+/// add a counted loop of about some number of blocks: a test, a body, and
+/// a block that counts and jumps back to the test
+static void add_loop(generator &g, unsigned num_blocks, unsigned depth) throw() {
+    simple_sym *head(get_label(g));
+    simple_sym *exit_label(get_label(g));
+    simple_reg *var(g.regs[depth]);
+    simple_reg *t0(g.temps[0]);
+    simple_reg *t2(g.temps[2]);
+
+    add_ldc(g, var, 0);
+
+    add_label(g, head);
+    add_ldc(g, t0, static_cast<int>(1U + random_below(g, 100U)));
+    add_base(g, SL_OP, t2, var, t0);
+    add_branch(g, BFALSE_OP, t2, exit_label);
+
+    add_region(g, num_blocks - 2U, depth + 1U);
+
+    add_block(g);
+    add_ldc(g, t0, 1);
+    add_base(g, ADD_OP, var, var, t0);
+    add_branch(g, JMP_OP, 0, head);
+
+    add_label(g, exit_label);
+}
+
+/// add an if/else with arms of some numbers of blocks
+static void add_if_else(
+    generator &g,
+    unsigned then_blocks,
+    unsigned else_blocks,
+    unsigned depth
+) throw() {
+    simple_sym *else_label(get_label(g));
+    simple_sym *join(get_label(g));
+    simple_reg *t0(g.temps[0]);
+
+    add_base(g, SNE_OP, t0, random_reg(g), random_reg(g));
+    add_branch(g, BTRUE_OP, t0, else_label);
+
+    add_region(g, then_blocks, depth);
+    add_branch(g, JMP_OP, 0, join);
+
+    add_label(g, else_label);
+    add_region(g, else_blocks, depth);
+
+    add_label(g, join);
+}
+
+/// add a region of about some number of blocks, made up of blocks, loops
+/// and if/else regions. A region always ends with a block that falls
+/// through.
+static void add_region(generator &g, unsigned num_blocks, unsigned depth) throw() {
+    const bench_config &config(*(g.config));
+
+    for(; num_blocks > 1U; ) {
+        const unsigned kind(random_below(g, 100U));
+
+        if(4U <= num_blocks
+        && depth < config.loop_depth
+        && kind < config.loop_percent) {
+            const unsigned size(3U + random_below(g, num_blocks - 2U));
+            add_loop(g, size, depth);
+            num_blocks -= size;
+
+        } else if(4U <= num_blocks
+               && kind < config.loop_percent + config.branch_percent) {
+            const unsigned max_size(std::min(
+                static_cast<unsigned>(MAX_ARM_SIZE), (num_blocks - 2U) / 2U));
+            const unsigned then_blocks(1U + random_below(g, max_size));
+            const unsigned else_blocks(1U + random_below(g, max_size));
+            add_if_else(g, then_blocks, else_blocks, depth);
+            num_blocks -= then_blocks + else_blocks + 1U;
+
+        } else {
+            add_block(g);
+            --num_blocks;
+        }
+    }
+
+    add_block(g);
+}
+
+/// make a synthetic procedure of about some number of blocks; the same
+/// seed and size always give the same procedure
+static simple_instr *make_procedure(
+    generator &g,
+    unsigned num_blocks
+) throw() {
+    g.state = g.config->seed;
+    g.first = 0;
+    g.last = 0;
+    g.num_instrs = 0U;
+    g.next_label = 0U;
+
+    add_region(g, num_blocks, 0U);
+
+    simple_instr *in(add_instr(g, RET_OP, simple_type_signed));
+    in->u.base.dst = 0;
+    in->u.base.src1 = g.regs[g.config->loop_depth];
+    in->u.base.src2 = 0;
+
+    return g.first;
+}
+
+static void free_procedure(simple_instr *in) throw() {
+    for(simple_instr *next(0); 0 != in; in = next) {
+        next = in->next;
+        free_instr(in);
+    }
+}
+
+static double to_ms(clock_t time) throw() {
+    return 1000.0 * static_cast<double>(time) / CLOCKS_PER_SEC;
+}
+
+/// time an analysis, once everything that it depends on is up to date
+template <typename T>
+static clock_t time_analysis(optimizer &o) throw() {
+    o.get<T>();
+    const clock_t start(clock());
+    o.force_get<T>();
+    return clock() - start;
+}
+
+/// bring everything that a pass depends on up to date, so that only the
+/// pass is timed
+template <typename T0>
+static void prepare(optimizer &o, void (*)(optimizer &, T0 &)) throw() {
+    o.get<T0>();
+}
+
+template <typename T0, typename T1>
+static void prepare(optimizer &o, void (*)(optimizer &, T0 &, T1 &)) throw() {
+    o.get<T0>();
+    o.get<T1>();
+}
+
+template <typename T0, typename T1, typename T2>
+static void prepare(optimizer &o, void (*)(optimizer &, T0 &, T1 &, T2 &)) throw() {
+    o.get<T0>();
+    o.get<T1>();
+    o.get<T2>();
+}
+
+template <typename T0, typename T1, typename T2, typename T3>
+static void prepare(
+    optimizer &o,
+    void (*)(optimizer &, T0 &, T1 &, T2 &, T3 &)
+) throw() {
+    o.get<T0>();
+    o.get<T1>();
+    o.get<T2>();
+    o.get<T3>();
+}
+
+/// time a pass on its own, without cascading into any other pass
+template <typename F>
+static clock_t time_pass(optimizer &o, F *func) throw() {
+    prepare(o, func);
+    optimizer::pass p(o.add_pass(func));
+    const clock_t start(clock());
+    o.run(p);
+    return clock() - start;
+}
+
+static clock_t time_item(optimizer &o, bench_item item) throw() {
+    switch(item) {
+    case BENCH_CFG: return time_analysis<cfg>(o);
+    case BENCH_DOMS: return time_analysis<dominator_map>(o);
+    case BENCH_LOOPS: return time_analysis<loop_map>(o);
+    case BENCH_VAR_DEFS: return time_analysis<var_def_map>(o);
+    case BENCH_VAR_USES: return time_analysis<var_use_map>(o);
+    case BENCH_UD: return time_analysis<use_def_map>(o);
+    case BENCH_DU: return time_analysis<def_use_map>(o);
+    case BENCH_AE: return time_analysis<available_expression_map>(o);
+    case BENCH_ALIASES: return time_analysis<alias_map>(o);
+    case BENCH_SB: return time_pass(o, form_superblocks);
+    case BENCH_CP: return time_pass(o, propagate_copies);
+    case BENCH_CF: return time_pass(o, fold_constants);
+    case BENCH_DCE: return time_pass(o, eliminate_dead_code);
+    case BENCH_CSE: return time_pass(o, eliminate_common_sub_expressions);
+    case BENCH_RLE: return time_pass(o, eliminate_redundant_loads);
+    case BENCH_DSE: return time_pass(o, eliminate_dead_stores);
+    case BENCH_NS: return time_pass(o, split_irreducible_loops);
+    case BENCH_LICM: return time_pass(o, hoist_loop_invariant_code);
+    case BENCH_SR: return time_pass(o, replace_loop_scalars);
+    case BENCH_EVAL: return time_pass(o, abstract_evaluator);
+    case BENCH_COALESCE: return time_pass(o, coalesce_registers);
+    case BENCH_BP: return time_pass(o, place_blocks);
+    default: return 0;
+    }
+}
+
+/// time an analysis or pass on a fresh procedure of some size, as many
+/// times as needed for a stable average; returns milliseconds. Also gets
+/// how long each sample took overall, including making the procedure and
+/// everything that the analysis or pass depends on.
+static double measure(
+    generator &g,
+    bench_item item,
+    unsigned num_blocks,
+    double &sample_ms
+) throw() {
+    const clock_t start(clock());
+    clock_t total(0);
+    unsigned num_samples(0U);
+
+    do {
+        simple_instr *in(make_procedure(g, num_blocks));
+        {
+            optimizer o(in, SUMMARIES);
+            total += time_item(o, item);
+            in = o.first_instruction();
+        }
+        free_procedure(in);
+        ++num_samples;
+    } while(to_ms(clock() - start) < MIN_SAMPLE_MS && num_samples < MAX_SAMPLES);
+
+    sample_ms = to_ms(clock() - start) / num_samples;
+    return to_ms(total) / num_samples;
+}
+
+/// the slope of a scaling curve between two sizes, or 1 if the times are
+/// too small to say
+static double find_slope(
+    double last_ms,
+    double ms,
+    unsigned last_blocks,
+    unsigned num_blocks
+) throw() {
+    if(0U == last_blocks || last_ms < 0.01 || ms < 0.01) {
+        return 1.0;
+    }
+    return log(ms / last_ms) / log(static_cast<double>(num_blocks) / last_blocks);
+}
+
+/// time one analysis or pass over every size, and report its scaling curve
+static void run_item(generator &g, bench_item item) throw() {
+    const bench_config &config(*(g.config));
+    double last_ms(0.0);
+    double last_sample_ms(0.0);
+    unsigned last_blocks(0U);
+
+    for(unsigned num_blocks(config.min_blocks); ; ) {
+        double sample_ms(0.0);
+        const double ms(measure(g, item, num_blocks, sample_ms));
+        const double slope(find_slope(last_ms, ms, last_blocks, num_blocks));
+
+        printf("%-10s %8u %9u %12.3f", BENCH_ITEM_NAMES[item],
+            num_blocks, g.num_instrs, ms);
+
+        // the slope isn't meaningful for tiny times
+        if(0U != last_blocks && 0.01 <= last_ms && 0.01 <= ms) {
+            printf(" %7.2f\n", slope);
+        } else {
+            printf("       -\n");
+        }
+        fflush(stdout);
+
+        if(config.max_blocks <= num_blocks) {
+            break;
+        }
+
+        // guess how long the next size will take, going by whichever grows
+        // faster: the analysis or pass, or everything that it depends on
+        const unsigned next_blocks(std::min(2U * num_blocks, config.max_blocks));
+        const double growth(std::max(std::max(slope, 1.0), find_slope(
+            last_sample_ms, sample_ms, last_blocks, num_blocks)));
+        const double next_ms(sample_ms * pow(
+            static_cast<double>(next_blocks) / num_blocks, growth));
+
+        if(config.max_ms < next_ms) {
+            printf("%-10s %8u  skipped; would take about %.0f ms\n",
+                BENCH_ITEM_NAMES[item], next_blocks, next_ms);
+            break;
+        }
+
+        last_ms = ms;
+        last_sample_ms = sample_ms;
+        last_blocks = num_blocks;
+        num_blocks = next_blocks;
+    }
+
+    fflush(stdout);
+}
+
+/// run the benchmark instead of optimizing the first procedure
+simple_instr *do_procedure(simple_instr *in_list, char *) {
+    static bool ran(false);
+    if(ran) {
+        return in_list;
+    }
+    ran = true;
+
+    bench_config config;
+    config.seed = get_setting("ECE540_BENCH_SEED", 1U);
+    config.min_blocks = std::max(get_setting("ECE540_BENCH_MIN_BLOCKS", 100U), 1U);
+    config.max_blocks = std::max(get_setting("ECE540_BENCH_MAX_BLOCKS", 100000U), config.min_blocks);
+    config.block_size = get_setting("ECE540_BENCH_BLOCK_SIZE", 6U);
+    config.loop_depth = get_setting("ECE540_BENCH_LOOP_DEPTH", 3U);
+    config.num_regs = std::max(get_setting("ECE540_BENCH_REGS", 16U), config.loop_depth + 1U);
+    config.loop_percent = get_setting("ECE540_BENCH_LOOPS", 10U);
+    config.branch_percent = get_setting("ECE540_BENCH_BRANCHES", 25U);
+    config.max_ms = get_setting("ECE540_BENCH_MAX_MS", 10000U);
+    config.only = getenv("ECE540_BENCH_ONLY");
+
+    generator g;
+    g.config = &config;
+    g.base = new_register(simple_type_addr, PSEUDO_REG);
+    for(unsigned i(0U); i < config.num_regs; ++i) {
+        g.regs.push_back(new_register(simple_type_signed, PSEUDO_REG));
+    }
+    g.temps.push_back(new_register(simple_type_signed, TEMP_REG));
+    g.temps.push_back(new_register(simple_type_addr, TEMP_REG));
+    g.temps.push_back(new_register(simple_type_signed, TEMP_REG));
+
+    printf("%-10s %8s %9s %12s %7s\n",
+        "what", "blocks", "instrs", "ms", "slope");
+
+    for(unsigned i(0U); i < NUM_BENCH_ITEMS; ++i) {
+        if(0 != config.only && 0 != strcmp(config.only, BENCH_ITEM_NAMES[i])) {
+            continue;
+        }
+        run_item(g, static_cast<bench_item>(i));
+    }
+
+    return in_list;
+}
@@ -5,34 +5,77 @@
 //#undef MAIN
 
 #include "include/optimizer.h"
+#include "include/summary.h"
+#include "include/stats.h"
+#include "include/profile.h"
+#include "include/sim.h"
+#include "include/ir.h"
 #include "include/opt/cf.h"
 #include "include/opt/cp.h"
 #include "include/opt/dce.h"
 #include "include/opt/cse.h"
+#include "include/opt/rle.h"
+#include "include/opt/dse.h"
 #include "include/opt/licm.h"
+#include "include/opt/sr.h"
 #include "include/opt/eval.h"
+#include "include/opt/coalesce.h"
+#include "include/opt/sb.h"
+#include "include/opt/ns.h"
+#include "include/opt/bp.h"
 
-static optimizer::pass CF, CP, CP_2, DCE, CSE, LICM, EVAL;
+static optimizer::pass SB, SB_2, CF, CP, CP_2, DCE, CSE, RLE, DSE, NS, LICM, SR, EVAL, COALESCE, BP;
+
+/// summaries of all procedures optimized so far
+static summary_map SUMMARIES;
 
 /// set up and run the optimizer pipeline.
 simple_instr *do_procedure(simple_instr *in_list, char *proc_name) {
 
-    optimizer o(in_list);
+    // binary IR: replace the procedure with a saved one, and/or save it
+    in_list = ir::load(proc_name, in_list);
+    ir::save(proc_name, in_list);
+
+    optimizer o(in_list, SUMMARIES);
+
+    // profiling: either count how often each block runs instead of
+    // optimizing, or attach the counts of an earlier run to the blocks
+    profile::find_runtime(o.first_instruction());
+    if(profile::is_generating()) {
+        profile::instrument(proc_name, o.get<cfg>());
+        return o.first_instruction();
+    }
+    if(profile::is_using()) {
+        profile::attach(proc_name, o.get<cfg>());
+    }
+
+    // remember the procedure as it was, so that it can be run later on
+    sim::record_before(proc_name, o);
 
+    SB = o.add_pass(form_superblocks);
     CP = o.add_pass(propagate_copies);
     CF = o.add_pass(fold_constants);
     DCE = o.add_pass(eliminate_dead_code);
     CSE = o.add_pass(eliminate_common_sub_expressions);
+    RLE = o.add_pass(eliminate_redundant_loads);
+    DSE = o.add_pass(eliminate_dead_stores);
+    NS = o.add_pass(split_irreducible_loops);
     LICM = o.add_pass(hoist_loop_invariant_code);
+    SR = o.add_pass(replace_loop_scalars);
     EVAL = o.add_pass(abstract_evaluator);
 
-    //               5           7
-    //    1 .--------<---------.-<--.                 10
-    //  .-<-.   2      4       |    |              .--->---.
-    // -`-> CP ->- CF ->- DCE -'->- CSE ->- LICM -'- DCE ---`>-- EVAL
-    //       `--<--'             6       8        9         11
-    //          3
-
+    //                      5           7        9
+    //   0       1 .--------<---------.-<--.---<----.
+    //  .-<-.    .-<-.   2      4       |    |        |
+    // -`-> SB ->-`-> CP ->- CF ->- DCE -'->- CSE ->- RLE ->- DSE ->- NS ->- LICM -.
+    //                 `--<--'             6       8        10     11    26       |
+    //                    3                                                       |
+    //                 .---------------------<------------------------------------'
+    //                 |      12          13          14
+    //                 `---->---- SR ->- DCE ---->---- EVAL
+
+    o.cascade_if(SB, SB, true);         // 0
+    o.cascade_if(SB, CP, false);
     o.cascade_if(CP, CP, true);         // 1
     o.cascade_if(CP, CF, false);        // 2
     o.cascade_if(CF, CP, true);         // 3
@@ -40,37 +83,56 @@ simple_instr *do_procedure(simple_instr *in_list, char *proc_name) {
     o.cascade_if(DCE, CP, true);        // 5
     o.cascade_if(DCE, CSE, false);      // 6
     o.cascade_if(CSE, CP, true);        // 7
-    o.cascade_if(CSE, LICM, false);     // 8
+    o.cascade_if(CSE, RLE, false);      // 8
+    o.cascade_if(RLE, CP, true);        // 9
+    o.cascade_if(RLE, DSE, false);      // 10
+    o.cascade(DSE, NS);                 // 11
+    o.cascade(NS, LICM);                // 26
 
     DCE = o.add_pass(eliminate_dead_code);
 
-    o.cascade_if(LICM, DCE, true);      // 9
-
-    o.cascade_if(LICM, EVAL, false);    // 10
-    o.cascade(DCE, EVAL);               // 11
+    o.cascade(LICM, SR);                // 12
+    o.cascade(SR, DCE);                 // 13
+    o.cascade(DCE, EVAL);               // 14
 
-    //  -.                      17          19
-    //   | 10,11    13 .--------<--------.--<--.
-    //   |        .-<-.  14              |     |
-    // EVAL -->---`-> CP ->- CF ->- DCE -'->- CSE -->-- DONE!
-    //       12        `--<--'  16        18
-    //                   15
+    //  -.                                 20          22            24
+    //   | 14      25          16 .--------<--------.--<--.---------<---------.
+    //   |        .-<-.      .-<-.  17              |     |                   |
+    // EVAL -->---`-> SB ->--`-> CP ->- CF ->- DCE -'->- CSE -->-- COALESCE --'
+    //       15                   `--<--'  19        21        23       |
+    //                              18                               27 |
+    //                                                       DONE! --<-- BP --<--'
 
+    SB_2 = o.add_pass(form_superblocks);
     CP_2 = o.add_pass(propagate_copies);
     CF = o.add_pass(fold_constants);
     DCE = o.add_pass(eliminate_dead_code);
     CSE = o.add_pass(eliminate_common_sub_expressions);
-
-    o.cascade(EVAL, CP_2);              // 12
-    o.cascade_if(CP_2, CP_2, true);     // 13
-    o.cascade_if(CP_2, CF, false);      // 14
-    o.cascade_if(CF, CP_2, true);       // 15
-    o.cascade_if(CF, DCE, false);       // 16
-    o.cascade_if(DCE, CP_2, true);      // 17
-    o.cascade_if(DCE, CSE, false);      // 18
-    o.cascade_if(CSE, CP_2, true);      // 19
-
-    o.run(CP);
+    COALESCE = o.add_pass(coalesce_registers);
+    BP = o.add_pass(place_blocks);
+
+    o.cascade(EVAL, SB_2);              // 15
+    o.cascade_if(SB_2, SB_2, true);     // 25
+    o.cascade_if(SB_2, CP_2, false);
+    o.cascade_if(CP_2, CP_2, true);     // 16
+    o.cascade_if(CP_2, CF, false);      // 17
+    o.cascade_if(CF, CP_2, true);       // 18
+    o.cascade_if(CF, DCE, false);       // 19
+    o.cascade_if(DCE, CP_2, true);      // 20
+    o.cascade_if(DCE, CSE, false);      // 21
+    o.cascade_if(CSE, CP_2, true);      // 22
+    o.cascade_if(CSE, COALESCE, false); // 23
+    o.cascade_if(COALESCE, DCE, true);  // 24
+    o.cascade_if(COALESCE, BP, false);  // 27
+
+    o.run(SB);
+    sim::record_after(proc_name, o);
+
+    // summarize the optimized procedure so that later procedures in the same
+    // file can reason about calls to it
+    SUMMARIES.summarize(proc_name, o.first_instruction());
+
+    stats::report(proc_name);
 
     return o.first_instruction();
     //return print_dot(o.first_instruction(), proc_name);
@@ -0,0 +1,153 @@
+/*
+ * alias.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_ALIAS_H_
+#define project_ALIAS_H_
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <map>
+#include <set>
+
+#include "include/data_flow/var_use.h"
+
+class cfg;
+class basic_block;
+struct loop;
+
+/// the abstract value of a register as far as pointers are concerned. Values
+/// form a lattice:
+///
+///                  TOP
+///                /     |
+///         INTEGER     ADDRESS(s)
+///            |         |
+///       CONSTANT(c)   ADDRESS(s')
+///                |    |
+///                BOTTOM
+///
+/// where an ADDRESS is a set of (symbol, offset) pairs, and the offset can be
+/// unknown. TOP means "could point anywhere". The constant 0 (i.e. NULL) joins
+/// with an ADDRESS to give that ADDRESS.
+struct points_to {
+public:
+
+    enum {
+        ANY_OFFSET = -2147483647 - 1
+    };
+
+    typedef enum {
+        BOTTOM,
+        CONSTANT,
+        INTEGER,
+        ADDRESS,
+        TOP
+    } kind_type;
+
+    kind_type kind;
+    int constant;
+    std::map<simple_sym *, int> offsets;
+
+    points_to(void) throw();
+    explicit points_to(kind_type) throw();
+
+    /// join another value into this one; returns true iff this value changed
+    bool join(const points_to &) throw();
+
+    bool operator==(const points_to &) const throw();
+    bool operator!=(const points_to &) const throw();
+};
+
+/// a leaf of a symbolic address; either the value of a register at the
+/// beginning of a region of code, or the value defined by some instruction
+/// that we don't know how to look through.
+struct address_leaf {
+public:
+    simple_reg *reg;
+    const simple_instr *def;
+
+    bool operator<(const address_leaf &) const throw();
+    bool operator==(const address_leaf &) const throw();
+};
+
+/// a symbolic address of the form: base + sum(scale * leaf) + offset. Two
+/// symbolic addresses are only comparable if they were computed relative to
+/// the same region of code.
+struct symbolic_address {
+public:
+    bool is_valid;
+    simple_sym *base;
+    int offset;
+    std::map<address_leaf, int> terms;
+
+    symbolic_address(void) throw();
+
+    /// do two addresses differ only by their constant offsets?
+    bool is_comparable(const symbolic_address &) const throw();
+};
+
+/// describes a single read from or write to memory
+struct memory_access {
+public:
+    simple_instr *in;
+    simple_reg *addr;
+    unsigned size; // in bytes; 0 if unknown
+    symbolic_address address;
+};
+
+/// flow-insensitive points-to information for every register in a procedure
+class alias_map {
+private:
+
+    friend void find_aliases(cfg &, var_use_map &, alias_map &) throw();
+
+    std::map<simple_reg *, points_to> values;
+
+public:
+
+    /// get the points-to information of a register
+    const points_to &operator()(simple_reg *) const throw();
+
+    /// might two instructions access overlapping memory? This is true at
+    /// every point in the procedure.
+    bool may_alias(simple_instr *, simple_instr *) const throw();
+
+    /// might two memory accesses overlap? Uses the symbolic addresses of the
+    /// accesses if they are valid, and so the symbolic addresses must have
+    /// been computed relative to the same region.
+    bool may_alias(const memory_access &, const memory_access &) const throw();
+
+    /// do two memory accesses definitely access the same memory?
+    bool must_alias(const memory_access &, const memory_access &) const throw();
+};
+
+/// find the points-to information of every register in the cfg
+void find_aliases(cfg &, var_use_map &, alias_map &) throw();
+
+/// describe the memory read/written by an instruction; returns false if the
+/// instruction doesn't read/write memory. These do not compute symbolic
+/// addresses.
+bool find_memory_read(simple_instr *, memory_access &) throw();
+bool find_memory_write(simple_instr *, memory_access &) throw();
+
+/// compute the symbolic address of a memory access relative to the beginning
+/// of its basic block
+void find_local_address(memory_access &) throw();
+
+/// compute the symbolic address of a memory access (inside of a loop)
+/// relative to the beginning of the loop. The address is invalid if it
+/// depends on anything that changes inside the loop. The set of registers
+/// is the set of all registers defined inside the loop.
+void find_loop_address(
+    const loop &,
+    const std::set<simple_reg *> &,
+    memory_access &
+) throw();
+
+#endif /* project_ALIAS_H_ */
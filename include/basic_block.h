@@ -54,9 +54,20 @@ public:
     bool entry_reachable;
     bool exit_reachable;
 
+    /// how many times this block ran, if there is a profile that says so
+    /// (see profile.h)
+    bool has_count;
+    unsigned count;
+
     /// number of instructions
     unsigned size(void) const throw();
 
+    /// number of instructions, not counting labels and NOPs
+    unsigned code_size(void) const throw();
+
+    /// can this block fall through to the next block?
+    bool falls_through(void) const throw();
+
     /// getters
     const std::set<basic_block *> &predecessors(void) const throw();
     const std::set<basic_block *> &successors(void) const throw();
@@ -118,6 +129,10 @@ public:
 
     /// replace a temporary register with a non-temporary register
     void replace_temp_reg(simple_reg *) throw();
+
+    /// copy the instructions of this block after some instruction; returns
+    /// the last copy
+    simple_instr *copy_after(simple_instr *) const throw();
 };
 
 /// iterator for basic blocks
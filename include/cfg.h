@@ -13,7 +13,10 @@ extern "C" {
 #   include <simple.h>
 }
 
+#include <map>
+
 #include "include/basic_block.h"
+#include "include/label_map.h"
 
 /// represents a control-flow graph
 class cfg {
@@ -26,11 +29,30 @@ private:
 
     simple_instr *instr_list;
 
+    /// maps labels to the blocks that they begin; kept across rebuilds
+    label_map labels;
+
+    /// profiled execution counts, by the labels that begin blocks; kept
+    /// across rebuilds
+    std::map<const simple_sym *, unsigned> counts;
+
+    /// has the graph been edited since the reachability of its blocks was
+    /// last computed?
+    bool is_reachability_dirty;
+
     /// create a new basic block
     basic_block *make_bb(simple_instr *, simple_instr *, unsigned) throw();
 
     static void connect_bbs(basic_block *, basic_block *) throw();
 
+    void build(void) throw();
+    void find_count(basic_block *, const simple_sym *) throw();
+    void clear(void) throw();
+    void link(void) throw();
+
+    cfg(const cfg &) throw();
+    cfg &operator=(const cfg &) throw();
+
 public:
 
     /// create a control-flow graph from a sequence of instructions
@@ -38,6 +60,9 @@ public:
 
     ~cfg(void) throw();
 
+    /// rebuild the control-flow graph from a sequence of instructions
+    void rebuild(simple_instr *) throw();
+
     basic_block_iterator begin(void) throw();
     const basic_block_iterator end(void) const throw();
 
@@ -48,6 +73,45 @@ public:
 
     void relink(void) throw();
 
+    /// record how many times a block ran in a profile; the count stays with
+    /// the label that begins the block when the graph is rebuilt
+    void set_count(basic_block *, unsigned) throw();
+
+    /// edit the graph in place. These keep the successor/predecessor
+    /// relations and the instruction counts up to date, so that the graph
+    /// doesn't need to be rebuilt. The reachability of the blocks from the
+    /// entry/exit blocks is only recomputed by update_reachability, so that
+    /// many edits cost one traversal; analyses of the graph (e.g. dominators)
+    /// are out of date afterward.
+
+    /// the block that begins with a label, or 0 if there is none
+    basic_block *find_block(const simple_sym *) throw();
+
+    /// remove the edge from one block to another, after the last instruction
+    /// of the first block was changed to no longer go to the second
+    void remove_edge(basic_block *, basic_block *) throw();
+
+    /// make the last instruction of a block branch/jump to another block
+    /// instead of to some block; returns false if it can't be done
+    bool redirect_branch(basic_block *, basic_block *, basic_block *) throw();
+
+    /// split a block after some instruction in it; returns the new block
+    /// that holds the rest of the instructions
+    basic_block *split_block(basic_block *, simple_instr *) throw();
+
+    /// merge the next block into a block, if the block only goes to the next
+    /// block and the next block is only reached from the block; returns false
+    /// if it can't be done
+    bool merge_blocks(basic_block *) throw();
+
+    /// remove a block that isn't reachable from the entry block, and free
+    /// its instructions
+    void remove_block(basic_block *) throw();
+
+    /// recompute which blocks are reachable from the entry/exit blocks, if
+    /// the graph was edited since they were last computed
+    void update_reachability(void) throw();
+
     bool for_each_basic_block(bool (*callback)(basic_block *));
 
     // allow passing of some info to the callback
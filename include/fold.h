@@ -0,0 +1,114 @@
+/*
+ * fold.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_FOLD_H_
+#define project_FOLD_H_
+
+#include <stdint.h>
+
+extern "C" {
+#   include <simple.h>
+}
+
+/// typed constant folding, shared by constant folding and the abstract
+/// interpreter. Integer values are computed in 64 bits, using signed or
+/// unsigned arithmetic as their types say, and are then truncated (and sign-
+/// or zero-extended) to the width of the destination type. Floating point
+/// values are computed as doubles and rounded to floats when the destination
+/// is 32 bits wide.
+///
+/// an integer constant is held in the (32 bit) int of a simple_immed, which
+/// an LDC sign-extends into wider registers; results that can't be held like
+/// that aren't folded.
+namespace fold {
+
+    enum {
+        MAX_INT_BITS = 64
+    };
+
+    /// the kind of arithmetic done on values of some type
+    typedef enum {
+        NO_ARITH,
+        SIGNED_ARITH,
+        UNSIGNED_ARITH,
+        FLOAT_ARITH
+    } arith_kind;
+
+    /// the kind of arithmetic done on a type; types that are too wide to be
+    /// computed with exactly have no arithmetic
+    arith_kind arithmetic_of(const simple_type *) throw();
+
+    bool is_integral(const simple_type *) throw();
+
+    /// the number of bits in an integral type
+    int int_bits(const simple_type *) throw();
+
+    /// truncate an integer to the width of a type, then sign- or zero-extend
+    /// it back to 64 bits
+    int64_t normalize(int64_t, const simple_type *) throw();
+
+    /// the value of an integer constant, as seen through some type
+    int64_t int_value(const simple_immed &, const simple_type *) throw();
+
+    /// make an integer constant of some type; fails if an LDC can't load the
+    /// value
+    bool make_int(simple_immed &, int64_t, const simple_type *) throw();
+
+    void make_float(simple_immed &, double, const simple_type *) throw();
+
+    /// a value of some type. Integers are held in 64 bits, truncated and
+    /// then sign- or zero-extended from the width of their type, and
+    /// floating point values are held as doubles.
+    struct value {
+    public:
+        int64_t i;
+        double f;
+    };
+
+    /// compute a unary operator on a value; fails if the result is undefined
+    bool unary(
+        simple_op op,
+        const simple_type *a_type,
+        const value &a,
+        const simple_type *dst_type,
+        value &result
+    ) throw();
+
+    /// compute a binary operator on values; fails if the result is undefined,
+    /// e.g. for division by zero
+    bool binary(
+        simple_op op,
+        const simple_type *a_type,
+        const value &a,
+        const simple_type *b_type,
+        const value &b,
+        const simple_type *dst_type,
+        value &result
+    ) throw();
+
+    /// fold a unary operator
+    bool unary(
+        simple_op op,
+        const simple_type *a_type,
+        const simple_immed &a,
+        const simple_type *dst_type,
+        simple_immed &result
+    ) throw();
+
+    /// fold a binary operator
+    bool binary(
+        simple_op op,
+        const simple_type *a_type,
+        const simple_immed &a,
+        const simple_type *b_type,
+        const simple_immed &b,
+        const simple_type *dst_type,
+        simple_immed &result
+    ) throw();
+}
+
+#endif /* project_FOLD_H_ */
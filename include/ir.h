@@ -0,0 +1,166 @@
+/*
+ * ir.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_IR_H_
+#define project_IR_H_
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <map>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+#include <stdint.h>
+
+/// a compact binary format for the instructions of procedures.
+///
+/// A file is a header followed by one chunk per procedure, so procedures are
+/// written one at a time as they are compiled. Everything is a little-endian
+/// 32 bit word, so a chunk is read where it is in a memory-mapped file,
+/// without copying it. A chunk is:
+///
+///     header      CHUNK_MAGIC, size of the chunk in words, then the number
+///                 of types, symbols, registers, instructions, extra words
+///                 and string words, and the offset of the name in the
+///                 strings
+///     types       (base, len) of each type
+///     symbols     (kind, offset of the name in the strings) of each symbol
+///     registers   (kind, num, type) of each register
+///     instrs      INSTR_WORDS words per instruction: its opcode, its type
+///                 plus one (zero means no type), then its operands; registers
+///                 are their index plus one, and symbols are their index
+///     extra       the targets of MBRs and the arguments of CALLs
+///     strings     nul-terminated names, padded to a word
+///
+/// If the ECE540_IR_SAVE environment variable names a file, then each
+/// procedure is written there as it comes from SUIF. If ECE540_IR_LOAD names
+/// such a file, then each procedure that is in the file is replaced by the
+/// one in the file before it's optimized, e.g. to optimize procedures that
+/// were changed or made by other tools. Registers and symbols of the saved
+/// procedure are matched to those of the procedure from SUIF by their number
+/// and name; missing labels and registers are made, but missing variables
+/// and procedures can't be, so such procedures aren't replaced.
+///
+/// ECE540_IR_LOAD can also name a text file, which is how small procedures
+/// are written by hand (e.g. the tests in tests/*.ir). Each procedure starts
+/// with `proc NAME`, and is followed by one label or instruction per line:
+///
+///     proc main
+///     L1:                         # a label
+///         ldc t1 = 0              # an integer, float or symbol (&A+4)
+///         add r2 = r2, t1         # most instructions: dst = src1, src2
+///         load r3:a = t2          # a type suffix (:a, :u, :f) on first use
+///         str t2, r3              # str/mcpy: address, value
+///         bfalse r3, L1           # jmp/btrue/bfalse: [src,] label
+///         mbr r3, 0, L2, L1, L2   # src, offset, default, targets
+///         call r4 = t3(r2, r3)    # result (optional), procedure(args)
+///         ret r2
+///
+/// Registers are pseudo (r) or temporary (t), and are always made anew,
+/// in the order that they first appear; registers without a type suffix are
+/// signed. Labels are made anew too, and symbols are found by name among the
+/// variables and procedures that the procedure from SUIF uses.
+namespace ir {
+
+    enum {
+        FILE_MAGIC = 0x52493545U, // "E5IR"
+        FILE_VERSION = 1U,
+        CHUNK_MAGIC = 0x434F5250U, // "PROC"
+
+        HEADER_WORDS = 9U,
+        TYPE_WORDS = 2U,
+        SYMBOL_WORDS = 2U,
+        REGISTER_WORDS = 3U,
+        INSTR_WORDS = 8U
+    };
+
+    /// a procedure in a mapped file. The tables point into the file.
+    struct procedure_view {
+    public:
+        const char *name;
+        uint32_t num_types;
+        uint32_t num_syms;
+        uint32_t num_regs;
+        uint32_t num_instrs;
+        uint32_t num_extra;
+        const unsigned char *types;
+        const unsigned char *syms;
+        const unsigned char *regs;
+        const unsigned char *instrs;
+        const unsigned char *extra;
+        const char *strings;
+        uint32_t string_size;
+    };
+
+    /// read a little-endian word
+    inline uint32_t word(const unsigned char *words, uint32_t i) throw() {
+        const unsigned char *w(words + 4U * i);
+        return static_cast<uint32_t>(w[0])
+             | (static_cast<uint32_t>(w[1]) << 8U)
+             | (static_cast<uint32_t>(w[2]) << 16U)
+             | (static_cast<uint32_t>(w[3]) << 24U);
+    }
+
+    /// writes procedures to a file, one at a time
+    class writer {
+    private:
+        FILE *fp;
+
+        writer(const writer &) throw();
+        writer &operator=(const writer &) throw();
+
+    public:
+        writer(void) throw();
+        ~writer(void) throw();
+
+        bool open(const char *) throw();
+        bool write(const char *, simple_instr *) throw();
+        void close(void) throw();
+    };
+
+    /// maps a file of procedures into memory, and finds them by name
+    class reader {
+    private:
+        void *data;
+        size_t size;
+        std::map<std::string, procedure_view> procs;
+        std::map<std::string, std::string> texts;
+
+        reader(const reader &) throw();
+        reader &operator=(const reader &) throw();
+
+    public:
+        reader(void) throw();
+        ~reader(void) throw();
+
+        bool open(const char *) throw();
+        const procedure_view *find(const char *) const throw();
+        const std::string *find_text(const char *) const throw();
+        void close(void) throw();
+    };
+
+    /// make the instructions of a saved procedure, using the registers and
+    /// symbols of the same procedure as it came from SUIF; returns 0 if some
+    /// symbol can't be found
+    simple_instr *decode(const procedure_view &, simple_instr *) throw();
+
+    /// make the instructions of a procedure written as text, using the
+    /// symbols of the same procedure as it came from SUIF; returns 0 (after
+    /// a warning) if the text is malformed
+    simple_instr *assemble(const std::string &, simple_instr *) throw();
+
+    /// save a procedure to the file named by ECE540_IR_SAVE, if it's set
+    void save(const char *, simple_instr *) throw();
+
+    /// replace a procedure by the one in the file named by ECE540_IR_LOAD, if
+    /// it's set and the procedure is in it
+    simple_instr *load(const char *, simple_instr *) throw();
+}
+
+#endif /* project_IR_H_ */
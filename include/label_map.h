@@ -0,0 +1,64 @@
+/*
+ * label_map.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_LABEL_MAP_H_
+#define project_LABEL_MAP_H_
+
+#include <vector>
+
+extern "C" {
+#   include <simple.h>
+}
+
+class basic_block;
+
+/// an open-addressed hash table from labels to the basic blocks that they
+/// begin, that also remembers which labels are branched to. Clearing the
+/// table is constant time (old entries are recognized by their generation),
+/// so one table can be reused every time the CFG is rebuilt.
+class label_map {
+private:
+
+    struct slot {
+    public:
+        simple_sym *label;
+        basic_block *block;
+        unsigned generation;
+        bool is_used;
+    };
+
+    std::vector<slot> slots;
+    unsigned generation;
+    unsigned num_labels;
+
+    slot *find(const simple_sym *) throw();
+    slot &insert(simple_sym *) throw();
+    void grow(void) throw();
+
+    label_map(const label_map &) throw();
+    label_map &operator=(const label_map &) throw();
+
+public:
+
+    label_map(void) throw();
+
+    /// forget every label
+    void clear(void) throw();
+
+    /// note that some branch/jump targets a label
+    void use(simple_sym *) throw();
+
+    /// is a label targeted by any branch/jump?
+    bool is_used(const simple_sym *) throw();
+
+    /// the basic block that a label begins, or 0 if it isn't known
+    basic_block *block(const simple_sym *) throw();
+
+    void set_block(simple_sym *, basic_block *) throw();
+};
+
+#endif /* project_LABEL_MAP_H_ */
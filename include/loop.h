@@ -9,6 +9,7 @@
 #ifndef asn2_LOOP_H_
 #define asn2_LOOP_H_
 
+#include <map>
 #include <set>
 #include <vector>
 #include <utility>
@@ -40,10 +41,32 @@ public:
     std::set<basic_block *> body;
     std::vector<basic_block *> tails;
 
+    /// the blocks outside of the loop that are successors of blocks inside
+    /// of the loop
+    std::vector<basic_block *> exits;
+
+    /// the innermost loop enclosing this loop (0 if this is an outermost
+    /// loop), and the loops directly nested in this loop
+    loop *parent;
+    std::vector<loop *> children;
+
+    /// how deeply this loop is nested; outermost loops have depth 1
+    unsigned depth;
+
     explicit loop(void) throw();
     ~loop(void) throw();
 };
 
+/// represents a cycle in the CFG that can be entered through more than one
+/// block, so that no block dominates the others (an irreducible loop)
+struct irreducible_loop {
+public:
+    std::set<basic_block *> body;
+
+    /// the blocks of the body that have predecessors outside of the body
+    std::vector<basic_block *> entries;
+};
+
 // comparison for pairs of basic blocks; natural comparison (lexicographic)
 // as opposed to the default of pointer comparison.
 namespace std {
@@ -66,38 +89,28 @@ namespace std {
             }
         }
     };
-
-    template <>
-    struct less<loop *> : public binary_function<loop *, loop *, bool> {
-    public:
-        bool operator()(const loop *a, const loop *b) const throw() {
-            if(a->head < b->head) {
-                return true;
-
-            } else if(b->head < a->head) {
-                return false;
-
-            // a.head == b.head
-            } else {
-                return lexicographical_compare(
-                    a->tails.begin(), a->tails.end(),
-                    b->tails.begin(), b->tails.end()
-                );
-            }
-        }
-    };
 }
 
-/// represents a mapping of loops
+/// represents a mapping of loops, as a forest of nested loops
 class loop_map {
 private:
 
     unsigned num_loops;
     loop *loops_;
 
+    /// outermost loops
+    std::vector<loop *> roots;
+
+    /// all loops, where nested loops come before their enclosing loops
+    std::vector<loop *> nested_first;
+
+    /// the innermost loop containing each block that is in some loop
+    std::map<basic_block *, loop *> innermost;
+
     friend void find_loops(cfg &, dominator_map &, loop_map &) throw();
 
     void clean_up(void) throw();
+    void nest(void) throw();
 
 public:
 
@@ -106,6 +119,24 @@ public:
 
     unsigned size(void) const throw();
 
+    /// the loops that aren't nested in any other loop
+    const std::vector<loop *> &outermost_loops(void) const throw();
+
+    /// every loop, ordered so that nested loops are visited before their
+    /// enclosing loops
+    const std::vector<loop *> &inner_to_outer(void) const throw();
+
+    /// the innermost loop containing a block, or 0 if the block isn't in a
+    /// loop
+    loop *innermost_loop(basic_block *) const throw();
+
+    /// the number of loops containing a block
+    unsigned depth(basic_block *) const throw();
+
+    /// a rough estimate of how often a block runs relative to a block outside
+    /// of any loop, assuming that each loop runs a fixed number of times
+    unsigned weight(basic_block *) const throw();
+
     template <typename T0>
     bool for_each_loop(bool (*func)(loop &, T0 &), T0 &t0) throw() {
         loop *it(loops_), *end(loops_ + num_loops);
@@ -121,4 +152,7 @@ public:
 /// find alll loops; allows us to re-initiliaze a loop map.
 void find_loops(cfg &, dominator_map &, loop_map &) throw();
 
+/// find the irreducible loops of a CFG, without changing the CFG
+void find_irreducible_loops(cfg &, std::vector<irreducible_loop> &) throw();
+
 #endif /* asn2_LOOP_H_ */
@@ -0,0 +1,21 @@
+/*
+ * bp.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_BP_H_
+#define project_BP_H_
+
+#include "include/loop.h"
+
+class cfg;
+class optimizer;
+
+/// reorder basic blocks so that the likely successor of each block falls
+/// through from it, which rotates loops so that they test at the bottom and
+/// removes jumps to the next block
+void place_blocks(optimizer &, cfg &, loop_map &) throw();
+
+#endif /* project_BP_H_ */
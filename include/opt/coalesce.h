@@ -0,0 +1,20 @@
+/*
+ * coalesce.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_COALESCE_H_
+#define project_COALESCE_H_
+
+#include "include/data_flow/var_use.h"
+
+class cfg;
+class optimizer;
+
+/// merge copy-related pseudo registers whose live ranges don't interfere,
+/// and remove the copies between them
+void coalesce_registers(optimizer &, cfg &, var_use_map &) throw();
+
+#endif /* project_COALESCE_H_ */
@@ -12,8 +12,9 @@
 class cfg;
 class optimizer;
 class available_expression_map;
+class summary_map;
 
-void eliminate_common_sub_expressions(optimizer &, cfg &, available_expression_map &) throw();
+void eliminate_common_sub_expressions(optimizer &, cfg &, available_expression_map &, summary_map &) throw();
 
 
 #endif /* project_CSE_H_ */
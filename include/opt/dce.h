@@ -12,8 +12,9 @@
 #include "include/optimizer.h"
 
 class cfg;
+class summary_map;
 
 /// eliminate all dead and unreachable code
-void eliminate_dead_code(optimizer &, cfg &, use_def_map &) throw();
+void eliminate_dead_code(optimizer &, cfg &, use_def_map &, summary_map &) throw();
 
 #endif /* project_DCE_H_ */
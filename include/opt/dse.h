@@ -0,0 +1,19 @@
+/*
+ * dse.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_DSE_H_
+#define project_DSE_H_
+
+class cfg;
+class optimizer;
+class alias_map;
+class summary_map;
+
+/// remove stores that are overwritten before they can be read
+void eliminate_dead_stores(optimizer &, cfg &, alias_map &, summary_map &) throw();
+
+#endif /* project_DSE_H_ */
@@ -15,6 +15,8 @@ extern "C" {
 }
 
 class optimizer;
+class summary_map;
+class loop_map;
 
 namespace eval {
     typedef enum {
@@ -30,7 +32,7 @@ eval::breakpoint_status abstract_evaluator_bp(
     simple_instr *break_point
 ) throw();
 
-void abstract_evaluator(optimizer &) throw();
+void abstract_evaluator(optimizer &, summary_map &, loop_map &) throw();
 
 
 #endif /* project_EVAL_H_ */
@@ -14,7 +14,14 @@
 class optimizer;
 class cfg;
 class loop_map;
+struct loop;
 
 void hoist_loop_invariant_code(optimizer &, cfg &, loop_map &) throw();
 
+/// try to prove that a loop will execute its body at least once. If the
+/// proof goes past a branch out of the loop, then that branch's block is
+/// returned in the last argument: on the first iteration, the loop doesn't
+/// exit from it.
+bool try_prove_loop_will_run(optimizer &, loop &, basic_block *&) throw();
+
 #endif /* project_LICM_H_ */
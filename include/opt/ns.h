@@ -0,0 +1,18 @@
+/*
+ * ns.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_NS_H_
+#define project_NS_H_
+
+class optimizer;
+class cfg;
+
+/// make irreducible loops reducible by copying all but one of their entry
+/// blocks (node splitting), so that the loop passes can work on them
+void split_irreducible_loops(optimizer &, cfg &) throw();
+
+#endif /* project_NS_H_ */
@@ -0,0 +1,20 @@
+/*
+ * rle.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_RLE_H_
+#define project_RLE_H_
+
+class cfg;
+class optimizer;
+class alias_map;
+class summary_map;
+
+/// replace loads of memory whose value is already in a register (because of
+/// an earlier load or store) with copies
+void eliminate_redundant_loads(optimizer &, cfg &, alias_map &, summary_map &) throw();
+
+#endif /* project_RLE_H_ */
@@ -0,0 +1,21 @@
+/*
+ * sb.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_SB_H_
+#define project_SB_H_
+
+#include "include/data_flow/dom.h"
+
+class cfg;
+class optimizer;
+
+/// grow basic blocks so that the local optimizations see longer regions:
+/// blocks only reached by a jump are moved up to the jump, and small join
+/// blocks are duplicated into the blocks that jump to them
+void form_superblocks(optimizer &, cfg &, dominator_map &) throw();
+
+#endif /* project_SB_H_ */
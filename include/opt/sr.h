@@ -0,0 +1,21 @@
+/*
+ * sr.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_SR_H_
+#define project_SR_H_
+
+class cfg;
+class optimizer;
+class loop_map;
+class alias_map;
+class summary_map;
+
+/// keep memory locations with loop-invariant addresses in registers for the
+/// duration of a loop (scalar replacement)
+void replace_loop_scalars(optimizer &, cfg &, loop_map &, alias_map &, summary_map &) throw();
+
+#endif /* project_SR_H_ */
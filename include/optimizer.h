@@ -21,6 +21,8 @@
 #include "include/loop.h"
 #include "include/use_def.h"
 #include "include/def_use.h"
+#include "include/summary.h"
+#include "include/alias.h"
 #include "include/unsafe_cast.h"
 
 
@@ -37,7 +39,7 @@ public:
 private:
 
     struct dirty_state {
-        unsigned padding_:24;
+        unsigned padding_:23;
         unsigned cfg:1;
         unsigned doms:1;
         unsigned ae:1;
@@ -46,6 +48,7 @@ private:
         unsigned ud:1;
         unsigned du:1;
         unsigned loops:1;
+        unsigned aliases:1;
     } dirty;
 
     bool changed_something;
@@ -60,6 +63,11 @@ private:
     use_def_map                 ud_chain;
     def_use_map                 du_chain;
     loop_map                    loops;
+    alias_map                   aliases;
+
+    /// summaries of previously optimized procedures; these outlive the
+    /// optimizer
+    summary_map                 &summaries;
 
     /// type tag; used only to distinguish among overloaded functions below
     template <typename T>
@@ -76,6 +84,8 @@ private:
     static loop_map &get(optimizer &self, tag<loop_map>, bool) throw();
     static use_def_map &get(optimizer &self, tag<use_def_map>, bool) throw();
     static def_use_map &get(optimizer &self, tag<def_use_map>, bool) throw();
+    static summary_map &get(optimizer &self, tag<summary_map>, bool) throw();
+    static alias_map &get(optimizer &self, tag<alias_map>, bool) throw();
 
     /// optimization pass unwrappers, allow for easily storing optimization
     /// pass functions using the same type, but then manually figuring out and
@@ -137,11 +147,12 @@ private:
 
 public:
 
-    optimizer(simple_instr *) throw();
+    optimizer(simple_instr *, summary_map &) throw();
 
     void changed_def(void) throw();
     void changed_use(void) throw();
     void changed_block(void) throw();
+    void changed_graph(void) throw();
     void removed_nop(void) throw();
 
     /// functions to add optimizations passes to the optimizer
@@ -200,6 +211,12 @@ public:
     /// anything was done
     bool run(pass &) throw();
 
+    /// get something, which is only recomputed if it is out of date
+    template <typename T>
+    T &get(void) throw() {
+        return get(*this, tag<T>(), false);
+    }
+
     /// forcefully get something
     template <typename T>
     T &force_get(void) throw() {
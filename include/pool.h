@@ -0,0 +1,67 @@
+/*
+ * pool.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_POOL_H_
+#define project_POOL_H_
+
+#include <vector>
+
+/// a simple slab allocator for objects that all die at the same time. Objects
+/// are handed out of fixed-size chunks and are never individually freed; the
+/// whole pool is released by clear() or when the pool is destroyed. Objects
+/// in the pool are default-constructed and their destructors are only run
+/// when their chunk is freed.
+template <typename T, unsigned CHUNK_SIZE=256U>
+class pool {
+private:
+
+    std::vector<T *> chunks;
+
+    /// index of the next free object in the last chunk
+    unsigned next;
+
+    pool(const pool &) throw();
+    pool &operator=(const pool &) throw();
+
+public:
+
+    pool(void) throw()
+        : next(CHUNK_SIZE)
+    { }
+
+    ~pool(void) throw() {
+        clear();
+    }
+
+    /// get a new object from the pool
+    T *allocate(void) throw() {
+        if(CHUNK_SIZE <= next) {
+            chunks.push_back(new T[CHUNK_SIZE]);
+            next = 0U;
+        }
+        return &(chunks.back()[next++]);
+    }
+
+    /// free every object in the pool
+    void clear(void) throw() {
+        for(unsigned i(0); i < chunks.size(); ++i) {
+            delete [] chunks[i];
+        }
+        chunks.clear();
+        next = CHUNK_SIZE;
+    }
+
+    /// the number of objects handed out since the last clear
+    unsigned size(void) const throw() {
+        if(chunks.empty()) {
+            return 0U;
+        }
+        return (chunks.size() - 1U) * CHUNK_SIZE + next;
+    }
+};
+
+#endif /* project_POOL_H_ */
@@ -0,0 +1,51 @@
+/*
+ * profile.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_PROFILE_H_
+#define project_PROFILE_H_
+
+extern "C" {
+#   include <simple.h>
+}
+
+class cfg;
+
+/// basic block execution counts.
+///
+/// If the ECE540_PROFILE_GENERATE environment variable is set, then
+/// procedures are instrumented instead of optimized: every basic block adds
+/// one to its own counter, and the counters are written out by the profiling
+/// runtime (proj_tests/ece540_profile.h) when main returns or exit is called.
+///
+/// If ECE540_PROFILE_USE is set to the file that the runtime wrote, then the
+/// counts are read back and attached to the basic blocks of each procedure.
+///
+/// Blocks are numbered in the order of the CFG of the unoptimized procedure,
+/// and each procedure gets a range of counters in the order that procedures
+/// are compiled. The first counter of each range holds a signature of the
+/// procedure (its name and number of blocks), so that the counts of a
+/// procedure that has since changed are ignored.
+namespace profile {
+
+    /// should procedures be instrumented instead of optimized?
+    bool is_generating(void) throw();
+
+    /// should the counts of an earlier run be attached to blocks?
+    bool is_using(void) throw();
+
+    /// look for the symbols of the profiling runtime in the instructions of a
+    /// procedure; the runtime must come before any instrumented procedure
+    void find_runtime(simple_instr *) throw();
+
+    /// add counters to the blocks of a procedure
+    void instrument(const char *, cfg &) throw();
+
+    /// attach the profiled counts of a procedure to its blocks
+    void attach(const char *, cfg &) throw();
+}
+
+#endif /* project_PROFILE_H_ */
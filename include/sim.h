@@ -0,0 +1,58 @@
+/*
+ * sim.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_SIM_H_
+#define project_SIM_H_
+
+class optimizer;
+
+/// a simulator that runs a whole program before and after it is optimized,
+/// and counts the instructions that run.
+///
+/// If the ECE540_SIMULATE environment variable is set, then each procedure is
+/// recorded before and after it is optimized, and once the file is compiled,
+/// main is run on both versions. The number of instructions that ran (other
+/// than labels and nops) is reported to stderr, in total, by procedure and by
+/// opcode, along with whether both versions did the same thing.
+///
+/// Then each procedure is run on its own, ECE540_SIM_TRIALS times (default
+/// 20), on random arguments (see ECE540_SIM_SEED), and the two versions are
+/// compared: they have to stop the same way, return the same value, make the
+/// same I/O calls, and leave memory the same. Trials where the unoptimized
+/// procedure traps, or where either version runs for too long, don't count.
+///
+/// Procedures in the file call each other. Other procedures are stubs of the
+/// C library: I/O procedures don't do anything besides recording their
+/// arguments in a trace, malloc and friends allocate from a heap, and the
+/// string and math procedures work. Calls to anything else return zero.
+///
+/// Simple-SUIF doesn't say how big symbols are, nor what their initial values
+/// are. Each symbol gets an equal part of the bottom half of the address
+/// space (the more symbols, the smaller the parts), and starts out zeroed.
+/// The contents of string literals are therefore unknown. Variables of a
+/// procedure are in static storage, i.e. they are shared by recursive calls.
+/// The parameters of a procedure are taken to be the pseudo registers that
+/// are live on entry to it, in the order they were made; a parameter that
+/// is never used therefore shifts the ones after it.
+namespace sim {
+
+    /// is the simulator on?
+    bool is_simulating(void) throw();
+
+    /// record a procedure before it is optimized
+    void record_before(const char *, optimizer &) throw();
+
+    /// record a procedure after it is optimized
+    void record_after(const char *, optimizer &) throw();
+
+    /// run the program and its procedures before and after they were
+    /// optimized, and report (to stderr) what ran; returns false if the two
+    /// versions did different things
+    bool report(void) throw();
+}
+
+#endif /* project_SIM_H_ */
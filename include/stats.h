@@ -0,0 +1,22 @@
+/*
+ * stats.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_STATS_H_
+#define project_STATS_H_
+
+/// named counters of how often optimizations fire; these are reported per
+/// procedure if the ECE540_STATS environment variable is set.
+namespace stats {
+
+    /// add to a named counter
+    void count(const char *, unsigned=1U) throw();
+
+    /// report (to stderr) and then reset all counters for a procedure
+    void report(const char *) throw();
+}
+
+#endif /* project_STATS_H_ */
@@ -0,0 +1,85 @@
+/*
+ * summary.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#ifndef project_SUMMARY_H_
+#define project_SUMMARY_H_
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <map>
+#include <string>
+
+/// summarizes the side-effects of a procedure so that its call sites can be
+/// reasoned about by the optimization passes.
+struct procedure_summary {
+public:
+
+    /// the procedure (or one of its callees) loads from memory
+    bool reads_memory;
+
+    /// the procedure (or one of its callees) stores to memory
+    bool writes_memory;
+
+    /// the procedure might not terminate, i.e. it has a backward branch or
+    /// calls something that might not terminate
+    bool may_loop;
+
+    /// the procedure calls something that we don't have a summary for, e.g.
+    /// a library function, a function pointer, or itself.
+    bool calls_unknown;
+
+    /// every return of the procedure returns the same constant
+    bool returns_constant;
+    simple_immed return_value;
+
+    procedure_summary(void) throw();
+
+    /// the result of the procedure depends only on its arguments, and it does
+    /// nothing observable
+    bool is_pure(void) const throw();
+
+    /// the procedure does nothing observable except (possibly) reading memory
+    bool is_read_only(void) const throw();
+
+    /// a call to the procedure can be removed if its result is not used
+    bool is_removable(void) const throw();
+
+    /// a call to the procedure can be replaced by its return value
+    bool is_constant(void) const throw();
+};
+
+/// maps procedure names to their summaries. Procedures are summarized after
+/// they are optimized, and so summaries are built bottom-up over the call
+/// graph as long as callees are defined before their callers in the input
+/// file. Anything else (forward references, recursion, library functions) is
+/// treated as unknown.
+class summary_map {
+private:
+
+    std::map<std::string, procedure_summary> summaries;
+
+public:
+
+    /// summarize a procedure, given its optimized instructions
+    void summarize(const char *, simple_instr *) throw();
+
+    /// find the summary for a procedure by name; returns 0 if the procedure
+    /// is unknown
+    const procedure_summary *find(const char *) const throw();
+
+    /// find the summary of the procedure called by a CALL instruction;
+    /// returns 0 if the callee can't be statically determined or is unknown
+    const procedure_summary *find(const simple_instr *) const throw();
+
+    /// find the symbol of the procedure called by a CALL instruction, or 0 if
+    /// the callee can't be statically determined
+    static simple_sym *callee(const simple_instr *) throw();
+};
+
+#endif /* project_SUMMARY_H_ */
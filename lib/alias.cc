@@ -0,0 +1,705 @@
+/*
+ * alias.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <vector>
+
+#include "include/alias.h"
+#include "include/cfg.h"
+#include "include/loop.h"
+#include "include/basic_block.h"
+#include "include/data_flow/var_def.h"
+
+/// limit on how far back we look through definitions when computing symbolic
+/// addresses
+enum {
+    MAX_ADDRESS_DEPTH = 16
+};
+
+points_to::points_to(void) throw()
+    : kind(BOTTOM)
+    , constant(0)
+{ }
+
+points_to::points_to(kind_type kind_) throw()
+    : kind(kind_)
+    , constant(0)
+{ }
+
+/// join another value into this one; returns true iff this value changed
+bool points_to::join(const points_to &that) throw() {
+    if(BOTTOM == that.kind || TOP == kind) {
+        return false;
+    }
+
+    if(BOTTOM == kind) {
+        *this = that;
+        return true;
+    }
+
+    if(TOP == that.kind) {
+        *this = that;
+        offsets.clear();
+        return true;
+    }
+
+    // null pointers don't point to anything
+    if(ADDRESS == kind && CONSTANT == that.kind && 0 == that.constant) {
+        return false;
+    } else if(CONSTANT == kind && 0 == constant && ADDRESS == that.kind) {
+        *this = that;
+        return true;
+    }
+
+    switch(kind) {
+    case CONSTANT:
+        if(CONSTANT == that.kind) {
+            if(constant == that.constant) {
+                return false;
+            }
+            kind = INTEGER;
+            return true;
+        } else if(INTEGER == that.kind) {
+            kind = INTEGER;
+            return true;
+        }
+        break;
+
+    case INTEGER:
+        if(CONSTANT == that.kind || INTEGER == that.kind) {
+            return false;
+        }
+        break;
+
+    case ADDRESS:
+        if(ADDRESS == that.kind) {
+            bool changed(false);
+            std::map<simple_sym *, int>::const_iterator it(that.offsets.begin())
+                                                      , end(that.offsets.end());
+            for(; it != end; ++it) {
+                std::map<simple_sym *, int>::iterator pos(offsets.find(it->first));
+                if(offsets.end() == pos) {
+                    offsets[it->first] = it->second;
+                    changed = true;
+                } else if(ANY_OFFSET != pos->second && pos->second != it->second) {
+                    pos->second = ANY_OFFSET;
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    // mixing integers and addresses; give up
+    kind = TOP;
+    offsets.clear();
+    return true;
+}
+
+bool points_to::operator==(const points_to &that) const throw() {
+    return kind == that.kind
+        && constant == that.constant
+        && offsets == that.offsets;
+}
+
+bool points_to::operator!=(const points_to &that) const throw() {
+    return !(*this == that);
+}
+
+bool address_leaf::operator<(const address_leaf &that) const throw() {
+    if(reg == that.reg) {
+        return def < that.def;
+    }
+    return reg < that.reg;
+}
+
+bool address_leaf::operator==(const address_leaf &that) const throw() {
+    return reg == that.reg && def == that.def;
+}
+
+symbolic_address::symbolic_address(void) throw()
+    : is_valid(false)
+    , base(0)
+    , offset(0)
+{ }
+
+/// do two addresses differ only by their constant offsets?
+bool symbolic_address::is_comparable(const symbolic_address &that) const throw() {
+    return is_valid && that.is_valid
+        && base == that.base
+        && terms == that.terms;
+}
+
+namespace {
+
+    /// the value of registers that we know nothing about, e.g. those that are
+    /// defined by loads and calls, or those that are live on entry to the
+    /// procedure
+    static points_to unknown_value(simple_reg *reg) throw() {
+        if(ADDRESS_TYPE == reg->var->type->base) {
+            return points_to(points_to::TOP);
+        }
+        return points_to(points_to::INTEGER);
+    }
+
+    /// make a constant value
+    static points_to constant_value(int c) throw() {
+        points_to val(points_to::CONSTANT);
+        val.constant = c;
+        return val;
+    }
+
+    /// shift every offset in an address by a constant (or an unknown) amount
+    static points_to shift_address(const points_to &addr, const points_to &by, int sign) throw() {
+        points_to val(addr);
+        std::map<simple_sym *, int>::iterator it(val.offsets.begin())
+                                            , end(val.offsets.end());
+        for(; it != end; ++it) {
+            if(points_to::ANY_OFFSET == it->second
+            || points_to::CONSTANT != by.kind) {
+                it->second = points_to::ANY_OFFSET;
+            } else {
+                it->second += sign * by.constant;
+            }
+        }
+        return val;
+    }
+
+    /// the value of an ADD_OP
+    static points_to add_values(const points_to &a, const points_to &b) throw() {
+        if(points_to::ADDRESS == a.kind && points_to::ADDRESS == b.kind) {
+            points_to val(shift_address(a, points_to(points_to::INTEGER), 1));
+            val.join(shift_address(b, points_to(points_to::INTEGER), 1));
+            return val;
+
+        } else if(points_to::ADDRESS == a.kind) {
+            return shift_address(a, b, 1);
+
+        } else if(points_to::ADDRESS == b.kind) {
+            return shift_address(b, a, 1);
+
+        } else if(points_to::CONSTANT == a.kind && points_to::CONSTANT == b.kind) {
+            return constant_value(static_cast<int>(
+                static_cast<unsigned>(a.constant) + static_cast<unsigned>(b.constant)));
+        }
+        return points_to(points_to::INTEGER);
+    }
+
+    /// the value of a SUB_OP
+    static points_to sub_values(const points_to &a, const points_to &b) throw() {
+        if(points_to::ADDRESS == a.kind && points_to::ADDRESS == b.kind) {
+            return points_to(points_to::INTEGER); // pointer difference
+
+        } else if(points_to::ADDRESS == a.kind) {
+            return shift_address(a, b, -1);
+
+        } else if(points_to::ADDRESS == b.kind) {
+            return points_to(points_to::TOP);
+
+        } else if(points_to::CONSTANT == a.kind && points_to::CONSTANT == b.kind) {
+            return constant_value(static_cast<int>(
+                static_cast<unsigned>(a.constant) - static_cast<unsigned>(b.constant)));
+        }
+        return points_to(points_to::INTEGER);
+    }
+
+    /// the value of any other arithmetic operation; these can't legitimately
+    /// make pointers
+    static points_to other_values(simple_op op, const points_to &a, const points_to &b) throw() {
+        if(points_to::ADDRESS == a.kind || points_to::ADDRESS == b.kind) {
+            return points_to(points_to::TOP);
+        }
+
+        if(points_to::CONSTANT == a.kind && points_to::CONSTANT == b.kind) {
+            const unsigned ua(static_cast<unsigned>(a.constant));
+            const unsigned ub(static_cast<unsigned>(b.constant));
+            switch(op) {
+            case MUL_OP: return constant_value(static_cast<int>(ua * ub));
+            case LSL_OP: return constant_value(static_cast<int>(ua << (ub & 31U)));
+            default: break;
+            }
+        }
+        return points_to(points_to::INTEGER);
+    }
+
+    struct alias_state {
+    public:
+        std::map<simple_reg *, points_to> *values;
+        bool changed;
+    };
+
+    /// get the current value of a register during the analysis
+    static const points_to &current_value(alias_state &s, simple_reg *reg) throw() {
+        return (*s.values)[reg];
+    }
+
+    /// compute the value defined by an instruction
+    static points_to transfer(alias_state &s, simple_instr *in, simple_reg *dst) throw() {
+        switch(in->opcode) {
+        case LDC_OP:
+            switch(in->u.ldc.value.format) {
+            case IMMED_INT:
+                return constant_value(in->u.ldc.value.u.ival);
+            case IMMED_SYMBOL: {
+                points_to val(points_to::ADDRESS);
+                val.offsets[in->u.ldc.value.u.s.symbol] = in->u.ldc.value.u.s.offset;
+                return val;
+            }
+            default:
+                return points_to(points_to::INTEGER);
+            }
+
+        case LOAD_OP: case CALL_OP:
+            return unknown_value(dst);
+
+        case CPY_OP: case CVT_OP:
+            return current_value(s, in->u.base.src1);
+
+        case NEG_OP: case NOT_OP:
+            return other_values(in->opcode, current_value(s, in->u.base.src1), points_to(points_to::INTEGER));
+
+        default:
+            break;
+        }
+
+        const points_to &a(current_value(s, in->u.base.src1));
+        const points_to &b(current_value(s, in->u.base.src2));
+
+        if(points_to::BOTTOM == a.kind || points_to::BOTTOM == b.kind) {
+            return points_to(points_to::BOTTOM);
+        } else if(points_to::TOP == a.kind || points_to::TOP == b.kind) {
+            return points_to(points_to::TOP);
+        }
+
+        switch(in->opcode) {
+        case ADD_OP: return add_values(a, b);
+        case SUB_OP: return sub_values(a, b);
+        case SEQ_OP: case SNE_OP: case SL_OP: case SLE_OP:
+            return points_to(points_to::INTEGER);
+        default:
+            return other_values(in->opcode, a, b);
+        }
+    }
+
+    /// update the value of a register defined by an instruction
+    static bool update_values(basic_block *bb, alias_state &s) throw() {
+        if(0 == bb->last) {
+            return true;
+        }
+
+        for(simple_instr *in(bb->first), *end(bb->last->next);
+            in != end;
+            in = in->next) {
+
+            simple_reg *dst(0);
+            if(!for_each_var_def(in, dst)) {
+                continue;
+            }
+
+            points_to val(transfer(s, in, dst));
+
+            // don't let integers pretend to be pointers
+            if(ADDRESS_TYPE == dst->var->type->base
+            && (points_to::INTEGER == val.kind
+                || (points_to::CONSTANT == val.kind && 0 != val.constant))) {
+                val = points_to(points_to::TOP);
+            }
+
+            if((*s.values)[dst].join(val)) {
+                s.changed = true;
+            }
+        }
+        return true;
+    }
+
+    /// find the size (in bytes) of some type
+    static unsigned type_size(simple_type *type) throw() {
+        if(0 == type || type->len <= 0) {
+            return 0U;
+        }
+        return static_cast<unsigned>(type->len) / 8U;
+    }
+
+    /// check if two ranges of memory overlap; an unknown size overlaps
+    /// with everything
+    static bool overlaps(int a, unsigned a_size, int b, unsigned b_size) throw() {
+        if(0U == a_size || 0U == b_size) {
+            return true;
+        }
+        const long long la(a), lb(b);
+        return la < lb + b_size && lb < la + a_size;
+    }
+
+    /// check if the points-to sets of two memory accesses can overlap
+    static bool points_to_overlap(
+        const points_to &a,
+        unsigned a_size,
+        const points_to &b,
+        unsigned b_size
+    ) throw() {
+        if(points_to::ADDRESS != a.kind || points_to::ADDRESS != b.kind) {
+            return true;
+        }
+
+        std::map<simple_sym *, int>::const_iterator it(a.offsets.begin())
+                                                  , end(a.offsets.end());
+        for(; it != end; ++it) {
+            std::map<simple_sym *, int>::const_iterator pos(b.offsets.find(it->first));
+            if(b.offsets.end() == pos) {
+                continue;
+            }
+
+            if(points_to::ANY_OFFSET == it->second
+            || points_to::ANY_OFFSET == pos->second
+            || overlaps(it->second, a_size, pos->second, b_size)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// the region of code relative to which a symbolic address is computed
+    struct address_frame {
+    public:
+        const loop *l;
+        const std::set<simple_reg *> *loop_defs;
+    };
+
+    /// find the definition of a register, looking backward from an instruction
+    /// (inclusive) to the beginning of its basic block
+    static simple_instr *find_def_from(simple_instr *in, simple_reg *reg) throw() {
+        for(; 0 != in && LABEL_OP != in->opcode; in = in->prev) {
+            simple_reg *defd_reg(0);
+            if(for_each_var_def(in, defd_reg) && reg == defd_reg) {
+                return in;
+            }
+        }
+        return 0;
+    }
+
+    /// make a symbolic address into a leaf
+    static void make_leaf(simple_reg *reg, const simple_instr *def, symbolic_address &out) throw() {
+        address_leaf leaf;
+        leaf.reg = reg;
+        leaf.def = def;
+        out.is_valid = true;
+        out.base = 0;
+        out.offset = 0;
+        out.terms.clear();
+        out.terms[leaf] = 1;
+    }
+
+    /// add (scale * b) into a
+    static void add_address(symbolic_address &a, const symbolic_address &b, int scale) throw() {
+        if(!a.is_valid || !b.is_valid) {
+            a.is_valid = false;
+            return;
+        }
+
+        if(0 != b.base) {
+            if(0 != a.base || 1 != scale) {
+                a.is_valid = false;
+                return;
+            }
+            a.base = b.base;
+        }
+
+        a.offset = static_cast<int>(
+            static_cast<unsigned>(a.offset) + static_cast<unsigned>(scale * b.offset));
+
+        std::map<address_leaf, int>::const_iterator it(b.terms.begin())
+                                                  , end(b.terms.end());
+        for(; it != end; ++it) {
+            int &coeff(a.terms[it->first]);
+            coeff += scale * it->second;
+            if(0 == coeff) {
+                a.terms.erase(it->first);
+            }
+        }
+    }
+
+    /// is a symbolic address a plain constant?
+    static bool is_constant_address(const symbolic_address &a) throw() {
+        return a.is_valid && 0 == a.base && a.terms.empty();
+    }
+
+    static void expand_reg(
+        address_frame &, simple_instr *, bool, simple_reg *, symbolic_address &, int
+    ) throw();
+
+    /// expand the value defined by an instruction into a symbolic address
+    static void expand_def(
+        address_frame &f,
+        simple_instr *def,
+        bool in_pre_header,
+        simple_reg *reg,
+        symbolic_address &out,
+        int depth
+    ) throw() {
+        symbolic_address a, b;
+
+        switch(def->opcode) {
+        case LDC_OP:
+            if(IMMED_INT == def->u.ldc.value.format) {
+                out.is_valid = true;
+                out.offset = def->u.ldc.value.u.ival;
+                return;
+            } else if(IMMED_SYMBOL == def->u.ldc.value.format) {
+                out.is_valid = true;
+                out.base = def->u.ldc.value.u.s.symbol;
+                out.offset = def->u.ldc.value.u.s.offset;
+                return;
+            }
+            break;
+
+        case CPY_OP:
+            expand_reg(f, def->prev, in_pre_header, def->u.base.src1, out, depth + 1);
+            return;
+
+        case CVT_OP:
+            if(FLOAT_TYPE == def->u.base.src1->var->type->base
+            || FLOAT_TYPE == reg->var->type->base) {
+                break;
+            }
+            expand_reg(f, def->prev, in_pre_header, def->u.base.src1, out, depth + 1);
+            return;
+
+        case ADD_OP: case SUB_OP:
+            expand_reg(f, def->prev, in_pre_header, def->u.base.src1, a, depth + 1);
+            expand_reg(f, def->prev, in_pre_header, def->u.base.src2, b, depth + 1);
+            if(SUB_OP == def->opcode && 0 != b.base) {
+                break;
+            }
+            out = a;
+            add_address(out, b, ADD_OP == def->opcode ? 1 : -1);
+            if(!out.is_valid) {
+                break;
+            }
+            return;
+
+        case MUL_OP: case LSL_OP:
+            expand_reg(f, def->prev, in_pre_header, def->u.base.src1, a, depth + 1);
+            expand_reg(f, def->prev, in_pre_header, def->u.base.src2, b, depth + 1);
+            if(MUL_OP == def->opcode && is_constant_address(a) && 0 == b.base) {
+                out.is_valid = true;
+                add_address(out, b, a.offset);
+                return;
+            } else if(is_constant_address(b) && 0 == a.base) {
+                int scale(b.offset);
+                if(LSL_OP == def->opcode) {
+                    if(b.offset < 0 || 30 < b.offset) {
+                        break;
+                    }
+                    scale = 1 << b.offset;
+                }
+                out.is_valid = true;
+                add_address(out, a, scale);
+                return;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        // we can't look through this definition; it is a leaf, but only if it
+        // doesn't change within the loop
+        if(0 != f.l && !in_pre_header) {
+            out.is_valid = false;
+        } else {
+            make_leaf(reg, def, out);
+        }
+    }
+
+    /// expand the value of a register just after an instruction into a
+    /// symbolic address
+    static void expand_reg(
+        address_frame &f,
+        simple_instr *from,
+        bool in_pre_header,
+        simple_reg *reg,
+        symbolic_address &out,
+        int depth
+    ) throw() {
+        out = symbolic_address();
+
+        if(MAX_ADDRESS_DEPTH < depth) {
+            return;
+        }
+
+        simple_instr *def(find_def_from(from, reg));
+
+        if(0 != def) {
+            expand_def(f, def, in_pre_header, reg, out, depth);
+
+        // the value of the register on entry to the basic block
+        } else if(0 == f.l || in_pre_header) {
+            make_leaf(reg, 0, out);
+
+        // the value of the register on entry to the loop; continue into the
+        // pre-header
+        } else if(0 == f.loop_defs->count(reg)) {
+            basic_block *pre_header(f.l->pre_header);
+            if(0 != pre_header && 0 != pre_header->last) {
+                expand_reg(f, pre_header->last, true, reg, out, depth + 1);
+            } else {
+                make_leaf(reg, 0, out);
+            }
+        }
+    }
+
+    /// fill in the basics of a memory access
+    static bool make_access(
+        simple_instr *in,
+        simple_reg *addr,
+        simple_type *type,
+        memory_access &access
+    ) throw() {
+        access.in = in;
+        access.addr = addr;
+        access.size = type_size(type);
+        access.address = symbolic_address();
+        return true;
+    }
+}
+
+/// get the points-to information of a register
+const points_to &alias_map::operator()(simple_reg *reg) const throw() {
+    static const points_to top(points_to::TOP);
+    std::map<simple_reg *, points_to>::const_iterator it(values.find(reg));
+    if(values.end() == it) {
+        return top;
+    }
+    return it->second;
+}
+
+/// might two instructions access overlapping memory?
+bool alias_map::may_alias(simple_instr *a, simple_instr *b) const throw() {
+    memory_access a_accesses[2], b_accesses[2];
+    unsigned num_a(0), num_b(0);
+
+    if(find_memory_read(a, a_accesses[num_a])) ++num_a;
+    if(find_memory_write(a, a_accesses[num_a])) ++num_a;
+    if(find_memory_read(b, b_accesses[num_b])) ++num_b;
+    if(find_memory_write(b, b_accesses[num_b])) ++num_b;
+
+    for(unsigned i(0); i < num_a; ++i) {
+        for(unsigned j(0); j < num_b; ++j) {
+            if(may_alias(a_accesses[i], b_accesses[j])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// might two memory accesses overlap?
+bool alias_map::may_alias(const memory_access &a, const memory_access &b) const throw() {
+    if(!points_to_overlap((*this)(a.addr), a.size, (*this)(b.addr), b.size)) {
+        return false;
+    }
+
+    // different objects
+    if(a.address.is_valid && b.address.is_valid
+    && 0 != a.address.base && 0 != b.address.base
+    && a.address.base != b.address.base) {
+        return false;
+    }
+
+    // same object, same variable part, different constant offsets
+    if(a.address.is_comparable(b.address)) {
+        return overlaps(a.address.offset, a.size, b.address.offset, b.size);
+    }
+
+    return true;
+}
+
+/// do two memory accesses definitely access the same memory?
+bool alias_map::must_alias(const memory_access &a, const memory_access &b) const throw() {
+    return 0U != a.size
+        && a.size == b.size
+        && a.address.is_comparable(b.address)
+        && a.address.offset == b.address.offset;
+}
+
+/// find the points-to information of every register in the cfg
+void find_aliases(cfg &flow, var_use_map &var_uses, alias_map &aliases) throw() {
+    aliases.values.clear();
+
+    // registers that are live on entry to the procedure (e.g. parameters)
+    // could be anything
+    std::set<basic_block *> entry_bbs(flow.entry()->successors());
+    entry_bbs.insert(flow.entry());
+
+    std::set<basic_block *>::iterator bb_it(entry_bbs.begin())
+                                    , bb_end(entry_bbs.end());
+    for(; bb_it != bb_end; ++bb_it) {
+        var_use_set &live_in(var_uses(*bb_it));
+        var_use_set::iterator it(live_in.begin()), end(live_in.end());
+        for(; it != end; ++it) {
+            aliases.values[it->reg].join(unknown_value(it->reg));
+        }
+    }
+
+    alias_state s;
+    s.values = &(aliases.values);
+    s.changed = true;
+
+    while(s.changed) {
+        s.changed = false;
+        flow.for_each_basic_block(&update_values, s);
+    }
+}
+
+/// describe the memory read by an instruction
+bool find_memory_read(simple_instr *in, memory_access &access) throw() {
+    switch(in->opcode) {
+    case LOAD_OP:
+        return make_access(in, in->u.base.src1, in->u.base.dst->var->type, access);
+    case MCPY_OP:
+        return make_access(in, in->u.base.src2, in->type, access);
+    default:
+        return false;
+    }
+}
+
+/// describe the memory written by an instruction
+bool find_memory_write(simple_instr *in, memory_access &access) throw() {
+    switch(in->opcode) {
+    case STR_OP:
+        return make_access(in, in->u.base.src1, in->u.base.src2->var->type, access);
+    case MCPY_OP:
+        return make_access(in, in->u.base.src1, in->type, access);
+    default:
+        return false;
+    }
+}
+
+/// compute the symbolic address of a memory access relative to the beginning
+/// of its basic block
+void find_local_address(memory_access &access) throw() {
+    address_frame f;
+    f.l = 0;
+    f.loop_defs = 0;
+    expand_reg(f, access.in->prev, false, access.addr, access.address, 0);
+}
+
+/// compute the symbolic address of a memory access relative to the beginning
+/// of a loop
+void find_loop_address(
+    const loop &l,
+    const std::set<simple_reg *> &loop_defs,
+    memory_access &access
+) throw() {
+    address_frame f;
+    f.l = &l;
+    f.loop_defs = &loop_defs;
+    expand_reg(f, access.in->prev, false, access.addr, access.address, 0);
+}
@@ -6,9 +6,12 @@
  *     Version: $Id$
  */
 
+#include <map>
 #include <cassert>
+#include <cstring>
 
 #include "include/basic_block.h"
+#include "include/instr.h"
 #include "include/data_flow/var_def.h"
 #include "include/data_flow/var_use.h"
 
@@ -21,6 +24,8 @@ basic_block::basic_block(unsigned num_, simple_instr *first_, simple_instr *last
     , next(0)
     , entry_reachable(false)
     , exit_reachable(false)
+    , has_count(false)
+    , count(0U)
 {
     if(0 != first) {
         assert(0 != last && "If the first instruction is non-null then the last instruction must be non-null");
@@ -31,6 +36,28 @@ unsigned basic_block::size(void) const throw() {
     return num_instructions;
 }
 
+unsigned basic_block::code_size(void) const throw() {
+    if(0 == last) {
+        return 0U;
+    }
+
+    unsigned num(0U);
+    for(simple_instr *in(first), *end(last->next); in != end; in = in->next) {
+        if(LABEL_OP != in->opcode && NOP_OP != in->opcode) {
+            ++num;
+        }
+    }
+    return num;
+}
+
+bool basic_block::falls_through(void) const throw() {
+    if(0 == last) {
+        return true;
+    }
+    return instr::can_default_fall_through(last)
+        && !instr::is_return(last);
+}
+
 const std::set<basic_block *> &basic_block::predecessors(void) const throw() {
     return predecessors_;
 }
@@ -91,3 +118,60 @@ void basic_block::replace_temp_reg(simple_reg *temp_reg) throw() {
         }
     }
 }
+
+/// give each temporary register defined in a copied instruction a new
+/// register; temporary registers are local to their block
+static void rename_temp_use(
+    simple_reg *reg,
+    simple_reg **pos,
+    simple_instr *,
+    std::map<simple_reg *, simple_reg *> &temps
+) throw() {
+    std::map<simple_reg *, simple_reg *>::iterator it(temps.find(reg));
+    if(temps.end() != it) {
+        *pos = it->second;
+    }
+}
+
+static void rename_temp_def(
+    simple_reg *reg,
+    simple_reg **pos,
+    simple_instr *,
+    std::map<simple_reg *, simple_reg *> &temps
+) throw() {
+    if(TEMP_REG == reg->kind) {
+        *pos = temps[reg] = new_register(reg->var->type, TEMP_REG);
+    }
+}
+
+/// copy the instructions of this block (except labels and NOPs) after some
+/// instruction, giving the copies their own temporary registers. Returns the
+/// last copied instruction, or the instruction copied after if nothing was
+/// copied. Note: a copied MBR shares its table of targets with the original.
+simple_instr *basic_block::copy_after(simple_instr *after) const throw() {
+    if(0 == last) {
+        return after;
+    }
+
+    std::map<simple_reg *, simple_reg *> temps;
+    for(simple_instr *in(first), *end(last->next);
+        in != end;
+        in = in->next) {
+
+        if(LABEL_OP == in->opcode || NOP_OP == in->opcode) {
+            continue;
+        }
+
+        simple_instr *copy(new_instr(NOP_OP, 0));
+        memcpy(copy, in, sizeof *copy);
+        copy->prev = copy->next = 0;
+
+        for_each_var_use(rename_temp_use, copy, temps);
+        for_each_var_def(rename_temp_def, copy, temps);
+
+        instr::insert_after(copy, after);
+        after = copy;
+    }
+
+    return after;
+}
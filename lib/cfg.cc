@@ -6,8 +6,8 @@
  *     Version: $Id$
  */
 
-#include <map>
 #include <set>
+#include <vector>
 #include <cassert>
 #include <cstdio>
 
@@ -16,58 +16,46 @@
 #include "include/diag.h"
 #include "include/data_flow/closure.h"
 
-/// go find all labels in the instruction stream
-static void find_labels(
-    simple_instr *in,
-    std::map<simple_sym *, simple_instr *> &labels
-) throw() {
+/// find all used labels, i.e. those targeted by some branch or jump
+static void find_used_labels(simple_instr *in, label_map &labels) throw() {
     for(; 0 != in; in = in->next) {
-        if(!instr::is_label(in)) {
-            continue;
-        }
-
-        labels[in->u.label.lab] = in;
-    }
-}
-
-/// find all used labels
-static void remove_unused_labels(simple_instr *in_) throw() {
-    std::set<simple_sym *> used_labels;
-
-    // find all used labels
-    for(simple_instr *in(in_); 0 != in; in = in->next) {
         switch(in->opcode) {
         case BTRUE_OP:
         case BFALSE_OP:
         case JMP_OP:
-            used_labels.insert(in->u.bj.target);
+            labels.use(in->u.bj.target);
             break;
 
         case MBR_OP:
-            used_labels.insert(in->u.mbr.deflab);
+            labels.use(in->u.mbr.deflab);
             for(unsigned i(0); i < in->u.mbr.ntargets; ++i) {
-                used_labels.insert(in->u.mbr.targets[i]);
+                labels.use(in->u.mbr.targets[i]);
             }
         default:
             break;
         }
     }
-
-    // remove unused labels
-    for(simple_instr *in(in_); 0 != in; in = in->next) {
-        if(LABEL_OP == in->opcode
-        && 0U == used_labels.count(in->u.label.lab)) {
-            in->opcode = NOP_OP;
-        }
-    }
 }
 
-/// find the end of a basic block, starting from the input instruction
-static simple_instr *find_bb_end(simple_instr *in, unsigned &num) throw() {
+/// find the end of a basic block, starting from the input instruction. If a
+/// label map is given, then labels that aren't used are removed (replaced with
+/// NOPs) along the way; this will allow us to more aggressively concatenate
+/// basic blocks after multiple optimization passes.
+static simple_instr *find_bb_end(
+    simple_instr *in,
+    unsigned &num,
+    label_map *used_labels
+) throw() {
     simple_instr *prev(0);
     for(simple_instr *curr(in); 0 != curr; prev = curr, curr = curr->next) {
         ++num;
 
+        if(0 != used_labels
+        && instr::is_label(curr)
+        && !used_labels->is_used(curr->u.label.lab)) {
+            curr->opcode = NOP_OP;
+        }
+
         if(instr::is_local_control_flow_transfer(curr)
         || instr::is_return(curr)) {
             return curr;
@@ -94,51 +82,40 @@ void cfg::connect_bbs(basic_block *pred, basic_block *succ) throw() {
     succ->predecessors_.insert(pred);
 }
 
-/// given a symbol, look up the instruction and then block that this symbol
-/// should bring us to. Checks for usage of unknown symbols, and if its a
-/// good use, then it removes from the set of unused symbols.
-static basic_block *lookup_and_use_label(
-    simple_sym *sym,
-    std::map<simple_sym *, simple_instr *> &sym_to_instr,
-    std::map<simple_instr *, basic_block *> &instr_to_block
-) throw() {
+/// given a symbol, look up the block that this symbol should bring us to.
+static basic_block *lookup_label(simple_sym *sym, label_map &labels) throw() {
     if(0 == sym) {
         diag::error("Found a null symbol.");
         return 0;
     }
 
-    if(0U == sym_to_instr.count(sym)) {
-        diag::error("Attempting to jump/branch to an unknown label '%s'.", sym->name);
-        return 0;
-    }
-
-    simple_instr *inst(sym_to_instr[sym]);
-
-    // shouldn't be possible given above checks
-    if(0U == instr_to_block.count(inst)) {
-        diag::error("The label '%s' is not a leader for any basic block.", sym->name);
-        return 0;
+    basic_block *bb(labels.block(sym));
+    if(0 == bb) {
+        diag::error(
+            "Attempting to jump/branch to the label '%s', which does not "
+            "begin a basic block.", sym->name);
     }
 
-    return instr_to_block[inst];
+    return bb;
 }
 
 /// (re)compute the successor/predecessor relationship in the control-flow
-/// graph.
+/// graph, e.g. after blocks were inserted with unsafe_insert_block.
 void cfg::relink(void) throw() {
+    for(basic_block *bb(entry_); 0 != bb; bb = bb->next) {
+        if(instr::is_label(bb->first)) {
+            labels.set_block(bb->first->u.label.lab, bb);
+        }
+    }
+    link();
+}
 
-    std::map<simple_sym *, simple_instr *> labels;
-    find_labels(instr_list, labels);
-    std::map<simple_instr *, basic_block *> block_by_leader;
-
-    // clear out all basic blocks and find the block leaders
+/// compute the successor/predecessor relationship in the control-flow graph,
+/// assuming that the label map knows the block of each leading label.
+void cfg::link(void) throw() {
     for(basic_block *bb(entry_); 0 != bb; bb = bb->next) {
         bb->successors_.clear();
         bb->predecessors_.clear();
-
-        if(0 != bb->first) {
-            block_by_leader[bb->first] = bb;
-        }
     }
 
     connect_bbs(entry_, entry_->next);
@@ -155,26 +132,14 @@ void cfg::relink(void) throw() {
             connect_bbs(bb, bb->next);
             // fall-through
         case JMP_OP:
-            connect_bbs(bb, lookup_and_use_label(
-                last->u.bj.target,
-                labels,
-                block_by_leader
-            ));
+            connect_bbs(bb, lookup_label(last->u.bj.target, labels));
             break;
 
         case MBR_OP:
-            connect_bbs(bb, lookup_and_use_label(
-                last->u.mbr.deflab,
-                labels,
-                block_by_leader
-            ));
+            connect_bbs(bb, lookup_label(last->u.mbr.deflab, labels));
 
             for(unsigned i(0); i < last->u.mbr.ntargets; ++i) {
-                connect_bbs(bb, lookup_and_use_label(
-                    last->u.mbr.targets[i],
-                    labels,
-                    block_by_leader
-                ));
+                connect_bbs(bb, lookup_label(last->u.mbr.targets[i], labels));
             }
             break;
 
@@ -191,20 +156,54 @@ void cfg::relink(void) throw() {
 
     // find the transitive closure of the entry and exit nodes
     find_closure(*this);
+    is_reachability_dirty = false;
 }
 
 /// initialize the control-flow graph with a sequence of instructions. this
 /// will create the basic blocks as it goes.
-///
-/// First, all labels are found. Then, all basic blocks are found. Finally,
-/// the successor/predecessory relation is filled out by looking for fall-
-/// throughs, branches, and jumps.
 cfg::cfg(simple_instr *instr_list_) throw()
     : entry_(0)
     , exit_(0)
     , last_allocated(0)
     , instr_list(instr_list_)
+    , is_reachability_dirty(false)
 {
+    build();
+}
+
+/// destroy all basic blocks
+cfg::~cfg(void) throw() {
+    clear();
+}
+
+/// rebuild the control-flow graph for a (changed) sequence of instructions;
+/// this reuses the label map of the previous graph
+void cfg::rebuild(simple_instr *instr_list_) throw() {
+    clear();
+    instr_list = instr_list_;
+    build();
+}
+
+/// destroy all basic blocks
+void cfg::clear(void) throw() {
+    for(basic_block *bb(entry_), *next_bb(0); 0 != bb; bb = next_bb) {
+        next_bb = bb->next;
+        delete bb;
+    }
+
+    entry_ = 0;
+    exit_ = 0;
+    last_allocated = 0;
+}
+
+/// build the basic blocks in two passes over the instructions. First, all
+/// labels that are branched/jumped to are found. Then, the instructions are
+/// split into basic blocks, and the block of each leading label is recorded.
+/// Finally, the successor/predecessory relation is filled out by looking for
+/// fall-throughs, branches, and jumps.
+void cfg::build(void) throw() {
+    labels.clear();
+
     entry_ = make_bb(0, 0, 0U);
 
     // no instructions for this procedure; keep us consistent
@@ -213,18 +212,21 @@ cfg::cfg(simple_instr *instr_list_) throw()
         entry_->successors_.insert(exit_);
         exit_->predecessors_.insert(entry_);
         return;
-
-    // go remove all unused labels; this will allow us to more aggressively
-    // concatenate basic blocks after multiple optimization passes
-    } else {
-        remove_unused_labels(instr_list_);
     }
 
+    simple_instr *first_instr(instr_list);
+    find_used_labels(first_instr, labels);
+
     // get all basic blocks
-    for(simple_instr *begin(instr_list_); 0 != begin; ) {
+    for(simple_instr *begin(first_instr); 0 != begin; ) {
+        const simple_sym *label(instr::is_label(begin) ? begin->u.label.lab : 0);
         unsigned num_instructions(0);
-        simple_instr *end(find_bb_end(begin, num_instructions));
-        make_bb(begin, end, num_instructions);
+        simple_instr *end(find_bb_end(begin, num_instructions, &labels));
+        basic_block *bb(make_bb(begin, end, num_instructions));
+        labels.set_block(bb->first->u.label.lab, bb);
+        if(!counts.empty()) {
+            find_count(bb, label);
+        }
         begin = end->next;
     }
 
@@ -233,23 +235,11 @@ cfg::cfg(simple_instr *instr_list_) throw()
     exit_ = make_bb(0, 0, 0U);
 
     // a label was added to the first block
-    if(0 != instr_list_->prev) {
-        instr_list = instr_list_->prev;
+    if(0 != first_instr->prev) {
+        instr_list = first_instr->prev;
     }
 
-    relink();
-}
-
-/// destroy all basic blocks
-cfg::~cfg(void) throw() {
-    for(basic_block *bb(entry_), *next_bb(0); 0 != bb; bb = next_bb) {
-        next_bb = bb->next;
-        delete bb;
-    }
-
-    entry_ = 0;
-    exit_ = 0;
-    last_allocated = 0;
+    link();
 }
 
 /// make a basic block and automatically assign that block a unique id
@@ -288,6 +278,266 @@ basic_block *cfg::make_bb(
     return bb;
 }
 
+/// the label that begins a block, if any
+static simple_sym *block_label(const basic_block *bb) throw() {
+    if(0 == bb || !instr::is_label(bb->first)) {
+        return 0;
+    }
+    return bb->first->u.label.lab;
+}
+
+/// give a block the profiled count of the label that began it. If that
+/// label wasn't used, then it was replaced by a new label, which takes over
+/// the count.
+void cfg::find_count(basic_block *bb, const simple_sym *label) throw() {
+    std::map<const simple_sym *, unsigned>::iterator it(counts.find(label));
+    if(counts.end() == it) {
+        return;
+    }
+
+    bb->has_count = true;
+    bb->count = it->second;
+
+    if(block_label(bb) != label) {
+        counts.erase(it);
+        counts[block_label(bb)] = bb->count;
+    }
+}
+
+void cfg::set_count(basic_block *bb, unsigned count) throw() {
+    bb->has_count = true;
+    bb->count = count;
+    if(instr::is_label(bb->first)) {
+        counts[bb->first->u.label.lab] = count;
+    }
+}
+
+basic_block *cfg::find_block(const simple_sym *label) throw() {
+    return labels.block(label);
+}
+
+void cfg::remove_edge(basic_block *pred, basic_block *succ) throw() {
+    if(0U == pred->successors_.erase(succ)) {
+        return;
+    }
+    succ->predecessors_.erase(pred);
+    is_reachability_dirty = true;
+}
+
+bool cfg::redirect_branch(
+    basic_block *bb,
+    basic_block *from,
+    basic_block *to
+) throw() {
+    simple_sym *from_label(block_label(from));
+    simple_sym *to_label(block_label(to));
+
+    if(0 == from_label || 0 == to_label || 0 == bb->last
+    || !instr::is_local_control_flow_transfer(bb->last)
+    || 0U == instr::replace_symbol(bb->last, from_label, to_label)) {
+        return false;
+    }
+
+    // the block might still fall through to the old target
+    if(from != bb->next || !bb->falls_through()) {
+        bb->successors_.erase(from);
+        from->predecessors_.erase(bb);
+    }
+
+    connect_bbs(bb, to);
+    is_reachability_dirty = true;
+    return true;
+}
+
+basic_block *cfg::split_block(basic_block *bb, simple_instr *in) throw() {
+    assert(0 != bb->last);
+    assert(in != bb->last);
+
+    // count the instructions that move into the new block
+    unsigned num_moved(0U);
+    for(simple_instr *moved(in->next); ; moved = moved->next) {
+        ++num_moved;
+        if(moved == bb->last) {
+            break;
+        }
+    }
+
+    simple_instr *label(new_instr(LABEL_OP, 0));
+    label->u.label.lab = new_label();
+    instr::insert_after(label, in);
+
+    basic_block *split(new basic_block(num_moved + 1U, label, bb->last));
+    bb->last = in;
+    bb->num_instructions -= num_moved;
+    labels.set_block(label->u.label.lab, split);
+
+    // put the new block after the block in the list of blocks
+    split->prev = bb;
+    split->next = bb->next;
+    if(0 != bb->next) {
+        bb->next->prev = split;
+    }
+    bb->next = split;
+    if(last_allocated == bb) {
+        last_allocated = split;
+    }
+
+    // the new block takes over the successors of the block
+    split->successors_.swap(bb->successors_);
+    std::set<basic_block *>::iterator it(split->successors_.begin())
+                                    , end(split->successors_.end());
+    for(; it != end; ++it) {
+        (*it)->predecessors_.erase(bb);
+        (*it)->predecessors_.insert(split);
+    }
+    connect_bbs(bb, split);
+
+    split->entry_reachable = bb->entry_reachable;
+    split->exit_reachable = bb->exit_reachable;
+    return split;
+}
+
+bool cfg::merge_blocks(basic_block *bb) throw() {
+    basic_block *next(bb->next);
+    if(0 == bb->first || 0 == next || 0 == next->first
+    || 1U != bb->successors_.size() || 0U == bb->successors_.count(next)
+    || 1U != next->predecessors_.size()) {
+        return false;
+    }
+
+    // the block has to go to the next block by either falling through or
+    // jumping to it
+    simple_sym *next_label(block_label(next));
+    if(JMP_OP == bb->last->opcode && next_label == bb->last->u.bj.target) {
+        bb->last->opcode = NOP_OP;
+    } else if(instr::is_local_control_flow_transfer(bb->last)
+           || !bb->falls_through()) {
+        return false;
+    }
+
+    // nothing else jumps to the next block, so its label isn't needed
+    if(0 != next_label) {
+        next->first->opcode = NOP_OP;
+        labels.set_block(next_label, 0);
+    }
+
+    bb->last = next->last;
+    bb->num_instructions += next->num_instructions;
+
+    bb->successors_.swap(next->successors_);
+    std::set<basic_block *>::iterator it(bb->successors_.begin())
+                                    , end(bb->successors_.end());
+    for(; it != end; ++it) {
+        (*it)->predecessors_.erase(next);
+        (*it)->predecessors_.insert(bb);
+    }
+
+    bb->next = next->next;
+    if(0 != next->next) {
+        next->next->prev = bb;
+    }
+    if(last_allocated == next) {
+        last_allocated = bb;
+    }
+
+    delete next;
+    return true;
+}
+
+void cfg::remove_block(basic_block *bb) throw() {
+    assert(!bb->entry_reachable);
+    assert(0 != bb->first && 0 != bb->first->prev);
+
+    // unlink the instructions; the block isn't the first one, so something
+    // comes before them
+    bb->first->prev->next = bb->last->next;
+    if(0 != bb->last->next) {
+        bb->last->next->prev = bb->first->prev;
+    }
+    bb->last->next = 0;
+
+    if(0 != block_label(bb)) {
+        labels.set_block(block_label(bb), 0);
+    }
+
+    // anything that fell through into this block (which must itself be
+    // unreachable) now falls through into the next block
+    std::set<basic_block *>::iterator it(bb->predecessors_.begin())
+                                    , end(bb->predecessors_.end());
+    for(; it != end; ++it) {
+        (*it)->successors_.erase(bb);
+        if(*it == bb->prev && (*it)->falls_through()) {
+            connect_bbs(*it, bb->next);
+        }
+    }
+
+    for(it = bb->successors_.begin(), end = bb->successors_.end();
+        it != end;
+        ++it) {
+        (*it)->predecessors_.erase(bb);
+    }
+
+    bb->prev->next = bb->next;
+    if(0 != bb->next) {
+        bb->next->prev = bb->prev;
+    }
+    if(last_allocated == bb) {
+        last_allocated = bb->prev;
+    }
+
+    for(simple_instr *in(bb->first), *next(0); 0 != in; in = next) {
+        next = in->next;
+        free_instr(in);
+    }
+
+    is_reachability_dirty = true;
+    delete bb;
+}
+
+/// mark the blocks reachable from some block by following either successors
+/// or predecessors
+static void mark_reachable(
+    basic_block *start,
+    bool basic_block::*reachable,
+    const std::set<basic_block *> &(basic_block::*next_blocks)(void) const
+) throw() {
+    std::vector<basic_block *> work_list;
+    work_list.push_back(start);
+    start->*reachable = true;
+
+    while(!work_list.empty()) {
+        basic_block *bb(work_list.back());
+        work_list.pop_back();
+
+        const std::set<basic_block *> &blocks((bb->*next_blocks)());
+        std::set<basic_block *>::const_iterator it(blocks.begin())
+                                              , end(blocks.end());
+        for(; it != end; ++it) {
+            if(!((*it)->*reachable)) {
+                (*it)->*reachable = true;
+                work_list.push_back(*it);
+            }
+        }
+    }
+}
+
+/// recompute reachability from the entry and exit blocks; unlike the closure
+/// computed when the graph is built, this can make blocks unreachable
+void cfg::update_reachability(void) throw() {
+    if(!is_reachability_dirty) {
+        return;
+    }
+    is_reachability_dirty = false;
+
+    for(basic_block *bb(entry_); 0 != bb; bb = bb->next) {
+        bb->entry_reachable = false;
+        bb->exit_reachable = false;
+    }
+
+    mark_reachable(entry_, &basic_block::entry_reachable, &basic_block::successors);
+    mark_reachable(exit_, &basic_block::exit_reachable, &basic_block::predecessors);
+}
+
 /// inject the basic block into the stream after prev and before next
 static void unsafe_inject_bb(
     basic_block *prev,
@@ -344,7 +594,7 @@ basic_block *cfg::unsafe_insert_block(
 
     // figure out how many instructions this bb has
     unsigned num_instrs(0U);
-    simple_instr *last_(find_bb_end(first, num_instrs));
+    simple_instr *last_(find_bb_end(first, num_instrs, 0));
 
     if(last_ != last) {
         diag::error(
@@ -0,0 +1,409 @@
+/*
+ * fold.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <cmath>
+
+#include "include/fold.h"
+#include "include/diag.h"
+
+namespace fold {
+
+    arith_kind arithmetic_of(const simple_type *type) throw() {
+        switch(type->base) {
+        case SIGNED_TYPE:
+            return (0 < type->len && MAX_INT_BITS >= type->len)
+                ? SIGNED_ARITH : NO_ARITH;
+        case UNSIGNED_TYPE: case ADDRESS_TYPE:
+            return (0 < type->len && MAX_INT_BITS >= type->len)
+                ? UNSIGNED_ARITH : NO_ARITH;
+        case FLOAT_TYPE:
+            return (32 == type->len || 64 == type->len)
+                ? FLOAT_ARITH : NO_ARITH;
+        default:
+            return NO_ARITH;
+        }
+    }
+
+    bool is_integral(const simple_type *type) throw() {
+        const arith_kind kind(arithmetic_of(type));
+        return SIGNED_ARITH == kind || UNSIGNED_ARITH == kind;
+    }
+
+    int int_bits(const simple_type *type) throw() {
+        return type->len;
+    }
+
+    /// a mask of the low bits of a 64 bit integer
+    static uint64_t low_mask(int bits) throw() {
+        if(64 <= bits) {
+            return ~static_cast<uint64_t>(0);
+        }
+        return (static_cast<uint64_t>(1) << bits) - 1U;
+    }
+
+    int64_t normalize(int64_t val, const simple_type *type) throw() {
+        const int bits(int_bits(type));
+        const uint64_t mask(low_mask(bits));
+        uint64_t uval(static_cast<uint64_t>(val) & mask);
+        if(SIGNED_ARITH == arithmetic_of(type) && 0U != ((uval >> (bits - 1)) & 1U)) {
+            uval |= ~mask;
+        }
+        return static_cast<int64_t>(uval);
+    }
+
+    int64_t int_value(const simple_immed &imm, const simple_type *type) throw() {
+        return normalize(static_cast<int64_t>(imm.u.ival), type);
+    }
+
+    bool make_int(simple_immed &imm, int64_t val, const simple_type *type) throw() {
+        const int64_t norm(normalize(val, type));
+        const int ival(static_cast<int>(static_cast<uint32_t>(norm)));
+
+        // wide values are sign-extended from 32 bits when they're loaded
+        if(32 < int_bits(type)
+        && static_cast<uint64_t>(static_cast<int64_t>(ival)) != static_cast<uint64_t>(norm)) {
+            return false;
+        }
+
+        imm.format = IMMED_INT;
+        imm.u.ival = ival;
+        return true;
+    }
+
+    void make_float(simple_immed &imm, double val, const simple_type *type) throw() {
+        imm.format = IMMED_FLOAT;
+        if(32 == type->len) {
+            val = static_cast<float>(val);
+        }
+        imm.u.fval = val;
+    }
+
+    /// convert a floating point value to an integer type; the truncated value
+    /// has to fit into the destination, otherwise the conversion is undefined
+    static bool float_to_int(double x, const simple_type *dst_type, value &result) throw() {
+        const int bits(int_bits(dst_type));
+        double lo(0.0), hi(0.0);
+        if(SIGNED_ARITH == arithmetic_of(dst_type)) {
+            lo = -ldexp(1.0, bits - 1);
+            hi = ldexp(1.0, bits - 1);
+        } else {
+            hi = ldexp(1.0, bits);
+        }
+
+        if(!(x > lo - 1.0 && x < hi)) {
+            return false;
+        } else if(0.0 > x) {
+            result.i = normalize(static_cast<int64_t>(x), dst_type);
+        } else {
+            result.i = normalize(
+                static_cast<int64_t>(static_cast<uint64_t>(x)), dst_type);
+        }
+        return true;
+    }
+
+    static void set_int(value &result, int64_t val, const simple_type *type) throw() {
+        result.i = normalize(val, type);
+    }
+
+    static void set_float(value &result, double val, const simple_type *type) throw() {
+        if(32 == type->len) {
+            val = static_cast<float>(val);
+        }
+        result.f = val;
+    }
+
+    /// get the value of a constant; fails for the addresses of symbols
+    static bool to_value(
+        const simple_immed &imm,
+        const simple_type *type,
+        value &val
+    ) throw() {
+        if(FLOAT_ARITH == arithmetic_of(type)) {
+            if(IMMED_FLOAT != imm.format) {
+                return false;
+            }
+            val.f = imm.u.fval;
+        } else {
+            if(IMMED_INT != imm.format) {
+                return false;
+            }
+            val.i = int_value(imm, type);
+        }
+        return true;
+    }
+
+    /// make a constant out of a value; fails if an LDC can't load it
+    static bool to_immed(
+        simple_immed &imm,
+        const value &val,
+        const simple_type *type
+    ) throw() {
+        if(FLOAT_ARITH == arithmetic_of(type)) {
+            make_float(imm, val.f, type);
+            return true;
+        }
+        return make_int(imm, val.i, type);
+    }
+
+    bool unary(
+        simple_op op,
+        const simple_type *a_type,
+        const value &a,
+        const simple_type *dst_type,
+        value &result
+    ) throw() {
+        const arith_kind ak(arithmetic_of(a_type));
+        const arith_kind dk(arithmetic_of(dst_type));
+
+        if(NO_ARITH == ak || NO_ARITH == dk) {
+            return false;
+        }
+
+        // floating point source
+        if(FLOAT_ARITH == ak) {
+            const double x(a.f);
+            switch(op) {
+            case CVT_OP:
+                if(FLOAT_ARITH == dk) {
+                    set_float(result, x, dst_type);
+                    return true;
+                }
+                return float_to_int(x, dst_type, result);
+
+            case NEG_OP:
+                if(FLOAT_ARITH != dk) {
+                    return false;
+                }
+                set_float(result, -x, dst_type);
+                return true;
+
+            default:
+                return false;
+            }
+        }
+
+        // integer source
+        const int64_t x(normalize(a.i, a_type));
+        switch(op) {
+        case CVT_OP:
+            if(FLOAT_ARITH != dk) {
+                set_int(result, x, dst_type);
+            } else if(UNSIGNED_ARITH == ak) {
+                set_float(result, static_cast<double>(static_cast<uint64_t>(x)), dst_type);
+            } else {
+                set_float(result, static_cast<double>(x), dst_type);
+            }
+            return true;
+
+        case NEG_OP:
+            if(FLOAT_ARITH == dk) {
+                return false;
+            }
+            set_int(result,
+                static_cast<int64_t>(0U - static_cast<uint64_t>(x)), dst_type);
+            return true;
+
+        case NOT_OP:
+            if(FLOAT_ARITH == dk) {
+                return false;
+            }
+            set_int(result, ~x, dst_type);
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    bool unary(
+        simple_op op,
+        const simple_type *a_type,
+        const simple_immed &a,
+        const simple_type *dst_type,
+        simple_immed &result
+    ) throw() {
+        value a_val, result_val;
+        if(NO_ARITH == arithmetic_of(a_type)
+        || NO_ARITH == arithmetic_of(dst_type)
+        || !to_value(a, a_type, a_val)
+        || !unary(op, a_type, a_val, dst_type, result_val)) {
+            return false;
+        }
+        return to_immed(result, result_val, dst_type);
+    }
+
+    /// fold a binary operator on floating point values
+    static bool float_binary(
+        simple_op op,
+        double x,
+        double y,
+        const simple_type *dst_type,
+        value &result
+    ) throw() {
+        const bool is_float(FLOAT_ARITH == arithmetic_of(dst_type));
+        switch(op) {
+        case ADD_OP: if(!is_float) return false; set_float(result, x + y, dst_type); return true;
+        case SUB_OP: if(!is_float) return false; set_float(result, x - y, dst_type); return true;
+        case MUL_OP: if(!is_float) return false; set_float(result, x * y, dst_type); return true;
+        case DIV_OP:
+            if(!is_float || 0.0 == y) {
+                return false;
+            }
+            set_float(result, x / y, dst_type);
+            return true;
+
+        case SEQ_OP: if(is_float) return false; set_int(result, x == y, dst_type); return true;
+        case SNE_OP: if(is_float) return false; set_int(result, x != y, dst_type); return true;
+        case SL_OP: if(is_float) return false; set_int(result, x < y, dst_type); return true;
+        case SLE_OP: if(is_float) return false; set_int(result, x <= y, dst_type); return true;
+        default:
+            return false;
+        }
+    }
+
+    bool binary(
+        simple_op op,
+        const simple_type *a_type,
+        const value &a,
+        const simple_type *b_type,
+        const value &b,
+        const simple_type *dst_type,
+        value &result
+    ) throw() {
+        const arith_kind ak(arithmetic_of(a_type));
+        const arith_kind bk(arithmetic_of(b_type));
+        const arith_kind dk(arithmetic_of(dst_type));
+
+        if(NO_ARITH == ak || NO_ARITH == bk || NO_ARITH == dk) {
+            return false;
+        }
+
+        if(FLOAT_ARITH == ak || FLOAT_ARITH == bk) {
+            if(ak != bk) {
+                return false;
+            }
+            return float_binary(op, a.f, b.f, dst_type, result);
+        }
+
+        if(FLOAT_ARITH == dk) {
+            return false;
+        }
+
+        const int bits(int_bits(a_type));
+        const uint64_t mask(low_mask(bits));
+        const int64_t min_signed(static_cast<int64_t>(~static_cast<uint64_t>(0) << (bits - 1)));
+        const bool is_unsigned(UNSIGNED_ARITH == ak);
+
+        // the values, and their bits (zero-extended)
+        const int64_t x(normalize(a.i, a_type));
+        const int64_t y(normalize(b.i, b_type));
+        const uint64_t ux(static_cast<uint64_t>(x) & mask);
+        const uint64_t uy(static_cast<uint64_t>(y) & low_mask(int_bits(b_type)));
+        int64_t r(0);
+
+        switch(op) {
+        case ADD_OP: r = static_cast<int64_t>(ux + uy); break;
+        case SUB_OP: r = static_cast<int64_t>(ux - uy); break;
+        case MUL_OP: r = static_cast<int64_t>(ux * uy); break;
+
+        case DIV_OP: case REM_OP: case MOD_OP:
+            if(0 == y) {
+                return false;
+            } else if(-1 == y && min_signed == x && !is_unsigned) {
+                return false;
+            }
+
+            if(is_unsigned) {
+                r = static_cast<int64_t>(DIV_OP == op ? ux / uy : ux % uy);
+            } else if(DIV_OP == op) {
+                r = x / y;
+            } else {
+                r = x % y;
+
+                // SUIF's modulo always returns a non-negative integer
+                if(MOD_OP == op && 0 > r) {
+                    r += y;
+                }
+            }
+            break;
+
+        case AND_OP: r = x & y; break;
+        case IOR_OP: r = x | y; break;
+        case XOR_OP: r = x ^ y; break;
+
+        case LSL_OP: case LSR_OP: case ASR_OP:
+            if(0 > y || bits <= y) {
+                return false;
+            }
+
+            if(LSL_OP == op) {
+                r = static_cast<int64_t>(ux << y);
+            } else if(LSR_OP == op) {
+                r = static_cast<int64_t>(ux >> y);
+            } else {
+                int64_t sx(static_cast<int64_t>(ux << (64 - bits)));
+                r = (sx >> (64 - bits)) >> y;
+            }
+            break;
+
+        // positive rotations are to the left, negative ones to the right
+        case ROT_OP: {
+            if(y <= -bits || bits <= y) {
+                return false;
+            }
+            const int k(static_cast<int>(0 > y ? bits + y : y));
+            r = 0 == k ? x : static_cast<int64_t>(
+                ((ux << k) | (ux >> (bits - k))) & mask);
+            break;
+        }
+
+        case SEQ_OP: r = x == y; break;
+        case SNE_OP: r = x != y; break;
+        case SL_OP: r = is_unsigned ? ux < uy : x < y; break;
+        case SLE_OP: r = is_unsigned ? ux <= uy : x <= y; break;
+
+        default:
+            return false;
+        }
+
+        set_int(result, r, dst_type);
+        return true;
+    }
+
+    bool binary(
+        simple_op op,
+        const simple_type *a_type,
+        const simple_immed &a,
+        const simple_type *b_type,
+        const simple_immed &b,
+        const simple_type *dst_type,
+        simple_immed &result
+    ) throw() {
+        value a_val, b_val, result_val;
+        if(NO_ARITH == arithmetic_of(a_type)
+        || NO_ARITH == arithmetic_of(b_type)
+        || NO_ARITH == arithmetic_of(dst_type)
+        || !to_value(a, a_type, a_val)
+        || !to_value(b, b_type, b_val)) {
+            return false;
+        }
+
+        if((DIV_OP == op || REM_OP == op || MOD_OP == op)
+        && is_integral(a_type)
+        && is_integral(b_type)
+        && FLOAT_ARITH != arithmetic_of(dst_type)
+        && 0 == b_val.i) {
+            diag::warning("Denominator to DIV or REM must not be zero.\n");
+            return false;
+        }
+
+        if(!binary(op, a_type, a_val, b_type, b_val, dst_type, result_val)) {
+            return false;
+        }
+        return to_immed(result, result_val, dst_type);
+    }
+}
@@ -0,0 +1,1102 @@
+/*
+ * ir.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "include/ir.h"
+#include "include/diag.h"
+
+namespace ir {
+
+    /// a procedure being turned into words
+    struct encoder {
+    public:
+        std::vector<unsigned char> types;
+        std::vector<unsigned char> syms;
+        std::vector<unsigned char> regs;
+        std::vector<unsigned char> instrs;
+        std::vector<unsigned char> extra;
+        std::vector<unsigned char> strings;
+
+        std::map<const simple_type *, uint32_t> type_ids;
+        std::map<simple_sym *, uint32_t> sym_ids;
+        std::map<simple_reg *, uint32_t> reg_ids;
+    };
+
+    static uint32_t size_in_words(const std::vector<unsigned char> &words) throw() {
+        return static_cast<uint32_t>(words.size() / 4U);
+    }
+
+    static void add_word(std::vector<unsigned char> &words, uint32_t w) throw() {
+        words.push_back(static_cast<unsigned char>(w & 0xFFU));
+        words.push_back(static_cast<unsigned char>((w >> 8U) & 0xFFU));
+        words.push_back(static_cast<unsigned char>((w >> 16U) & 0xFFU));
+        words.push_back(static_cast<unsigned char>((w >> 24U) & 0xFFU));
+    }
+
+    static void add_words(std::vector<unsigned char> &words, const std::vector<unsigned char> &more) throw() {
+        words.insert(words.end(), more.begin(), more.end());
+    }
+
+    static uint32_t add_string(encoder &e, const char *str) throw() {
+        const uint32_t offset(static_cast<uint32_t>(e.strings.size()));
+        e.strings.insert(e.strings.end(), str, str + strlen(str) + 1U);
+        return offset;
+    }
+
+    static uint32_t encode_type(encoder &e, const simple_type *type) throw() {
+        std::map<const simple_type *, uint32_t>::iterator it(e.type_ids.find(type));
+        if(e.type_ids.end() != it) {
+            return it->second;
+        }
+
+        const uint32_t id(size_in_words(e.types) / TYPE_WORDS);
+        add_word(e.types, static_cast<uint32_t>(type->base));
+        add_word(e.types, static_cast<uint32_t>(type->len));
+        e.type_ids[type] = id;
+        return id;
+    }
+
+    static uint32_t encode_sym(encoder &e, simple_sym *sym) throw() {
+        std::map<simple_sym *, uint32_t>::iterator it(e.sym_ids.find(sym));
+        if(e.sym_ids.end() != it) {
+            return it->second;
+        }
+
+        const uint32_t id(size_in_words(e.syms) / SYMBOL_WORDS);
+        add_word(e.syms, static_cast<uint32_t>(sym->kind));
+        add_word(e.syms, add_string(e, sym->name));
+        e.sym_ids[sym] = id;
+        return id;
+    }
+
+    /// registers are their index plus one, so that zero is no register
+    static uint32_t encode_reg(encoder &e, simple_reg *reg) throw() {
+        if(0 == reg) {
+            return 0U;
+        }
+
+        std::map<simple_reg *, uint32_t>::iterator it(e.reg_ids.find(reg));
+        if(e.reg_ids.end() != it) {
+            return it->second;
+        }
+
+        const uint32_t type(encode_type(e, reg->var->type));
+        const uint32_t id(size_in_words(e.regs) / REGISTER_WORDS + 1U);
+        add_word(e.regs, static_cast<uint32_t>(reg->kind));
+        add_word(e.regs, static_cast<uint32_t>(reg->num));
+        add_word(e.regs, type);
+        e.reg_ids[reg] = id;
+        return id;
+    }
+
+    static void encode_instr(encoder &e, simple_instr *in) throw() {
+        uint32_t w[INSTR_WORDS] = {0U};
+        w[0] = static_cast<uint32_t>(in->opcode);
+        w[1] = 0 == in->type ? 0U : encode_type(e, in->type) + 1U;
+
+        switch(in->opcode) {
+        case NOP_OP:
+            break;
+
+        case LABEL_OP:
+            w[2] = encode_sym(e, in->u.label.lab);
+            break;
+
+        case JMP_OP:
+            w[2] = encode_sym(e, in->u.bj.target);
+            break;
+
+        case BTRUE_OP: case BFALSE_OP:
+            w[2] = encode_sym(e, in->u.bj.target);
+            w[3] = encode_reg(e, in->u.bj.src);
+            break;
+
+        case MBR_OP:
+            w[2] = encode_reg(e, in->u.mbr.src);
+            w[3] = static_cast<uint32_t>(in->u.mbr.offset);
+            w[4] = in->u.mbr.ntargets;
+            w[5] = encode_sym(e, in->u.mbr.deflab);
+            w[6] = size_in_words(e.extra);
+            for(unsigned i(0U); i < in->u.mbr.ntargets; ++i) {
+                add_word(e.extra, encode_sym(e, in->u.mbr.targets[i]));
+            }
+            break;
+
+        case LDC_OP:
+            w[2] = encode_reg(e, in->u.ldc.dst);
+            w[3] = static_cast<uint32_t>(in->u.ldc.value.format);
+            switch(in->u.ldc.value.format) {
+            case IMMED_INT:
+                w[4] = static_cast<uint32_t>(in->u.ldc.value.u.ival);
+                break;
+            case IMMED_FLOAT: {
+                uint64_t bits(0U);
+                memcpy(&bits, &(in->u.ldc.value.u.fval), sizeof bits);
+                w[4] = static_cast<uint32_t>(bits & 0xFFFFFFFFU);
+                w[5] = static_cast<uint32_t>(bits >> 32U);
+                break;
+            }
+            case IMMED_SYMBOL:
+                w[4] = encode_sym(e, in->u.ldc.value.u.s.symbol);
+                w[5] = static_cast<uint32_t>(in->u.ldc.value.u.s.offset);
+                break;
+            }
+            break;
+
+        case CALL_OP:
+            w[2] = encode_reg(e, in->u.call.dst);
+            w[3] = encode_reg(e, in->u.call.proc);
+            w[4] = in->u.call.nargs;
+            w[5] = size_in_words(e.extra);
+            for(unsigned i(0U); i < in->u.call.nargs; ++i) {
+                add_word(e.extra, encode_reg(e, in->u.call.args[i]));
+            }
+            break;
+
+        default:
+            w[2] = encode_reg(e, in->u.base.dst);
+            w[3] = encode_reg(e, in->u.base.src1);
+            w[4] = encode_reg(e, in->u.base.src2);
+            break;
+        }
+
+        for(unsigned i(0U); i < INSTR_WORDS; ++i) {
+            add_word(e.instrs, w[i]);
+        }
+    }
+
+    writer::writer(void) throw()
+        : fp(0)
+    { }
+
+    writer::~writer(void) throw() {
+        close();
+    }
+
+    /// start a new file of procedures
+    bool writer::open(const char *file_name) throw() {
+        close();
+        fp = fopen(file_name, "wb");
+        if(0 == fp) {
+            return false;
+        }
+
+        std::vector<unsigned char> header;
+        add_word(header, FILE_MAGIC);
+        add_word(header, FILE_VERSION);
+        return 1U == fwrite(&(header[0]), header.size(), 1U, fp);
+    }
+
+    /// add a procedure to the end of the file
+    bool writer::write(const char *proc_name, simple_instr *in_list) throw() {
+        if(0 == fp) {
+            return false;
+        }
+
+        encoder e;
+        const uint32_t name(add_string(e, proc_name));
+        uint32_t num_instrs(0U);
+        for(simple_instr *in(in_list); 0 != in; in = in->next, ++num_instrs) {
+            encode_instr(e, in);
+        }
+        while(0U != e.strings.size() % 4U) {
+            e.strings.push_back('\0');
+        }
+
+        const uint32_t num_words(HEADER_WORDS
+            + size_in_words(e.types) + size_in_words(e.syms)
+            + size_in_words(e.regs) + size_in_words(e.instrs)
+            + size_in_words(e.extra) + size_in_words(e.strings));
+
+        std::vector<unsigned char> chunk;
+        chunk.reserve(4U * num_words);
+        add_word(chunk, CHUNK_MAGIC);
+        add_word(chunk, num_words);
+        add_word(chunk, size_in_words(e.types) / TYPE_WORDS);
+        add_word(chunk, size_in_words(e.syms) / SYMBOL_WORDS);
+        add_word(chunk, size_in_words(e.regs) / REGISTER_WORDS);
+        add_word(chunk, num_instrs);
+        add_word(chunk, size_in_words(e.extra));
+        add_word(chunk, size_in_words(e.strings));
+        add_word(chunk, name);
+        add_words(chunk, e.types);
+        add_words(chunk, e.syms);
+        add_words(chunk, e.regs);
+        add_words(chunk, e.instrs);
+        add_words(chunk, e.extra);
+        add_words(chunk, e.strings);
+
+        return 1U == fwrite(&(chunk[0]), chunk.size(), 1U, fp)
+            && 0 == fflush(fp);
+    }
+
+    void writer::close(void) throw() {
+        if(0 != fp) {
+            fclose(fp);
+            fp = 0;
+        }
+    }
+
+    reader::reader(void) throw()
+        : data(0)
+        , size(0U)
+    { }
+
+    reader::~reader(void) throw() {
+        close();
+    }
+
+    /// find the procedures in a chunk; returns false if the chunk is
+    /// malformed
+    static bool read_chunk(
+        const unsigned char *chunk,
+        uint32_t num_words,
+        procedure_view &view
+    ) throw() {
+        if(HEADER_WORDS > num_words || CHUNK_MAGIC != word(chunk, 0U)
+        || num_words != word(chunk, 1U)) {
+            return false;
+        }
+
+        view.num_types = word(chunk, 2U);
+        view.num_syms = word(chunk, 3U);
+        view.num_regs = word(chunk, 4U);
+        view.num_instrs = word(chunk, 5U);
+        view.num_extra = word(chunk, 6U);
+
+        const uint32_t string_words(word(chunk, 7U));
+        const uint32_t name(word(chunk, 8U));
+
+        // the sizes are checked one at a time, so that they can't overflow
+        const uint32_t sizes[] = {
+            view.num_types, TYPE_WORDS,
+            view.num_syms, SYMBOL_WORDS,
+            view.num_regs, REGISTER_WORDS,
+            view.num_instrs, INSTR_WORDS,
+            view.num_extra, 1U,
+            string_words, 1U
+        };
+        const unsigned char **tables[] = {
+            &(view.types), &(view.syms), &(view.regs),
+            &(view.instrs), &(view.extra), 0
+        };
+
+        uint32_t offset(HEADER_WORDS);
+        for(unsigned i(0U); i < 6U; ++i) {
+            const uint32_t left(num_words - offset);
+            if(sizes[2U * i] > left / sizes[2U * i + 1U]) {
+                return false;
+            }
+            if(0 != tables[i]) {
+                *(tables[i]) = chunk + 4U * offset;
+            }
+            offset += sizes[2U * i] * sizes[2U * i + 1U];
+        }
+
+        view.strings = reinterpret_cast<const char *>(
+            chunk + 4U * (num_words - string_words));
+        view.string_size = 4U * string_words;
+        if(view.string_size <= name
+        || 0 == memchr(view.strings + name, '\0', view.string_size - name)) {
+            return false;
+        }
+        view.name = view.strings + name;
+        return true;
+    }
+
+    /// split a text file into its procedures; each one starts with a
+    /// `proc NAME` line
+    static void read_texts(
+        const char *text,
+        size_t size,
+        std::map<std::string, std::string> &texts
+    ) throw() {
+        std::string *proc_text(0);
+        for(size_t begin(0U), end(0U); begin < size; begin = end + 1U) {
+            for(end = begin; end < size && '\n' != text[end]; ++end) {
+                /* find the end of the line */
+            }
+
+            const std::string line(text + begin, text + end);
+            char name[256];
+            if(1 == sscanf(line.c_str(), " proc %255s", name)) {
+                proc_text = &(texts[name]);
+                proc_text->clear();
+            } else if(0 != proc_text) {
+                proc_text->append(line);
+                proc_text->push_back('\n');
+            }
+        }
+    }
+
+    /// map a file of procedures into memory, and find the procedures in it
+    bool reader::open(const char *file_name) throw() {
+        close();
+
+        const int fd(::open(file_name, O_RDONLY));
+        if(0 > fd) {
+            return false;
+        }
+
+        struct stat info;
+        if(0 != fstat(fd, &info) || 8 > info.st_size) {
+            ::close(fd);
+            return false;
+        }
+
+        size = static_cast<size_t>(info.st_size);
+        data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(MAP_FAILED == data) {
+            data = 0;
+            size = 0U;
+            return false;
+        }
+
+        const unsigned char *bytes(static_cast<const unsigned char *>(data));
+        if(FILE_MAGIC != word(bytes, 0U)) {
+            read_texts(static_cast<const char *>(data), size, texts);
+            munmap(data, size);
+            data = 0;
+            size = 0U;
+            return true;
+        }
+
+        if(FILE_VERSION != word(bytes, 1U)) {
+            close();
+            return false;
+        }
+
+        // only the chunk headers are read; the rest is read as it's used
+        for(size_t offset(8U); offset + 4U * HEADER_WORDS <= size; ) {
+            const unsigned char *chunk(bytes + offset);
+            const uint32_t num_words(word(chunk, 1U));
+            procedure_view view;
+
+            if(num_words > (size - offset) / 4U
+            || !read_chunk(chunk, num_words, view)) {
+                diag::warning("Ignoring the rest of '%s'; it is malformed.", file_name);
+                break;
+            }
+
+            procs[view.name] = view;
+            offset += 4U * static_cast<size_t>(num_words);
+        }
+        return true;
+    }
+
+    const procedure_view *reader::find(const char *proc_name) const throw() {
+        std::map<std::string, procedure_view>::const_iterator it(procs.find(proc_name));
+        if(procs.end() == it) {
+            return 0;
+        }
+        return &(it->second);
+    }
+
+    const std::string *reader::find_text(const char *proc_name) const throw() {
+        std::map<std::string, std::string>::const_iterator it(texts.find(proc_name));
+        if(texts.end() == it) {
+            return 0;
+        }
+        return &(it->second);
+    }
+
+    void reader::close(void) throw() {
+        if(0 != data) {
+            munmap(data, size);
+        }
+        data = 0;
+        size = 0U;
+        procs.clear();
+        texts.clear();
+    }
+
+    /// the registers, symbols and types of a procedure from SUIF
+    struct decoder {
+    public:
+        std::map<std::pair<int, int>, simple_reg *> regs;
+        std::map<std::pair<int, std::string>, simple_sym *> syms;
+        std::vector<simple_type *> types;
+
+        std::vector<simple_reg *> reg_table;
+        std::vector<simple_sym *> sym_table;
+        std::vector<simple_type *> type_table;
+    };
+
+    static void find_type(decoder &d, simple_type *type) throw() {
+        if(0 != type) {
+            d.types.push_back(type);
+        }
+    }
+
+    static void find_reg(decoder &d, simple_reg *reg) throw() {
+        if(0 != reg) {
+            d.regs[std::make_pair(static_cast<int>(reg->kind), reg->num)] = reg;
+            find_type(d, reg->var->type);
+        }
+    }
+
+    static void find_sym(decoder &d, simple_sym *sym) throw() {
+        if(0 != sym) {
+            d.syms[std::make_pair(static_cast<int>(sym->kind), std::string(sym->name))] = sym;
+        }
+    }
+
+    /// find the registers, symbols and types used by the instructions of a
+    /// procedure
+    static void find_names(decoder &d, simple_instr *in_list) throw() {
+        for(simple_instr *in(in_list); 0 != in; in = in->next) {
+            find_type(d, in->type);
+
+            switch(in->opcode) {
+            case NOP_OP:
+                break;
+            case LABEL_OP:
+                find_sym(d, in->u.label.lab);
+                break;
+            case JMP_OP:
+                find_sym(d, in->u.bj.target);
+                break;
+            case BTRUE_OP: case BFALSE_OP:
+                find_sym(d, in->u.bj.target);
+                find_reg(d, in->u.bj.src);
+                break;
+            case MBR_OP:
+                find_reg(d, in->u.mbr.src);
+                find_sym(d, in->u.mbr.deflab);
+                for(unsigned i(0U); i < in->u.mbr.ntargets; ++i) {
+                    find_sym(d, in->u.mbr.targets[i]);
+                }
+                break;
+            case LDC_OP:
+                find_reg(d, in->u.ldc.dst);
+                if(IMMED_SYMBOL == in->u.ldc.value.format) {
+                    find_sym(d, in->u.ldc.value.u.s.symbol);
+                }
+                break;
+            case CALL_OP:
+                find_reg(d, in->u.call.dst);
+                find_reg(d, in->u.call.proc);
+                for(unsigned i(0U); i < in->u.call.nargs; ++i) {
+                    find_reg(d, in->u.call.args[i]);
+                }
+                break;
+            default:
+                find_reg(d, in->u.base.dst);
+                find_reg(d, in->u.base.src1);
+                find_reg(d, in->u.base.src2);
+                break;
+            }
+        }
+
+        simple_type *builtin_types[] = {
+            simple_type_void, simple_type_char, simple_type_signed,
+            simple_type_unsigned, simple_type_float, simple_type_double,
+            simple_type_addr
+        };
+        for(unsigned i(0U); i < sizeof builtin_types / sizeof builtin_types[0]; ++i) {
+            find_type(d, builtin_types[i]);
+        }
+    }
+
+    /// match the saved types, symbols and registers to those of the
+    /// procedure from SUIF
+    static bool match_names(decoder &d, const procedure_view &view) throw() {
+        for(uint32_t i(0U); i < view.num_types; ++i) {
+            const int base(static_cast<int>(word(view.types, TYPE_WORDS * i)));
+            const int len(static_cast<int>(word(view.types, TYPE_WORDS * i + 1U)));
+            simple_type *type(0);
+            for(unsigned t(0U); t < d.types.size() && 0 == type; ++t) {
+                if(base == static_cast<int>(d.types[t]->base) && len == d.types[t]->len) {
+                    type = d.types[t];
+                }
+            }
+            if(0 == type) {
+                return false;
+            }
+            d.type_table.push_back(type);
+        }
+
+        for(uint32_t i(0U); i < view.num_syms; ++i) {
+            const int kind(static_cast<int>(word(view.syms, SYMBOL_WORDS * i)));
+            const uint32_t name(word(view.syms, SYMBOL_WORDS * i + 1U));
+            if(view.string_size <= name
+            || 0 == memchr(view.strings + name, '\0', view.string_size - name)) {
+                return false;
+            }
+
+            std::map<std::pair<int, std::string>, simple_sym *>::iterator it(
+                d.syms.find(std::make_pair(kind, std::string(view.strings + name))));
+            if(d.syms.end() != it) {
+                d.sym_table.push_back(it->second);
+            } else if(LABEL_SYM == kind) {
+                d.sym_table.push_back(0);
+            } else {
+                return false;
+            }
+        }
+
+        // check the registers before making any
+        for(uint32_t i(0U); i < view.num_regs; ++i) {
+            const int kind(static_cast<int>(word(view.regs, REGISTER_WORDS * i)));
+            const int num(static_cast<int>(word(view.regs, REGISTER_WORDS * i + 1U)));
+            const uint32_t type(word(view.regs, REGISTER_WORDS * i + 2U));
+            if(view.num_types <= type) {
+                return false;
+            }
+
+            std::map<std::pair<int, int>, simple_reg *>::iterator it(
+                d.regs.find(std::make_pair(kind, num)));
+            if(d.regs.end() != it) {
+                const simple_type *reg_type(it->second->var->type);
+                if(reg_type->base != d.type_table[type]->base
+                || reg_type->len != d.type_table[type]->len) {
+                    return false;
+                }
+            } else if(PSEUDO_REG != kind && TEMP_REG != kind) {
+                return false;
+            }
+        }
+
+        for(uint32_t i(0U); i < d.sym_table.size(); ++i) {
+            if(0 == d.sym_table[i]) {
+                d.sym_table[i] = new_label();
+            }
+        }
+
+        for(uint32_t i(0U); i < view.num_regs; ++i) {
+            const int kind(static_cast<int>(word(view.regs, REGISTER_WORDS * i)));
+            const int num(static_cast<int>(word(view.regs, REGISTER_WORDS * i + 1U)));
+            const uint32_t type(word(view.regs, REGISTER_WORDS * i + 2U));
+
+            std::map<std::pair<int, int>, simple_reg *>::iterator it(
+                d.regs.find(std::make_pair(kind, num)));
+            if(d.regs.end() != it) {
+                d.reg_table.push_back(it->second);
+            } else {
+                d.reg_table.push_back(new_register(
+                    d.type_table[type], static_cast<reg_kind>(kind)));
+            }
+        }
+        return true;
+    }
+
+    /// check the operands of a saved instruction against the tables
+    static bool is_valid_instr(const procedure_view &view, const unsigned char *w) throw() {
+        const uint32_t op(word(w, 0U));
+        const uint32_t type(word(w, 1U));
+        if(LAST_OP <= op || view.num_types < type) {
+            return false;
+        }
+
+        switch(op) {
+        case NOP_OP:
+            return true;
+        case LABEL_OP: case JMP_OP:
+            return word(w, 2U) < view.num_syms;
+        case BTRUE_OP: case BFALSE_OP:
+            return word(w, 2U) < view.num_syms && word(w, 3U) <= view.num_regs;
+        case MBR_OP:
+            return word(w, 2U) <= view.num_regs
+                && word(w, 5U) < view.num_syms
+                && word(w, 6U) <= view.num_extra
+                && word(w, 4U) <= view.num_extra - word(w, 6U);
+        case LDC_OP:
+            return word(w, 2U) <= view.num_regs
+                && (IMMED_SYMBOL != word(w, 3U) || word(w, 4U) < view.num_syms);
+        case CALL_OP:
+            return word(w, 2U) <= view.num_regs
+                && word(w, 3U) <= view.num_regs
+                && word(w, 5U) <= view.num_extra
+                && word(w, 4U) <= view.num_extra - word(w, 5U);
+        default:
+            return word(w, 2U) <= view.num_regs
+                && word(w, 3U) <= view.num_regs
+                && word(w, 4U) <= view.num_regs;
+        }
+    }
+
+    static simple_reg *decode_reg(decoder &d, uint32_t id) throw() {
+        return 0U == id ? 0 : d.reg_table[id - 1U];
+    }
+
+    static simple_instr *decode_instr(
+        decoder &d,
+        const procedure_view &view,
+        const unsigned char *w
+    ) throw() {
+        const simple_op op(static_cast<simple_op>(word(w, 0U)));
+        const uint32_t type(word(w, 1U));
+        simple_instr *in(new_instr(op, 0U == type ? 0 : d.type_table[type - 1U]));
+
+        switch(op) {
+        case NOP_OP:
+            break;
+
+        case LABEL_OP:
+            in->u.label.lab = d.sym_table[word(w, 2U)];
+            break;
+
+        case JMP_OP:
+            in->u.bj.target = d.sym_table[word(w, 2U)];
+            in->u.bj.src = 0;
+            break;
+
+        case BTRUE_OP: case BFALSE_OP:
+            in->u.bj.target = d.sym_table[word(w, 2U)];
+            in->u.bj.src = decode_reg(d, word(w, 3U));
+            break;
+
+        case MBR_OP: {
+            const uint32_t num_targets(word(w, 4U));
+            const uint32_t first(word(w, 6U));
+            in->u.mbr.src = decode_reg(d, word(w, 2U));
+            in->u.mbr.offset = static_cast<int>(word(w, 3U));
+            in->u.mbr.ntargets = num_targets;
+            in->u.mbr.deflab = d.sym_table[word(w, 5U)];
+            in->u.mbr.targets = static_cast<simple_sym **>(
+                malloc(sizeof(simple_sym *) * (num_targets + 1U)));
+            for(uint32_t i(0U); i < num_targets; ++i) {
+                const uint32_t sym(word(view.extra, first + i));
+                in->u.mbr.targets[i] = sym < view.num_syms ? d.sym_table[sym] : in->u.mbr.deflab;
+            }
+            break;
+        }
+
+        case LDC_OP:
+            in->u.ldc.dst = decode_reg(d, word(w, 2U));
+            in->u.ldc.value.format = static_cast<immed_type>(word(w, 3U));
+            switch(in->u.ldc.value.format) {
+            case IMMED_INT:
+                in->u.ldc.value.u.ival = static_cast<int>(word(w, 4U));
+                break;
+            case IMMED_FLOAT: {
+                const uint64_t bits(
+                    static_cast<uint64_t>(word(w, 4U))
+                    | (static_cast<uint64_t>(word(w, 5U)) << 32U));
+                memcpy(&(in->u.ldc.value.u.fval), &bits, sizeof bits);
+                break;
+            }
+            case IMMED_SYMBOL:
+                in->u.ldc.value.u.s.symbol = d.sym_table[word(w, 4U)];
+                in->u.ldc.value.u.s.offset = static_cast<int>(word(w, 5U));
+                break;
+            }
+            break;
+
+        case CALL_OP: {
+            const uint32_t num_args(word(w, 4U));
+            const uint32_t first(word(w, 5U));
+            in->u.call.dst = decode_reg(d, word(w, 2U));
+            in->u.call.proc = decode_reg(d, word(w, 3U));
+            in->u.call.nargs = num_args;
+            in->u.call.args = static_cast<simple_reg **>(
+                malloc(sizeof(simple_reg *) * (num_args + 1U)));
+            for(uint32_t i(0U); i < num_args; ++i) {
+                const uint32_t reg(word(view.extra, first + i));
+                in->u.call.args[i] = reg <= view.num_regs ? decode_reg(d, reg) : 0;
+            }
+            break;
+        }
+
+        default:
+            in->u.base.dst = decode_reg(d, word(w, 2U));
+            in->u.base.src1 = decode_reg(d, word(w, 3U));
+            in->u.base.src2 = decode_reg(d, word(w, 4U));
+            break;
+        }
+        return in;
+    }
+
+    simple_instr *decode(const procedure_view &view, simple_instr *in_list) throw() {
+        for(uint32_t i(0U); i < view.num_instrs; ++i) {
+            if(!is_valid_instr(view, view.instrs + 4U * INSTR_WORDS * i)) {
+                return 0;
+            }
+        }
+
+        decoder d;
+        find_names(d, in_list);
+        if(!match_names(d, view)) {
+            return 0;
+        }
+
+        simple_instr *first(0), *prev(0);
+        for(uint32_t i(0U); i < view.num_instrs; ++i) {
+            simple_instr *in(decode_instr(d, view, view.instrs + 4U * INSTR_WORDS * i));
+            in->prev = prev;
+            in->next = 0;
+            if(0 == prev) {
+                first = in;
+            } else {
+                prev->next = in;
+            }
+            prev = in;
+        }
+        return first;
+    }
+
+    /// the registers, labels and symbols of a procedure written as text
+    struct assembler {
+    public:
+        decoder names;
+        std::map<std::string, simple_reg *> regs;
+        std::map<std::string, simple_sym *> labels;
+        std::vector<std::string> words;
+        bool has_dst;
+    };
+
+    /// split a line of text into words; commas, parentheses and equals signs
+    /// only separate words, and comments are dropped
+    static void split_words(assembler &a, const std::string &line) throw() {
+        a.words.clear();
+        a.has_dst = false;
+        std::string word;
+        for(unsigned i(0U); i <= line.size(); ++i) {
+            const char c(i < line.size() ? line[i] : '#');
+            if(isspace(c) || ',' == c || '(' == c || ')' == c || '=' == c || '#' == c) {
+                if(!word.empty()) {
+                    a.words.push_back(word);
+                    word.clear();
+                }
+                a.has_dst = a.has_dst || '=' == c;
+                if('#' == c) {
+                    break;
+                }
+            } else {
+                word.push_back(c);
+            }
+        }
+    }
+
+    /// find or make the register named by a word, e.g. r2 or t1:a
+    static simple_reg *assemble_reg(assembler &a, const std::string &word) throw() {
+        const std::string::size_type colon(word.find(':'));
+        const std::string name(word.substr(0U, colon));
+        if(name.size() < 2U || ('r' != name[0] && 't' != name[0])
+        || name.size() != strspn(name.c_str() + 1U, "0123456789") + 1U) {
+            return 0;
+        }
+
+        std::map<std::string, simple_reg *>::iterator it(a.regs.find(name));
+        if(a.regs.end() != it) {
+            return it->second;
+        }
+
+        simple_type *type(simple_type_signed);
+        if(std::string::npos != colon) {
+            const std::string suffix(word.substr(colon + 1U));
+            if("a" == suffix) {
+                type = simple_type_addr;
+            } else if("u" == suffix) {
+                type = simple_type_unsigned;
+            } else if("f" == suffix) {
+                type = simple_type_double;
+            } else if("i" != suffix) {
+                return 0;
+            }
+        }
+
+        simple_reg *reg(new_register(type, 'r' == name[0] ? PSEUDO_REG : TEMP_REG));
+        a.regs[name] = reg;
+        return reg;
+    }
+
+    /// find or make the label named by a word
+    static simple_sym *assemble_label(assembler &a, const std::string &word) throw() {
+        std::map<std::string, simple_sym *>::iterator it(a.labels.find(word));
+        if(a.labels.end() != it) {
+            return it->second;
+        }
+        simple_sym *label(new_label());
+        a.labels[word] = label;
+        return label;
+    }
+
+    /// find the variable or procedure named by a word, e.g. &A or &A+4
+    static simple_sym *assemble_sym(assembler &a, const std::string &word, int &offset) throw() {
+        const std::string::size_type plus(word.find('+'));
+        const std::string name(word.substr(1U, plus - 1U));
+        offset = std::string::npos == plus ? 0 : atoi(word.c_str() + plus + 1U);
+
+        const int kinds[] = {VAR_SYM, PROC_SYM};
+        for(unsigned i(0U); i < 2U; ++i) {
+            std::map<std::pair<int, std::string>, simple_sym *>::iterator it(
+                a.names.syms.find(std::make_pair(kinds[i], name)));
+            if(a.names.syms.end() != it) {
+                return it->second;
+            }
+        }
+        return 0;
+    }
+
+    /// the operator named by a word
+    static bool assemble_op(const std::string &word, simple_op &op) throw() {
+        for(int i(0); i < LAST_OP; ++i) {
+            if(word == simple_op_name(static_cast<simple_op>(i))) {
+                op = static_cast<simple_op>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// make the instruction on one line; returns 0 if it is malformed
+    static simple_instr *assemble_instr(assembler &a) throw() {
+        const std::vector<std::string> &w(a.words);
+        const std::string &first(w[0U]);
+
+        if(1U == w.size() && ':' == first[first.size() - 1U]) {
+            simple_instr *in(new_instr(LABEL_OP, simple_type_void));
+            in->u.label.lab = assemble_label(a, first.substr(0U, first.size() - 1U));
+            return in;
+        }
+
+        simple_op op;
+        if(!assemble_op(first, op)) {
+            return 0;
+        }
+
+        simple_instr *in(new_instr(op, simple_type_void));
+        bool is_valid(true);
+        switch(op) {
+        case NOP_OP:
+            is_valid = 1U == w.size();
+            break;
+
+        case JMP_OP:
+            is_valid = 2U == w.size();
+            if(is_valid) {
+                in->u.bj.target = assemble_label(a, w[1U]);
+                in->u.bj.src = 0;
+            }
+            break;
+
+        case BTRUE_OP: case BFALSE_OP:
+            is_valid = 3U == w.size()
+                && 0 != (in->u.bj.src = assemble_reg(a, w[1U]));
+            if(is_valid) {
+                in->u.bj.target = assemble_label(a, w[2U]);
+            }
+            break;
+
+        case MBR_OP:
+            is_valid = 4U <= w.size()
+                && 0 != (in->u.mbr.src = assemble_reg(a, w[1U]));
+            if(is_valid) {
+                in->u.mbr.offset = atoi(w[2U].c_str());
+                in->u.mbr.deflab = assemble_label(a, w[3U]);
+                in->u.mbr.ntargets = static_cast<unsigned>(w.size() - 4U);
+                in->u.mbr.targets = static_cast<simple_sym **>(
+                    malloc(sizeof(simple_sym *) * (w.size() - 3U)));
+                for(unsigned i(4U); i < w.size(); ++i) {
+                    in->u.mbr.targets[i - 4U] = assemble_label(a, w[i]);
+                }
+            }
+            break;
+
+        case LDC_OP:
+            is_valid = 3U == w.size()
+                && 0 != (in->u.ldc.dst = assemble_reg(a, w[1U]));
+            if(!is_valid) {
+                break;
+            }
+            in->type = in->u.ldc.dst->var->type;
+            if('&' == w[2U][0]) {
+                in->u.ldc.value.format = IMMED_SYMBOL;
+                in->u.ldc.value.u.s.symbol = assemble_sym(
+                    a, w[2U], in->u.ldc.value.u.s.offset);
+                is_valid = 0 != in->u.ldc.value.u.s.symbol;
+            } else if(std::string::npos != w[2U].find_first_of(".eE")) {
+                in->u.ldc.value.format = IMMED_FLOAT;
+                in->u.ldc.value.u.fval = atof(w[2U].c_str());
+            } else {
+                in->u.ldc.value.format = IMMED_INT;
+                in->u.ldc.value.u.ival = atoi(w[2U].c_str());
+            }
+            break;
+
+        case CALL_OP: {
+            // the result is optional: call r4 = t3(r2) or call t3(r2)
+            const unsigned proc(a.has_dst ? 2U : 1U);
+            in->u.call.dst = 0;
+            is_valid = proc < w.size()
+                && (!a.has_dst || 0 != (in->u.call.dst = assemble_reg(a, w[1U])))
+                && 0 != (in->u.call.proc = assemble_reg(a, w[proc]));
+            if(!is_valid) {
+                break;
+            }
+            in->u.call.nargs = static_cast<unsigned>(w.size() - proc - 1U);
+            in->u.call.args = static_cast<simple_reg **>(
+                malloc(sizeof(simple_reg *) * (w.size() - proc)));
+            for(unsigned i(proc + 1U); i < w.size(); ++i) {
+                in->u.call.args[i - proc - 1U] = assemble_reg(a, w[i]);
+                is_valid = is_valid && 0 != in->u.call.args[i - proc - 1U];
+            }
+            if(0 != in->u.call.dst) {
+                in->type = in->u.call.dst->var->type;
+            }
+            break;
+        }
+
+        case RET_OP:
+            in->u.base.dst = 0;
+            in->u.base.src1 = 0;
+            in->u.base.src2 = 0;
+            is_valid = 2U >= w.size()
+                && (1U == w.size() || 0 != (in->u.base.src1 = assemble_reg(a, w[1U])));
+            if(is_valid && 0 != in->u.base.src1) {
+                in->type = in->u.base.src1->var->type;
+            }
+            break;
+
+        case STR_OP: case MCPY_OP:
+            in->u.base.dst = 0;
+            is_valid = 3U == w.size()
+                && 0 != (in->u.base.src1 = assemble_reg(a, w[1U]))
+                && 0 != (in->u.base.src2 = assemble_reg(a, w[2U]));
+            if(is_valid) {
+                in->type = in->u.base.src2->var->type;
+            }
+            break;
+
+        default:
+            // dst = src1 or dst = src1, src2
+            in->u.base.src2 = 0;
+            is_valid = (3U == w.size() || 4U == w.size())
+                && 0 != (in->u.base.dst = assemble_reg(a, w[1U]))
+                && 0 != (in->u.base.src1 = assemble_reg(a, w[2U]))
+                && (3U == w.size() || 0 != (in->u.base.src2 = assemble_reg(a, w[3U])));
+            if(is_valid) {
+                in->type = in->u.base.dst->var->type;
+            }
+            break;
+        }
+
+        if(!is_valid) {
+            free_instr(in);
+            return 0;
+        }
+        return in;
+    }
+
+    simple_instr *assemble(const std::string &text, simple_instr *in_list) throw() {
+        assembler a;
+        find_names(a.names, in_list);
+
+        simple_instr *first(0), *prev(0);
+        unsigned line_num(0U);
+        for(std::string::size_type begin(0U), end(0U); begin < text.size(); begin = end + 1U) {
+            end = text.find('\n', begin);
+            if(std::string::npos == end) {
+                end = text.size();
+            }
+            ++line_num;
+
+            split_words(a, text.substr(begin, end - begin));
+            if(a.words.empty()) {
+                continue;
+            }
+
+            simple_instr *in(assemble_instr(a));
+            if(0 == in) {
+                diag::warning(
+                    "Unable to read line %u of a procedure: %s",
+                    line_num, text.substr(begin, end - begin).c_str());
+                for(simple_instr *next(0); 0 != first; first = next) {
+                    next = first->next;
+                    free_instr(first);
+                }
+                return 0;
+            }
+
+            in->prev = prev;
+            in->next = 0;
+            if(0 == prev) {
+                first = in;
+            } else {
+                prev->next = in;
+            }
+            prev = in;
+        }
+        return first;
+    }
+
+    /// the file that procedures are saved to
+    static writer SAVED;
+    static bool IS_SAVE_OPEN(false);
+
+    void save(const char *proc_name, simple_instr *in_list) throw() {
+        const char *file_name(getenv("ECE540_IR_SAVE"));
+        if(0 == file_name) {
+            return;
+        }
+
+        if(!IS_SAVE_OPEN) {
+            IS_SAVE_OPEN = true;
+            if(!SAVED.open(file_name)) {
+                diag::warning("Unable to open '%s' to save procedures.", file_name);
+            }
+        }
+
+        if(!SAVED.write(proc_name, in_list)) {
+            diag::warning("Unable to save '%s'.", proc_name);
+        }
+    }
+
+    /// the file that procedures are loaded from
+    static reader LOADED;
+    static bool IS_LOAD_OPEN(false);
+
+    simple_instr *load(const char *proc_name, simple_instr *in_list) throw() {
+        const char *file_name(getenv("ECE540_IR_LOAD"));
+        if(0 == file_name) {
+            return in_list;
+        }
+
+        if(!IS_LOAD_OPEN) {
+            IS_LOAD_OPEN = true;
+            if(!LOADED.open(file_name)) {
+                diag::warning("Unable to load procedures from '%s'.", file_name);
+            }
+        }
+
+        const procedure_view *view(LOADED.find(proc_name));
+        const std::string *text(LOADED.find_text(proc_name));
+        simple_instr *loaded(0);
+        if(0 != view) {
+            loaded = decode(*view, in_list);
+            if(0 == loaded && 0U != view->num_instrs) {
+                diag::warning("Unable to load '%s'; its symbols don't match.", proc_name);
+                return in_list;
+            }
+        } else if(0 != text) {
+            loaded = assemble(*text, in_list);
+            if(0 == loaded) {
+                diag::warning("Unable to load '%s' from text.", proc_name);
+                return in_list;
+            }
+        } else {
+            return in_list;
+        }
+
+        for(simple_instr *in(in_list), *next(0); 0 != in; in = next) {
+            next = in->next;
+            free_instr(in);
+        }
+        return loaded;
+    }
+}
@@ -0,0 +1,120 @@
+/*
+ * label_map.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <stdint.h>
+
+#include "include/label_map.h"
+
+enum {
+    MIN_SLOTS = 64U
+};
+
+/// hash a label by its address; the low bits of addresses are mostly zero,
+/// so mix the bits with a multiplicative hash
+static unsigned hash_label(const simple_sym *label, unsigned num_slots) throw() {
+    const uintptr_t addr(reinterpret_cast<uintptr_t>(label));
+    const uint32_t mixed(static_cast<uint32_t>((addr >> 3) ^ (addr >> 17)) * 2654435761U);
+    return mixed & (num_slots - 1U);
+}
+
+label_map::label_map(void) throw()
+    : slots(MIN_SLOTS)
+    , generation(1U)
+    , num_labels(0U)
+{
+    for(unsigned i(0); i < slots.size(); ++i) {
+        slots[i].generation = 0U;
+    }
+}
+
+void label_map::clear(void) throw() {
+    ++generation;
+    num_labels = 0U;
+
+    // the generation wrapped around; really clear the table
+    if(0U == generation) {
+        for(unsigned i(0); i < slots.size(); ++i) {
+            slots[i].generation = 0U;
+        }
+        generation = 1U;
+    }
+}
+
+/// find the slot of a label, or 0 if the label isn't in the table
+label_map::slot *label_map::find(const simple_sym *label) throw() {
+    const unsigned mask(static_cast<unsigned>(slots.size()) - 1U);
+    for(unsigned i(hash_label(label, mask + 1U)); ; i = (i + 1U) & mask) {
+        slot &s(slots[i]);
+        if(generation != s.generation) {
+            return 0;
+        } else if(label == s.label) {
+            return &s;
+        }
+    }
+}
+
+/// find the slot of a label, adding the label if it isn't in the table
+label_map::slot &label_map::insert(simple_sym *label) throw() {
+    if(slots.size() <= 2U * (num_labels + 1U)) {
+        grow();
+    }
+
+    const unsigned mask(static_cast<unsigned>(slots.size()) - 1U);
+    for(unsigned i(hash_label(label, mask + 1U)); ; i = (i + 1U) & mask) {
+        slot &s(slots[i]);
+        if(generation != s.generation) {
+            s.label = label;
+            s.block = 0;
+            s.generation = generation;
+            s.is_used = false;
+            ++num_labels;
+            return s;
+        } else if(label == s.label) {
+            return s;
+        }
+    }
+}
+
+/// double the size of the table, keeping it at most half full
+void label_map::grow(void) throw() {
+    std::vector<slot> old_slots(2U * slots.size());
+    old_slots.swap(slots);
+
+    const unsigned old_generation(generation);
+    for(unsigned i(0); i < slots.size(); ++i) {
+        slots[i].generation = 0U;
+    }
+    generation = 1U;
+    num_labels = 0U;
+
+    for(unsigned i(0); i < old_slots.size(); ++i) {
+        const slot &old(old_slots[i]);
+        if(old_generation == old.generation) {
+            slot &s(insert(old.label));
+            s.block = old.block;
+            s.is_used = old.is_used;
+        }
+    }
+}
+
+void label_map::use(simple_sym *label) throw() {
+    insert(label).is_used = true;
+}
+
+bool label_map::is_used(const simple_sym *label) throw() {
+    const slot *s(find(label));
+    return 0 != s && s->is_used;
+}
+
+basic_block *label_map::block(const simple_sym *label) throw() {
+    const slot *s(find(label));
+    return 0 == s ? 0 : s->block;
+}
+
+void label_map::set_block(simple_sym *label, basic_block *bb) throw() {
+    insert(label).block = bb;
+}
@@ -7,6 +7,7 @@
  */
 
 #include <map>
+#include <algorithm>
 #include <cassert>
 
 #include "include/loop.h"
@@ -247,6 +248,127 @@ static void add_pre_header(
     );
 }
 
+/// state for finding the strongly connected components of part of a CFG
+struct scc_state {
+public:
+    const std::set<basic_block *> *blocks;
+    std::map<basic_block *, unsigned> index;
+    std::map<basic_block *, unsigned> low_link;
+    std::vector<basic_block *> stack;
+    std::set<basic_block *> on_stack;
+    std::vector<std::set<basic_block *> > components;
+};
+
+/// Tarjan's algorithm for strongly connected components, restricted to the
+/// blocks in the state's set of blocks
+static void find_component(scc_state &s, basic_block *bb) throw() {
+    const unsigned bb_index(static_cast<unsigned>(s.index.size()));
+    s.index[bb] = bb_index;
+    s.low_link[bb] = bb_index;
+    s.stack.push_back(bb);
+    s.on_stack.insert(bb);
+
+    const std::set<basic_block *> &succs(bb->successors());
+    std::set<basic_block *>::const_iterator it(succs.begin()), end(succs.end());
+    for(; it != end; ++it) {
+        basic_block *succ(*it);
+        if(0U == s.blocks->count(succ)) {
+            continue;
+
+        } else if(0U == s.index.count(succ)) {
+            find_component(s, succ);
+            s.low_link[bb] = std::min(s.low_link[bb], s.low_link[succ]);
+
+        } else if(0U != s.on_stack.count(succ)) {
+            s.low_link[bb] = std::min(s.low_link[bb], s.index[succ]);
+        }
+    }
+
+    if(s.low_link[bb] != bb_index) {
+        return;
+    }
+
+    s.components.push_back(std::set<basic_block *>());
+    std::set<basic_block *> &component(s.components.back());
+    for(basic_block *member(0); member != bb; ) {
+        member = s.stack.back();
+        s.stack.pop_back();
+        s.on_stack.erase(member);
+        component.insert(member);
+    }
+}
+
+/// find the cycles with more than one entry among some blocks. This follows
+/// Ramalingam's approach: a strongly connected component with a single entry
+/// is a (reducible) loop, and cycles nested in it are found by looking at the
+/// component without its entry; a component with several entries is an
+/// irreducible loop, and nested cycles are found by looking at the component
+/// without any of its entries.
+static void find_irreducible_loops(
+    const std::set<basic_block *> &blocks,
+    std::vector<irreducible_loop> &irreducible
+) throw() {
+    scc_state s;
+    s.blocks = &blocks;
+
+    std::set<basic_block *>::const_iterator it(blocks.begin())
+                                          , end(blocks.end());
+    for(; it != end; ++it) {
+        if(0U == s.index.count(*it)) {
+            find_component(s, *it);
+        }
+    }
+
+    for(unsigned i(0U); i < s.components.size(); ++i) {
+        std::set<basic_block *> &component(s.components[i]);
+
+        // a single block is at most a self-loop
+        if(1U == component.size()) {
+            continue;
+        }
+
+        std::vector<basic_block *> entries;
+        for(it = component.begin(), end = component.end(); it != end; ++it) {
+            const std::set<basic_block *> &preds((*it)->predecessors());
+            std::set<basic_block *>::const_iterator pred_it(preds.begin())
+                                                  , pred_end(preds.end());
+            for(; pred_it != pred_end; ++pred_it) {
+                if(0U == component.count(*pred_it)) {
+                    entries.push_back(*it);
+                    break;
+                }
+            }
+        }
+
+        if(1U < entries.size()) {
+            irreducible.push_back(irreducible_loop());
+            irreducible.back().body = component;
+            irreducible.back().entries = entries;
+        }
+
+        for(unsigned j(0U); j < entries.size(); ++j) {
+            component.erase(entries[j]);
+        }
+
+        find_irreducible_loops(component, irreducible);
+    }
+}
+
+/// find the irreducible loops among the blocks reachable from the entry of a
+/// CFG
+void find_irreducible_loops(
+    cfg &flow_graph,
+    std::vector<irreducible_loop> &irreducible
+) throw() {
+    std::set<basic_block *> blocks;
+    for(basic_block *bb(flow_graph.entry()); 0 != bb; bb = bb->next) {
+        if(bb->entry_reachable) {
+            blocks.insert(bb);
+        }
+    }
+    find_irreducible_loops(blocks, irreducible);
+}
+
 /// (re)initialize the loop map by first finding potential loop bounds (back edges)
 /// and then trying to fill out the bodies of those loops given their bounds
 void find_loops(
@@ -378,9 +500,14 @@ void find_loops(
     }
 
     assert(curr_loop == lm.num_loops);
+
+    lm.nest();
 }
 
 void loop_map::clean_up(void) throw() {
+    roots.clear();
+    nested_first.clear();
+    innermost.clear();
     num_loops = 0;
     if(0 != loops_) {
         delete [] loops_;
@@ -402,15 +529,138 @@ loop::loop(void) throw()
     , head(0)
     , body()
     , tails()
+    , exits()
+    , parent(0)
+    , children()
+    , depth(0U)
 { }
 
 loop::~loop(void) throw() {
     pre_header = 0;
     head = 0;
+    parent = 0;
     body.clear();
     tails.clear();
+    exits.clear();
+    children.clear();
 }
 
+/// the estimated number of times that the body of a loop runs each time the
+/// loop is entered, and the deepest nesting that is weighted
+enum {
+    LOOP_WEIGHT = 10U,
+    MAX_WEIGHTED_DEPTH = 6U
+};
+
 unsigned loop_map::size(void) const throw() {
     return num_loops;
 }
+
+const std::vector<loop *> &loop_map::outermost_loops(void) const throw() {
+    return roots;
+}
+
+const std::vector<loop *> &loop_map::inner_to_outer(void) const throw() {
+    return nested_first;
+}
+
+loop *loop_map::innermost_loop(basic_block *bb) const throw() {
+    std::map<basic_block *, loop *>::const_iterator it(innermost.find(bb));
+    if(innermost.end() == it) {
+        return 0;
+    }
+    return it->second;
+}
+
+unsigned loop_map::depth(basic_block *bb) const throw() {
+    const loop *l(innermost_loop(bb));
+    return 0 == l ? 0U : l->depth;
+}
+
+unsigned loop_map::weight(basic_block *bb) const throw() {
+    const unsigned depth(std::min(this->depth(bb), unsigned(MAX_WEIGHTED_DEPTH)));
+    unsigned weight(1U);
+    for(unsigned i(0U); i < depth; ++i) {
+        weight *= LOOP_WEIGHT;
+    }
+    return weight;
+}
+
+/// go find the exit nodes of the loop
+static void find_exits(loop &loop) throw() {
+    std::set<basic_block *>::const_iterator it(loop.body.begin())
+                                          , end(loop.body.end());
+
+    for(; it != end; ++it) {
+        const basic_block *bb(*it);
+
+        if(0 == bb->last) {
+            continue;
+        }
+
+        switch(bb->last->opcode) {
+
+        // we only care if one of their successors is not in the loop's body
+        case BTRUE_OP: case BFALSE_OP: case MBR_OP: {
+            const std::set<basic_block *> &succ(bb->successors());
+            std::set<basic_block *>::const_iterator succ_it(succ.begin())
+                                                  , succ_end(succ.end());
+
+            for(; succ_it != succ_end; ++succ_it) {
+                if(0U == loop.body.count(*succ_it)) {
+                    loop.exits.push_back(*succ_it);
+                }
+            }
+
+            break;
+        }
+
+        // note: by definition, a fall-through or direct jump cannot
+        //       be an exit of the loop, as each only has one successor
+        default:
+            assert(1U == bb->successors().size());
+            break;
+        }
+    }
+}
+
+/// orders loops by decreasing size; an enclosing loop is always bigger than
+/// the loops nested in it
+static bool larger_loop(const loop *a, const loop *b) throw() {
+    return a->body.size() > b->body.size();
+}
+
+/// build the loop nesting forest. Loops are visited from largest to smallest,
+/// so the enclosing loops of a loop are visited before it, and the innermost
+/// loop seen so far that contains a loop's head is its parent.
+void loop_map::nest(void) throw() {
+    std::vector<loop *> by_size;
+    by_size.reserve(num_loops);
+    for(unsigned i(0U); i < num_loops; ++i) {
+        by_size.push_back(&(loops_[i]));
+    }
+    std::stable_sort(by_size.begin(), by_size.end(), &larger_loop);
+
+    for(unsigned i(0U); i < by_size.size(); ++i) {
+        loop *l(by_size[i]);
+
+        find_exits(*l);
+
+        l->parent = innermost_loop(l->head);
+        if(0 == l->parent) {
+            l->depth = 1U;
+            roots.push_back(l);
+        } else {
+            l->depth = l->parent->depth + 1U;
+            l->parent->children.push_back(l);
+        }
+
+        std::set<basic_block *>::const_iterator it(l->body.begin())
+                                              , end(l->body.end());
+        for(; it != end; ++it) {
+            innermost[*it] = l;
+        }
+    }
+
+    nested_first.assign(by_size.rbegin(), by_size.rend());
+}
@@ -0,0 +1,638 @@
+/*
+ * bp.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <map>
+#include <utility>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "include/opt/bp.h"
+#include "include/cfg.h"
+#include "include/instr.h"
+#include "include/loop.h"
+#include "include/optimizer.h"
+#include "include/stats.h"
+
+/// static probabilities (in percent) that the more likely successor of a
+/// conditional branch is taken; these are Ball and Larus' loop branch, loop
+/// exit and return heuristics
+enum {
+    LOOP_BRANCH_PROB = 88U,
+    LOOP_EXIT_PROB = 80U,
+    RETURN_PROB = 72U,
+    EVEN_PROB = 50U,
+
+    /// how often the first block runs, and how many times the head of a loop
+    /// runs each time that the loop is entered
+    ENTRY_FREQUENCY = 1000U,
+    LOOP_TRIP_COUNT = 10U,
+
+    /// largest block ending in a conditional branch that is copied instead of
+    /// being jumped to
+    MAX_COPIED_TEST_SIZE = 4U,
+
+    /// how much (in percent of a jump) is saved when a conditional branch
+    /// falls through instead of being taken
+    BRANCH_SAVING = 50U,
+
+    NO_BLOCK = ~0U // block index of a missing block
+};
+
+/// block frequencies stop growing here, so that deep loop nests don't
+/// overflow the edge weights
+static const uint64_t MAX_FREQUENCY(static_cast<uint64_t>(1) << 40);
+
+/// a successor of a block, and the probability (in percent) that the block
+/// goes to it
+struct placement_succ {
+public:
+    unsigned block;
+    unsigned prob;
+};
+
+/// an edge along which one block could fall through to another, weighted by
+/// how often it is expected to be followed
+struct placement_edge {
+public:
+    uint64_t weight;
+    unsigned from;
+    unsigned to;
+    bool is_unconditional;
+    bool is_fall_through;
+};
+
+struct placement_state {
+public:
+    loop_map *loops;
+    cfg *flow;
+
+    /// the blocks in their original order, and the index of each block
+    std::vector<basic_block *> blocks;
+    std::map<basic_block *, unsigned> index;
+
+    /// the block that each block originally falls through to, or NO_BLOCK
+    std::vector<unsigned> fall_through;
+
+    /// the successors of each block, and the estimated number of times that
+    /// each block runs
+    std::vector<std::vector<placement_succ> > succs;
+    std::vector<uint64_t> frequency;
+
+    std::vector<placement_edge> edges;
+
+    /// chains of blocks that will fall through to one another. Each chain is
+    /// a doubly-linked list, and the blocks of merged chains are kept in a
+    /// union-find forest so that it's cheap to tell if two blocks are in the
+    /// same chain.
+    std::vector<unsigned> chain_next;
+    std::vector<unsigned> chain_prev;
+    std::vector<unsigned> chain_root;
+
+    unsigned num_inverted;
+    unsigned num_tests_copied;
+    unsigned num_jumps_removed;
+    unsigned num_jumps_added;
+};
+
+/// does a block end by returning?
+static bool returns(basic_block *bb) throw() {
+    return 0 != bb->last && instr::is_return(bb->last);
+}
+
+/// is an edge a back edge of some loop containing a block?
+static bool is_back_edge(loop_map &loops, basic_block *bb, basic_block *succ) throw() {
+    for(loop *l(loops.innermost_loop(bb)); 0 != l; l = l->parent) {
+        if(succ == l->head) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// does an edge leave the innermost loop containing a block?
+static bool exits_loop(loop_map &loops, basic_block *bb, basic_block *succ) throw() {
+    loop *l(loops.innermost_loop(bb));
+    return 0 != l && 0U == l->body.count(succ);
+}
+
+/// the probability (in percent) that a block goes to a successor that can
+/// only be reached from it, according to the profile
+static bool profiled_probability(
+    basic_block *bb,
+    basic_block *succ,
+    unsigned &prob
+) throw() {
+    if(!succ->has_count || 1U != succ->predecessors().size()) {
+        return false;
+    }
+    const uint64_t count(std::min(succ->count, bb->count));
+    prob = static_cast<unsigned>(count * 100U / bb->count);
+    return true;
+}
+
+/// guess the probability (in percent) that a conditional branch is taken.
+/// If the profile has counts for the block and for a successor that only it
+/// goes to, then those say how often the branch is taken. Otherwise, back
+/// edges are likely to be taken, edges that leave a loop are unlikely, and so
+/// are edges to blocks that return.
+static unsigned taken_probability(
+    loop_map &loops,
+    basic_block *bb,
+    basic_block *taken,
+    basic_block *not_taken
+) throw() {
+    unsigned prob(0U);
+    if(bb->has_count && 0U != bb->count) {
+        if(profiled_probability(bb, taken, prob)) {
+            return prob;
+        } else if(profiled_probability(bb, not_taken, prob)) {
+            return 100U - prob;
+        }
+    }
+
+    const bool taken_back(is_back_edge(loops, bb, taken));
+    if(taken_back != is_back_edge(loops, bb, not_taken)) {
+        return taken_back ? LOOP_BRANCH_PROB : 100U - LOOP_BRANCH_PROB;
+    }
+
+    const bool taken_exits(exits_loop(loops, bb, taken));
+    if(taken_exits != exits_loop(loops, bb, not_taken)) {
+        return taken_exits ? 100U - LOOP_EXIT_PROB : LOOP_EXIT_PROB;
+    }
+
+    const bool taken_returns(returns(taken));
+    if(taken_returns != returns(not_taken)) {
+        return taken_returns ? 100U - RETURN_PROB : RETURN_PROB;
+    }
+
+    return EVEN_PROB;
+}
+
+/// order edges by decreasing weight. Ties go to edges from blocks with only
+/// one successor, as not following those costs a jump, while a branch has to
+/// be there anyway; then to edges that already fall through, and then to
+/// earlier blocks, so that the original order is kept when nothing better is
+/// known.
+static bool is_heavier(const placement_edge &a, const placement_edge &b) throw() {
+    if(a.weight != b.weight) {
+        return a.weight > b.weight;
+    } else if(a.is_unconditional != b.is_unconditional) {
+        return a.is_unconditional;
+    } else if(a.is_fall_through != b.is_fall_through) {
+        return a.is_fall_through;
+    } else if(a.from != b.from) {
+        return a.from < b.from;
+    }
+    return a.to < b.to;
+}
+
+/// add a successor of a block, if it is a block that can be moved around
+/// (i.e. not the exit block)
+static void add_succ(
+    placement_state &s,
+    unsigned from,
+    basic_block *succ,
+    unsigned prob
+) throw() {
+    std::map<basic_block *, unsigned>::const_iterator it(s.index.find(succ));
+    if(s.index.end() == it) {
+        return;
+    }
+
+    placement_succ ps;
+    ps.block = it->second;
+    ps.prob = prob;
+    s.succs[from].push_back(ps);
+}
+
+/// number the blocks in their original order; returns false if they can't be
+/// moved around
+static bool find_blocks(placement_state &s) throw() {
+    cfg &flow(*s.flow);
+    for(basic_block *bb(flow.entry()->next); flow.exit() != bb; bb = bb->next) {
+        if(!instr::is_label(bb->first)) {
+            return false;
+        }
+        s.index[bb] = static_cast<unsigned>(s.blocks.size());
+        s.blocks.push_back(bb);
+    }
+
+    // the last block can't be moved if it falls off the end of the procedure
+    if(2U > s.blocks.size() || s.blocks.back()->falls_through()) {
+        return false;
+    }
+
+    for(unsigned i(0U); i < s.blocks.size(); ++i) {
+        s.fall_through.push_back(s.blocks[i]->falls_through() ? i + 1U : NO_BLOCK);
+    }
+    return true;
+}
+
+/// find the successors of each block, and how likely each one is
+static void find_succs(placement_state &s) throw() {
+    s.succs.resize(s.blocks.size());
+
+    for(unsigned i(0U); i < s.blocks.size(); ++i) {
+        basic_block *bb(s.blocks[i]);
+        simple_instr *last(bb->last);
+
+        switch(last->opcode) {
+        case JMP_OP:
+            add_succ(s, i, s.flow->find_block(last->u.bj.target), 100U);
+            break;
+
+        case BTRUE_OP:
+        case BFALSE_OP: {
+            basic_block *taken(s.flow->find_block(last->u.bj.target));
+            basic_block *not_taken(s.blocks[s.fall_through[i]]);
+            if(taken == not_taken) {
+                add_succ(s, i, taken, 100U);
+                break;
+            }
+
+            const unsigned prob(taken_probability(
+                *s.loops, bb, taken, not_taken));
+
+            add_succ(s, i, taken, prob);
+            add_succ(s, i, not_taken, 100U - prob);
+            break;
+        }
+
+        case MBR_OP: {
+            const std::set<basic_block *> &succs(bb->successors());
+            const unsigned prob(100U / static_cast<unsigned>(succs.size()));
+            std::set<basic_block *>::const_iterator it(succs.begin()), end(succs.end());
+            for(; it != end; ++it) {
+                add_succ(s, i, *it, prob);
+            }
+            break;
+        }
+
+        default:
+            if(NO_BLOCK != s.fall_through[i]) {
+                add_succ(s, i, s.blocks[s.fall_through[i]], 100U);
+            }
+            break;
+        }
+    }
+}
+
+/// estimate how often each block runs. Blocks are visited in reverse post
+/// order, so each block is visited after all of its predecessors, except for
+/// those along back edges. The frequency of a block is its profiled count if
+/// there is one. Otherwise, it's the sum of the frequencies of the edges into
+/// it, and the head of a loop runs LOOP_TRIP_COUNT times for each time the
+/// loop is entered.
+static void find_frequencies(placement_state &s) throw() {
+    const unsigned num_blocks(static_cast<unsigned>(s.blocks.size()));
+
+    std::vector<unsigned> num_loops(num_blocks, 0U);
+    const std::vector<loop *> &loops(s.loops->inner_to_outer());
+    for(unsigned i(0U); i < loops.size(); ++i) {
+        std::map<basic_block *, unsigned>::const_iterator it(
+            s.index.find(loops[i]->head));
+        if(s.index.end() != it) {
+            ++num_loops[it->second];
+        }
+    }
+
+    // find a post order of the blocks reachable from the first block
+    std::vector<unsigned> post_order;
+    std::vector<unsigned> post_number(num_blocks, NO_BLOCK);
+    std::vector<bool> is_seen(num_blocks, false);
+    std::vector<std::pair<unsigned, unsigned> > stack;
+    stack.push_back(std::make_pair(0U, 0U));
+    is_seen[0] = true;
+    while(!stack.empty()) {
+        const unsigned i(stack.back().first);
+        const unsigned next_succ(stack.back().second);
+        if(next_succ < s.succs[i].size()) {
+            ++stack.back().second;
+            const unsigned succ(s.succs[i][next_succ].block);
+            if(!is_seen[succ]) {
+                is_seen[succ] = true;
+                stack.push_back(std::make_pair(succ, 0U));
+            }
+        } else {
+            post_number[i] = static_cast<unsigned>(post_order.size());
+            post_order.push_back(i);
+            stack.pop_back();
+        }
+    }
+
+    // spread the frequencies along the edges that go forward in the order
+    s.frequency.assign(num_blocks, 0U);
+    std::vector<uint64_t> incoming(num_blocks, 0U);
+    incoming[0] = ENTRY_FREQUENCY;
+    for(unsigned k(static_cast<unsigned>(post_order.size())); k-- > 0U; ) {
+        const unsigned i(post_order[k]);
+        basic_block *bb(s.blocks[i]);
+        uint64_t freq(incoming[i]);
+        if(bb->has_count) {
+            freq = bb->count;
+        } else {
+            for(unsigned j(0U); j < num_loops[i]; ++j) {
+                freq *= LOOP_TRIP_COUNT;
+            }
+        }
+        s.frequency[i] = std::min(freq, MAX_FREQUENCY);
+
+        for(unsigned j(0U); j < s.succs[i].size(); ++j) {
+            const placement_succ &succ(s.succs[i][j]);
+            if(post_number[succ.block] < k) {
+                incoming[succ.block] += s.frequency[i] * succ.prob / 100U;
+            }
+        }
+    }
+}
+
+/// find the edges along which blocks could fall through to one another,
+/// heaviest first. The first block of the procedure can't be fallen into.
+static void find_edges(placement_state &s) throw() {
+    for(unsigned i(0U); i < s.blocks.size(); ++i) {
+        for(unsigned j(0U); j < s.succs[i].size(); ++j) {
+            const placement_succ &succ(s.succs[i][j]);
+            if(0U == succ.block || i == succ.block) {
+                continue;
+            }
+
+            placement_edge edge;
+            edge.weight = s.frequency[i] * succ.prob;
+            edge.from = i;
+            edge.to = succ.block;
+            edge.is_unconditional = (1U == s.succs[i].size());
+            edge.is_fall_through = (s.fall_through[i] == succ.block);
+            if(!edge.is_unconditional) {
+                edge.weight = edge.weight * BRANCH_SAVING / 100U;
+            }
+            s.edges.push_back(edge);
+        }
+    }
+
+    std::sort(s.edges.begin(), s.edges.end(), &is_heavier);
+}
+
+/// find the chain that a block belongs to
+static unsigned find_chain(placement_state &s, unsigned i) throw() {
+    unsigned root(i);
+    while(s.chain_root[root] != root) {
+        root = s.chain_root[root];
+    }
+    while(s.chain_root[i] != root) {
+        const unsigned next(s.chain_root[i]);
+        s.chain_root[i] = root;
+        i = next;
+    }
+    return root;
+}
+
+/// greedily join chains of blocks along the heaviest edges (Pettis and
+/// Hansen's bottom-up placement). An edge joins two chains if it goes from
+/// the end of one to the beginning of another.
+static void build_chains(placement_state &s) throw() {
+    const unsigned num_blocks(static_cast<unsigned>(s.blocks.size()));
+    s.chain_next.assign(num_blocks, NO_BLOCK);
+    s.chain_prev.assign(num_blocks, NO_BLOCK);
+    s.chain_root.resize(num_blocks);
+    for(unsigned i(0U); i < num_blocks; ++i) {
+        s.chain_root[i] = i;
+    }
+
+    for(unsigned i(0U); i < s.edges.size(); ++i) {
+        const placement_edge &edge(s.edges[i]);
+        if(NO_BLOCK != s.chain_next[edge.from]
+        || NO_BLOCK != s.chain_prev[edge.to]) {
+            continue;
+        }
+
+        const unsigned from_chain(find_chain(s, edge.from));
+        const unsigned to_chain(find_chain(s, edge.to));
+        if(from_chain == to_chain) {
+            continue;
+        }
+
+        s.chain_next[edge.from] = edge.to;
+        s.chain_prev[edge.to] = edge.from;
+        s.chain_root[to_chain] = from_chain;
+    }
+}
+
+/// order the blocks chain by chain. The chains are placed in the order of
+/// their earliest blocks, so the chain of the first block stays first.
+static void order_blocks(placement_state &s, std::vector<unsigned> &order) throw() {
+    std::vector<bool> is_placed(s.blocks.size(), false);
+    for(unsigned i(0U); i < s.blocks.size(); ++i) {
+        const unsigned chain(find_chain(s, i));
+        if(is_placed[chain]) {
+            continue;
+        }
+        is_placed[chain] = true;
+
+        unsigned head(i);
+        while(NO_BLOCK != s.chain_prev[head]) {
+            head = s.chain_prev[head];
+        }
+        for(unsigned j(head); NO_BLOCK != j; j = s.chain_next[j]) {
+            order.push_back(j);
+        }
+    }
+}
+
+/// add a jump to a label after some instruction
+static void add_jump(simple_instr *after, simple_sym *lab) throw() {
+    simple_instr *jmp(new_instr(JMP_OP, 0));
+    jmp->u.bj.target = lab;
+    jmp->u.bj.src = 0;
+    instr::insert_after(jmp, after);
+}
+
+/// instead of adding a jump from a block to the block that it used to fall
+/// through to, copy that block if it is a small test whose copy can fall
+/// through to the next block. This is what happens to the jump into a loop
+/// whose test was moved to the bottom: the test is copied in front of the
+/// loop, so that the loop is entered without a jump.
+static bool copy_test(
+    placement_state &s,
+    basic_block *bb,
+    basic_block *next
+) throw() {
+    const unsigned fall_through(s.fall_through[s.index[bb]]);
+    if(0 == next
+    || NO_BLOCK == fall_through
+    || instr::is_local_control_flow_transfer(bb->last)) {
+        return false;
+    }
+
+    basic_block *test(s.blocks[fall_through]);
+    if(next == test
+    || (BTRUE_OP != test->last->opcode && BFALSE_OP != test->last->opcode)
+    || MAX_COPIED_TEST_SIZE < test->code_size()) {
+        return false;
+    }
+
+    const unsigned test_fall_through(s.fall_through[fall_through]);
+    if(NO_BLOCK == test_fall_through || next != s.blocks[test_fall_through]) {
+        return false;
+    }
+
+    test->copy_after(bb->last);
+    ++s.num_tests_copied;
+    return true;
+}
+
+/// fix up the end of a block, now that some other block (or none) follows
+/// it. A jump to the next block is removed. A branch whose target now follows
+/// it is inverted, and a block that no longer falls through to where it used
+/// to gets a jump there; for a conditional branch, this jump splits the edge
+/// into a new block.
+static void fix_block_end(
+    placement_state &s,
+    basic_block *bb,
+    basic_block *next
+) throw() {
+    simple_instr *last(bb->last);
+    simple_sym *next_label(0 == next ? 0 : next->first->u.label.lab);
+
+    if(JMP_OP == last->opcode) {
+        if(next_label == last->u.bj.target) {
+            last->prev->next = last->next;
+            if(0 != last->next) {
+                last->next->prev = last->prev;
+            }
+            ++s.num_jumps_removed;
+        }
+        return;
+    }
+
+    const unsigned fall_through(s.fall_through[s.index[bb]]);
+    if(NO_BLOCK == fall_through) {
+        return;
+    }
+
+    basic_block *fall_through_bb(s.blocks[fall_through]);
+    if(next == fall_through_bb) {
+        return;
+    }
+
+    simple_sym *fall_through_label(fall_through_bb->first->u.label.lab);
+
+    if((BTRUE_OP == last->opcode || BFALSE_OP == last->opcode)
+    && next_label == last->u.bj.target) {
+        last->opcode = (BTRUE_OP == last->opcode) ? BFALSE_OP : BTRUE_OP;
+        last->u.bj.target = fall_through_label;
+        ++s.num_inverted;
+    } else {
+        add_jump(last, fall_through_label);
+        ++s.num_jumps_added;
+    }
+}
+
+/// relink the instructions of the blocks in their new order, then fix up the
+/// ends of the blocks. Tests are copied before anything else is fixed up, as
+/// that copies the original branches.
+static void move_blocks(placement_state &s, const std::vector<unsigned> &order) throw() {
+    simple_instr *prev(0);
+    for(unsigned i(0U); i < order.size(); ++i) {
+        basic_block *bb(s.blocks[order[i]]);
+        bb->first->prev = prev;
+        if(0 != prev) {
+            prev->next = bb->first;
+        }
+        prev = bb->last;
+    }
+    prev->next = 0;
+
+    std::vector<basic_block *> next(order.size(), 0);
+    for(unsigned i(0U); i + 1U < order.size(); ++i) {
+        next[i] = s.blocks[order[i + 1U]];
+    }
+
+    std::vector<bool> is_fixed(order.size(), false);
+    for(unsigned i(0U); i < order.size(); ++i) {
+        is_fixed[i] = copy_test(s, s.blocks[order[i]], next[i]);
+    }
+
+    for(unsigned i(0U); i < order.size(); ++i) {
+        if(!is_fixed[i]) {
+            fix_block_end(s, s.blocks[order[i]], next[i]);
+        }
+    }
+}
+
+/// reorder the basic blocks so that each block is followed by its most
+/// likely successor. How often an edge is followed comes from the profiled
+/// counts of the blocks (see profile.h). Without a profile, it is guessed
+/// from static branch heuristics, which give the frequencies of the blocks,
+/// assuming that every loop runs a fixed number of times. Chains of blocks
+/// are built along the heaviest edges first. This moves the test of a loop
+/// whose head exits the loop to the bottom of the loop, so that each
+/// iteration runs one branch instead of a branch and a jump. Afterward,
+/// jumps to the next block are removed, and jumps (or copies of small tests)
+/// are added where a block no longer falls through to its successor.
+void place_blocks(optimizer &o, cfg &flow, loop_map &loops) throw() {
+    if(0 != getenv("ECE540_DISABLE_BP")) {
+        return;
+    }
+
+    placement_state s;
+    s.loops = &loops;
+    s.flow = &flow;
+    s.num_inverted = 0U;
+    s.num_tests_copied = 0U;
+    s.num_jumps_removed = 0U;
+    s.num_jumps_added = 0U;
+
+    if(!find_blocks(s)) {
+        return;
+    }
+
+    find_succs(s);
+    find_frequencies(s);
+    find_edges(s);
+    build_chains(s);
+
+    std::vector<unsigned> order;
+    order_blocks(s, order);
+
+    bool is_moved(false);
+    for(unsigned i(0U); i < order.size(); ++i) {
+        if(i != order[i]) {
+            is_moved = true;
+            break;
+        }
+    }
+
+    if(!is_moved) {
+        return;
+    }
+
+    move_blocks(s, order);
+
+    if(0U != s.num_inverted) {
+        stats::count("bp.inverted", s.num_inverted);
+    }
+    if(0U != s.num_tests_copied) {
+        stats::count("bp.tests_copied", s.num_tests_copied);
+    }
+    if(0U != s.num_jumps_removed) {
+        stats::count("bp.jumps_removed", s.num_jumps_removed);
+    }
+    if(0U != s.num_jumps_added) {
+        stats::count("bp.jumps_added", s.num_jumps_added);
+    }
+
+    o.changed_block();
+    o.changed_def();
+    o.changed_use();
+}
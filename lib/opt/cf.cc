@@ -10,6 +10,7 @@
 #define project_CF_CC_
 
 #include <map>
+#include <set>
 #include <vector>
 #include <cstring>
 #include <cassert>
@@ -24,34 +25,43 @@ extern "C" {
 
 #include "include/cfg.h"
 #include "include/optimizer.h"
-#include "include/diag.h"
+#include "include/fold.h"
 #include "include/basic_block.h"
 #include "include/instr.h"
 #include "include/operator.h"
+#include "include/stats.h"
 
 #include "include/data_flow/var_use.h"
 #include "include/data_flow/var_def.h"
 
-/// maintains a mapping of non-floating-point-type temporary registers
-/// whose values are loaded with constants
+/// maintains a mapping of temporary registers whose values are loaded with
+/// (integer or floating point) constants
 struct cf_state {
 
     /// map of temporary registers to the values they contain
-    std::map<simple_reg *, int> constants;
+    std::map<simple_reg *, simple_immed> constants;
 
     /// map of non-temporary registers to the values they currently contain
-    std::map<simple_reg *, int> peephole;
+    std::map<simple_reg *, simple_immed> peephole;
 
     /// update the result for what was done to the cfg
     optimizer *opt;
 
+    /// the graph being folded; edges of folded branches are removed from it
+    cfg *flow;
+
     /// true iff we should keep looking for constants
     bool keep_looking_for_constants;
 
-private:
+    /// which algebraic simplification rules are enabled
+    std::vector<bool> enabled_rules;
+
+public:
 
-    template <typename T>
-    bool get_constant_impl(simple_reg *reg, T &constant) throw() {
+    /// return true iff a constant is stored in the register. if the register
+    /// contains a constant, assign the constant to the variable constant passed
+    /// in by reference
+    bool get_constant(simple_reg *reg, simple_immed &constant) throw() {
         if(0U != peephole.count(reg)) {
             constant = peephole[reg];
             return true;
@@ -65,17 +75,14 @@ private:
         return false;
     }
 
-public:
-
-    /// return true iff a constant is stored in the register. if the register
-    /// contains a constant, assign the constant to the variable constant passed
-    /// in by reference
+    /// same as above, but only for integer constants
     bool get_constant(simple_reg *reg, int &constant) throw() {
-        return get_constant_impl(reg, constant);
-    }
-
-    bool get_constant(simple_reg *reg, unsigned &constant) throw() {
-        return get_constant_impl(reg, constant);
+        simple_immed value;
+        if(!get_constant(reg, value) || IMMED_INT != value.format) {
+            return false;
+        }
+        constant = value.u.ival;
+        return true;
     }
 
     /// clear the peephole cache
@@ -84,7 +91,7 @@ public:
     }
 
     /// update the set of constants
-    void update(simple_reg *reg, int value) throw() {
+    void update(simple_reg *reg, const simple_immed &value) throw() {
         if(TEMP_REG == reg->kind) {
             constants[reg] = value;
         } else {
@@ -106,6 +113,10 @@ public:
             // assign into peephold; base case
             } else if(constants.count(source)) {
                 peephole[dest] = constants[source];
+
+            // the copy kills the register
+            } else {
+                peephole.erase(dest);
             }
 
         // any definition kills the register
@@ -115,74 +126,437 @@ public:
     }
 };
 
-/// fold an abitrary binary operator
-template <
-    typename T0, typename T1,
-    int (*operator_func)(const T0 &, const T1 &),
-    bool (*check_args)(T0, T1)
->
-class binary {
-public:
-    static bool fold(
-        cf_state &state,
-        simple_reg *left_reg,
-        simple_reg *right_reg,
-        int &result
-    ) throw() {
-        T0 left_val(0);
-        T1 right_val(0);
-        if(state.get_constant(left_reg, left_val)
-        && state.get_constant(right_reg, right_val)
-        && check_args(left_val, right_val)) {
-            result = operator_func(left_val, right_val);
+/// replace the value computed by an instruction with a constant
+static void replace_with_constant(
+    cf_state &state,
+    basic_block *bb,
+    simple_instr *in,
+    const simple_immed &result
+) throw() {
+    simple_reg *dest(in->u.base.dst);
+
+    // update the instruction in place
+    if(TEMP_REG == dest->kind) {
+
+        in->opcode = LDC_OP;
+        in->u.ldc.dst = dest;
+        in->u.ldc.value = result;
+
+        state.update(dest, result);
+
+    // add in a new instruction and update the instruction
+    // to be a cpy
+    } else {
+
+        state.opt->changed_def();
+
+        simple_instr *lin(new_instr(LDC_OP, dest->var->type));
+        simple_reg *ldest(new_register(dest->var->type, TEMP_REG));
+
+        // fill in the load constant instruction
+        lin->u.ldc.dst = ldest;
+        lin->u.ldc.value = result;
+
+        // update the instruction to a copy
+        in->opcode = CPY_OP;
+        in->u.base.src1 = ldest;
+        in->u.base.src2 = 0;
+
+        instr::insert_before(lin, in);
+
+        // make sure blocks are kept consistent
+        if(bb->first == in) {
+            bb->first = lin;
+        }
+
+        state.update(ldest, result);
+        state.update(dest, result);
+    }
+
+    state.opt->changed_use();
+}
+
+/// table-driven algebraic simplification and strength reduction. Each rule
+/// applies to one opcode, and can be turned off with its own environment
+/// variable.
+namespace simplify {
+
+    /// check if two types have the same representation
+    static bool same_type(const simple_type *a, const simple_type *b) throw() {
+        return a == b || (a->base == b->base && a->len == b->len);
+    }
+
+    /// check if a register holds a specific integer constant
+    static bool is_int(cf_state &state, simple_reg *reg, int64_t expected) throw() {
+        simple_immed value;
+        return fold::is_integral(reg->var->type)
+            && state.get_constant(reg, value)
+            && IMMED_INT == value.format
+            && fold::int_value(value, reg->var->type) == expected;
+    }
+
+    /// check if a register holds a specific constant, integer or floating point
+    static bool is_number(cf_state &state, simple_reg *reg, int expected) throw() {
+        simple_immed value;
+        if(is_int(state, reg, expected)) {
             return true;
         }
-        return false;
+        return FLOAT_TYPE == reg->var->type->base
+            && state.get_constant(reg, value)
+            && IMMED_FLOAT == value.format
+            && static_cast<double>(expected) == value.u.fval;
     }
-};
 
-namespace op {
+    /// check if a register holds a positive power of two; returns the power
+    static int power_of_two(cf_state &state, simple_reg *reg) throw() {
+        simple_immed value;
+        if(!fold::is_integral(reg->var->type)
+        || !state.get_constant(reg, value)
+        || IMMED_INT != value.format) {
+            return 0;
+        }
+
+        // compare unsigned, as 1 << 63 overflows an int64_t
+        const uint64_t x(static_cast<uint64_t>(
+            fold::int_value(value, reg->var->type)));
+        for(int k(1); k < fold::int_bits(reg->var->type); ++k) {
+            if((static_cast<uint64_t>(1) << k) == x) {
+                return k;
+            }
+        }
+        return 0;
+    }
 
-    /// automatically accept the arguments as valid
-    bool accept_args(int, int) throw() {
+    /// the mask 2^k - 1 for a power of two 2^k, if an LDC can load it
+    static bool low_mask(int k, int &mask) throw() {
+        if(0 == k || 31 < k) {
+            return false;
+        }
+        mask = static_cast<int>((static_cast<int64_t>(1) << k) - 1);
         return true;
     }
-    bool accept_args(int, unsigned) throw() {
+
+    /// does an instruction compute an integer?
+    static bool is_integral(simple_instr *in) throw() {
+        return fold::is_integral(in->u.base.dst->var->type);
+    }
+
+    /// turn an instruction into a copy of one of its operands. A copy of a
+    /// register into itself does nothing, so the instruction becomes a NOP
+    /// instead; this isn't reported as a simplification, so that it can't
+    /// start another round of CF and CP
+    static bool make_copy(cf_state &s, simple_instr *in, simple_reg *src) throw() {
+        if(!same_type(in->u.base.dst->var->type, src->var->type)) {
+            return false;
+        } else if(in->u.base.dst == src) {
+            in->opcode = NOP_OP;
+            s.opt->changed_def();
+            return false;
+        }
+        in->opcode = CPY_OP;
+        in->u.base.src1 = src;
+        in->u.base.src2 = 0;
         return true;
     }
 
-    /// check for non-zero right argument for modulo, divide
-    bool accept_nonzero_right(int, int right) throw() {
-        if(0 != right) {
-            return true;
+    /// turn an instruction into an integer constant
+    static bool make_int(cf_state &state, basic_block *bb, simple_instr *in, int64_t val) throw() {
+        simple_immed result;
+        if(!fold::make_int(result, val, in->u.base.dst->var->type)) {
+            return false;
+        }
+        replace_with_constant(state, bb, in, result);
+        return true;
+    }
+
+    /// turn an instruction into an operation with a constant right operand
+    static bool make_op(
+        basic_block *bb,
+        simple_instr *in,
+        simple_op op,
+        simple_reg *left,
+        simple_reg *right_type,
+        int right
+    ) throw() {
+        simple_reg *reg(new_register(right_type->var->type, TEMP_REG));
+        simple_instr *lin(new_instr(LDC_OP, reg->var->type));
+        lin->u.ldc.dst = reg;
+        lin->u.ldc.value.format = IMMED_INT;
+        lin->u.ldc.value.u.ival = right;
+
+        instr::insert_before(lin, in);
+        if(bb->first == in) {
+            bb->first = lin;
         }
 
-        diag::warning("Denominator to DIV or REM must not be zero.\n");
+        in->opcode = op;
+        in->u.base.src1 = left;
+        in->u.base.src2 = reg;
+        return true;
+    }
+
+    /// x + 0 = 0 + x = x
+    static bool add_zero(cf_state &s, basic_block *, simple_instr *in) throw() {
+        if(!is_integral(in)) {
+            return false;
+        } else if(is_int(s, in->u.base.src2, 0)) {
+            return make_copy(s, in, in->u.base.src1);
+        } else if(is_int(s, in->u.base.src1, 0)) {
+            return make_copy(s, in, in->u.base.src2);
+        }
         return false;
     }
-};
 
-/// table of functions to fold binary operators
-typedef bool (fold_op_func)(cf_state &, simple_reg *, simple_reg *, int &);
-fold_op_func *fold_funcs[] = {
-    binary<int,int,binary_operator<int>::add, op::accept_args>::fold, // ADD_OP
-    binary<int,int,binary_operator<int>::subtract, op::accept_args>::fold, // SUB_OP
-    binary<int,int,binary_operator<int>::multiply, op::accept_args>::fold, // MUL_OP
-    binary<int,int,binary_operator<int>::divide, op::accept_nonzero_right>::fold, // DIV_OP
-    binary<int,int,binary_operator<int>::modulo, op::accept_nonzero_right>::fold, // REM_OP
-    binary<int,int,op::mod, op::accept_nonzero_right>::fold, // MOD_OP
-    binary<int,int,binary_operator<int>::bitwise_and, op::accept_args>::fold, // AND_OP
-    binary<int,int,binary_operator<int>::bitwise_or, op::accept_args>::fold, // IOR_OP
-    binary<int,int,binary_operator<int>::bitwise_xor, op::accept_args>::fold, // XOR_OP
-    binary<int,unsigned,op::asr, op::accept_args>::fold, // ASR_OP
-    binary<int,unsigned,op::lsl, op::accept_args>::fold, // LSL_OP
-    binary<int,unsigned,op::lsr, op::accept_args>::fold, // LSR_OP
-    binary<int,int,op::rot, op::accept_args>::fold, // ROT_OP
-    binary<int,int,binary_operator<int>::equal, op::accept_args>::fold, // SEQ_OP
-    binary<int,int,binary_operator<int>::not_equal, op::accept_args>::fold, // SNE_OP
-    binary<int,int,binary_operator<int>::less_than, op::accept_args>::fold, // SL_OP
-    binary<int,int,binary_operator<int>::less_than_equal, op::accept_args>::fold, // SLE_OP
-};
+    /// x - 0 = x
+    static bool sub_zero(cf_state &s, basic_block *, simple_instr *in) throw() {
+        return is_integral(in)
+            && is_int(s, in->u.base.src2, 0)
+            && make_copy(s, in, in->u.base.src1);
+    }
+
+    /// x - x = 0
+    static bool sub_self(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        return is_integral(in)
+            && in->u.base.src1 == in->u.base.src2
+            && make_int(s, bb, in, 0);
+    }
+
+    /// x * 1 = 1 * x = x
+    static bool mul_one(cf_state &s, basic_block *, simple_instr *in) throw() {
+        if(is_number(s, in->u.base.src2, 1)) {
+            return make_copy(s, in, in->u.base.src1);
+        } else if(is_number(s, in->u.base.src1, 1)) {
+            return make_copy(s, in, in->u.base.src2);
+        }
+        return false;
+    }
+
+    /// x * 0 = 0 * x = 0
+    static bool mul_zero(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        return is_integral(in)
+            && (is_int(s, in->u.base.src1, 0) || is_int(s, in->u.base.src2, 0))
+            && make_int(s, bb, in, 0);
+    }
+
+    /// x * 2^k = 2^k * x = x << k
+    static bool mul_pow2(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        if(!is_integral(in)) {
+            return false;
+        }
+
+        int k(power_of_two(s, in->u.base.src2));
+        if(0 != k) {
+            return make_op(bb, in, LSL_OP, in->u.base.src1, in->u.base.src2, k);
+        }
+
+        k = power_of_two(s, in->u.base.src1);
+        if(0 != k) {
+            return make_op(bb, in, LSL_OP, in->u.base.src2, in->u.base.src1, k);
+        }
+        return false;
+    }
+
+    /// x / 1 = x
+    static bool div_one(cf_state &s, basic_block *, simple_instr *in) throw() {
+        return is_number(s, in->u.base.src2, 1)
+            && make_copy(s, in, in->u.base.src1);
+    }
+
+    /// x / 2^k = x >> k, for unsigned x
+    static bool udiv_pow2(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        if(UNSIGNED_TYPE != in->u.base.src1->var->type->base
+        || !is_integral(in)) {
+            return false;
+        }
+
+        const int k(power_of_two(s, in->u.base.src2));
+        return 0 != k
+            && make_op(bb, in, LSR_OP, in->u.base.src1, in->u.base.src2, k);
+    }
+
+    /// x % 2^k = x & (2^k - 1), for unsigned x
+    static bool urem_pow2(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        if(UNSIGNED_TYPE != in->u.base.src1->var->type->base
+        || !is_integral(in)) {
+            return false;
+        }
+
+        int mask(0);
+        return low_mask(power_of_two(s, in->u.base.src2), mask)
+            && make_op(bb, in, AND_OP, in->u.base.src1, in->u.base.src2, mask);
+    }
+
+    /// x mod 2^k = x & (2^k - 1); SUIF's modulo is never negative, so this
+    /// also works for signed x
+    static bool mod_pow2(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        if(!is_integral(in) || !fold::is_integral(in->u.base.src1->var->type)) {
+            return false;
+        }
+
+        int mask(0);
+        return low_mask(power_of_two(s, in->u.base.src2), mask)
+            && make_op(bb, in, AND_OP, in->u.base.src1, in->u.base.src2, mask);
+    }
+
+    /// x & 0 = 0 & x = 0
+    static bool and_zero(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        return is_integral(in)
+            && (is_int(s, in->u.base.src1, 0) || is_int(s, in->u.base.src2, 0))
+            && make_int(s, bb, in, 0);
+    }
+
+    /// x & ~0 = ~0 & x = x
+    static bool and_ones(cf_state &s, basic_block *, simple_instr *in) throw() {
+        if(!is_integral(in)) {
+            return false;
+        }
+
+        simple_reg *src1(in->u.base.src1), *src2(in->u.base.src2);
+        const int64_t ones1(fold::normalize(-1, src1->var->type));
+        const int64_t ones2(fold::normalize(-1, src2->var->type));
+
+        if(is_int(s, src2, ones2)) {
+            return make_copy(s, in, src1);
+        } else if(is_int(s, src1, ones1)) {
+            return make_copy(s, in, src2);
+        }
+        return false;
+    }
+
+    /// x & x = x | x = x
+    static bool idempotent_self(cf_state &s, basic_block *, simple_instr *in) throw() {
+        return is_integral(in)
+            && in->u.base.src1 == in->u.base.src2
+            && make_copy(s, in, in->u.base.src1);
+    }
+
+    /// x | 0 = 0 | x = x ^ 0 = 0 ^ x = x
+    static bool or_zero(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        return add_zero(s, bb, in);
+    }
+
+    /// x ^ x = 0
+    static bool xor_self(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        return sub_self(s, bb, in);
+    }
+
+    /// x << 0 = x >> 0 = x
+    static bool shift_zero(cf_state &s, basic_block *, simple_instr *in) throw() {
+        return is_integral(in)
+            && is_int(s, in->u.base.src2, 0)
+            && make_copy(s, in, in->u.base.src1);
+    }
+
+    /// x == x = x <= x = 1 (not for floating point, because of NaN)
+    static bool compare_self_true(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        return in->u.base.src1 == in->u.base.src2
+            && fold::is_integral(in->u.base.src1->var->type)
+            && is_integral(in)
+            && make_int(s, bb, in, 1);
+    }
+
+    /// x != x = x < x = 0 (not for floating point, because of NaN)
+    static bool compare_self_false(cf_state &s, basic_block *bb, simple_instr *in) throw() {
+        return in->u.base.src1 == in->u.base.src2
+            && fold::is_integral(in->u.base.src1->var->type)
+            && is_integral(in)
+            && make_int(s, bb, in, 0);
+    }
+
+    typedef bool (rule_func)(cf_state &, basic_block *, simple_instr *);
+
+    struct rule {
+    public:
+        simple_op opcode;
+        const char *name; // for statistics
+        const char *disable_flag;
+        rule_func *apply;
+    };
+
+    static const rule RULES[] = {
+        {ADD_OP, "cf.add_zero", "ECE540_DISABLE_RULE_ADD_ZERO", add_zero},
+        {SUB_OP, "cf.sub_zero", "ECE540_DISABLE_RULE_SUB_ZERO", sub_zero},
+        {SUB_OP, "cf.sub_self", "ECE540_DISABLE_RULE_SUB_SELF", sub_self},
+        {MUL_OP, "cf.mul_zero", "ECE540_DISABLE_RULE_MUL_ZERO", mul_zero},
+        {MUL_OP, "cf.mul_one", "ECE540_DISABLE_RULE_MUL_ONE", mul_one},
+        {MUL_OP, "cf.mul_pow2", "ECE540_DISABLE_RULE_MUL_POW2", mul_pow2},
+        {DIV_OP, "cf.div_one", "ECE540_DISABLE_RULE_DIV_ONE", div_one},
+        {DIV_OP, "cf.udiv_pow2", "ECE540_DISABLE_RULE_UDIV_POW2", udiv_pow2},
+        {REM_OP, "cf.urem_pow2", "ECE540_DISABLE_RULE_UREM_POW2", urem_pow2},
+        {MOD_OP, "cf.mod_pow2", "ECE540_DISABLE_RULE_MOD_POW2", mod_pow2},
+        {AND_OP, "cf.and_zero", "ECE540_DISABLE_RULE_AND_ZERO", and_zero},
+        {AND_OP, "cf.and_ones", "ECE540_DISABLE_RULE_AND_ONES", and_ones},
+        {AND_OP, "cf.and_self", "ECE540_DISABLE_RULE_AND_SELF", idempotent_self},
+        {IOR_OP, "cf.or_zero", "ECE540_DISABLE_RULE_OR_ZERO", or_zero},
+        {IOR_OP, "cf.or_self", "ECE540_DISABLE_RULE_OR_SELF", idempotent_self},
+        {XOR_OP, "cf.xor_zero", "ECE540_DISABLE_RULE_XOR_ZERO", or_zero},
+        {XOR_OP, "cf.xor_self", "ECE540_DISABLE_RULE_XOR_SELF", xor_self},
+        {LSL_OP, "cf.shift_zero", "ECE540_DISABLE_RULE_SHIFT_ZERO", shift_zero},
+        {LSR_OP, "cf.shift_zero", "ECE540_DISABLE_RULE_SHIFT_ZERO", shift_zero},
+        {ASR_OP, "cf.shift_zero", "ECE540_DISABLE_RULE_SHIFT_ZERO", shift_zero},
+        {ROT_OP, "cf.shift_zero", "ECE540_DISABLE_RULE_SHIFT_ZERO", shift_zero},
+        {SEQ_OP, "cf.compare_self", "ECE540_DISABLE_RULE_COMPARE_SELF", compare_self_true},
+        {SLE_OP, "cf.compare_self", "ECE540_DISABLE_RULE_COMPARE_SELF", compare_self_true},
+        {SNE_OP, "cf.compare_self", "ECE540_DISABLE_RULE_COMPARE_SELF", compare_self_false},
+        {SL_OP, "cf.compare_self", "ECE540_DISABLE_RULE_COMPARE_SELF", compare_self_false}
+    };
+
+    enum {
+        NUM_RULES = sizeof RULES / sizeof RULES[0]
+    };
+
+    /// figure out which rules are enabled
+    static void find_enabled_rules(cf_state &state) throw() {
+        state.enabled_rules.resize(NUM_RULES);
+        for(unsigned i(0); i < NUM_RULES; ++i) {
+            state.enabled_rules[i] = 0 == getenv(RULES[i].disable_flag);
+        }
+    }
+
+    /// apply the first enabled rule that simplifies an instruction; returns
+    /// true iff the instruction was changed
+    static bool apply(cf_state &state, basic_block *bb, simple_instr *in) throw() {
+        for(unsigned i(0); i < NUM_RULES; ++i) {
+            const rule &r(RULES[i]);
+            if(r.opcode != in->opcode
+            || !state.enabled_rules[i]
+            || !r.apply(state, bb, in)) {
+                continue;
+            }
+
+            stats::count(r.name);
+            state.opt->changed_def();
+            state.opt->changed_use();
+            return true;
+        }
+        return false;
+    }
+}
+
+/// remove the edges of a folded branch that can no longer be taken; the
+/// branch is now either a jump or a NOP
+static void remove_untaken_edges(
+    cf_state &state,
+    basic_block *bb,
+    simple_instr *in
+) throw() {
+    assert(in == bb->last);
+
+    basic_block *taken(bb->next);
+    if(JMP_OP == in->opcode) {
+        taken = state.flow->find_block(in->u.bj.target);
+    }
+
+    std::set<basic_block *> untaken(bb->successors());
+    untaken.erase(taken);
+
+    std::set<basic_block *>::iterator it(untaken.begin()), end(untaken.end());
+    for(; it != end; ++it) {
+        state.flow->remove_edge(bb, *it);
+    }
+
+    state.opt->changed_graph();
+}
 
 /// go fold constants in each block
 static bool fold_constants(basic_block *bb, cf_state &state) throw() {
@@ -198,63 +572,67 @@ static bool fold_constants(basic_block *bb, cf_state &state) throw() {
         state.peek(in);
 
         bool updated_locally(false);
-        int result(0);
+        int cond(0);
         int64_t result64(0);
+        simple_immed result;
+        simple_immed left, right;
 
         switch(in->opcode) {
 
         // branch true
         case BTRUE_OP:
-            if(!state.get_constant(in->u.bj.src, result)) {
+            if(!state.get_constant(in->u.bj.src, cond)) {
                 continue;
             }
 
-            if(result) {
+            if(cond) {
                 in->opcode = JMP_OP;
                 in->u.bj.src = 0;
             } else {
                 in->opcode = NOP_OP;
             }
 
-            state.opt->changed_block();
+            stats::count("cf.branch");
+            remove_untaken_edges(state, bb, in);
             continue;
 
         // branch false
         case BFALSE_OP:
-            if(!state.get_constant(in->u.bj.src, result)) {
+            if(!state.get_constant(in->u.bj.src, cond)) {
                 continue;
             }
 
-            if(!result) {
+            if(!cond) {
                 in->opcode = JMP_OP;
                 in->u.bj.src = 0;
             } else {
                 in->opcode = NOP_OP;
             }
 
-            state.opt->changed_block();
+            stats::count("cf.branch");
+            remove_untaken_edges(state, bb, in);
             continue;
 
         // multi-way branch
         case MBR_OP:
-            if(!state.get_constant(in->u.bj.src, result)) {
+            if(!state.get_constant(in->u.mbr.src, cond)) {
                 continue;
             }
 
             // try not to lose precision when using unsigned/signed types as
             // the source of the mbr
-            if(UNSIGNED_TYPE == in->u.bj.src->var->type->base) {
-                unsigned uresult(0);
-                memcpy(&uresult, &result, sizeof uresult);
-                result64 = uresult;
+            if(UNSIGNED_TYPE == in->u.mbr.src->var->type->base) {
+                unsigned ucond(0);
+                memcpy(&ucond, &cond, sizeof ucond);
+                result64 = ucond;
             } else {
-                result64 = result;
+                result64 = cond;
             }
 
             result64 -= in->u.mbr.offset;
 
             // outside the range of valid offsets, jump to default
-            if(result64 < 0 || in->u.mbr.ntargets < result64) {
+            if(result64 < 0 || in->u.mbr.ntargets <= result64) {
                 simple_sym *default_target(in->u.mbr.deflab);
                 in->opcode = JMP_OP;
                 in->u.bj.target = default_target;
@@ -265,30 +643,20 @@ static bool fold_constants(basic_block *bb, cf_state &state) throw() {
                 in->opcode = JMP_OP;
                 in->u.bj.target = target;
             }
+            in->u.bj.src = 0;
 
-            state.opt->changed_block();
+            stats::count("cf.branch");
+            remove_untaken_edges(state, bb, in);
             continue;
 
-        // type conversion, between signed and unsigned, no bits change
-        case CVT_OP:
-            if(state.get_constant(in->u.base.src1, result)) {
-                updated_locally = true;
-            }
-            break;
-
-        // unary minus
-        case NEG_OP:
-            if(state.get_constant(in->u.base.src1, result)) {
-                updated_locally = true;
-                result = -result;
-            }
-            break;
-
-        // unary bitwise not
-        case NOT_OP:
-            if(state.get_constant(in->u.base.src1, result)) {
+        // unary operators, including type conversions
+        case CVT_OP: case NEG_OP: case NOT_OP:
+            if(state.get_constant(in->u.base.src1, left)
+            && fold::unary(
+                in->opcode,
+                in->u.base.src1->var->type, left,
+                in->u.base.dst->var->type, result)) {
                 updated_locally = true;
-                result = ~result;
             }
             break;
 
@@ -298,9 +666,18 @@ static bool fold_constants(basic_block *bb, cf_state &state) throw() {
                 continue;
             }
 
-            const int op(in->opcode - ADD_OP);
-            if(fold_funcs[op](state, in->u.base.src1, in->u.base.src2, result)) {
+            if(state.get_constant(in->u.base.src1, left)
+            && state.get_constant(in->u.base.src2, right)
+            && fold::binary(
+                in->opcode,
+                in->u.base.src1->var->type, left,
+                in->u.base.src2->var->type, right,
+                in->u.base.dst->var->type, result)) {
                 updated_locally = true;
+
+            // try to simplify the expression instead
+            } else if(simplify::apply(state, bb, in)) {
+                continue;
             }
             break;
         }
@@ -310,49 +687,8 @@ static bool fold_constants(basic_block *bb, cf_state &state) throw() {
         }
 
         // we've computed a result
-        simple_reg *dest(in->u.base.dst);
-
-        // update the instruction in place
-        if(TEMP_REG == dest->kind) {
-
-            in->opcode = LDC_OP;
-            in->u.ldc.dst = dest;
-            in->u.ldc.value.format = IMMED_INT;
-            in->u.ldc.value.u.ival = result;
-
-            state.update(dest, result);
-
-        // add in a new instruction and update the instruction
-        // to be a cpy
-        } else {
-
-            state.opt->changed_def();
-
-            simple_instr *lin(new_instr(LDC_OP, dest->var->type));
-            simple_reg *ldest(new_register(dest->var->type, TEMP_REG));
-
-            // fill in the load constant instruction
-            lin->u.ldc.dst = dest;
-            lin->u.ldc.value.format = IMMED_INT;
-            lin->u.ldc.value.u.ival = result;
-
-            // update the instruction to a copy
-            in->opcode = CPY_OP;
-            in->u.base.src1 = ldest;
-            in->u.base.src2 = 0;
-
-            instr::insert_before(lin, in);
-
-            // make sure blocks are kept consistent
-            if(bb->first == in) {
-                bb->first = lin;
-            }
-
-            state.update(ldest, result);
-            state.update(dest, result);
-        }
-
-        state.opt->changed_use();
+        stats::count("cf.fold");
+        replace_with_constant(state, bb, in, result);
     }
 
     return true;
@@ -369,11 +705,11 @@ static bool find_constants(basic_block *bb, cf_state &state) throw() {
     for(; in != end; in = in->next) {
         if(LDC_OP != in->opcode
         || TEMP_REG != in->u.ldc.dst->kind
-        || IMMED_INT != in->u.ldc.value.format) {
+        || IMMED_SYMBOL == in->u.ldc.value.format) {
             continue;
         }
 
-        state.constants[in->u.ldc.dst] = in->u.ldc.value.u.ival;
+        state.constants[in->u.ldc.dst] = in->u.ldc.value;
     }
 
     return true;
@@ -464,11 +800,12 @@ static bool combine_constants(basic_block *bb, optimizer &o) throw() {
     constant_instr_map constant_ins;
 
     // go collect all constants in a basic block, mapping to the instructions
-    // that load them, in the order that the instructions appear
+    // that load them, in the order that the instructions appear. only loads
+    // into temporaries are combined, as only their uses are remapped
     for(simple_instr *in(bb->first); in != bb->last->next; in = in->next) {
         assert(0 != in);
 
-        if(LDC_OP == in->opcode) {
+        if(LDC_OP == in->opcode && TEMP_REG == in->u.ldc.dst->kind) {
             constant_ins[in->u.ldc.value].push_back(in);
         }
     }
@@ -530,10 +867,13 @@ void fold_constants(optimizer &opt, cfg &graph) throw() {
 
     cf_state state;
     state.opt = &opt;
+    state.flow = &graph;
 
     graph.for_each_basic_block(combine_constants, opt);
     graph.for_each_basic_block(find_constants, state);
 
+    simplify::find_enabled_rules(state);
+
     if(!state.constants.empty()) {
         state.keep_looking_for_constants = true;
 
@@ -541,9 +881,10 @@ void fold_constants(optimizer &opt, cfg &graph) throw() {
             state.keep_looking_for_constants = false;
             graph.for_each_basic_block(find_temp_copies, state);
         }
-
-        graph.for_each_basic_block(fold_constants, state);
     }
+
+    // some simplifications (e.g. x - x) don't need any constants
+    graph.for_each_basic_block(fold_constants, state);
 }
 
 #endif /* project_CF_CC_ */
@@ -0,0 +1,333 @@
+/*
+ * coalesce.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <map>
+#include <set>
+#include <vector>
+#include <cstdlib>
+
+#include "include/opt/coalesce.h"
+#include "include/cfg.h"
+#include "include/optimizer.h"
+#include "include/data_flow/var_def.h"
+#include "include/data_flow/var_use.h"
+
+/// registers whose live ranges overlap
+typedef std::map<simple_reg *, std::set<simple_reg *> > interference_graph;
+
+struct coalesce_state {
+public:
+    var_use_map *var_uses;
+    interference_graph graph;
+    std::set<simple_reg *> live_in;
+    std::vector<simple_instr *> copies;
+    std::map<simple_reg *, simple_reg *> parent;
+};
+
+/// can a register take part in coalescing?
+static bool is_coalescable(simple_reg *reg) throw() {
+    return 0 != reg && PSEUDO_REG == reg->kind;
+}
+
+/// record that two registers are live at the same time
+static void interfere(coalesce_state &s, simple_reg *a, simple_reg *b) throw() {
+    if(a == b || !is_coalescable(a) || !is_coalescable(b)) {
+        return;
+    }
+    s.graph[a].insert(b);
+    s.graph[b].insert(a);
+}
+
+/// add the registers in a set of variable uses to a set of live registers
+static void add_live_regs(var_use_set &uses, std::set<simple_reg *> &live) throw() {
+    var_use_set::iterator it(uses.begin()), end(uses.end());
+    for(; it != end; ++it) {
+        live.insert(it->reg);
+    }
+}
+
+static void add_live_reg(
+    simple_reg *reg,
+    simple_reg **,
+    simple_instr *,
+    std::set<simple_reg *> &live
+) throw() {
+    live.insert(reg);
+}
+
+/// build the interference graph for a basic block by walking backward from
+/// the registers live at its exit
+static bool find_interference(basic_block *bb, coalesce_state &s) throw() {
+    if(0 == bb->last) {
+        return true;
+    }
+
+    std::set<simple_reg *> live;
+    const std::set<basic_block *> &succs(bb->successors());
+    std::set<basic_block *>::const_iterator succ_it(succs.begin())
+                                          , succ_end(succs.end());
+    for(; succ_it != succ_end; ++succ_it) {
+        add_live_regs((*s.var_uses)(*succ_it), live);
+    }
+
+    for(simple_instr *in(bb->last), *end(bb->first->prev);
+        in != end;
+        in = in->prev) {
+
+        simple_reg *defd_reg(0);
+        if(for_each_var_def(in, defd_reg)) {
+
+            // the destination and source of a copy can share a register
+            simple_reg *copied_reg(0);
+            if(CPY_OP == in->opcode) {
+                copied_reg = in->u.base.src1;
+                if(is_coalescable(defd_reg)
+                && is_coalescable(copied_reg)
+                && defd_reg != copied_reg) {
+                    s.copies.push_back(in);
+                }
+            }
+
+            std::set<simple_reg *>::iterator it(live.begin()), end(live.end());
+            for(; it != end; ++it) {
+                if(*it != copied_reg) {
+                    interfere(s, defd_reg, *it);
+                }
+            }
+            live.erase(defd_reg);
+        }
+
+        for_each_var_use(add_live_reg, in, live);
+    }
+
+    return true;
+}
+
+/// find the representative register of a coalesced group
+static simple_reg *find_rep(coalesce_state &s, simple_reg *reg) throw() {
+    std::map<simple_reg *, simple_reg *>::iterator it(s.parent.find(reg));
+    if(s.parent.end() == it) {
+        return reg;
+    }
+    simple_reg *rep(find_rep(s, it->second));
+    it->second = rep;
+    return rep;
+}
+
+/// merge one group of registers into another
+static void merge(coalesce_state &s, simple_reg *from, simple_reg *into) throw() {
+    s.parent[from] = into;
+
+    std::set<simple_reg *> &neighbours(s.graph[from]);
+    std::set<simple_reg *>::iterator it(neighbours.begin())
+                                   , end(neighbours.end());
+    for(; it != end; ++it) {
+        s.graph[*it].insert(into);
+        s.graph[into].insert(*it);
+    }
+}
+
+/// try to put the source and destination of a copy into the same register
+static bool coalesce_copy(coalesce_state &s, simple_instr *in) throw() {
+    simple_reg *dst(find_rep(s, in->u.base.dst));
+    simple_reg *src(find_rep(s, in->u.base.src1));
+
+    if(dst == src) {
+        return true;
+    }
+
+    if(dst->var->type != src->var->type
+    && (dst->var->type->base != src->var->type->base
+        || dst->var->type->len != src->var->type->len)) {
+        return false;
+    }
+
+    if(0U != s.graph[dst].count(src) || 0U != s.graph[src].count(dst)) {
+        return false;
+    }
+
+    // keep registers that are live on entry (e.g. parameters) as the
+    // representatives
+    if(0U != s.live_in.count(dst)) {
+        merge(s, src, dst);
+    } else {
+        merge(s, dst, src);
+    }
+    return true;
+}
+
+static void rename_reg(
+    simple_reg *reg,
+    simple_reg **pos,
+    simple_instr *,
+    coalesce_state &s
+) throw() {
+    *pos = find_rep(s, reg);
+}
+
+/// rename all coalesced registers in a basic block, and remove the copies
+/// that are no longer needed
+static bool rename_regs(basic_block *bb, coalesce_state &s) throw() {
+    if(0 == bb->last) {
+        return true;
+    }
+
+    for(simple_instr *in(bb->first), *end(bb->last->next);
+        in != end;
+        in = in->next) {
+
+        for_each_var_def(rename_reg, in, s);
+        for_each_var_use(rename_reg, in, s);
+
+        if(CPY_OP == in->opcode && in->u.base.dst == in->u.base.src1) {
+            in->opcode = NOP_OP;
+        }
+    }
+
+    return true;
+}
+
+/// used to check if an instruction mentions a register
+struct reg_finder {
+public:
+    simple_reg *reg;
+    bool found;
+};
+
+static void find_reg(
+    simple_reg *reg,
+    simple_reg **,
+    simple_instr *,
+    reg_finder &f
+) throw() {
+    if(reg == f.reg) {
+        f.found = true;
+    }
+}
+
+/// remove copies from temporary registers into pseudo registers by making the
+/// instruction that defines the temporary register define the pseudo register
+/// instead, e.g.:
+///
+///     add t3 = r1, r5                 add r1 = r1, r5
+///     cpy r1 = t3         becomes     nop
+///
+/// this is only done if the pseudo register isn't used or defined between the
+/// two instructions.
+static bool remove_temp_copies(basic_block *bb, bool &changed) throw() {
+    if(0 == bb->last) {
+        return true;
+    }
+
+    for(simple_instr *in(bb->first), *end(bb->last->next);
+        in != end;
+        in = in->next) {
+
+        if(CPY_OP != in->opcode
+        || TEMP_REG != in->u.base.src1->kind
+        || !is_coalescable(in->u.base.dst)) {
+            continue;
+        }
+
+        simple_reg *temp(in->u.base.src1);
+        simple_reg *dst(in->u.base.dst);
+
+        if(temp->var->type != dst->var->type
+        && (temp->var->type->base != dst->var->type->base
+            || temp->var->type->len != dst->var->type->len)) {
+            continue;
+        }
+
+        reg_finder f;
+        f.reg = dst;
+        f.found = false;
+
+        simple_instr *def(in->prev);
+        for(; 0 != def && def != bb->first->prev; def = def->prev) {
+            simple_reg *defd_reg(0);
+            if(for_each_var_def(def, defd_reg) && temp == defd_reg) {
+                break;
+            }
+
+            for_each_var_def(find_reg, def, f);
+            for_each_var_use(find_reg, def, f);
+            if(f.found) {
+                break;
+            }
+        }
+
+        if(f.found || 0 == def || def == bb->first->prev) {
+            continue;
+        }
+
+        if(LDC_OP == def->opcode) {
+            def->u.ldc.dst = dst;
+        } else if(CALL_OP == def->opcode) {
+            def->u.call.dst = dst;
+        } else {
+            def->u.base.dst = dst;
+        }
+
+        in->opcode = NOP_OP;
+        changed = true;
+    }
+
+    return true;
+}
+
+/// merge copy-related pseudo registers whose live ranges don't interfere,
+/// and remove the copies between them
+void coalesce_registers(optimizer &o, cfg &flow, var_use_map &var_uses) throw() {
+    if(0 != getenv("ECE540_DISABLE_COALESCE")) {
+        return;
+    }
+
+    coalesce_state s;
+    s.var_uses = &var_uses;
+
+    // everything live on entry to the procedure is live at the same time
+    std::set<basic_block *> entry_bbs(flow.entry()->successors());
+    entry_bbs.insert(flow.entry());
+    std::set<basic_block *>::iterator bb_it(entry_bbs.begin())
+                                    , bb_end(entry_bbs.end());
+    for(; bb_it != bb_end; ++bb_it) {
+        add_live_regs(var_uses(*bb_it), s.live_in);
+    }
+
+    std::set<simple_reg *>::iterator a(s.live_in.begin()), end(s.live_in.end());
+    for(; a != end; ++a) {
+        std::set<simple_reg *>::iterator b(a);
+        for(++b; b != end; ++b) {
+            interfere(s, *a, *b);
+        }
+    }
+
+    flow.for_each_basic_block(&find_interference, s);
+
+    bool changed(false);
+    for(unsigned i(0); i < s.copies.size(); ++i) {
+        if(coalesce_copy(s, s.copies[i])) {
+            changed = true;
+        }
+    }
+
+    if(changed) {
+        flow.for_each_basic_block(&rename_regs, s);
+    }
+
+    // this changes live ranges, so it must be done after coalescing
+    flow.for_each_basic_block(&remove_temp_copies, changed);
+
+    if(changed) {
+        o.changed_def();
+        o.changed_use();
+    }
+}
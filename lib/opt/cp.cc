@@ -8,20 +8,123 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <set>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <iterator>
 
 #include "include/opt/cp.h"
 #include "include/cfg.h"
+#include "include/basic_block.h"
 #include "include/optimizer.h"
 #include "include/use_def.h"
 #include "include/diag.h"
 
+/// a copy of a pseudo register (second) into a register (first)
+typedef std::pair<simple_reg *, simple_reg *> copy_pair;
+typedef std::set<copy_pair> copy_set;
+
 struct cp_state {
 public:
     use_def_map *ud;
     optimizer *o;
     const var_def_set *rd;
+
+    /// the copies that are available at the start of each basic block, and
+    /// before the instruction being looked at
+    std::map<basic_block *, copy_set> available;
+    const copy_set *copies;
 };
 
+/// kill the copies into or out of the register defined by an instruction, and
+/// add the copy made by the instruction, if any
+static void update_copies(simple_instr *in, copy_set &copies) throw() {
+    simple_reg *reg(0);
+    if(!for_each_var_def(in, reg)) {
+        return;
+    }
+
+    for(copy_set::iterator it(copies.begin()); it != copies.end(); ) {
+        if(reg == it->first || reg == it->second) {
+            copies.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    if(CPY_OP == in->opcode
+    && PSEUDO_REG == in->u.base.src1->kind
+    && reg != in->u.base.src1) {
+        copies.insert(copy_pair(reg, in->u.base.src1));
+    }
+}
+
+/// find the copies made in a basic block
+static bool find_copies(basic_block *bb, copy_set &copies) throw() {
+    if(0 == bb->last) {
+        return true;
+    }
+    for(simple_instr *in(bb->first); in != bb->last->next; in = in->next) {
+        if(CPY_OP == in->opcode
+        && PSEUDO_REG == in->u.base.src1->kind
+        && in->u.base.dst != in->u.base.src1) {
+            copies.insert(copy_pair(in->u.base.dst, in->u.base.src1));
+        }
+    }
+    return true;
+}
+
+/// find the copies that are available at the start of each basic block: a
+/// copy is available if it is made on every path to the block, and neither
+/// of its registers is defined after it. Reaching definitions aren't enough,
+/// as they don't say if the copied register is defined after the copy.
+static void find_available_copies(cfg &flow, cp_state &s) throw() {
+    copy_set all_copies;
+    flow.for_each_basic_block(&find_copies, all_copies);
+
+    std::map<basic_block *, copy_set> out;
+    for(basic_block *bb(flow.entry()); 0 != bb; bb = bb->next) {
+        out[bb] = all_copies;
+    }
+
+    for(bool changed(true); changed; ) {
+        changed = false;
+
+        for(basic_block *bb(flow.entry()); 0 != bb; bb = bb->next) {
+            copy_set &in_copies(s.available[bb]);
+            in_copies.clear();
+
+            const std::set<basic_block *> &preds(bb->predecessors());
+            std::set<basic_block *>::const_iterator it(preds.begin())
+                                                  , end(preds.end());
+            if(flow.entry() != bb && it != end) {
+                in_copies = out[*it];
+                for(++it; it != end; ++it) {
+                    copy_set meet;
+                    std::set_intersection(
+                        in_copies.begin(), in_copies.end(),
+                        out[*it].begin(), out[*it].end(),
+                        std::inserter(meet, meet.begin()));
+                    in_copies.swap(meet);
+                }
+            }
+
+            copy_set out_copies(in_copies);
+            if(0 != bb->last) {
+                for(simple_instr *in(bb->first); in != bb->last->next; in = in->next) {
+                    update_copies(in, out_copies);
+                }
+            }
+
+            if(out_copies != out[bb]) {
+                out[bb].swap(out_copies);
+                changed = true;
+            }
+        }
+    }
+}
+
 /// propagate copies at the usage level
 static void try_propagate_copy(
     simple_reg *reg,
@@ -59,7 +162,8 @@ static void try_propagate_copy(
 
     assert(0 != copied_reg);
 
-    if(PSEUDO_REG != copied_reg->kind) {
+    if(PSEUDO_REG != copied_reg->kind
+    || 0U == s.copies->count(copy_pair(reg, copied_reg))) {
         return;
     }
 
@@ -72,11 +176,15 @@ static bool propagate_in_bb(basic_block *bb, cp_state &s) {
     if(0 == bb->last) {
         return true;
     }
+    copy_set copies(s.available[bb]);
     const simple_instr *past_end(bb->last->next);
     for(simple_instr *in(bb->first); past_end != in; in = in->next) {
         s.rd = &((*(s.ud))(in));
+        s.copies = &copies;
         for_each_var_use(&try_propagate_copy, in, s);
         s.rd = 0;
+        s.copies = 0;
+        update_copies(in, copies);
     }
 
     return true;
@@ -90,6 +198,9 @@ void propagate_copies(optimizer &o, cfg &flow, use_def_map &ud) throw() {
     cp_state state;
     state.o = &o;
     state.ud = &ud;
+    state.rd = 0;
+    state.copies = 0;
+    find_available_copies(flow, state);
     flow.for_each_basic_block(&propagate_in_bb, state);
 }
 
@@ -7,6 +7,7 @@
  */
 
 #include <set>
+#include <vector>
 #include <cassert>
 #include <cstdlib>
 
@@ -21,6 +22,7 @@ extern "C" {
 #include "include/operator.h"
 #include "include/optimizer.h"
 #include "include/set.h"
+#include "include/summary.h"
 #include "include/data_flow/ae.h"
 #include "include/data_flow/var_def.h"
 #include "include/data_flow/var_use.h"
@@ -29,6 +31,7 @@ struct cse_state {
 public:
     available_expression_map *ae_exit;
     available_expression_map *ae_enter;
+    summary_map *summaries;
     optimizer *o;
 };
 
@@ -157,7 +160,11 @@ static bool replace_common_sub_expressions(
                     simple_instr *copy(new_instr(CPY_OP, d_f.reg->var->type));
                     for_each_var_def(&find_dest_reg, it->in, ae_f);
 
-                    assert(it->in->opcode == in->opcode);
+                    // the expression might have already been replaced by a
+                    // copy from an earlier common sub-expression in this
+                    // pass; its destination still holds the value
+                    assert(it->in->opcode == in->opcode
+                        || CPY_OP == it->in->opcode);
 
                     // make sure not to over-use a temporary register
                     if(TEMP_REG == ae_f.reg->kind) {
@@ -208,11 +215,155 @@ static bool replace_common_sub_expressions(
     return true;
 }
 
+/// a previous call to a procedure without side-effects
+struct cse_call {
+public:
+    simple_instr *in;
+    simple_sym *callee;
+    bool reads_memory;
+};
+
+/// check if two calls are to the same procedure with the same arguments
+static bool is_same_call(const cse_call &prev, simple_sym *callee, simple_instr *in) throw() {
+    if(prev.callee != callee
+    || prev.in->u.call.nargs != in->u.call.nargs
+    || prev.in->u.call.dst->var->type != in->u.call.dst->var->type) {
+        return false;
+    }
+    for(unsigned i(0); i < in->u.call.nargs; ++i) {
+        if(prev.in->u.call.args[i] != in->u.call.args[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// check if a previous call uses a register as an argument
+static bool call_uses_arg(const cse_call &prev, simple_reg *reg) throw() {
+    for(unsigned i(0); i < prev.in->u.call.nargs; ++i) {
+        if(prev.in->u.call.args[i] == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// reuse the results of calls to procedures without side-effects within a
+/// basic block. Unlike normal expressions, calls aren't tracked by available
+/// expressions; a call is available until one of its arguments or its result
+/// register is redefined, or, if the procedure reads memory, until something
+/// could have written to memory.
+static bool replace_common_calls(
+    basic_block *bb,
+    cse_state &s
+) throw() {
+    if(0 == bb->last) {
+        return true;
+    }
+
+    std::vector<cse_call> calls;
+
+    for(simple_instr *in(bb->first), *end(bb->last->next);
+        in != end;
+        in = in->next) {
+
+        bool writes_memory(false);
+
+        switch(in->opcode) {
+        case STR_OP: case MCPY_OP:
+            writes_memory = true;
+            break;
+
+        case CALL_OP: {
+            const procedure_summary *summary(s.summaries->find(in));
+            if(0 == summary || !summary->is_read_only()) {
+                writes_memory = true;
+                break;
+            }
+
+            if(0 == in->u.call.dst) {
+                break;
+            }
+
+            simple_sym *callee(summary_map::callee(in));
+            std::vector<cse_call>::iterator it(calls.begin()), it_end(calls.end());
+            for(; it != it_end; ++it) {
+                if(is_same_call(*it, callee, in)) {
+                    break;
+                }
+            }
+
+            // first time we've seen this call
+            if(it == it_end) {
+                cse_call call;
+                call.in = in;
+                call.callee = callee;
+                call.reads_memory = summary->reads_memory;
+                calls.push_back(call);
+                break;
+            }
+
+            // make sure not to over-use a temporary register
+            if(TEMP_REG == it->in->u.call.dst->kind) {
+                bb->replace_temp_reg(it->in->u.call.dst);
+            }
+
+            // replace the call with a copy, which doesn't need the arguments
+            simple_reg *dst(in->u.call.dst);
+            free(in->u.call.args);
+            in->u.call.args = 0;
+            in->opcode = CPY_OP;
+            in->type = dst->var->type;
+            in->u.base.dst = dst;
+            in->u.base.src1 = it->in->u.call.dst;
+            in->u.base.src2 = 0;
+
+            s.o->changed_def();
+            s.o->changed_use();
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        // kill calls that might read clobbered memory
+        if(writes_memory) {
+            for(unsigned i(0); i < calls.size(); ) {
+                if(calls[i].reads_memory) {
+                    calls[i] = calls.back();
+                    calls.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+        }
+
+        // kill calls that depend on a redefined register; this is done after
+        // adding in a new call, so a call like r = f(r) will kill itself
+        simple_reg *reg(0);
+        if(for_each_var_def(in, reg)) {
+            for(unsigned i(0); i < calls.size(); ) {
+                if(call_uses_arg(calls[i], reg)
+                || (calls[i].in != in && calls[i].in->u.call.dst == reg)) {
+                    calls[i] = calls.back();
+                    calls.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
 /// eliminate all common sub expressions
 void eliminate_common_sub_expressions(
     optimizer &o,
     cfg &flow,
-    available_expression_map &ae_exit
+    available_expression_map &ae_exit,
+    summary_map &summaries
 ) throw() {
     if(0 != getenv("ECE540_DISABLE_CSE")) {
         return;
@@ -225,6 +376,7 @@ void eliminate_common_sub_expressions(
     cse_state state;
     state.ae_enter = &ae_enter;
     state.ae_exit = &ae_exit;
+    state.summaries = &summaries;
     state.o = &o;
 
     // get the available expressions entering into each basic block
@@ -232,5 +384,8 @@ void eliminate_common_sub_expressions(
 
     // update the graph
     flow.for_each_basic_block(&replace_common_sub_expressions, state);
+
+    // reuse the results of calls to procedures without side-effects
+    flow.for_each_basic_block(&replace_common_calls, state);
 }
 
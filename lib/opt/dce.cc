@@ -12,7 +12,9 @@
 
 #include "include/opt/dce.h"
 #include "include/cfg.h"
+#include "include/instr.h"
 #include "include/optimizer.h"
+#include "include/summary.h"
 
 /// a work item in our DCE work list
 struct dce_work_item {
@@ -26,8 +28,16 @@ public:
     { }
 };
 
-/// NOP out all unreachable basic blocks
-static bool clear_unreachable_bbs(basic_block *bb, optimizer &o) throw() {
+enum {
+    MAX_THREADED_JUMPS = 8U
+};
+
+/// NOP out all unreachable basic blocks; they are removed from the CFG once
+/// the use-def chains that mention them are no longer needed
+static bool clear_unreachable_bbs(
+    basic_block *bb,
+    std::vector<basic_block *> &unreachable
+) throw() {
     if(bb->entry_reachable || 0 == bb->first) {
         return true;
     }
@@ -36,68 +46,171 @@ static bool clear_unreachable_bbs(basic_block *bb, optimizer &o) throw() {
         in->opcode = NOP_OP;
     }
 
-    o.changed_block();
+    unreachable.push_back(bb);
     return true;
 }
 
-/// kill useless JMPs; after a few cycles through the pipeline, this might
-/// give us the opportunity to merge basic blocks. This is actually a form of
-/// peephole optimization
-static void kill_jmps(simple_instr *in, optimizer &o) throw() {
-    for(simple_instr *next(0); 0 != in; in = next) {
-        next = in->next;
-        if(0 != next
-        && JMP_OP == in->opcode
-        && LABEL_OP == next->opcode
-        && in->u.bj.target == next->u.label.lab) {
-            o.changed_block();
-            in->opcode = NOP_OP;
+/// remove all unreachable basic blocks from the CFG
+static bool remove_unreachable_bbs(cfg &flow) throw() {
+    std::vector<basic_block *> unreachable;
+    for(basic_block *bb(flow.entry()->next); 0 != bb; bb = bb->next) {
+        if(!bb->entry_reachable && 0 != bb->first) {
+            unreachable.push_back(bb);
         }
     }
+
+    for(unsigned i(0); i < unreachable.size(); ++i) {
+        flow.remove_block(unreachable[i]);
+    }
+
+    return !unreachable.empty();
 }
 
-/// kill all NOPs
-static void kill_nops(simple_instr *in, optimizer &o) throw() {
+/// kill useless JMPs, i.e. jumps to the next block; this gives us the
+/// opportunity to merge basic blocks. This is actually a form of peephole
+/// optimization
+static bool kill_jmps(basic_block *bb, bool &changed) throw() {
+    if(0 == bb->last
+    || JMP_OP != bb->last->opcode
+    || 0 == bb->next
+    || !instr::is_label(bb->next->first)
+    || bb->last->u.bj.target != bb->next->first->u.label.lab) {
+        return true;
+    }
+
+    bb->last->opcode = NOP_OP;
+    changed = true;
+    return true;
+}
+
+/// if a block does nothing but jump to another block, then return the block
+/// that it jumps to; otherwise return 0
+static basic_block *forwarded_block(cfg &flow, basic_block *bb) throw() {
+    if(0 == bb->last || JMP_OP != bb->last->opcode) {
+        return 0;
+    }
+
+    for(simple_instr *in(bb->first); in != bb->last; in = in->next) {
+        if(LABEL_OP != in->opcode && NOP_OP != in->opcode) {
+            return 0;
+        }
+    }
 
-    for(simple_instr *next(0); 0 != in; in = next) {
-        if(NOP_OP == in->opcode) {
+    return flow.find_block(bb->last->u.bj.target);
+}
 
-            // find the next non-NOP
-            for(next = in->next;
-                0 != next && NOP_OP == next->opcode;
-                next = next->next) {
-                // loop :-P
+/// retarget branches/jumps to blocks that only jump elsewhere to instead go
+/// to where those blocks jump (jump threading). The skipped blocks might
+/// become unreachable.
+static bool thread_jumps(basic_block *bb, cfg &flow, bool &changed) throw() {
+    if(!instr::is_local_control_flow_transfer(bb->last)) {
+        return true;
+    }
+
+    const std::set<basic_block *> succs(bb->successors());
+    std::set<basic_block *>::const_iterator it(succs.begin()), end(succs.end());
+    for(; it != end; ++it) {
+        std::set<basic_block *> seen;
+        basic_block *target(*it);
+
+        // follow the chain of jumps, stopping at cycles
+        for(unsigned i(0); i < MAX_THREADED_JUMPS; ++i) {
+            seen.insert(target);
+            basic_block *forward(forwarded_block(flow, target));
+            if(0 == forward || 0U != seen.count(forward)) {
+                break;
             }
+            target = forward;
+        }
 
-            // unlink, if possible
-            if(0 != in->prev) {
-                simple_instr *prev(in->prev);
-                prev->next = next;
+        if(target != *it && flow.redirect_branch(bb, *it, target)) {
+            changed = true;
+        }
+    }
 
-                if(0 != next) {
-                    next->prev = prev;
-                }
+    return true;
+}
+
+/// merge blocks that always execute one after the other
+static bool merge_blocks(basic_block *bb, cfg &flow, bool &changed) throw() {
+    while(flow.merge_blocks(bb)) {
+        changed = true;
+    }
+    return true;
+}
+
+/// kill all NOPs in a basic block, keeping the first instruction of the
+/// procedure and at least one instruction in the block
+static bool kill_nops(basic_block *bb) throw() {
+    if(0 == bb->first) {
+        return true;
+    }
+
+    simple_instr *first(0);
+    simple_instr *last(0);
+    unsigned num_instructions(0U);
+    simple_instr *end(bb->last->next);
+
+    for(simple_instr *in(bb->first), *next(0); in != end; in = next) {
+        next = in->next;
+
+        if(NOP_OP == in->opcode
+        && 0 != in->prev
+        && (0 != last || next != end)) {
+            in->prev->next = next;
+            if(0 != next) {
+                next->prev = in->prev;
             }
-        } else {
-            next = in->next;
+            continue;
+        }
+
+        if(0 == first) {
+            first = in;
         }
+        last = in;
+        ++num_instructions;
     }
+
+    bb->first = first;
+    bb->last = last;
+    bb->num_instructions = num_instructions;
+    return true;
 }
 
 typedef std::vector<dce_work_item> dce_work_list;
 
+struct dce_state {
+public:
+    dce_work_list work_list;
+    summary_map *summaries;
+};
+
 /// go find all instructions that allow variables to escape the function and
 /// consider those instructions to be essential
-static bool find_initial_essential_ins(basic_block *bb, dce_work_list &wl) throw() {
+static bool find_initial_essential_ins(basic_block *bb, dce_state &s) throw() {
     if(0 == bb->first) {
         return true;
     }
 
+    const procedure_summary *callee(0);
+
     for(simple_instr *in(bb->first); in != bb->last->next; in = in->next) {
         switch(in->opcode) {
-        case RET_OP: case CALL_OP: case STR_OP: case MCPY_OP:
-        case LOAD_OP:
-            wl.push_back(dce_work_item(bb, in));
+
+        // calls to procedures without side-effects are only essential if
+        // their results are used
+        case CALL_OP:
+            callee = s.summaries->find(in);
+            if(0 != callee && callee->is_removable()) {
+                break;
+            }
+            s.work_list.push_back(dce_work_item(bb, in));
+            break;
+
+        // note: loads are not essential; a load whose value is never used
+        //       can be removed like any other definition
+        case RET_OP: case STR_OP: case MCPY_OP:
+            s.work_list.push_back(dce_work_item(bb, in));
         default:
             break;
         }
@@ -123,10 +236,12 @@ static bool find_label_essential_ins(
     return true;
 }
 
-/// turn every non-essential instruction into a NOP for later cleaning up
+/// turn every non-essential instruction into a NOP for later cleaning up;
+/// notes if this changes where a block goes
 static bool clear_non_essential_ins(
     basic_block *bb,
-    std::set<simple_instr *> &essential_ins
+    std::set<simple_instr *> &essential_ins,
+    bool &cleared_branch
 ) throw() {
     if(0 == bb->first) {
         return true;
@@ -135,6 +250,8 @@ static bool clear_non_essential_ins(
     for(simple_instr *in(bb->first); in != bb->last->next; in = in->next) {
         if(NOP_OP != in->opcode
         && 0U == essential_ins.count(in)) {
+            cleared_branch = cleared_branch
+                          || instr::is_local_control_flow_transfer(in);
             in->opcode = NOP_OP;
         }
     }
@@ -142,18 +259,21 @@ static bool clear_non_essential_ins(
     return true;
 }
 
-/// eliminate dead code
-static void do_dce(
+/// eliminate dead code; returns true if a branch/jump was removed
+static bool do_dce(
     optimizer &o,
     cfg &flow,
-    use_def_map &ud
+    use_def_map &ud,
+    summary_map &summaries
 ) throw() {
     std::set<simple_instr *> essential_ins;
     std::set<basic_block *> control_dep;
-    dce_work_list work_list;
+    dce_state state;
+    dce_work_list &work_list(state.work_list);
+    state.summaries = &summaries;
 
     // initialize the work list
-    flow.for_each_basic_block(&find_initial_essential_ins, work_list);
+    flow.for_each_basic_block(&find_initial_essential_ins, state);
 
     // initialize essential instructions with all labels; unused labels will
     // be destroyed the next time the cfg is initialized
@@ -238,23 +358,52 @@ static void do_dce(
     }
 
     // clear (to NOPs) every non-essential instruction
-    flow.for_each_basic_block(&clear_non_essential_ins, essential_ins);
+    bool cleared_branch(false);
+    flow.for_each_basic_block(&clear_non_essential_ins, essential_ins, cleared_branch);
+    return cleared_branch;
 }
 
 /// determine essential instructions and convert non-essential instructions
 /// into NOPs. Do a final pass over the instructions to clear out NOPs.
-void eliminate_dead_code(optimizer &o, cfg &flow, use_def_map &ud) throw() {
+void eliminate_dead_code(
+    optimizer &o,
+    cfg &flow,
+    use_def_map &ud,
+    summary_map &summaries
+) throw() {
     if(0 != getenv("ECE540_DISABLE_DCE")) {
         return;
     }
 
-    // clear out all unreachable blocks; they will be cleaned up later by the
-    // NOP killing pass
-    flow.for_each_basic_block(&clear_unreachable_bbs, o);
+    // clear out all unreachable blocks; they will be removed once DCE no
+    // longer needs the use-def chains
+    std::vector<basic_block *> unreachable;
+    flow.for_each_basic_block(&clear_unreachable_bbs, unreachable);
 
-    do_dce(o, flow, ud);
+    const bool cleared_branch(do_dce(o, flow, ud, summaries));
 
-    // clean up useless things
-    kill_jmps(o.first_instruction(), o);
-    kill_nops(o.first_instruction(), o);
+    for(unsigned i(0); i < unreachable.size(); ++i) {
+        flow.remove_block(unreachable[i]);
+    }
+
+    // clean up useless things; the CFG is edited in place unless DCE removed
+    // a branch, which changes the edges of the graph
+    bool changed(!unreachable.empty());
+    flow.for_each_basic_block(&kill_jmps, changed);
+
+    if(cleared_branch) {
+        flow.for_each_basic_block(&kill_nops);
+        o.changed_block();
+        return;
+    }
+
+    flow.for_each_basic_block(&thread_jumps, flow, changed);
+    flow.update_reachability();
+    changed = remove_unreachable_bbs(flow) || changed;
+    flow.for_each_basic_block(&merge_blocks, flow, changed);
+    flow.for_each_basic_block(&kill_nops);
+
+    if(changed) {
+        o.changed_graph();
+    }
 }
@@ -0,0 +1,123 @@
+/*
+ * dse.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <vector>
+#include <cstdlib>
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include "include/opt/dse.h"
+#include "include/alias.h"
+#include "include/cfg.h"
+#include "include/optimizer.h"
+#include "include/summary.h"
+
+struct dse_state {
+public:
+    alias_map *aliases;
+    summary_map *summaries;
+    optimizer *o;
+};
+
+/// remove every later store that might be read by some memory access
+static void keep_read_stores(
+    std::vector<memory_access> &stores,
+    const memory_access &read,
+    const alias_map &aliases
+) throw() {
+    for(unsigned i(0); i < stores.size(); ) {
+        if(aliases.may_alias(stores[i], read)) {
+            stores[i] = stores.back();
+            stores.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+/// remove dead stores within a basic block. This goes backward through the
+/// basic block remembering which stores will definitely happen before
+/// anything can read the memory they write; an earlier store to the same
+/// memory is dead.
+static bool remove_dead_stores(basic_block *bb, dse_state &s) throw() {
+    if(0 == bb->last) {
+        return true;
+    }
+
+    std::vector<memory_access> later_stores;
+
+    for(simple_instr *in(bb->last), *end(bb->first->prev);
+        in != end;
+        in = in->prev) {
+
+        memory_access access;
+
+        switch(in->opcode) {
+        case STR_OP: {
+            find_memory_write(in, access);
+            find_local_address(access);
+
+            bool is_dead(false);
+            for(unsigned i(0); i < later_stores.size(); ++i) {
+                if(s.aliases->must_alias(later_stores[i], access)) {
+                    is_dead = true;
+                    break;
+                }
+            }
+
+            if(is_dead) {
+                in->opcode = NOP_OP;
+                s.o->changed_use();
+            } else {
+                later_stores.push_back(access);
+            }
+            break;
+        }
+
+        case LOAD_OP: case MCPY_OP:
+            find_memory_read(in, access);
+            find_local_address(access);
+            keep_read_stores(later_stores, access, *(s.aliases));
+            break;
+
+        // calls to procedures that might read memory could read anything
+        case CALL_OP: {
+            const procedure_summary *callee(s.summaries->find(in));
+            if(0 == callee || callee->calls_unknown || callee->reads_memory) {
+                later_stores.clear();
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    return true;
+}
+
+/// remove stores that are overwritten before they can be read
+void eliminate_dead_stores(
+    optimizer &o,
+    cfg &flow,
+    alias_map &aliases,
+    summary_map &summaries
+) throw() {
+    if(0 != getenv("ECE540_DISABLE_DSE")) {
+        return;
+    }
+
+    dse_state state;
+    state.aliases = &aliases;
+    state.summaries = &summaries;
+    state.o = &o;
+
+    flow.for_each_basic_block(&remove_dead_stores, state);
+}
@@ -11,342 +11,449 @@ extern "C" {
 }
 
 #include <map>
+#include <set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
 #include <cassert>
+#include <cstring>
 #include <stdint.h>
 #include <exception>
 #include <cstdlib>
+#include <sys/time.h>
 
 #include "include/optimizer.h"
-#include "include/operator.h"
+#include "include/loop.h"
+#include "include/fold.h"
 #include "include/instr.h"
-#include "include/unsafe_cast.h"
+#include "include/summary.h"
+#include "include/pool.h"
+#include "include/stats.h"
 
 #include "include/data_flow/var_def.h"
 #include "include/data_flow/var_use.h"
 
 #include "include/opt/eval.h"
 
-/// filters out specific operations that cannot be performed on floating point
-/// numbers
-template <
-    template <typename L, typename R, typename O> class OpFunctor,
-    typename L0
->
-class binary_op_functor_filter {
-public:
-    typedef OpFunctor<L0,L0,L0> functor;
-};
-
-template <
-    template <typename L, typename O> class OpFunctor,
-    typename L0
->
-class unary_op_functor_filter {
-public:
-    typedef OpFunctor<L0,L0> functor;
-};
-
-class useless_double_functor {
-public:
-    double operator()(const double &, const double &) throw() {
-        return 0.0;
-    }
-    double operator()(const double &) throw() {
-        return 0.0;
-    }
-};
-
-/// perform a unary type cast from one type to another
-template <typename SourceType, typename>
-struct cast_to_int {
-    int operator()(const SourceType &ii) throw() {
-        return static_cast<int>(ii);
-    }
-};
-template <typename SourceType, typename>
-struct cast_to_unsigned {
-    unsigned operator()(const SourceType &ii) throw() {
-        return static_cast<unsigned>(ii);
-    }
-};
-template <typename SourceType, typename>
-struct cast_to_double {
-    double operator()(const SourceType &ii) throw() {
-        return static_cast<double>(ii);
-    }
+/// exact arithmetic on the concrete values that the interpreter's fast paths
+/// handle; signed arithmetic wraps around like the machine does
+template <typename T>
+struct exact {
+    static T add(T ll, T rr) throw() { return ll + rr; }
+    static T subtract(T ll, T rr) throw() { return ll - rr; }
+    static T multiply(T ll, T rr) throw() { return ll * rr; }
 };
 
-/// various SUIF-specific ops that are annoying
-template <typename SourceType, typename, typename>
-struct suif_mod {
-    int operator()(const SourceType &ll, const SourceType &rr) throw() {
-        return op::mod((int) ll, (int) rr);
+template <>
+struct exact<int> {
+    static int add(int ll, int rr) throw() {
+        return static_cast<int>(static_cast<unsigned>(ll) + static_cast<unsigned>(rr));
     }
-};
-
-template <typename SourceType, typename, typename>
-struct suif_lsr {
-    int operator()(const SourceType &ll, const SourceType &rr) throw() {
-        return op::lsr((int) ll, (unsigned) rr);
-    }
-};
-
-template <typename SourceType, typename, typename>
-struct suif_lsl {
-    int operator()(const SourceType &ll, const SourceType &rr) throw() {
-        return op::lsl((int) ll, (unsigned) rr);
+    static int subtract(int ll, int rr) throw() {
+        return static_cast<int>(static_cast<unsigned>(ll) - static_cast<unsigned>(rr));
     }
-};
-
-template <typename SourceType, typename, typename>
-struct suif_asr {
-    int operator()(const SourceType &ll, const SourceType &rr) throw() {
-        return op::asr((int) ll, (unsigned) rr);
+    static int multiply(int ll, int rr) throw() {
+        return static_cast<int>(static_cast<unsigned>(ll) * static_cast<unsigned>(rr));
     }
 };
 
-template <typename SourceType, typename, typename>
-struct suif_rot {
-    int operator()(const SourceType &ll, const SourceType &rr) throw() {
-        return op::rot((int) ll, (unsigned) rr);
-    }
-};
+/// the operators that have fast paths in the interpreter. Arithmetic
+/// operators compute a value of their operands' type, and comparisons
+/// compute an int.
+#define EVAL_ARITH_FUNCTOR(name, expr) \
+    template <typename T> \
+    struct name { \
+        typedef T result_type; \
+        static T apply(T ll, T rr) throw() { return expr; } \
+    };
 
-#define USELESS_DOUBLE_FUNCTOR(filter, the_op) \
-    template <> \
-    class filter<the_op, double> { \
-    public: \
-        typedef useless_double_functor functor; \
+#define EVAL_COMPARE_FUNCTOR(name, expr) \
+    template <typename T> \
+    struct name { \
+        typedef int result_type; \
+        static int apply(T ll, T rr) throw() { return expr; } \
     };
 
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, op::modulo)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, op::bitwise_and)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, op::bitwise_or)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, op::bitwise_xor)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, suif_mod)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, suif_lsr)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, suif_lsl)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, suif_asr)
-USELESS_DOUBLE_FUNCTOR(binary_op_functor_filter, suif_rot)
-USELESS_DOUBLE_FUNCTOR(unary_op_functor_filter, op::bitwise_not)
-USELESS_DOUBLE_FUNCTOR(unary_op_functor_filter, op::negate)
-#undef USELESS_DOUBLE_FUNCTOR
-
-/// represents the base of a runtime value in the abstract interpreter
+EVAL_ARITH_FUNCTOR(eval_add, exact<T>::add(ll, rr))
+EVAL_ARITH_FUNCTOR(eval_sub, exact<T>::subtract(ll, rr))
+EVAL_ARITH_FUNCTOR(eval_mul, exact<T>::multiply(ll, rr))
+EVAL_ARITH_FUNCTOR(eval_and, ll & rr)
+EVAL_ARITH_FUNCTOR(eval_or, ll | rr)
+EVAL_ARITH_FUNCTOR(eval_xor, ll ^ rr)
+EVAL_COMPARE_FUNCTOR(eval_seq, ll == rr)
+EVAL_COMPARE_FUNCTOR(eval_sne, ll != rr)
+EVAL_COMPARE_FUNCTOR(eval_sl, ll < rr)
+EVAL_COMPARE_FUNCTOR(eval_sle, ll <= rr)
+
+#undef EVAL_ARITH_FUNCTOR
+#undef EVAL_COMPARE_FUNCTOR
+
+struct symbolic_expression;
+
+/// represents a runtime value in the abstract interpreter. Concrete values and
+/// symbolic registers are stored inline; only expressions need to be
+/// allocated, and they are allocated out of a pool owned by the interpreter.
 struct abstract_value {
 public:
-    int ref_count;
-    int depth;
-    simple_instr *instr;
-    simple_reg *emitted_reg;
-
-    enum {
-        INT, UNSIGNED, FLOAT, UNKNOWN
-    } type;
 
     typedef enum {
         VALUE       = 1 << 0,
         SYMBOL      = 1 << 1,
         EXPRESSION  = 1 << 2,
-        BIG_VALUE   = 1 << 3
+        BIG_VALUE   = 1 << 3,
+
+        /// the value of a register at the start of an arbitrary iteration of
+        /// a loop; these only exist while a loop is being summarized
+        LOOP_SYMBOL = 1 << 4,
+
+        /// the address of a symbol, plus some offset in bytes
+        ADDRESS     = 1 << 5
     } kind_type;
 
     kind_type kind;
 
-    enum {
-        KIND = VALUE | SYMBOL | EXPRESSION | BIG_VALUE
-    };
+    typedef enum {
+        INT, UNSIGNED, FLOAT, UNKNOWN
+    } type_kind;
 
-    abstract_value(simple_instr *in) throw()
-        : ref_count(1)
-        , instr(in)
-        , emitted_reg(0)
-        , depth(1)
-    { }
+    type_kind type;
 
-    virtual ~abstract_value(void) throw() { };
+    /// the type of the register that this value was computed into; used when
+    /// emitting code for the value
+    simple_type *reg_type;
 
-    //virtual void union_symbols(std::set<simple_reg *> &) throw() = 0;
+    union {
+        int as_int;
+        unsigned as_uint;
+        double as_float;
+        simple_reg *reg;
+        symbolic_expression *expr;
+        struct {
+            simple_sym *sym;
+            int offset;
+        } as_address;
+    } value;
 };
 
-/// reference counting
-static abstract_value *inc_ref(abstract_value *val) throw() {
-    ++(val->ref_count);
-    return val;
-}
-
-static void dec_ref(abstract_value *val) throw() {
-    if(0 == --(val->ref_count)) {
-        delete val;
-    }
-}
-
-static void unsafe_dec_ref(abstract_value *val) throw() {
-    --(val->ref_count);
-}
-
-static int max_depth(int a, int b) throw() {
-    return a < b ? b : a;
-}
-
-/// represents an abstract expression that depends on some symbolic values. this
-/// is guaranteed to be a DAG by virtue of dependent_regs, which is the union
-/// of all symbolic registers in all sub-expressions. If at any point one
-/// assigns to symbolic register a value that depends on that register, the
-/// abstract interpreter will bail out, thus maintaining the correct invariant.
-struct symbolic_expression : public abstract_value {
+/// represents an abstract expression that depends on some symbolic values.
+struct symbolic_expression {
 public:
 
-    enum {
-        KIND = EXPRESSION
-    };
-
     enum {
         UNARY, BINARY
     } arity;
 
-    //std::set<simple_reg *> dependent_regs;
+    int depth;
+
+    /// the number of registers needed to evaluate the expression, assuming
+    /// that nothing in it is shared (i.e. its Sethi-Ullman number)
+    unsigned need;
 
-    abstract_value *left;
-    abstract_value *right;
+    simple_instr *instr;
+    simple_reg *emitted_reg;
 
-    /// constructor for binary expression
-    symbolic_expression(simple_instr *in, abstract_value *a0, abstract_value *a1) throw()
-        : abstract_value(in)
-        , arity(BINARY)
-        , left(a0)
-        , right(a1)
-    {
-        this->depth = max_depth(a0->depth, a1->depth) + 1;
-        //a0->union_symbols(dependent_regs);
-        //a1->union_symbols(dependent_regs);
+    abstract_value left;
+    abstract_value right;
+};
 
-        inc_ref(a0);
-        inc_ref(a1);
+/// identifies an expression by its operator and operands
+struct expression_key {
+public:
+    int opcode;
+    simple_type *instr_type;
+    simple_type *type;
+    abstract_value left;
+    abstract_value right;
+};
 
-        this->type = a0->type;
-        this->kind = EXPRESSION;
+template <typename T>
+static int compare(const T &a, const T &b) throw() {
+    if(a < b) {
+        return -1;
+    } else if(b < a) {
+        return 1;
     }
+    return 0;
+}
 
-    /// constructor for unary expression
-    symbolic_expression(simple_instr *in, abstract_value *a0) throw()
-        : abstract_value(in)
-        , arity(UNARY)
-        , left(a0)
-        , right(0)
-    {
-        this->depth = a0->depth + 1;
-        //a0->union_symbols(dependent_regs);
-
-        inc_ref(a0);
+template <typename T>
+static int compare(T *a, T *b) throw() {
+    std::less<T *> less;
+    if(less(a, b)) {
+        return -1;
+    } else if(less(b, a)) {
+        return 1;
+    }
+    return 0;
+}
 
-        this->type = a0->type;
-        this->kind = EXPRESSION;
+/// a total order on abstract values; floating point values are ordered by
+/// their bits so that NaNs are equal to themselves
+static int compare_values(const abstract_value &a, const abstract_value &b) throw() {
+    int cmp(compare(static_cast<int>(a.kind), static_cast<int>(b.kind)));
+    if(0 == cmp) {
+        cmp = compare(static_cast<int>(a.type), static_cast<int>(b.type));
     }
+    if(0 == cmp) {
+        cmp = compare(a.reg_type, b.reg_type);
+    }
+    if(0 != cmp) {
+        return cmp;
+    }
+
+    switch(a.kind) {
+    case abstract_value::VALUE:
+        if(abstract_value::FLOAT == a.type) {
+            uint64_t a_bits, b_bits;
+            memcpy(&a_bits, &(a.value.as_float), sizeof a_bits);
+            memcpy(&b_bits, &(b.value.as_float), sizeof b_bits);
+            return compare(a_bits, b_bits);
+        }
+        return compare(a.value.as_uint, b.value.as_uint);
 
-    virtual ~symbolic_expression(void) throw() {
-        dec_ref(left);
-        left = 0;
+    case abstract_value::SYMBOL:
+    case abstract_value::LOOP_SYMBOL:
+        return compare(a.value.reg, b.value.reg);
 
-        if(0 != right) {
-            dec_ref(right);
-            right = 0;
+    case abstract_value::EXPRESSION:
+        return compare(a.value.expr, b.value.expr);
+
+    case abstract_value::ADDRESS:
+        cmp = compare(a.value.as_address.sym, b.value.as_address.sym);
+        if(0 == cmp) {
+            cmp = compare(a.value.as_address.offset, b.value.as_address.offset);
         }
+        return cmp;
 
-        //dependent_regs.clear();
+    default:
+        return 0;
     }
+}
 
-    /*virtual void union_symbols(std::set<simple_reg *> &syms) throw() {
-        syms.insert(dependent_regs.begin(), dependent_regs.end());
-    }*/
-};
+static bool operator<(const expression_key &a, const expression_key &b) throw() {
+    int cmp(compare(a.opcode, b.opcode));
+    if(0 == cmp) {
+        cmp = compare(a.instr_type, b.instr_type);
+    }
+    if(0 == cmp) {
+        cmp = compare(a.type, b.type);
+    }
+    if(0 == cmp) {
+        cmp = compare_values(a.left, b.left);
+    }
+    if(0 == cmp) {
+        cmp = compare_values(a.right, b.right);
+    }
+    return cmp < 0;
+}
 
-/// represents a single value. The value is known at compile time.
-struct concrete_value : public abstract_value {
+/// a pool of expressions; this is freed all at once when the interpreter is
+/// done. Expressions are hash-consed, i.e. an expression with the same
+/// operator and operands as an existing expression is the existing
+/// expression. As operands are hash-consed too, equal expression trees are
+/// the same pointer, and so code for them is only emitted once.
+struct expression_pool {
 public:
+    pool<symbolic_expression> nodes;
+    std::map<expression_key, symbolic_expression *> table;
+    unsigned num_shared;
 
-    enum {
-        KIND = VALUE
-    };
-
-    union {
-        int as_int;
-        unsigned as_uint;
-        double as_float;
-    } value;
+    expression_pool(void) throw()
+        : num_shared(0U)
+    { }
 
-    concrete_value(simple_instr *in, int i) throw()
-        : abstract_value(in)
-    {
-        value.as_int = i;
-        this->type = INT;
-        this->kind = VALUE;
+    /// the number of distinct expressions
+    unsigned size(void) const throw() {
+        return nodes.size();
     }
 
-    concrete_value(simple_instr *in, unsigned u) throw()
-        : abstract_value(in)
-    {
-        value.as_uint = u;
-        this->type = UNSIGNED;
-        this->kind = VALUE;
+    void clear(void) throw() {
+        nodes.clear();
+        table.clear();
+        num_shared = 0U;
     }
+};
+
+static int max_depth(int a, int b) throw() {
+    return a < b ? b : a;
+}
 
-    concrete_value(simple_instr *in, double f) throw()
-        : abstract_value(in)
-    {
-        value.as_float = f;
-        this->type = FLOAT;
-        this->kind = VALUE;
+/// the depth of the expression tree of a value
+static int depth_of(const abstract_value &val) throw() {
+    if(abstract_value::EXPRESSION == val.kind) {
+        return val.value.expr->depth;
     }
+    return 1;
+}
 
-    virtual ~concrete_value(void) throw() { }
+/// make concrete values; these are known at compile time
+static abstract_value make_value(simple_type *type, int i) throw() {
+    abstract_value val;
+    val.kind = abstract_value::VALUE;
+    val.type = abstract_value::INT;
+    val.reg_type = type;
+    val.value.as_int = i;
+    return val;
+}
 
-    //virtual void union_symbols(std::set<simple_reg *> &) throw() { }
-};
+static abstract_value make_value(simple_type *type, unsigned u) throw() {
+    abstract_value val;
+    val.kind = abstract_value::VALUE;
+    val.type = abstract_value::UNSIGNED;
+    val.reg_type = type;
+    val.value.as_uint = u;
+    return val;
+}
 
-/// represents a symbolic value stored in a register
-struct symbolic_value : public abstract_value {
-public:
+static abstract_value make_value(simple_type *type, double f) throw() {
+    abstract_value val;
+    val.kind = abstract_value::VALUE;
+    val.type = abstract_value::FLOAT;
+    val.reg_type = type;
+    val.value.as_float = f;
+    return val;
+}
 
-    enum {
-        KIND = SYMBOL
-    };
+/// make a symbolic value stored in a register
+static abstract_value make_symbol(simple_reg *reg) throw() {
+    abstract_value val;
+    val.kind = abstract_value::SYMBOL;
+    val.type = abstract_value::UNKNOWN;
+    val.reg_type = reg->var->type;
+    val.value.reg = reg;
+    return val;
+}
 
-    simple_reg *reg;
+/// make the address of a symbol
+static abstract_value make_address(simple_type *type, simple_sym *sym, int offset) throw() {
+    abstract_value val;
+    val.kind = abstract_value::ADDRESS;
+    val.type = abstract_value::UNKNOWN;
+    val.reg_type = type;
+    val.value.as_address.sym = sym;
+    val.value.as_address.offset = offset;
+    return val;
+}
 
-    symbolic_value(simple_reg *r) throw()
-        : abstract_value(0)
-        , reg(r)
-    {
-        this->type = UNKNOWN;
-        this->kind = SYMBOL;
-    }
+/// make a symbolic value for a register at the start of a loop iteration
+static abstract_value make_loop_symbol(simple_reg *reg) throw() {
+    abstract_value val(make_symbol(reg));
+    val.kind = abstract_value::LOOP_SYMBOL;
+    return val;
+}
 
-    virtual ~symbolic_value(void) throw() { }
+/// make a "big" value, i.e. we exceeded the maximum sized value, so we
+/// just killed it off and keep this instead.
+static abstract_value make_big(const abstract_value &old) throw() {
+    abstract_value val(old);
+    val.kind = abstract_value::BIG_VALUE;
+    val.value.expr = 0;
+    return val;
+}
 
-    /*virtual void union_symbols(std::set<simple_reg *> &syms) throw() {
-        syms.insert(reg);
-    }*/
-};
+/// the number of registers needed to evaluate a value; symbolic values are
+/// already in registers
+static unsigned need_of(const abstract_value &val) throw() {
+    if(abstract_value::EXPRESSION == val.kind) {
+        return val.value.expr->need;
+    } else if(abstract_value::SYMBOL == val.kind) {
+        return 0U;
+    }
+    return 1U;
+}
 
-/// represents a "big" value, i.e. we exceeded the maximum sized value, so we
-/// just killed it off and keep this instead.
-struct big_value : public abstract_value {
-public:
+/// is an operator commutative? The operands of these are put into a
+/// canonical order so that e.g. a + b and b + a are the same expression.
+static bool is_commutative(int opcode) throw() {
+    switch(opcode) {
+    case ADD_OP: case MUL_OP: case AND_OP: case IOR_OP: case XOR_OP:
+    case SEQ_OP: case SNE_OP:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    big_value(abstract_value *val) throw()
-        : abstract_value(0)
-    {
-        this->kind = BIG_VALUE;
-        this->type = val->type;
+/// make a unary or binary expression, or find an existing one that is the
+/// same
+static abstract_value make_expression(
+    expression_pool &exprs,
+    simple_instr *in,
+    simple_type *type,
+    const abstract_value &a0,
+    const abstract_value *a1
+) throw() {
+    expression_key key;
+    key.opcode = in->opcode;
+    key.instr_type = in->type;
+    key.type = type;
+    key.left = a0;
+    key.right.kind = abstract_value::BIG_VALUE;
+    key.right.type = abstract_value::UNKNOWN;
+    key.right.reg_type = 0;
+    key.right.value.expr = 0;
+
+    if(0 != a1) {
+        key.right = *a1;
+        if(is_commutative(in->opcode)
+        && a0.type == a1->type
+        && 0 < compare_values(a0, *a1)) {
+            std::swap(key.left, key.right);
+        }
+    }
 
-        dec_ref(val);
+    // big values aren't all the same, so expressions of them can't be shared
+    const bool can_share(abstract_value::BIG_VALUE != a0.kind
+        && (0 == a1 || abstract_value::BIG_VALUE != a1->kind));
+
+    symbolic_expression *expr(0);
+    if(can_share) {
+        std::map<expression_key, symbolic_expression *>::iterator it(
+            exprs.table.find(key));
+        if(exprs.table.end() != it) {
+            expr = it->second;
+            ++(exprs.num_shared);
+        }
     }
 
-    virtual ~big_value(void) throw() { }
+    if(0 == expr) {
+        expr = exprs.nodes.allocate();
+        expr->instr = in;
+        expr->emitted_reg = 0;
+        expr->left = key.left;
+
+        if(0 != a1) {
+            const unsigned left_need(need_of(key.left));
+            const unsigned right_need(need_of(key.right));
+
+            expr->arity = symbolic_expression::BINARY;
+            expr->right = key.right;
+            expr->depth = max_depth(depth_of(a0), depth_of(*a1)) + 1;
+            expr->need = left_need == right_need
+                ? left_need + 1U
+                : (left_need < right_need ? right_need : left_need);
+        } else {
+            expr->arity = symbolic_expression::UNARY;
+            expr->depth = depth_of(a0) + 1;
+            expr->need = need_of(a0);
+            if(0U == expr->need) {
+                expr->need = 1U;
+            }
+        }
 
-    //virtual void union_symbols(std::set<simple_reg *> &) throw() { }
-};
+        if(can_share) {
+            exprs.table[key] = expr;
+        }
+    }
+
+    abstract_value val;
+    val.kind = abstract_value::EXPRESSION;
+    val.type = a0.type;
+    val.reg_type = type;
+    val.value.expr = expr;
+    return val;
+}
 
 /// an exception thrown when something illegal is done, i.e. something that
 /// cannot be interpreted abstractly.
@@ -355,45 +462,29 @@ public:
     stop_interpreter(int) throw() { }
 };
 
-/// check if an abstract value uses a particular register; this is how cycles
-/// are conservatively detected.
-/*static bool uses_register(const abstract_value *val, simple_reg *reg) throw() {
-
-    if(abstract_value::EXPRESSION == val->kind) {
-        const symbolic_expression *expr(unsafe_cast<const symbolic_expression *>(val));
-        return !!expr->dependent_regs.count(reg);
-
-    } else if(abstract_value::SYMBOL == val->kind) {
-        const symbolic_value *sym(unsafe_cast<const symbolic_value *>(val));
-        return sym->reg == reg;
-
-    } else {
-        return false;
-    }
-}*/
-
-/// pattern match over a binary expression
-template <typename L, typename R>
-bool match_binary(abstract_value *val, L *&a0, R *&a1) throw() {
-    if(abstract_value::EXPRESSION != val->kind) {
+/// pattern match over a binary expression of a concrete value and something
+/// else
+static bool match_value_binary(
+    const abstract_value &val,
+    const abstract_value *&a0,
+    const abstract_value *&a1
+) throw() {
+    if(abstract_value::EXPRESSION != val.kind) {
         return false;
     }
 
-    symbolic_expression *expr(unsafe_cast<symbolic_expression *>(val));
+    const symbolic_expression *expr(val.value.expr);
 
     if(symbolic_expression::UNARY == expr->arity) {
         return false;
     }
 
-    abstract_value *left(expr->left)
-                 , *right(expr->right);
-
-    if((L::KIND & left->kind) && (R::KIND & right->kind)) {
-        a0 = unsafe_cast<L *>(left);
-        a1 = unsafe_cast<R *>(right);
-    } else if((L::KIND & right->kind) && (R::KIND & left->kind)) {
-        a0 = unsafe_cast<L *>(right);
-        a1 = unsafe_cast<R *>(left);
+    if(abstract_value::VALUE == expr->left.kind) {
+        a0 = &(expr->left);
+        a1 = &(expr->right);
+    } else if(abstract_value::VALUE == expr->right.kind) {
+        a0 = &(expr->right);
+        a1 = &(expr->left);
     } else {
         return false;
     }
@@ -402,231 +493,900 @@ bool match_binary(abstract_value *val, L *&a0, R *&a1) throw() {
 }
 
 /// attempt to combine expressions of the form C1 + (C2 + ?) into (C1 + C2) + ?
-static abstract_value *combine_constant_adds(
+static bool combine_constant_adds(
+    expression_pool &exprs,
     simple_instr *instr,
-    abstract_value *a0,
-    abstract_value *a1
+    simple_type *type,
+    const abstract_value &a0,
+    const abstract_value &a1,
+    abstract_value &out
 ) throw() {
-    if(ADD_OP != instr->opcode) {
-        return 0;
+    if(ADD_OP != instr->opcode || abstract_value::FLOAT == a0.type) {
+        return false;
     }
 
-    concrete_value *val(0);
-    abstract_value *expr(0);
+    const abstract_value *val(0);
+    const abstract_value *expr(0);
 
     // we're pattern matching for V op (V op ?)
-    if(abstract_value::VALUE == a0->kind) {
-        val = unsafe_cast<concrete_value *>(a0);
-        expr = a1;
-    } else if(abstract_value::VALUE == a1->kind) {
-        val = unsafe_cast<concrete_value *>(a1);
-        expr = a0;
+    if(abstract_value::VALUE == a0.kind) {
+        val = &a0;
+        expr = &a1;
+    } else if(abstract_value::VALUE == a1.kind) {
+        val = &a1;
+        expr = &a0;
     } else {
-        return 0;
+        return false;
     }
 
-    concrete_value *sub_val(0);
-    abstract_value *sub_expr(0);
+    const abstract_value *sub_val(0);
+    const abstract_value *sub_expr(0);
 
-    if(match_binary(expr, sub_val, sub_expr)) {
+    if(match_value_binary(*expr, sub_val, sub_expr)
+    && ADD_OP == expr->value.expr->instr->opcode) {
 
         // okay, lets flatten this
-        concrete_value *new_sub_val(new concrete_value(
-            sub_val->instr,
+        const abstract_value new_sub_val(make_value(
+            sub_val->reg_type,
             val->value.as_int + sub_val->value.as_int
         ));
 
-        unsafe_dec_ref(new_sub_val); // make sure ref count on the sub-value is 1, not 2
-
-        return new symbolic_expression(instr, new_sub_val, sub_expr);
+        out = make_expression(exprs, instr, type, new_sub_val, sub_expr);
+        return true;
     }
 
-    return 0;
+    return false;
 }
 
 /// exception value that is thrown if interpretation should stop
 const static stop_interpreter STOP_INTERPRETER(0);
 
-/// perform a binary operation on two abstract values
-template <template <typename L, typename R, typename O> class OpFunctor>
-abstract_value *apply_binary(
-    simple_instr *instr,        // instruction being executed
-    simple_reg *dest_reg,       // what is the reg's old value?
-    abstract_value *a0,         // left param of binary operator
-    abstract_value *a1          // right param of binary operator
-) throw(stop_interpreter) {
+/// is a value a concrete integer (that isn't an address)?
+static bool is_int_value(const abstract_value &val) throw() {
+    return abstract_value::VALUE == val.kind
+        && abstract_value::FLOAT != val.type;
+}
 
-    // filter out any invalid operations and instantiate the operator templates
-    typedef typename binary_op_functor_filter<OpFunctor, int>::functor int_functor;
-    typedef typename binary_op_functor_filter<OpFunctor, unsigned>::functor unsigned_functor;
-    typedef typename binary_op_functor_filter<OpFunctor, double>::functor double_functor;
+/// perform address arithmetic. Adding/subtracting a concrete integer to/from
+/// an address gives another address, and the difference between two
+/// addresses of the same symbol is an integer.
+static bool apply_address(
+    simple_instr *instr,
+    simple_type *type,
+    const abstract_value &a0,
+    const abstract_value &a1,
+    abstract_value &out
+) throw() {
+    switch(instr->opcode) {
+    case ADD_OP:
+        if(abstract_value::ADDRESS == a0.kind && is_int_value(a1)) {
+            out = make_address(type, a0.value.as_address.sym,
+                a0.value.as_address.offset + a1.value.as_int);
+            return true;
+        } else if(is_int_value(a0) && abstract_value::ADDRESS == a1.kind) {
+            out = make_address(type, a1.value.as_address.sym,
+                a1.value.as_address.offset + a0.value.as_int);
+            return true;
+        }
+        return false;
 
-    // both compile-time values; simple case
-    if(abstract_value::VALUE == a0->kind && a0->kind == a1->kind) {
+    case SUB_OP:
+        if(abstract_value::ADDRESS != a0.kind) {
+            return false;
+        } else if(is_int_value(a1)) {
+            out = make_address(type, a0.value.as_address.sym,
+                a0.value.as_address.offset - a1.value.as_int);
+            return true;
+        } else if(abstract_value::ADDRESS == a1.kind
+               && a0.value.as_address.sym == a1.value.as_address.sym) {
+            const int diff(
+                a0.value.as_address.offset - a1.value.as_address.offset);
+            if(SIGNED_TYPE == type->base) {
+                out = make_value(type, diff);
+            } else {
+                out = make_value(type, static_cast<unsigned>(diff));
+            }
+            return true;
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
 
-        concrete_value *p0(unsafe_cast<concrete_value *>(a0));
-        concrete_value *p1(unsafe_cast<concrete_value *>(a1));
+/// turn a concrete value into a constant
+static void to_immed(const abstract_value &val, simple_immed &imm) throw() {
+    if(abstract_value::FLOAT == val.type) {
+        imm.format = IMMED_FLOAT;
+        imm.u.fval = val.value.as_float;
+    } else {
+        imm.format = IMMED_INT;
+        imm.u.ival = val.value.as_int;
+    }
+}
 
-        switch(a0->type) {
-        case abstract_value::INT:
-            return new concrete_value(instr, int_functor()(p0->value.as_int, p1->value.as_int));
+/// turn a constant into a concrete value of some type. Integers of all widths
+/// are held in 32 bits, in the same way that an LDC holds them.
+static abstract_value from_immed(const simple_immed &imm, simple_type *type) throw() {
+    if(IMMED_FLOAT == imm.format) {
+        return make_value(type, imm.u.fval);
+    } else if(SIGNED_TYPE == type->base) {
+        return make_value(type, imm.u.ival);
+    }
+    return make_value(type, static_cast<unsigned>(imm.u.ival));
+}
 
-        case abstract_value::UNSIGNED:
-            return new concrete_value(instr, unsigned_functor()(p0->value.as_uint, p1->value.as_uint));
+/// perform a binary operation on two abstract values. Concrete values are
+/// folded exactly, as the types of the registers say; this fails if the
+/// result is undefined (e.g. division by zero) or can't be represented.
+static bool apply_binary(
+    expression_pool &exprs,
+    simple_instr *instr,        // instruction being executed
+    simple_reg *dest_reg,       // register being assigned to
+    const abstract_value &a0,   // left param of binary operator
+    const abstract_value &a1,   // right param of binary operator
+    abstract_value &ret
+) throw() {
+    simple_type *type(dest_reg->var->type);
 
-        case abstract_value::FLOAT:
-            return new concrete_value(instr, double_functor()(p0->value.as_float, p1->value.as_float));
+    if((abstract_value::ADDRESS == a0.kind || abstract_value::ADDRESS == a1.kind)
+    && apply_address(instr, type, a0, a1, ret)) {
+        return true;
+    }
 
-        default:
-            assert(false);
-            break;
+    // both compile-time values; simple case
+    if(abstract_value::VALUE == a0.kind && a0.kind == a1.kind) {
+        simple_immed left, right, result;
+        to_immed(a0, left);
+        to_immed(a1, right);
+        if(!fold::binary(instr->opcode,
+            instr->u.base.src1->var->type, left,
+            instr->u.base.src2->var->type, right,
+            type, result)) {
+            return false;
         }
+        ret = from_immed(result, type);
 
     // need to compute an expression;
-    } else {
-        //if(uses_register(a0, dest_reg) || uses_register(a1, dest_reg)) {
-        //    throw STOP_INTERPRETER;
-        //}
-
-        abstract_value *ret(combine_constant_adds(instr, a0, a1));
+    } else if(!combine_constant_adds(exprs, instr, type, a0, a1, ret)) {
+        ret = make_expression(exprs, instr, type, a0, &a1);
+    }
+    return true;
+}
 
-        if(0 == ret) {
-            ret = new symbolic_expression(instr, a0, a1);
+/// perform a unary operation on an abstract value
+static bool apply_unary(
+    expression_pool &exprs,
+    simple_instr *instr,        // instruction being executed
+    simple_reg *dest_reg,       // register being assigned to
+    const abstract_value &a0,   // param of unary operator
+    abstract_value &ret
+) throw() {
+    simple_type *type(dest_reg->var->type);
+
+    // compile-time value; simple case
+    if(abstract_value::VALUE == a0.kind) {
+        simple_immed arg, result;
+        to_immed(a0, arg);
+        if(!fold::unary(instr->opcode,
+            instr->u.base.src1->var->type, arg, type, result)) {
+            return false;
         }
+        ret = from_immed(result, type);
 
-        return ret;
+    // need to compute an expression;
+    } else {
+        ret = make_expression(exprs, instr, type, a0, 0);
     }
+    return true;
 }
 
-/// perform a unary operation on two abstract values
-template <template <typename L, typename O> class OpFunctor>
-abstract_value *apply_unary(
-    simple_instr *instr,        // instruction being executed
-    simple_reg *dest_reg,       // what is the reg's old value?
-    abstract_value *a0          // left param of binary operator
-) throw(stop_interpreter) {
+enum {
+    NO_REG = ~0U,   // register slot for a missing register
+    NO_INSTR = ~0U, // instruction index that is never reached
+    NO_LOOP = ~0U   // loop index for instructions that don't begin a loop
+};
 
-    // filter out any invalid operations and instantiate the operator templates
-    typedef typename unary_op_functor_filter<OpFunctor, int>::functor int_functor;
-    typedef typename unary_op_functor_filter<OpFunctor, unsigned>::functor unsigned_functor;
-    typedef typename unary_op_functor_filter<OpFunctor, double>::functor double_functor;
+/// how a pre-decoded instruction is executed. Handlers are chosen once, when
+/// the code is decoded, based on the opcode and the types of the registers
+/// involved.
+///
+/// binary operators with fast paths are listed with the functor that
+/// implements them, and the value (if any) that comparing a value against
+/// itself produces. The fast paths are for 32 bit integers and doubles;
+/// everything else (including division and shifts, which can be undefined) is
+/// folded by the general handlers.
+#define EVAL_INT_OPS(X) \
+    X(ADD, eval_add, -1) \
+    X(SUB, eval_sub, -1) \
+    X(MUL, eval_mul, -1) \
+    X(AND, eval_and, -1) \
+    X(IOR, eval_or, -1) \
+    X(XOR, eval_xor, -1) \
+    X(SEQ, eval_seq, 1) \
+    X(SNE, eval_sne, -1) \
+    X(SL, eval_sl, 0) \
+    X(SLE, eval_sle, 1)
+
+#define EVAL_FLOAT_OPS(X) \
+    X(ADD, eval_add, -1) \
+    X(SUB, eval_sub, -1) \
+    X(MUL, eval_mul, -1) \
+    X(SEQ, eval_seq, 1) \
+    X(SNE, eval_sne, -1) \
+    X(SL, eval_sl, 0) \
+    X(SLE, eval_sle, 1)
+
+#define EVAL_INT_HANDLERS(name, functor, same) \
+    X(H_ ## name ## _INT) \
+    X(H_ ## name ## _UNSIGNED)
+
+#define EVAL_FLOAT_HANDLERS(name, functor, same) \
+    X(H_ ## name ## _FLOAT)
+
+#define EVAL_HANDLERS(X) \
+    X(H_END) \
+    X(H_BREAK) \
+    X(H_UNKNOWN) \
+    X(H_STOP) \
+    X(H_NOP) \
+    X(H_RET) \
+    X(H_CPY) \
+    X(H_LDC) \
+    X(H_UNARY) \
+    X(H_BINARY) \
+    X(H_CVT_ADDRESS) \
+    X(H_JMP) \
+    X(H_BTRUE) \
+    X(H_BFALSE) \
+    X(H_MBR) \
+    X(H_LOAD) \
+    X(H_STR) \
+    X(H_MCPY) \
+    X(H_LOOP_HEAD) \
+    X(H_LOOP_EXIT) \
+    EVAL_INT_OPS(EVAL_INT_HANDLERS) \
+    EVAL_FLOAT_OPS(EVAL_FLOAT_HANDLERS)
+
+typedef enum {
+#define X(handler) handler,
+    EVAL_HANDLERS(X)
+#undef X
+    NUM_HANDLERS
+} handler_kind;
+
+/// use direct-threaded dispatch (computed goto) if the compiler supports it;
+/// otherwise, dispatch with a switch statement
+#if defined(__GNUC__) && !defined(ECE540_NO_THREADED_CODE)
+#   define EVAL_THREADED_CODE 1
+#endif
+
+/// a pre-decoded instruction. Registers have been resolved to slots in the
+/// interpreter's register file, branch targets have been resolved to indices
+/// of instructions in the interpreter's code, and the handler that executes
+/// the instruction has been chosen.
+struct resolved_instr {
+public:
+    handler_kind handler;
 
-    // both compile-time values; simple case
-    if(abstract_value::VALUE == a0->kind) {
+    simple_instr *in;
+    simple_reg *dst_reg;
 
-        concrete_value *p0(unsafe_cast<concrete_value *>(a0));
+    unsigned dst;
+    unsigned src1;
+    unsigned src2;
 
-        switch(a0->type) {
-        case abstract_value::INT:
-            return new concrete_value(instr, int_functor()(p0->value.as_int));
+    /// target of a JMP/BTRUE/BFALSE, or default target of an MBR
+    unsigned target;
 
-        case abstract_value::UNSIGNED:
-            return new concrete_value(instr, unsigned_functor()(p0->value.as_uint));
+    /// index of the first of the MBR's targets in the interpreter's list of
+    /// multi-way branch targets
+    unsigned first_target;
 
-        case abstract_value::FLOAT:
-            return new concrete_value(instr, double_functor()(p0->value.as_float));
+    /// index of the loop that begins at this instruction
+    unsigned loop;
 
-        default:
-            assert(false);
-            break;
-        }
+    /// constant loaded by an LDC, or returned by a call to a procedure that
+    /// always returns the same constant
+    abstract_value constant;
+};
 
-    // need to compute an expression;
-    } else {
-        //if(uses_register(a0, dest_reg)) {
-        //    throw STOP_INTERPRETER;
-        //}
+/// limits on how much work the interpreter can do in a single call to
+/// abstract_evaluator or abstract_evaluator_bp. Limits can be changed with
+/// the ECE540_EVAL_MAX_STEPS, ECE540_EVAL_MAX_VALUES, ECE540_EVAL_MAX_MS and
+/// ECE540_EVAL_MAX_GROWTH environment variables. There is no time limit
+/// unless one is set, so that the output doesn't depend on the machine.
+struct interpreter_budget {
+public:
 
-        return new symbolic_expression(instr, a0);
-    }
-}
+    enum {
+        DEFAULT_MAX_STEPS = 2000000U,
+        DEFAULT_MAX_VALUES = 200000U,
+        DEFAULT_MAX_MS = 0U, // no limit
+        DEFAULT_MAX_GROWTH = 256U,
+
+        /// how many instructions are executed between checks of the value
+        /// and time limits
+        SLICE = 4096U
+    };
+
+    unsigned max_steps;     // instructions executed
+    unsigned max_values;    // expressions allocated
+    unsigned max_ms;        // wall time, in milliseconds
+    unsigned max_growth;    // instructions emitted
 
-/// maps label symbols to the instructions following the labels
-typedef std::map<simple_sym *, simple_instr *> branch_map;
+    unsigned steps;         // instructions executed in previous slices
+    unsigned slice;         // size of the current slice
+    unsigned fuel;          // instructions left in the current slice
 
-/// maps registers to their abstract values
-class symbol_map : public std::map<simple_reg *, abstract_value *> {
+    struct timeval start;
+};
+
+/// a value stored in memory, and the store that put it there
+struct memory_cell {
 public:
+    unsigned size;
+    simple_instr *store;
+    abstract_value value;
+};
 
-    abstract_value *&operator[](simple_reg *reg) throw() {
-        assert(0 != reg);
-        return this->std::map<simple_reg *, abstract_value *>::operator[](reg);
-    }
+/// the known contents of the memory of a symbol, indexed by byte offset.
+/// Bytes that aren't covered by a cell have unknown contents.
+typedef std::map<int, memory_cell> memory_frame;
+
+/// abstract memory; only memory reached through the addresses of symbols is
+/// modeled, as nothing else can have a concrete address.
+typedef std::map<simple_sym *, memory_frame> abstract_memory;
+
+/// a loop that the interpreter can try to summarize instead of running it
+/// one iteration at a time. These are innermost loops without memory
+/// accesses or calls, whose only exit is the conditional branch at the end of
+/// the loop head.
+struct loop_summary {
+public:
+    unsigned head;              // index of the label beginning the loop
+    unsigned exit_branch;       // index of the branch that leaves the loop
+    unsigned stay;              // where the exit branch goes to stay in the loop
+
+    handler_kind exit_handler;  // the handler of the exit branch
+    bool stay_on_target;        // does taking the exit branch stay in the loop?
+    bool stay_if_true;          // does the loop continue if the condition is true?
+    bool failed;                // can the loop not be summarized?
+
+    /// register file slots of the pseudo registers defined in the loop
+    std::vector<std::pair<unsigned, simple_reg *> > defs;
 };
 
 /// the state of the abstract interpreter
 struct interpreter_state {
-    branch_map branch_targets;
-    symbol_map registers;
-
-    simple_instr *pc;       // current program counter
-    simple_instr *ret;      // instruction used to return a value
-    simple_instr *error;    // instruction where an error occurred
-    simple_instr *bp;       // breakpoint, i.e. instruction before which to stop interpreting
+    std::vector<resolved_instr> code;
+    std::vector<unsigned> mbr_targets;
+    std::vector<abstract_value> registers;
+    std::vector<simple_reg *> slot_regs;
+    expression_pool expressions;
+    abstract_memory memory;
+
+    unsigned pc;                    // current program counter
+    unsigned bp;                    // breakpoint, i.e. instruction before which to stop interpreting
+    simple_instr *ret;              // instruction used to return a value
+    const resolved_instr *error;    // instruction where an error occurred
 
     bool did_return;
-    abstract_value *return_val;
+    bool out_of_budget;
+    abstract_value return_val;
+
+    interpreter_budget budget;
+
+    /// loops that can be summarized, and the loop (if any) currently being
+    /// summarized
+    std::vector<loop_summary> loops;
+    unsigned summarizing;
+    bool iteration_done;
+    abstract_value loop_condition;
+
+    summary_map *summaries;
 };
 
+/// used to map registers to slots and labels to instructions while setting
+/// up the interpreter
+struct setup_state {
+public:
+    std::map<simple_reg *, unsigned> slots;
+    std::map<simple_sym *, unsigned> labels;
+};
 
-/// build up a table of all registers
-static void assign_symbolic_value(
-    simple_reg *reg,
-    simple_reg **,
-    simple_instr *,
-    symbol_map &symbols
+/// assign a register file slot to a register; all registers start off with
+/// a symbolic value
+static unsigned resolve_reg(
+    interpreter_state &s,
+    setup_state &setup,
+    simple_reg *reg
 ) throw() {
-    if(0U == symbols.count(reg)) {
-        assert(0 != reg);
-        symbols[reg] = new symbolic_value(reg);
+    if(0 == reg) {
+        return NO_REG;
     }
-}
 
-/// try to set up the interpreter
-static bool setup_interpreter(interpreter_state &s) throw() {
-    bool ret(true);
-    for(simple_instr *in(s.pc); 0 != in; in = in->next) {
+    std::map<simple_reg *, unsigned>::iterator it(setup.slots.find(reg));
+    if(setup.slots.end() != it) {
+        return it->second;
+    }
 
-        // assign symbolic values to all registers
-        for_each_var_use(assign_symbolic_value, in, s.registers);
-        for_each_var_def(assign_symbolic_value, in, s.registers);
+    const unsigned slot(static_cast<unsigned>(s.registers.size()));
+    setup.slots[reg] = slot;
+    s.registers.push_back(make_symbol(reg));
+    s.slot_regs.push_back(reg);
+    return slot;
+}
 
-        switch(in->opcode) {
-        case LABEL_OP:
-            s.branch_targets[in->u.label.lab] = in->next;
-            continue;
+/// resolve a label to the index of the instruction following it; labels
+/// that aren't in the code go to the end of the code.
+static unsigned resolve_label(
+    interpreter_state &s,
+    setup_state &setup,
+    simple_sym *label
+) throw() {
+    std::map<simple_sym *, unsigned>::iterator it(setup.labels.find(label));
+    if(setup.labels.end() == it) {
+        return static_cast<unsigned>(s.code.size() - 1U);
+    }
+    return it->second;
+}
 
-        case CALL_OP: case LOAD_OP: case STR_OP: case MCPY_OP:
-            ret = false;
-            continue;
+/// is a type one that the fast paths of the interpreter compute with
+/// exactly, i.e. a 32 bit integer or a double?
+static bool is_native_type(const simple_type *type) throw() {
+    switch(type->base) {
+    case SIGNED_TYPE: case UNSIGNED_TYPE: return 32 == type->len;
+    case FLOAT_TYPE: return 64 == type->len;
+    default: return false;
+    }
+}
+
+/// choose the handler for a binary operator. Operators on native types get a
+/// type-specialized handler; everything else goes through the general one.
+static void decode_binary(resolved_instr &ri) throw() {
+    simple_instr *in(ri.in);
+    const simple_type *src1(in->u.base.src1->var->type);
+    const simple_type *src2(in->u.base.src2->var->type);
+    const simple_type *dst(ri.dst_reg->var->type);
+
+    ri.handler = H_BINARY;
+
+    if(!is_native_type(src1) || !is_native_type(dst)
+    || src1->base != src2->base || src1->len != src2->len) {
+        return;
+    }
+
+    // comparisons compute a 32 bit integer, everything else computes a value
+    // of the type of its operands
+    switch(in->opcode) {
+    case SEQ_OP: case SNE_OP: case SL_OP: case SLE_OP:
+        if(FLOAT_TYPE == dst->base) {
+            return;
+        }
+        break;
+    default:
+        if(src1->base != dst->base) {
+            return;
+        }
+        break;
+    }
+
+    switch(src1->base) {
+    case SIGNED_TYPE:
+#define X(name, functor, same) \
+        if(name ## _OP == in->opcode) ri.handler = H_ ## name ## _INT;
+        EVAL_INT_OPS(X)
+#undef X
+        break;
+
+    case UNSIGNED_TYPE:
+#define X(name, functor, same) \
+        if(name ## _OP == in->opcode) ri.handler = H_ ## name ## _UNSIGNED;
+        EVAL_INT_OPS(X)
+#undef X
+        break;
+
+    default:
+#define X(name, functor, same) \
+        if(name ## _OP == in->opcode) ri.handler = H_ ## name ## _FLOAT;
+        EVAL_FLOAT_OPS(X)
+#undef X
+        break;
+    }
+}
+
+/// decode the value loaded by an LDC
+static void decode_ldc(resolved_instr &ri) throw() {
+    simple_instr *in(ri.in);
+    simple_reg *dst_reg(in->u.ldc.dst);
+    simple_type *type(dst_reg->var->type);
+
+    switch(in->u.ldc.value.format) {
+    // narrow integers are truncated to the width of their register
+    case IMMED_INT: {
+        int val(in->u.ldc.value.u.ival);
+        if(fold::is_integral(type) && 32 > fold::int_bits(type)) {
+            val = static_cast<int>(fold::int_value(in->u.ldc.value, type));
+        }
+        if(SIGNED_TYPE == type->base) {
+            ri.constant = make_value(type, val);
+        } else {
+            ri.constant = make_value(type, static_cast<unsigned>(val));
+        }
+        break;
+    }
+
+    case IMMED_FLOAT:
+        ri.constant = make_value(type, in->u.ldc.value.u.fval);
+        break;
+
+    // the address of a symbol is fixed, but unknown; we can still emit it
+    // by loading the symbol's address
+    case IMMED_SYMBOL:
+        ri.constant = make_address(type,
+            in->u.ldc.value.u.s.symbol, in->u.ldc.value.u.s.offset);
+        break;
+
+    default:
+        ri.constant = make_big(make_symbol(dst_reg));
+        break;
+    }
+
+    ri.handler = H_LDC;
+}
+
+/// decode a call. calls to procedures that always return the same constant
+/// can be interpreted as loading that constant; everything else is unknown
+static bool decode_call(interpreter_state &s, resolved_instr &ri) throw() {
+    simple_instr *in(ri.in);
+    const procedure_summary *callee(s.summaries->find(in));
+
+    ri.handler = H_STOP;
+    if(0 == callee || !callee->is_constant()) {
+        return false;
+    } else if(0 == in->u.call.dst) {
+        ri.handler = H_NOP;
+        return true;
+    }
+
+    simple_type *type(in->u.call.dst->var->type);
+    const simple_immed &ret(callee->return_value);
+
+    switch(type->base) {
+    case SIGNED_TYPE:
+        if(IMMED_INT != ret.format) {
+            return true;
+        }
+        ri.constant = make_value(type, ret.u.ival);
+        break;
+    case UNSIGNED_TYPE:
+        if(IMMED_INT != ret.format) {
+            return true;
+        }
+        ri.constant = make_value(type, static_cast<unsigned>(ret.u.ival));
+        break;
+    case FLOAT_TYPE:
+        if(IMMED_FLOAT != ret.format) {
+            return true;
+        }
+        ri.constant = make_value(type, ret.u.fval);
+        break;
+    default:
+        return true;
+    }
+
+    ri.handler = H_LDC;
+    return true;
+}
+
+/// check if a loop can be summarized, and if so, make its head begin the
+/// summary.
+static void find_summarizable_loop(
+    interpreter_state &s,
+    setup_state &setup,
+    std::map<simple_instr *, unsigned> &index_of,
+    const loop &l
+) throw() {
+
+    // only innermost loops
+    if(!l.children.empty()) {
+        return;
+    }
+
+    simple_instr *label(l.head->first);
+    simple_instr *branch(l.head->last);
+    if(0 == label || LABEL_OP != label->opcode
+    || 0 == branch || (BTRUE_OP != branch->opcode && BFALSE_OP != branch->opcode)
+    || 0U == index_of.count(label) || 0U == index_of.count(branch)) {
+        return;
+    }
+
+    std::set<unsigned> defs;
+    basic_block *exit_bb(0);
+    unsigned num_exits(0U);
+
+    std::set<basic_block *>::const_iterator it(l.body.begin())
+                                          , end(l.body.end());
+    for(; it != end; ++it) {
+        basic_block *bb(*it);
+        if(0 == bb->first || 0 == bb->last) {
+            return;
+        }
+
+        // the loop can only leave through the branch in its head
+        const std::set<basic_block *> &succs(bb->successors());
+        std::set<basic_block *>::const_iterator succ_it(succs.begin())
+                                              , succ_end(succs.end());
+        for(; succ_it != succ_end; ++succ_it) {
+            if(0U == l.body.count(*succ_it)) {
+                exit_bb = *succ_it;
+                ++num_exits;
+                if(bb != l.head) {
+                    return;
+                }
+            }
+        }
+
+        for(simple_instr *in(bb->first), *after(bb->last->next);
+            in != after;
+            in = in->next) {
+
+            std::map<simple_instr *, unsigned>::iterator pos(index_of.find(in));
+            if(index_of.end() == pos) {
+                return;
+            }
+
+            const resolved_instr &ri(s.code[pos->second]);
+            switch(ri.handler) {
+            case H_END: case H_BREAK: case H_UNKNOWN: case H_STOP:
+            case H_RET: case H_MBR: case H_LOAD: case H_STR: case H_MCPY:
+                return;
+            default:
+                break;
+            }
+
+            if(0 != ri.dst_reg && PSEUDO_REG == ri.dst_reg->kind) {
+                defs.insert(ri.dst);
+            }
+        }
+    }
+
+    if(1U != num_exits) {
+        return;
+    }
+
+    loop_summary summary;
+    summary.head = index_of[label];
+    summary.exit_branch = index_of[branch];
+    summary.stay = NO_INSTR;
+    summary.exit_handler = s.code[summary.exit_branch].handler;
+    summary.stay_on_target = !(LABEL_OP == exit_bb->first->opcode
+        && branch->u.bj.target == exit_bb->first->u.label.lab);
+    summary.stay_if_true = (BTRUE_OP == branch->opcode) == summary.stay_on_target;
+    summary.failed = false;
+
+    std::set<unsigned>::iterator def_it(defs.begin()), def_end(defs.end());
+    for(; def_it != def_end; ++def_it) {
+        summary.defs.push_back(std::make_pair(
+            *def_it, s.registers[*def_it].value.reg));
+    }
+
+    // the head's label begins the summary; branches back to the head need to
+    // go to the label instead of after it
+    resolved_instr &head(s.code[summary.head]);
+    head.handler = H_LOOP_HEAD;
+    head.loop = static_cast<unsigned>(s.loops.size());
+    setup.labels[label->u.label.lab] = summary.head;
+
+    s.loops.push_back(summary);
+}
+
+/// try to set up the interpreter. This lowers the instruction list into an
+/// array of pre-decoded instructions so that the interpreter never needs to
+/// look anything up or re-decode an instruction. If loops are given, then
+/// the loops that can be summarized are found.
+static bool setup_interpreter(
+    interpreter_state &s,
+    simple_instr *first_instr,
+    simple_instr *break_point,
+    loop_map *loops
+) throw() {
+    setup_state setup;
+    std::map<simple_instr *, unsigned> index_of;
+    bool ret(true);
+
+    s.pc = 0U;
+    s.bp = NO_INSTR;
+
+    for(simple_instr *in(first_instr); 0 != in; in = in->next) {
+        const unsigned pc(static_cast<unsigned>(s.code.size()));
+
+        if(0 != loops) {
+            index_of[in] = pc;
+        }
+
+        resolved_instr ri;
+        ri.handler = H_UNKNOWN;
+        ri.in = in;
+        ri.dst_reg = 0;
+        ri.dst = ri.src1 = ri.src2 = NO_REG;
+        ri.target = ri.first_target = NO_INSTR;
+        ri.loop = NO_LOOP;
+
+        switch(in->opcode) {
+        case NOP_OP:
+            ri.handler = H_NOP;
+            break;
+
+        case LABEL_OP:
+            ri.handler = H_NOP;
+            setup.labels[in->u.label.lab] = pc + 1U;
+            break;
+
+        case JMP_OP:
+            ri.handler = H_JMP;
+            break;
+
+        case BTRUE_OP: case BFALSE_OP:
+            ri.handler = BTRUE_OP == in->opcode ? H_BTRUE : H_BFALSE;
+            ri.src1 = resolve_reg(s, setup, in->u.bj.src);
+            break;
+
+        case MBR_OP:
+            ri.handler = H_MBR;
+            ri.src1 = resolve_reg(s, setup, in->u.mbr.src);
+            break;
 
         case LDC_OP:
-            if(IMMED_SYMBOL == in->u.ldc.value.format) {
+            ri.dst_reg = in->u.ldc.dst;
+            ri.dst = resolve_reg(s, setup, ri.dst_reg);
+            decode_ldc(ri);
+            break;
+
+        case CALL_OP:
+            ri.dst_reg = in->u.call.dst;
+            ri.dst = resolve_reg(s, setup, ri.dst_reg);
+            if(!decode_call(s, ri)) {
                 ret = false;
             }
-            continue;
+            break;
+
         default:
-            continue;
+            ri.dst_reg = in->u.base.dst;
+            ri.dst = resolve_reg(s, setup, in->u.base.dst);
+            ri.src1 = resolve_reg(s, setup, in->u.base.src1);
+            ri.src2 = resolve_reg(s, setup, in->u.base.src2);
+
+            switch(in->opcode) {
+            case LOAD_OP: ri.handler = H_LOAD; break;
+            case STR_OP: ri.handler = H_STR; break;
+            case MCPY_OP: ri.handler = H_MCPY; break;
+            case RET_OP: ri.handler = H_RET; break;
+            case CPY_OP: ri.handler = H_CPY; break;
+            case NEG_OP: case NOT_OP: ri.handler = H_UNARY; break;
+
+            // convert a value of one type to another type
+            case CVT_OP:
+                switch(ri.dst_reg->var->type->base) {
+                case SIGNED_TYPE: case UNSIGNED_TYPE: case FLOAT_TYPE:
+                    ri.handler = H_UNARY;
+                    break;
+                case ADDRESS_TYPE: ri.handler = H_CVT_ADDRESS; break;
+                default: break;
+                }
+                break;
+
+            case ADD_OP: case SUB_OP: case MUL_OP: case DIV_OP: case REM_OP:
+            case MOD_OP: case AND_OP: case IOR_OP: case XOR_OP: case ASR_OP:
+            case LSL_OP: case LSR_OP: case ROT_OP: case SEQ_OP: case SNE_OP:
+            case SL_OP: case SLE_OP:
+                decode_binary(ri);
+                break;
+
+            default:
+                break;
+            }
+            break;
+        }
+
+        // stop the interpreter if we hit the breakpoint
+        if(in == break_point) {
+            s.bp = pc;
+            ri.handler = H_BREAK;
+        }
+
+        s.code.push_back(ri);
+    }
+
+    // add a sentinel instruction at the end of the code, so that running off
+    // the end of the code doesn't need to be checked for
+    resolved_instr end;
+    end.handler = H_END;
+    end.in = 0;
+    end.dst_reg = 0;
+    end.dst = end.src1 = end.src2 = NO_REG;
+    end.target = end.first_target = NO_INSTR;
+    end.loop = NO_LOOP;
+    s.code.push_back(end);
+
+    // find the loops that can be summarized; this needs to happen before
+    // branch targets are resolved, as it changes where the loop heads' labels
+    // go
+    if(0 != loops) {
+        const std::vector<loop *> &all_loops(loops->inner_to_outer());
+        for(unsigned i(0U); i < all_loops.size(); ++i) {
+            find_summarizable_loop(s, setup, index_of, *(all_loops[i]));
         }
     }
+
+    // running off the end of the code is the same as reaching a null
+    // breakpoint
+    if(0 == break_point) {
+        s.bp = static_cast<unsigned>(s.code.size() - 1U);
+    }
+
+    // resolve the branch targets now that all labels are known
+    for(unsigned pc(0U); pc < s.code.size() - 1U; ++pc) {
+        resolved_instr &ri(s.code[pc]);
+        simple_instr *in(ri.in);
+
+        switch(in->opcode) {
+        case JMP_OP: case BTRUE_OP: case BFALSE_OP:
+            ri.target = resolve_label(s, setup, in->u.bj.target);
+            break;
+
+        case MBR_OP:
+            ri.target = resolve_label(s, setup, in->u.mbr.deflab);
+            ri.first_target = static_cast<unsigned>(s.mbr_targets.size());
+            for(unsigned i(0U); i < in->u.mbr.ntargets; ++i) {
+                s.mbr_targets.push_back(
+                    resolve_label(s, setup, in->u.mbr.targets[i]));
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    for(unsigned i(0U); i < s.loops.size(); ++i) {
+        loop_summary &summary(s.loops[i]);
+        summary.stay = summary.stay_on_target
+            ? s.code[summary.exit_branch].target
+            : summary.exit_branch + 1U;
+    }
+
     return ret;
 }
 
-#define LOOKUP_ARGS \
-    src1 = s.registers[src1_reg]; \
-    src2 = s.registers[src2_reg]; \
-    dst = &(s.registers[dst_reg]);
+/// check if two abstract values are definitely the same value
+static bool is_same_value(const abstract_value &a, const abstract_value &b) throw() {
+    if(a.kind != b.kind) {
+        return false;
+    } else if(abstract_value::SYMBOL == a.kind
+           || abstract_value::LOOP_SYMBOL == a.kind) {
+        return a.value.reg == b.value.reg;
+    } else if(abstract_value::EXPRESSION == a.kind) {
+        return a.value.expr == b.value.expr;
+    } else if(abstract_value::ADDRESS == a.kind) {
+        return a.value.as_address.sym == b.value.as_address.sym
+            && a.value.as_address.offset == b.value.as_address.offset;
+    }
+    return false;
+}
 
-/// this is to limit crazy amounts of loop unrolling
+/// this is to limit crazy amounts of loop unrolling, and to make sure that
+/// partially evaluated code is worth keeping
 enum {
-    MAX_DEPTH = 300
+    MAX_DEPTH = 300,
+    MIN_RESIDUAL_GAIN = 4U
 };
 
-static bool assign(abstract_value **dst, abstract_value *src) throw(stop_interpreter) {
-    dec_ref(*dst);
-
-    if(MAX_DEPTH < src->depth) {
-        *dst = new big_value(src); // too deep of an expression; use a dummy
+static bool assign(abstract_value *dst, const abstract_value &src) throw(stop_interpreter) {
+    if(MAX_DEPTH < depth_of(src)) {
+        *dst = make_big(src); // too deep of an expression; use a dummy
     } else {
         *dst = src;
     }
@@ -634,328 +1394,1156 @@ static bool assign(abstract_value **dst, abstract_value *src) throw(stop_interpr
     return true;
 }
 
-/// attempt to interpret an instruction. interpretation will fail for one of a
-/// few reasons:
-///     1) a control branch depends on a symbolic value/expression
-//      2) there is a cyclic dependency in with some symbolic value, e.g. a new
-//         instance of a register depends on a previous instance, where the
-//         previous instance was symbolic
-//      3)
-static bool interpret_instruction(interpreter_state &s) throw(stop_interpreter) {
-    if(0 == s.pc) {
+/// access the concrete value of some type in an abstract value
+template <typename T>
+struct value_of;
+
+template <>
+struct value_of<int> {
+    static const abstract_value::type_kind TYPE = abstract_value::INT;
+    static int get(const abstract_value &val) throw() {
+        return val.value.as_int;
+    }
+};
+
+template <>
+struct value_of<unsigned> {
+    static const abstract_value::type_kind TYPE = abstract_value::UNSIGNED;
+    static unsigned get(const abstract_value &val) throw() {
+        return val.value.as_uint;
+    }
+};
+
+template <>
+struct value_of<double> {
+    static const abstract_value::type_kind TYPE = abstract_value::FLOAT;
+    static double get(const abstract_value &val) throw() {
+        return val.value.as_float;
+    }
+};
+
+/// make the result of a fast path operator, as a value of the type of the
+/// destination register
+static abstract_value make_result(simple_type *type, int r) throw() {
+    if(SIGNED_TYPE == type->base) {
+        return make_value(type, r);
+    }
+    return make_value(type, static_cast<unsigned>(r));
+}
+
+static abstract_value make_result(simple_type *type, unsigned r) throw() {
+    return make_result(type, static_cast<int>(r));
+}
+
+static abstract_value make_result(simple_type *type, double r) throw() {
+    return make_value(type, r);
+}
+
+/// execute a binary operator that has no fast path, or whose operands aren't
+/// concrete values of the expected type
+static bool execute_general_binary(
+    interpreter_state &s,
+    const resolved_instr &ri,
+    abstract_value *regs
+) throw() {
+    abstract_value ret;
+    if(!apply_binary(s.expressions, ri.in, ri.dst_reg,
+                     regs[ri.src1], regs[ri.src2], ret)) {
         return false;
     }
+    assign(&(regs[ri.dst]), ret);
+    return true;
+}
 
-    simple_instr *in(s.pc);
+/// execute a binary operator, specialized for operands of a particular type.
+/// The fast path handles two concrete values of the expected type; anything
+/// else goes through the general apply_binary.
+template <
+    template <typename T> class Functor,
+    typename T,
+    int SAME_VALUE
+>
+inline static bool execute_binary(
+    interpreter_state &s,
+    const resolved_instr &ri,
+    abstract_value *regs
+) throw() {
+    const abstract_value &a0(regs[ri.src1]);
+    const abstract_value &a1(regs[ri.src2]);
+
+    if(abstract_value::VALUE == a0.kind
+    && abstract_value::VALUE == a1.kind
+    && value_of<T>::TYPE == a0.type
+    && value_of<T>::TYPE == a1.type) {
+        regs[ri.dst] = make_result(ri.dst_reg->var->type, Functor<T>::apply(
+            value_of<T>::get(a0),
+            value_of<T>::get(a1)
+        ));
+        return true;
 
-    // stop the interpreter if we hit a breakpoint
-    if(in == s.bp) {
-        s.error = 0;
-        throw STOP_INTERPRETER;
+    // comparing a value against itself; not for floating point, because of
+    // NaN
+    } else if(0 <= SAME_VALUE
+           && abstract_value::FLOAT != value_of<T>::TYPE
+           && is_same_value(a0, a1)) {
+        regs[ri.dst] = make_result(ri.dst_reg->var->type, (int) SAME_VALUE);
+        return true;
     }
 
-    // common case: next instruction is the next pc
-    s.error = in;
-    s.pc = in->next;
+    return execute_general_binary(s, ri, regs);
+}
 
-    abstract_value *src1(0);
-    abstract_value *src2(0);
-    abstract_value **dst(0);
+/// execute a unary operator
+static bool execute_unary(
+    interpreter_state &s,
+    const resolved_instr &ri,
+    abstract_value *regs
+) throw() {
+    abstract_value ret;
+    if(!apply_unary(s.expressions, ri.in, ri.dst_reg, regs[ri.src1], ret)) {
+        return false;
+    }
+    assign(&(regs[ri.dst]), ret);
+    return true;
+}
 
-    // conveniences for the common case, unsafe for other cases, unless manually
-    // assigned to!
-    simple_reg *src1_reg(in->u.base.src1);
-    simple_reg *src2_reg(in->u.base.src2);
-    simple_reg *dst_reg(in->u.base.dst);
+/// the size, in bytes, of a value of some type; 0 if it isn't known
+static unsigned memory_size(const simple_type *type) throw() {
+    if(0 == type || 0 >= type->len || 0 != (type->len % 8)) {
+        return 0U;
+    }
+    return static_cast<unsigned>(type->len / 8);
+}
 
-    concrete_value *val(0);
+/// find the cell that exactly holds some bytes of memory
+static const memory_cell *read_memory(
+    const abstract_memory &memory,
+    const abstract_value &addr,
+    unsigned size
+) throw() {
+    if(abstract_value::ADDRESS != addr.kind || 0U == size) {
+        return 0;
+    }
 
-    switch(in->opcode) {
-    case NOP_OP: return true;
+    abstract_memory::const_iterator frame(
+        memory.find(addr.value.as_address.sym));
+    if(memory.end() == frame) {
+        return 0;
+    }
 
-    case RET_OP:
-        s.ret = in;
-        s.did_return = true;
-        s.error = 0;
-        if(0 != in->u.base.src1) {
-            s.return_val = s.registers[in->u.base.src1];
+    memory_frame::const_iterator cell(
+        frame->second.find(addr.value.as_address.offset));
+    if(frame->second.end() == cell || size != cell->second.size) {
+        return 0;
+    }
+
+    return &(cell->second);
+}
+
+/// write a cell into memory. This fails if the write would partially
+/// overwrite a cell already in memory, as the bytes left over would no
+/// longer be known.
+static bool write_memory(
+    abstract_memory &memory,
+    simple_sym *sym,
+    int offset,
+    const memory_cell &cell
+) throw() {
+    memory_frame &frame(memory[sym]);
+    const int end(offset + static_cast<int>(cell.size));
+
+    // find the first cell that could overlap the write
+    memory_frame::iterator first(frame.lower_bound(offset));
+    if(frame.begin() != first) {
+        memory_frame::iterator prev(first);
+        --prev;
+        if(offset < prev->first + static_cast<int>(prev->second.size)) {
+            return false;
         }
+    }
+
+    memory_frame::iterator last(first);
+    for(; frame.end() != last && last->first < end; ++last) {
+        if(end < last->first + static_cast<int>(last->second.size)) {
+            return false;
+        }
+    }
+
+    frame.erase(first, last);
+    frame[offset] = cell;
+    return true;
+}
+
+/// load a value from memory into a register; fails if the value isn't known,
+/// or if it can't be re-interpreted as a value of the register's type
+static bool execute_load(
+    interpreter_state &s,
+    const resolved_instr &ri,
+    abstract_value *regs
+) throw() {
+    simple_type *type(ri.dst_reg->var->type);
+    const memory_cell *cell(read_memory(
+        s.memory, regs[ri.src1], memory_size(type)));
+
+    if(0 == cell
+    || 0 == cell->value.reg_type
+    || (FLOAT_TYPE == type->base) != (FLOAT_TYPE == cell->value.reg_type->base)) {
         return false;
+    }
 
-    case STR_OP: assert(false); return false;
-    case MCPY_OP: assert(false); return false;
+    abstract_value val(cell->value);
+    if(abstract_value::VALUE == val.kind) {
+        if(SIGNED_TYPE == type->base) {
+            val.type = abstract_value::INT;
+        } else if(UNSIGNED_TYPE == type->base) {
+            val.type = abstract_value::UNSIGNED;
+        }
+    } else if(type->base != val.reg_type->base) {
+        return false;
+    }
 
-    // copy from one register into another; making sure to update ref counts
-    // accordingly
-    case CPY_OP:
-        if(src1_reg == dst_reg) {
-            return true;
+    val.reg_type = type;
+    regs[ri.dst] = val;
+    return true;
+}
 
-        // load src first, just in case src and *dst are the same
-        } else {
-            src1 = inc_ref(s.registers[src1_reg]);
+/// store the value of a register into memory
+static bool execute_store(
+    interpreter_state &s,
+    const resolved_instr &ri,
+    abstract_value *regs
+) throw() {
+    const abstract_value &addr(regs[ri.src1]);
+
+    memory_cell cell;
+    cell.size = memory_size(ri.in->u.base.src2->var->type);
+    cell.store = ri.in;
+    cell.value = regs[ri.src2];
+
+    return abstract_value::ADDRESS == addr.kind
+        && 0U != cell.size
+        && write_memory(s.memory, addr.value.as_address.sym,
+                        addr.value.as_address.offset, cell);
+}
+
+/// copy a block of memory; every byte of the source must be known
+static bool execute_copy(
+    interpreter_state &s,
+    const resolved_instr &ri,
+    abstract_value *regs
+) throw() {
+    const abstract_value &dst(regs[ri.src1]);
+    const abstract_value &src(regs[ri.src2]);
+    const unsigned size(memory_size(ri.in->type));
+
+    if(abstract_value::ADDRESS != dst.kind
+    || abstract_value::ADDRESS != src.kind
+    || 0U == size) {
+        return false;
+    }
+
+    memory_frame &frame(s.memory[src.value.as_address.sym]);
+    const int begin(src.value.as_address.offset);
+    const int end(begin + static_cast<int>(size));
+    int next(begin);
+
+    // the cells of the source must exactly cover the copied bytes; copy them
+    // out first, in case the source and destination overlap
+    std::vector<std::pair<int, memory_cell> > cells;
+    memory_frame::iterator it(frame.lower_bound(begin));
+    for(; frame.end() != it && it->first < end; ++it) {
+        if(next != it->first) {
+            return false;
+        }
+        next += static_cast<int>(it->second.size);
+        cells.push_back(*it);
+    }
+
+    if(end != next) {
+        return false;
+    }
+
+    // write into a copy of the destination, so that nothing is changed if
+    // the copy fails
+    memory_frame dst_frame(s.memory[dst.value.as_address.sym]);
+    abstract_memory dst_memory;
+    dst_memory[dst.value.as_address.sym].swap(dst_frame);
+
+    for(unsigned i(0U); i < cells.size(); ++i) {
+        if(!write_memory(dst_memory, dst.value.as_address.sym,
+            dst.value.as_address.offset + (cells[i].first - begin),
+            cells[i].second)) {
+            return false;
+        }
+    }
+
+    s.memory[dst.value.as_address.sym].swap(
+        dst_memory[dst.value.as_address.sym]);
+    return true;
+}
+
+/// the number of milliseconds since the interpreter started
+static unsigned elapsed_ms(const interpreter_budget &budget) throw() {
+    struct timeval now;
+    gettimeofday(&now, 0);
+    return static_cast<unsigned>(
+        (now.tv_sec - budget.start.tv_sec) * 1000L
+      + (now.tv_usec - budget.start.tv_usec) / 1000L);
+}
+
+/// start a new slice of instructions, making sure that the interpreter is
+/// still within its budget. If it isn't, then interpretation stops at the
+/// instruction at pc.
+static unsigned refuel(interpreter_state &s, unsigned pc) throw(stop_interpreter) {
+    interpreter_budget &budget(s.budget);
+    const char *limit(0);
+
+    budget.steps += budget.slice;
+
+    if(budget.max_steps <= budget.steps) {
+        limit = "eval.budget.steps";
+    } else if(budget.max_values < s.expressions.size()) {
+        limit = "eval.budget.values";
+    } else if(0U != budget.max_ms && budget.max_ms < elapsed_ms(budget)) {
+        limit = "eval.budget.time";
+    }
+
+    if(0 != limit) {
+        stats::count(limit);
+        budget.slice = budget.fuel = 0U;
+        s.out_of_budget = true;
+        s.error = &(s.code[pc]);
+        s.pc = pc;
+        throw STOP_INTERPRETER;
+    }
+
+    budget.slice = budget.max_steps - budget.steps;
+    if(interpreter_budget::SLICE < budget.slice) {
+        budget.slice = interpreter_budget::SLICE;
+    }
+    return budget.slice;
+}
+
+static void summarize_loop(interpreter_state &s, unsigned id) throw(stop_interpreter);
+
+/// execute the pre-decoded code, starting at the current program counter.
+/// This returns when the code returns or runs off its end, and throws
+/// STOP_INTERPRETER when an instruction can't be interpreted (s.error is the
+/// instruction), the breakpoint is reached (s.error is null), or the
+/// interpreter runs out of budget (s.out_of_budget is true).
+///
+/// interpretation will fail for one of a few reasons:
+///     1) a control branch depends on a symbolic value/expression
+///     2) the instruction touches memory or calls an unknown procedure
+///
+/// when a summarizable loop is reached, the loop is summarized, and if that
+/// works, then interpretation continues with the values the loop's registers
+/// have when the loop exits.
+static void run_interpreter(interpreter_state &s) throw(stop_interpreter) {
+    const resolved_instr *code(&(s.code[0]));
+    abstract_value *regs(s.registers.empty() ? 0 : &(s.registers[0]));
+    const abstract_value *src1(0);
+    unsigned pc(s.pc);
+    unsigned &fuel(s.budget.fuel);
+
+#if EVAL_THREADED_CODE
+    static void *const HANDLERS[] = {
+#   define X(handler) &&L_ ## handler,
+        EVAL_HANDLERS(X)
+#   undef X
+    };
+#   define HANDLER(handler) case handler: L_ ## handler
+#   define DISPATCH goto *HANDLERS[code[pc].handler]
+#else
+#   define HANDLER(handler) case handler
+#   define DISPATCH continue
+#endif
+
+/// go to the next instruction, checking the budget every so often
+#define NEXT \
+    if(0U == --fuel) { \
+        fuel = refuel(s, pc); \
+    } \
+    DISPATCH
+
+/// stop interpreting at the current instruction; the program counter is left
+/// after the instruction
+#define STOP \
+    s.error = &(code[pc]); \
+    s.pc = pc + 1U; \
+    throw STOP_INTERPRETER;
+
+    for(;;) {
+        const resolved_instr *ri(&(code[pc]));
+        switch(ri->handler) {
+
+        // we've run off the end of the code
+        HANDLER(H_END):
+            s.error = 0;
+            s.pc = pc;
+            return;
+
+        // stop the interpreter if we hit a breakpoint
+        HANDLER(H_BREAK):
+            s.error = 0;
+            s.pc = pc;
+            throw STOP_INTERPRETER;
+
+        HANDLER(H_UNKNOWN):
+            s.error = &(code[pc]);
+            s.pc = pc + 1U;
+            return;
+
+        HANDLER(H_STOP):
+            STOP
+
+        HANDLER(H_NOP):
+            ++pc;
+            NEXT;
+
+        HANDLER(H_RET):
+            ri = &(code[pc]);
+            s.ret = ri->in;
+            s.did_return = true;
+            s.error = 0;
+            s.pc = pc + 1U;
+            if(NO_REG != ri->src1) {
+                s.return_val = regs[ri->src1];
+            }
+            return;
+
+        // copy from one register into another
+        HANDLER(H_CPY):
+            ri = &(code[pc++]);
+            regs[ri->dst] = regs[ri->src1];
+            NEXT;
+
+        // load a pre-decoded constant
+        HANDLER(H_LDC):
+            ri = &(code[pc++]);
+            regs[ri->dst] = ri->constant;
+            NEXT;
+
+        // unary operators, including conversions between numeric types
+        HANDLER(H_UNARY):
+            if(!execute_unary(s, code[pc], regs)) {
+                STOP
+            }
+            ++pc;
+            NEXT;
+
+        // binary operators without fast paths
+        HANDLER(H_BINARY):
+            if(!execute_general_binary(s, code[pc], regs)) {
+                STOP
+            }
+            ++pc;
+            NEXT;
+
+        // pointers of one type can be converted to pointers of another type
+        HANDLER(H_CVT_ADDRESS):
+            ri = &(code[pc++]);
+            if(abstract_value::ADDRESS == regs[ri->src1].kind) {
+                regs[ri->dst] = regs[ri->src1];
+                regs[ri->dst].reg_type = ri->dst_reg->var->type;
+            } else {
+                assign(&(regs[ri->dst]), make_expression(
+                    s.expressions, ri->in, ri->dst_reg->var->type,
+                    regs[ri->src1], 0));
+            }
+            NEXT;
+
+        HANDLER(H_JMP):
+            pc = code[pc].target;
+            NEXT;
+
+        HANDLER(H_BTRUE):
+            ri = &(code[pc]);
+            src1 = &(regs[ri->src1]);
+            if(abstract_value::VALUE != src1->kind) {
+                STOP
+            }
+            pc = (1 == src1->value.as_int) ? ri->target : pc + 1U;
+            NEXT;
+
+        HANDLER(H_BFALSE):
+            ri = &(code[pc]);
+            src1 = &(regs[ri->src1]);
+            if(abstract_value::VALUE != src1->kind) {
+                STOP
+            }
+            pc = (1 != src1->value.as_int) ? ri->target : pc + 1U;
+            NEXT;
+
+        // multi-way branch
+        HANDLER(H_MBR): {
+            ri = &(code[pc]);
+            src1 = &(regs[ri->src1]);
+            if(abstract_value::VALUE != src1->kind) {
+                STOP
+            }
+
+            int result(src1->value.as_int);
+            result -= ri->in->u.mbr.offset;
+
+            if(result < 0 || static_cast<int>(ri->in->u.mbr.ntargets) <= result) {
+                pc = ri->target;
+            } else {
+                pc = s.mbr_targets[ri->first_target + result];
+            }
+            NEXT;
+        }
+
+        // memory accesses; these stop if the memory being accessed isn't known
+        HANDLER(H_LOAD):
+            if(!execute_load(s, code[pc], regs)) {
+                STOP
+            }
+            ++pc;
+            NEXT;
+
+        HANDLER(H_STR):
+            if(!execute_store(s, code[pc], regs)) {
+                STOP
+            }
+            ++pc;
+            NEXT;
+
+        HANDLER(H_MCPY):
+            if(!execute_copy(s, code[pc], regs)) {
+                STOP
+            }
+            ++pc;
+            NEXT;
+
+        // the head of a loop; either we've finished one iteration of the loop
+        // being summarized, or we need to try to summarize the loop
+        HANDLER(H_LOOP_HEAD):
+            ri = &(code[pc]);
+            if(NO_LOOP != s.summarizing) {
+                s.iteration_done = ri->loop == s.summarizing;
+                s.error = 0;
+                s.pc = pc;
+                throw STOP_INTERPRETER;
+            }
+            if(!s.loops[ri->loop].failed) {
+                s.pc = pc;
+                summarize_loop(s, ri->loop);
+            }
+            ++pc;
+            NEXT;
+
+        // the branch leaving a loop that is being summarized; remember the
+        // condition and stay in the loop
+        HANDLER(H_LOOP_EXIT):
+            ri = &(code[pc]);
+            s.loop_condition = regs[ri->src1];
+            pc = s.loops[s.summarizing].stay;
+            NEXT;
+
+#define X(name, functor, same) \
+        HANDLER(H_ ## name ## _INT): \
+            if(!execute_binary<functor, int, same>(s, code[pc], regs)) { \
+                STOP \
+            } \
+            ++pc; \
+            NEXT; \
+        HANDLER(H_ ## name ## _UNSIGNED): \
+            if(!execute_binary<functor, unsigned, same>(s, code[pc], regs)) { \
+                STOP \
+            } \
+            ++pc; \
+            NEXT;
+        EVAL_INT_OPS(X)
+#undef X
+
+#define X(name, functor, same) \
+        HANDLER(H_ ## name ## _FLOAT): \
+            if(!execute_binary<functor, double, same>(s, code[pc], regs)) { \
+                STOP \
+            } \
+            ++pc; \
+            NEXT;
+        EVAL_FLOAT_OPS(X)
+#undef X
+
+        default:
+            s.error = &(code[pc]);
+            s.pc = pc + 1U;
+            return;
+        }
+    }
+
+#undef STOP
+#undef NEXT
+#undef DISPATCH
+#undef HANDLER
+}
+
+/// a linear combination of the values that registers have at the start of a
+/// loop iteration, plus a constant. Arithmetic wraps around, like it does on
+/// the (32-bit) machine.
+struct affine_form {
+public:
+    uint32_t constant;
+    std::map<simple_reg *, uint32_t> coeffs;
+};
+
+/// the value of an induction variable at the start of the first iteration of
+/// a loop, and how much it changes by in each iteration
+struct induction_var {
+public:
+    uint32_t initial;
+    uint32_t step;
+};
+
+typedef std::map<simple_reg *, induction_var> induction_map;
+
+/// loops are summarized with 32 bit arithmetic
+static bool is_integer_type(const simple_type *type) throw() {
+    return 0 != type
+        && 32 == type->len
+        && (SIGNED_TYPE == type->base || UNSIGNED_TYPE == type->base);
+}
+
+/// is a value a concrete integer?
+static bool is_integer_value(const abstract_value &val) throw() {
+    return abstract_value::VALUE == val.kind
+        && abstract_value::FLOAT != val.type
+        && is_integer_type(val.reg_type);
+}
+
+/// does a value depend on the values of registers at the start of a loop
+/// iteration? Big values are unknown, so they might.
+static bool has_loop_symbol(const abstract_value &val) throw() {
+    switch(val.kind) {
+    case abstract_value::LOOP_SYMBOL: case abstract_value::BIG_VALUE:
+        return true;
+    case abstract_value::EXPRESSION:
+        return has_loop_symbol(val.value.expr->left)
+            || (symbolic_expression::BINARY == val.value.expr->arity
+                && has_loop_symbol(val.value.expr->right));
+    default:
+        return false;
+    }
+}
+
+/// add a scaled affine form to another one
+static void add_form(affine_form &a, const affine_form &b, uint32_t scale) throw() {
+    a.constant += scale * b.constant;
+
+    std::map<simple_reg *, uint32_t>::const_iterator it(b.coeffs.begin())
+                                                   , end(b.coeffs.end());
+    for(; it != end; ++it) {
+        uint32_t &coeff(a.coeffs[it->first]);
+        coeff += scale * it->second;
+        if(0U == coeff) {
+            a.coeffs.erase(it->first);
+        }
+    }
+}
 
-            dst = &(s.registers[dst_reg]);
-            dec_ref(*dst);
+/// try to represent an abstract value as an affine form
+static bool make_affine(const abstract_value &val, affine_form &form) throw() {
+    form.constant = 0U;
+    form.coeffs.clear();
 
-            *dst = src1;
+    if(abstract_value::VALUE == val.kind) {
+        if(abstract_value::FLOAT == val.type) {
+            return false;
         }
+        form.constant = val.value.as_uint;
         return true;
 
-    // convert a value of one type to another type
-    case CVT_OP:
+    } else if(abstract_value::LOOP_SYMBOL == val.kind) {
+        if(!is_integer_type(val.reg_type)) {
+            return false;
+        }
+        form.coeffs[val.value.reg] = 1U;
+        return true;
 
-        src1 = s.registers[src1_reg];
-        dst = &(s.registers[dst_reg]);
+    } else if(abstract_value::EXPRESSION != val.kind
+           || !is_integer_type(val.reg_type)) {
+        return false;
+    }
+
+    const symbolic_expression *expr(val.value.expr);
+    affine_form left;
+    affine_form right;
+
+    if(!make_affine(expr->left, left)
+    || (symbolic_expression::BINARY == expr->arity
+        && !make_affine(expr->right, right))) {
+        return false;
+    }
+
+    switch(expr->instr->opcode) {
+    case ADD_OP:
+        add_form(form, left, 1U);
+        add_form(form, right, 1U);
+        return true;
+
+    case SUB_OP:
+        add_form(form, left, 1U);
+        add_form(form, right, ~0U);
+        return true;
+
+    case NEG_OP:
+        add_form(form, left, ~0U);
+        return true;
+
+    // converting between signed and unsigned doesn't change any bits
+    case CVT_OP:
+        add_form(form, left, 1U);
+        return true;
 
-        switch(dst_reg->var->type->base) {
-        case SIGNED_TYPE:
-            return assign(dst, apply_unary<cast_to_int>(in, dst_reg, src1));
+    case MUL_OP:
+        if(left.coeffs.empty()) {
+            add_form(form, right, left.constant);
+        } else if(right.coeffs.empty()) {
+            add_form(form, left, right.constant);
+        } else {
+            return false;
+        }
+        return true;
 
-        case UNSIGNED_TYPE:
-            return assign(dst, apply_unary<cast_to_unsigned>(in, dst_reg, src1));
+    case LSL_OP:
+        if(!right.coeffs.empty() || 32U <= right.constant) {
+            return false;
+        }
+        add_form(form, left, 1U << right.constant);
+        return true;
 
-        case FLOAT_TYPE:
-            return assign(dst, apply_unary<cast_to_double>(in, dst_reg, src1));
+    default:
+        return false;
+    }
+}
 
-        default: // abort
-            assert(false);
+/// evaluate an affine form of induction variables at the start of the first
+/// iteration, and find how much it changes by in each iteration
+static bool evaluate_form(
+    const affine_form &form,
+    const induction_map &ivs,
+    uint32_t &initial,
+    uint32_t &step
+) throw() {
+    initial = form.constant;
+    step = 0U;
+
+    std::map<simple_reg *, uint32_t>::const_iterator it(form.coeffs.begin())
+                                                   , end(form.coeffs.end());
+    for(; it != end; ++it) {
+        induction_map::const_iterator iv(ivs.find(it->first));
+        if(ivs.end() == iv) {
             return false;
         }
+        initial += it->second * iv->second.initial;
+        step += it->second * iv->second.step;
+    }
+
+    return true;
+}
+
+/// the most iterations that a summarized loop can have
+const static int64_t MAX_TRIP_COUNT(0x80000000LL);
+
+/// find the number of times that a loop iterates, i.e. the first iteration
+/// where the exit condition is met. The exit condition must compare two affine
+/// forms of induction variables.
+static bool find_trip_count(
+    const loop_summary &summary,
+    const abstract_value &cond,
+    const induction_map &ivs,
+    uint32_t &trip_count
+) throw() {
+    if(abstract_value::EXPRESSION != cond.kind
+    || symbolic_expression::BINARY != cond.value.expr->arity) {
+        return false;
+    }
+
+    const symbolic_expression *expr(cond.value.expr);
+    simple_instr *in(expr->instr);
+    if(!is_integer_type(in->u.base.src1->var->type)) {
+        return false;
+    }
+
+    affine_form left;
+    affine_form right;
+    uint32_t left_initial(0U), left_step(0U);
+    uint32_t right_initial(0U), right_step(0U);
+
+    if(!make_affine(expr->left, left)
+    || !make_affine(expr->right, right)
+    || !evaluate_form(left, ivs, left_initial, left_step)
+    || !evaluate_form(right, ivs, right_initial, right_step)) {
+        return false;
+    }
+
+    // the values being compared, without wrapping around
+    const bool is_signed(SIGNED_TYPE == in->u.base.src1->var->type->base);
+    const int64_t l0(is_signed
+        ? static_cast<int64_t>(static_cast<int32_t>(left_initial))
+        : static_cast<int64_t>(left_initial));
+    const int64_t r0(is_signed
+        ? static_cast<int64_t>(static_cast<int32_t>(right_initial))
+        : static_cast<int64_t>(right_initial));
+    const int64_t dl(static_cast<int32_t>(left_step));
+    const int64_t dr(static_cast<int32_t>(right_step));
+
+    // the loop continues while (e0 + k * de) relates to zero
+    enum {
+        LT, LE, EQ, NE
+    } relation;
+    bool negate(false);
 
+    switch(in->opcode) {
+    case SL_OP:
+        relation = summary.stay_if_true ? LT : LE;
+        negate = !summary.stay_if_true;
+        break;
+    case SLE_OP:
+        relation = summary.stay_if_true ? LE : LT;
+        negate = !summary.stay_if_true;
+        break;
+    case SEQ_OP:
+        relation = summary.stay_if_true ? EQ : NE;
+        break;
+    case SNE_OP:
+        relation = summary.stay_if_true ? NE : EQ;
         break;
+    default:
+        return false;
+    }
+
+    const int64_t e0(negate ? r0 - l0 : l0 - r0);
+    const int64_t de(negate ? dr - dl : dl - dr);
+    int64_t k(0);
+
+    switch(relation) {
+    case LT:
+        if(0 > e0) {
+            if(0 >= de) {
+                return false;
+            }
+            k = (-e0 + de - 1) / de;
+        }
+        break;
+    case LE:
+        if(0 >= e0) {
+            if(0 >= de) {
+                return false;
+            }
+            k = -e0 / de + 1;
+        }
+        break;
+    case EQ:
+        if(0 == e0) {
+            if(0 == de) {
+                return false;
+            }
+            k = 1;
+        }
+        break;
+    case NE:
+        if(0 != e0) {
+            if(0 == de || 0 != (-e0 % de) || 0 >= -e0 / de) {
+                return false;
+            }
+            k = -e0 / de;
+        }
+        break;
+    }
+
+    if(MAX_TRIP_COUNT < k) {
+        return false;
+    }
 
-    case NEG_OP: LOOKUP_ARGS
-        return assign(dst, apply_unary<op::negate>(in, dst_reg, src1));
+    // make sure that neither value wraps around before the loop exits; the
+    // values change linearly, so it's enough to check the last one
+    const int64_t lk(l0 + k * dl);
+    const int64_t rk(r0 + k * dr);
+    const int64_t min_val(is_signed ? -0x80000000LL : 0LL);
+    const int64_t max_val(is_signed ? 0x7FFFFFFFLL : 0xFFFFFFFFLL);
+    if(lk < min_val || max_val < lk || rk < min_val || max_val < rk) {
+        return false;
+    }
 
-    case NOT_OP: LOOKUP_ARGS
-        return assign(dst, apply_unary<op::bitwise_not>(in, dst_reg, src1));
+    trip_count = static_cast<uint32_t>(k);
+    return true;
+}
+
+/// make a concrete integer value for a register
+static abstract_value make_integer(simple_reg *reg, uint32_t val) throw() {
+    simple_type *type(reg->var->type);
+    if(SIGNED_TYPE == type->base) {
+        return make_value(type, static_cast<int>(val));
+    }
+    return make_value(type, static_cast<unsigned>(val));
+}
 
-    case LOAD_OP: assert(false);  return false;
+/// compute the values of the registers defined in a loop when the loop exits,
+/// given their values at the start and after one symbolic iteration of the
+/// loop. Registers must either not depend on the values at the start of the
+/// iteration, or be affine recurrences:
+///
+///     r' = r + c                  (induction variables)
+///     r' = r + a + b * i + ...    (accumulators of induction variables)
+///     r' = a + b * i + ...        (functions of induction variables)
+static bool summarize_values(
+    interpreter_state &s,
+    const loop_summary &summary,
+    const std::vector<abstract_value> &initial,
+    const std::vector<abstract_value> &next,
+    std::vector<abstract_value> &final
+) throw() {
+    const unsigned num_defs(static_cast<unsigned>(summary.defs.size()));
+    std::vector<affine_form> forms(num_defs);
+    std::vector<bool> is_affine(num_defs, false);
+    induction_map ivs;
 
-    case ADD_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::add>(in, dst_reg, src1, src2));
+    // find the induction variables
+    for(unsigned i(0U); i < num_defs; ++i) {
+        const unsigned slot(summary.defs[i].first);
+        simple_reg *reg(summary.defs[i].second);
 
-    case SUB_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::subtract>(in, dst_reg, src1, src2));
+        if(!has_loop_symbol(next[i]) || !make_affine(next[i], forms[i])) {
+            continue;
+        }
 
-    case MUL_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::multiply>(in, dst_reg, src1, src2));
+        is_affine[i] = true;
 
-    case DIV_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::divide>(in, dst_reg, src1, src2));
+        if(1U == forms[i].coeffs.size()
+        && 0U != forms[i].coeffs.count(reg)
+        && 1U == forms[i].coeffs[reg]
+        && is_integer_value(initial[slot])) {
+            induction_var &iv(ivs[reg]);
+            iv.initial = initial[slot].value.as_uint;
+            iv.step = forms[i].constant;
+        }
+    }
 
-    case REM_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::modulo>(in, dst_reg, src1, src2));
+    uint32_t trip_count(0U);
+    if(!find_trip_count(summary, s.loop_condition, ivs, trip_count)) {
+        return false;
+    }
+
+    final.clear();
+    if(0U == trip_count) {
+        return true;
+    }
+
+    const uint32_t k(trip_count);
+    const uint32_t triangle(static_cast<uint32_t>(
+        (static_cast<uint64_t>(k) * (k - 1U)) / 2U));
+
+    for(unsigned i(0U); i < num_defs; ++i) {
+        const unsigned slot(summary.defs[i].first);
+        simple_reg *reg(summary.defs[i].second);
+
+        // the register isn't changed by the loop
+        if(abstract_value::LOOP_SYMBOL == next[i].kind
+        && reg == next[i].value.reg) {
+            final.push_back(initial[slot]);
+            continue;
+
+        // the register gets the same value in every iteration
+        } else if(!has_loop_symbol(next[i])) {
+            final.push_back(next[i]);
+            continue;
+
+        } else if(!is_affine[i] || !is_integer_type(reg->var->type)) {
+            return false;
+        }
 
-    case MOD_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<suif_mod>(in, dst_reg, src1, src2));
+        affine_form form(forms[i]);
+        uint32_t self(0U);
+        if(0U != form.coeffs.count(reg)) {
+            self = form.coeffs[reg];
+            form.coeffs.erase(reg);
+        }
 
-    case AND_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::bitwise_and>(in, dst_reg, src1, src2));
+        uint32_t a0(0U), step(0U);
+        if(!evaluate_form(form, ivs, a0, step)) {
+            return false;
+        }
 
-    case IOR_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::bitwise_or>(in, dst_reg, src1, src2));
+        // r_k = a_(k-1), where a_j = a0 + j * step
+        if(0U == self) {
+            final.push_back(make_integer(reg, a0 + (k - 1U) * step));
 
-    case XOR_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::bitwise_xor>(in, dst_reg, src1, src2));
+        // r_k = r_0 + sum_(j < k) a_j
+        } else if(1U == self && is_integer_value(initial[slot])) {
+            final.push_back(make_integer(reg,
+                initial[slot].value.as_uint + k * a0 + triangle * step));
 
-    case ASR_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<suif_asr>(in, dst_reg, src1, src2));
+        } else {
+            return false;
+        }
+    }
 
-    case LSL_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<suif_lsl>(in, dst_reg, src1, src2));
+    return true;
+}
 
-    case LSR_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<suif_lsr>(in, dst_reg, src1, src2));
+/// try to summarize a loop by interpreting one iteration of it symbolically,
+/// and then solving for the values that its registers have when it exits.
+/// If this works, then the registers are updated with their final values,
+/// and interpretation can continue at the head of the loop, where the loop
+/// will exit.
+static void summarize_loop(interpreter_state &s, unsigned id) throw(stop_interpreter) {
+    loop_summary &summary(s.loops[id]);
+    const unsigned pc(s.pc);
+    const std::vector<abstract_value> initial(s.registers);
+
+    for(unsigned i(0U); i < summary.defs.size(); ++i) {
+        s.registers[summary.defs[i].first] = make_loop_symbol(
+            summary.defs[i].second);
+    }
 
-    case ROT_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<suif_rot>(in, dst_reg, src1, src2));
+    s.code[summary.exit_branch].handler = H_LOOP_EXIT;
+    s.summarizing = id;
+    s.iteration_done = false;
+    s.loop_condition.kind = abstract_value::BIG_VALUE;
+    s.pc = summary.head + 1U;
 
-    case SEQ_OP: LOOKUP_ARGS
-        if(src1 == src2) {
-            return assign(dst, new concrete_value(in, (int) 1));
-        }
-        return assign(dst, apply_binary<op::equal>(in, dst_reg, src1, src2));
+    try {
+        run_interpreter(s);
+    } catch(stop_interpreter &) { }
 
-    case SNE_OP: LOOKUP_ARGS
-        return assign(dst, apply_binary<op::not_equal>(in, dst_reg, src1, src2));
+    s.code[summary.exit_branch].handler = summary.exit_handler;
+    s.summarizing = NO_LOOP;
 
-    case SL_OP: LOOKUP_ARGS
-        if(src1 == src2) {
-            return assign(dst, new concrete_value(in, (int) 0));
-        }
-        return assign(dst, apply_binary<op::less_than>(in, dst_reg, src1, src2));
+    if(s.out_of_budget) {
+        throw STOP_INTERPRETER;
+    }
 
-    case SLE_OP: LOOKUP_ARGS
-        if(src1 == src2) {
-            return assign(dst, new concrete_value(in, (int) 1));
-        }
-        return assign(dst, apply_binary<op::less_than_equal>(in, dst_reg, src1, src2));
+    std::vector<abstract_value> next;
+    std::vector<abstract_value> final;
+    for(unsigned i(0U); i < summary.defs.size(); ++i) {
+        next.push_back(s.registers[summary.defs[i].first]);
+    }
 
-    case JMP_OP:
-        s.pc = s.branch_targets[in->u.label.lab];
-        return true;
+    std::copy(initial.begin(), initial.end(), s.registers.begin());
+    s.error = 0;
+    s.pc = pc;
 
-    case BTRUE_OP:
-        src1 = s.registers[in->u.bj.src];
-        if(abstract_value::VALUE != src1->kind) {
-            throw STOP_INTERPRETER;
-        }
+    if(!s.iteration_done
+    || !summarize_values(s, summary, initial, next, final)) {
+        summary.failed = true;
+        stats::count("eval.loop.failed");
+        return;
+    }
 
-        val = unsafe_cast<concrete_value *>(src1);
-        if(1 == val->value.as_int) {
-            s.pc = s.branch_targets[in->u.bj.target];
-        }
-        return true;
+    for(unsigned i(0U); i < final.size(); ++i) {
+        s.registers[summary.defs[i].first] = final[i];
+    }
 
-    case BFALSE_OP:
-        src1 = s.registers[in->u.bj.src];
-        if(abstract_value::VALUE != src1->kind) {
-            throw STOP_INTERPRETER;
-        }
+    if(!final.empty()) {
+        stats::count("eval.loop.summarized");
+    }
+}
 
-        val = unsafe_cast<concrete_value *>(src1);
-        if(1 != val->value.as_int) {
-            s.pc = s.branch_targets[in->u.bj.target];
-        }
-        return true;
+/// where a path through the partially evaluated code goes back to the
+/// original code
+struct resume_point {
+public:
 
-    // create a concrete value :D note: this does not use the normal assign
-    // as abstract_values initialize with refcount=1
-    case LDC_OP:
-        dst = &(s.registers[in->u.ldc.dst]);
-        dec_ref(*dst);
+    /// the instruction to resume at, and the label before it
+    simple_instr *at;
+    simple_sym *label;
+    bool needs_label;
 
-        switch(in->u.ldc.value.format) {
-        case IMMED_INT:
-            if(SIGNED_TYPE == in->u.ldc.dst->var->type->base) {
-                *dst = new concrete_value(in, in->u.ldc.value.u.ival);
-            } else {
-                *dst = new concrete_value(in,
-                    static_cast<unsigned>(in->u.ldc.value.u.ival)
-                );
-            }
-            return true;
-        case IMMED_FLOAT:
-            *dst = new concrete_value(in, in->u.ldc.value.u.fval);
-            return true;
-        default:
-            assert(false);
-            return false;
-        }
-        break;
+    /// temporary registers that are live across the resume point, i.e.
+    /// defined before it and used after it in the same basic block
+    std::vector<simple_reg *> temps;
+};
 
-    case CALL_OP: assert(false);  return false;
+/// state of the residual code emitter. Code is emitted in a chain that ends
+/// at last.
+struct emitter {
+public:
+    simple_instr *last;
 
-    // multi-way branch
-    case MBR_OP: {
-        src1 = s.registers[in->u.mbr.src];
-        if(abstract_value::VALUE != src1->kind) {
-            throw STOP_INTERPRETER;
-        } else {
-            val = unsafe_cast<concrete_value *>(src1);
+    /// expressions that have been emitted into a register, so that the
+    /// registers can be forgotten when a path is done
+    std::vector<symbolic_expression *> emitted;
 
-            int result(val->value.as_int);
-            result -= in->u.mbr.offset;
+    /// where paths go back to the original code, indexed by the position
+    /// of the instruction in the interpreter's code
+    std::map<unsigned, resume_point> resume_points;
 
-            if(result < 0 || in->u.mbr.ntargets < result) {
-                s.pc = s.branch_targets[in->u.mbr.deflab];
-            } else {
-                s.pc = s.branch_targets[in->u.mbr.targets[result]];
-            }
-        }
+    /// the pseudo registers that replace temporary registers that are live
+    /// across resume points
+    std::map<simple_reg *, simple_reg *> pseudos;
 
-        return true;
-    }
+    /// branches that have been forked on along the current path
+    std::vector<unsigned> forks;
 
-    case LABEL_OP:
-        return true;
+    bool allow_residual;
+    unsigned num_emitted;
+    unsigned num_stores;
+    unsigned num_forks;
+    unsigned num_fallbacks;
+};
 
-    default:
-        break;
-    }
+static simple_reg *emit_dispatch(emitter &e, const abstract_value &val) throw(stop_interpreter);
+static simple_reg *emit_value(emitter &e, const abstract_value &val) throw();
+static simple_reg *emit(emitter &e, symbolic_expression *val) throw(stop_interpreter);
 
-    return false;
+/// add an instruction to the end of the emitted code
+static void append(emitter &e, simple_instr *in) throw() {
+    instr::insert_after(in, e.last);
+    e.last = in;
+    ++(e.num_emitted);
 }
 
-static simple_reg *emit_dispatch(simple_instr **prev, abstract_value *val) throw(stop_interpreter);
-static simple_reg *emit(simple_instr **prev, concrete_value *val) throw();
-static simple_reg *emit(simple_instr **prev, symbolic_value *val) throw();
-static simple_reg *emit(simple_instr **prev, symbolic_expression *val) throw(stop_interpreter);
-
 /// dispatch to various sub-emitters
-static simple_reg *emit_dispatch(simple_instr **prev, abstract_value *val) throw(stop_interpreter) {
-    if(abstract_value::VALUE == val->kind) {
-        return emit(prev, unsafe_cast<concrete_value *>(val));
-    } else if(abstract_value::SYMBOL == val->kind) {
-        return emit(prev, unsafe_cast<symbolic_value *>(val));
-    } else if(abstract_value::BIG_VALUE == val->kind) {
+static simple_reg *emit_dispatch(emitter &e, const abstract_value &val) throw(stop_interpreter) {
+    if(abstract_value::VALUE == val.kind || abstract_value::ADDRESS == val.kind) {
+        return emit_value(e, val);
+    } else if(abstract_value::SYMBOL == val.kind) {
+        return val.value.reg;
+    } else if(abstract_value::BIG_VALUE == val.kind
+           || abstract_value::LOOP_SYMBOL == val.kind) {
         throw STOP_INTERPRETER;
         return 0;
     } else {
-        return emit(prev, unsafe_cast<symbolic_expression *>(val));
+        return emit(e, val.value.expr);
     }
 }
 
-/// emit the instructions for loading a constant
-static simple_reg *emit(simple_instr **prev, concrete_value *val) throw() {
-
-    simple_instr *orig_ldc(val->instr);
-    simple_reg *orig_dest(val->instr->u.ldc.dst);
-
-    // it will be used multiple times, and codegen has already happened
-    if(0 != val->emitted_reg) {
-        return val->emitted_reg;
-    }
-
-    // load constant. note: orig_ldc isn't actually guranteed to be a LDC, but
-    // should have approximately the correct type
-    simple_instr *in(new_instr(LDC_OP, orig_ldc->type));
-    val->emitted_reg = new_register(orig_dest->var->type, TEMP_REG);
+/// emit the instructions for loading a constant or an address. Concrete
+/// values are stored inline, so every use of one gets its own (single-use)
+/// temporary register.
+static simple_reg *emit_value(emitter &e, const abstract_value &val) throw() {
+    simple_instr *in(new_instr(LDC_OP, val.reg_type));
+    simple_reg *reg(new_register(val.reg_type, TEMP_REG));
 
     in->next = in->prev = 0;
-    in->u.ldc.dst = val->emitted_reg;
+    in->u.ldc.dst = reg;
 
     // put the right value in
-    switch(val->type) {
+    if(abstract_value::ADDRESS == val.kind) {
+        in->u.ldc.value.format = IMMED_SYMBOL;
+        in->u.ldc.value.u.s.symbol = val.value.as_address.sym;
+        in->u.ldc.value.u.s.offset = val.value.as_address.offset;
+    } else switch(val.type) {
     case abstract_value::INT:
         in->u.ldc.value.format = IMMED_INT;
-        in->u.ldc.value.u.ival = val->value.as_int;
+        in->u.ldc.value.u.ival = val.value.as_int;
         break;
     case abstract_value::UNSIGNED:
         in->u.ldc.value.format = IMMED_INT;
-        in->u.ldc.value.u.ival = val->value.as_uint;
+        in->u.ldc.value.u.ival = val.value.as_uint;
         break;
     case abstract_value::FLOAT:
         in->u.ldc.value.format = IMMED_FLOAT;
-        in->u.ldc.value.u.fval = val->value.as_float;
+        in->u.ldc.value.u.fval = val.value.as_float;
         break;
     default: assert(false); break;
     }
 
-    instr::insert_after(in, *prev);
-    *prev = in;
-
-    // copy iff this constant will be used more than once
-    if(1 < val->ref_count) {
-        in = new_instr(CPY_OP, orig_ldc->type);
-        in->u.base.dst = new_register(orig_dest->var->type, PSEUDO_REG);
-        in->u.base.src1 = val->emitted_reg;
-        val->emitted_reg = in->u.base.dst;
-        instr::insert_after(in, *prev);
-
-        assert((*prev)->next == in);
-
-        *prev = in;
-    }
-
-    return val->emitted_reg;
-}
-
-/// emit the register being used
-static simple_reg *emit(simple_instr **, symbolic_value *val) throw() {
-    return val->reg;
+    append(e, in);
+    return reg;
 }
 
 struct register_injector {
@@ -974,20 +2562,37 @@ void inject_register(
 }
 
 /// emit instructions for evaluating unary and binary expressions
-static simple_reg *emit(simple_instr **prev, symbolic_expression *val) throw(stop_interpreter) {
+static simple_reg *emit(emitter &e, symbolic_expression *val) throw(stop_interpreter) {
 
     if(0 != val->emitted_reg) {
         return val->emitted_reg;
     }
 
-    unsigned i(0);
+    unsigned i(1);
 
     register_injector inj;
     inj.accessor = 0U;
-    inj.regs[i++] = emit_dispatch(prev, val->left);
 
+    // evaluate the operand that needs more registers first, so that fewer
+    // registers are live at once; constants are loaded last, right before
+    // they're used
     if(symbolic_expression::BINARY == val->arity) {
-        inj.regs[i++] = emit_dispatch(prev, val->right);
+        const unsigned left_need(need_of(val->left));
+        const unsigned right_need(need_of(val->right));
+
+        if(left_need < right_need
+        || (left_need == right_need
+            && abstract_value::EXPRESSION != val->left.kind
+            && abstract_value::EXPRESSION == val->right.kind)) {
+            inj.regs[1] = emit_dispatch(e, val->right);
+            inj.regs[0] = emit_dispatch(e, val->left);
+        } else {
+            inj.regs[0] = emit_dispatch(e, val->left);
+            inj.regs[1] = emit_dispatch(e, val->right);
+        }
+        i = 2;
+    } else {
+        inj.regs[0] = emit_dispatch(e, val->left);
     }
 
     // both operands have been evaluated; now make the instruction to perform
@@ -1016,24 +2621,414 @@ static simple_reg *emit(simple_instr **prev, symbolic_expression *val) throw(sto
     for_each_var_def(inject_register, in, inj);
 
     // chain the instruction in
-    instr::insert_after(in, *prev);
-    *prev = in;
+    append(e, in);
 
+    val->emitted_reg = out;
+    e.emitted.push_back(val);
     return out;
 }
 
-/// cleanup the registers in memory
-static void cleanup_state(interpreter_state &s) throw() {
-    s.branch_targets.clear();
-    symbol_map::iterator reg_it(s.registers.begin())
-                       , reg_end(s.registers.end());
+/// forget the registers of expressions emitted since some point; they aren't
+/// available on other paths
+static void forget_emitted(emitter &e, unsigned mark) throw() {
+    for(unsigned i(mark); i < e.emitted.size(); ++i) {
+        e.emitted[i]->emitted_reg = 0;
+    }
+    e.emitted.resize(mark);
+}
+
+/// emit a copy from one register into another
+static void emit_copy(emitter &e, simple_reg *dst, simple_reg *src) throw() {
+    simple_instr *in(new_instr(CPY_OP, dst->var->type));
+    in->next = in->prev = 0;
+    in->u.base.dst = dst;
+    in->u.base.src1 = src;
+    in->u.base.src2 = 0;
+    append(e, in);
+}
+
+/// emit stores of everything that was written to memory. We can't tell
+/// whether a symbol is local to the procedure, and so everything written has
+/// to be written again to keep the procedure's side-effects.
+static void emit_memory(emitter &e, const abstract_memory &memory) throw(stop_interpreter) {
+    abstract_memory::const_iterator frame(memory.begin())
+                                  , frame_end(memory.end());
+    for(; frame_end != frame; ++frame) {
+        memory_frame::const_iterator it(frame->second.begin())
+                                   , end(frame->second.end());
+        for(; end != it; ++it) {
+            const simple_instr *store(it->second.store);
+
+            simple_reg *addr(emit_value(e, make_address(
+                store->u.base.src1->var->type, frame->first, it->first)));
+            simple_reg *val(emit_dispatch(e, it->second.value));
+
+            simple_instr *in(new_instr(STR_OP, store->type));
+            in->next = in->prev = 0;
+            in->u.base.dst = 0;
+            in->u.base.src1 = addr;
+            in->u.base.src2 = val;
+
+            append(e, in);
+            ++(e.num_stores);
+        }
+    }
+}
+
+/// emit the end of a path that returns from the procedure
+static bool emit_return(interpreter_state &s, emitter &e) throw(stop_interpreter) {
+    emit_memory(e, s.memory);
+
+    simple_reg *val(0);
+    if(0 != s.ret->u.base.src1) {
+        val = emit_dispatch(e, s.return_val);
+    }
+
+    simple_instr *in(new_instr(RET_OP, s.ret->type));
+    in->next = in->prev = 0;
+    in->u.base.dst = 0;
+    in->u.base.src1 = val;
+    in->u.base.src2 = 0;
+    append(e, in);
+    return true;
+}
+
+/// does an instruction end a basic block?
+static bool ends_block(const simple_instr *in) throw() {
+    return RET_OP == in->opcode || instr::is_local_control_flow_transfer(in);
+}
+
+static void add_reg(
+    simple_reg *reg,
+    simple_reg **,
+    simple_instr *,
+    std::set<simple_reg *> &regs
+) throw() {
+    regs.insert(reg);
+}
+
+/// find (or make) the point where a path goes back to the original code,
+/// just before the instruction at pc.
+static resume_point *find_resume_point(
+    interpreter_state &s,
+    emitter &e,
+    unsigned pc
+) throw() {
+    std::map<unsigned, resume_point>::iterator it(e.resume_points.find(pc));
+    if(e.resume_points.end() != it) {
+        return &(it->second);
+    }
+
+    simple_instr *at(s.code[pc].in);
+    if(0 == at) {
+        return 0;
+    }
+
+    resume_point &rp(e.resume_points[pc]);
+    rp.at = at;
+    rp.needs_label = false;
+
+    if(LABEL_OP == at->opcode) {
+        rp.label = at->u.label.lab;
+        return &rp;
+    } else if(0 != at->prev && LABEL_OP == at->prev->opcode) {
+        rp.label = at->prev->u.label.lab;
+        return &rp;
+    }
+
+    rp.label = new_label();
+    rp.needs_label = true;
+
+    // find the temporary registers defined before the resume point in its
+    // basic block, and used after it
+    std::set<simple_reg *> defs;
+    std::set<simple_reg *> uses;
+
+    for(simple_instr *in(at->prev);
+        0 != in && LABEL_OP != in->opcode && !ends_block(in);
+        in = in->prev) {
+        simple_reg *reg(0);
+        if(for_each_var_def(in, reg) && TEMP_REG == reg->kind) {
+            defs.insert(reg);
+        }
+    }
+
+    for(simple_instr *in(at); 0 != in; in = in->next) {
+        if(in != at && LABEL_OP == in->opcode) {
+            break;
+        }
+        for_each_var_use(add_reg, in, uses);
+        if(ends_block(in)) {
+            break;
+        }
+    }
 
+    std::set<simple_reg *>::iterator reg_it(defs.begin()), reg_end(defs.end());
     for(; reg_it != reg_end; ++reg_it) {
-        dec_ref(reg_it->second);
-        reg_it->second = 0;
+        if(0U != uses.count(*reg_it)) {
+            rp.temps.push_back(*reg_it);
+            if(0U == e.pseudos.count(*reg_it)) {
+                e.pseudos[*reg_it] = new_register(
+                    (*reg_it)->var->type, PSEUDO_REG);
+            }
+        }
+    }
+
+    return &rp;
+}
+
+/// emit the end of a path that goes back to the original code before the
+/// instruction at pc: the memory written along the path is stored, the
+/// registers changed along the path get their values, and then we jump into
+/// the original code.
+static bool emit_fallback(interpreter_state &s, emitter &e, unsigned pc) throw(stop_interpreter) {
+    resume_point *rp(0);
+    if(!e.allow_residual || 0 == (rp = find_resume_point(s, e, pc))) {
+        return false;
+    }
+
+    ++(e.num_fallbacks);
+    emit_memory(e, s.memory);
+
+    // compute every value before assigning any register, as the values are
+    // in terms of the registers on entry to the procedure
+    std::vector<std::pair<simple_reg *, simple_reg *> > copies;
+    for(unsigned slot(0U); slot < s.registers.size(); ++slot) {
+        simple_reg *reg(s.slot_regs[slot]);
+        const abstract_value &val(s.registers[slot]);
+
+        if(abstract_value::SYMBOL == val.kind && reg == val.value.reg) {
+            continue;
+        }
+
+        if(TEMP_REG == reg->kind) {
+            if(rp->temps.end() == std::find(rp->temps.begin(), rp->temps.end(), reg)) {
+                continue;
+            }
+            reg = e.pseudos[reg];
+        }
+
+        simple_reg *src(emit_dispatch(e, val));
+        if(abstract_value::SYMBOL == val.kind) {
+            simple_reg *copy(new_register(src->var->type, PSEUDO_REG));
+            emit_copy(e, copy, src);
+            src = copy;
+        }
+        copies.push_back(std::make_pair(reg, src));
+    }
+
+    for(unsigned i(0U); i < copies.size(); ++i) {
+        emit_copy(e, copies[i].first, copies[i].second);
+    }
+
+    simple_instr *in(new_instr(JMP_OP, 0));
+    in->next = in->prev = 0;
+    in->u.bj.target = rp->label;
+    in->u.bj.src = 0;
+    append(e, in);
+    return true;
+}
+
+static bool specialize(interpreter_state &s, emitter &e, unsigned pc) throw();
+
+/// split the path at a branch whose condition isn't known; both sides of the
+/// branch are specialized separately.
+static bool fork(interpreter_state &s, emitter &e, unsigned pc) throw(stop_interpreter) {
+    const resolved_instr &ri(s.code[pc]);
+    simple_reg *cond(emit_dispatch(e, s.registers[ri.src1]));
+    simple_sym *taken(new_label());
+
+    simple_instr *in(new_instr(ri.in->opcode, ri.in->type));
+    in->next = in->prev = 0;
+    in->u.bj.target = taken;
+    in->u.bj.src = cond;
+    append(e, in);
+
+    const std::vector<abstract_value> registers(s.registers);
+    const abstract_memory memory(s.memory);
+    const unsigned mark(static_cast<unsigned>(e.emitted.size()));
+
+    ++(e.num_forks);
+    e.forks.push_back(pc);
+
+    bool ok(specialize(s, e, pc + 1U));
+
+    if(ok) {
+        forget_emitted(e, mark);
+        std::copy(registers.begin(), registers.end(), s.registers.begin());
+        s.memory = memory;
+
+        simple_instr *label(new_instr(LABEL_OP, 0));
+        label->next = label->prev = 0;
+        label->u.label.lab = taken;
+        append(e, label);
+
+        ok = specialize(s, e, ri.target);
+    }
+
+    e.forks.pop_back();
+    return ok;
+}
+
+/// partially evaluate the code along one path, starting at pc. Everything
+/// that can be interpreted is; the path ends when the procedure returns, or
+/// the interpreter stops. A branch that can't be interpreted splits the path
+/// if the code growth budget allows it, and anything else goes back to the
+/// original code.
+static bool specialize(interpreter_state &s, emitter &e, unsigned pc) throw() {
+    s.pc = pc;
+    s.error = 0;
+    s.did_return = false;
+
+    try {
+        run_interpreter(s);
+    } catch(stop_interpreter &) { }
+
+    if(s.out_of_budget || e.num_emitted > s.budget.max_growth) {
+        return false;
+    }
+
+    try {
+        if(s.did_return) {
+            return emit_return(s, e);
+
+        // ran off the end of the procedure
+        } else if(0 == s.error) {
+            return false;
+        }
+
+        const unsigned at(static_cast<unsigned>(s.error - &(s.code[0])));
+        const handler_kind handler(s.code[at].handler);
+
+        if((H_BTRUE == handler || H_BFALSE == handler)
+        && e.allow_residual
+        && e.num_emitted < s.budget.max_growth
+        && e.forks.end() == std::find(e.forks.begin(), e.forks.end(), at)) {
+            return fork(s, e, at);
+        }
+
+        return emit_fallback(s, e, at);
+
+    } catch(stop_interpreter &) {
+        return false;
+    }
+}
+
+static void rename_reg(
+    simple_reg *reg,
+    simple_reg **pos,
+    simple_instr *,
+    std::map<simple_reg *, simple_reg *> &pseudos
+) throw() {
+    std::map<simple_reg *, simple_reg *>::iterator it(pseudos.find(reg));
+    if(pseudos.end() != it) {
+        *pos = it->second;
+    }
+}
+
+/// replace the temporary registers that are live across the resume points,
+/// and add the labels for the resume points into the original code
+static void add_resume_points(emitter &e) throw() {
+    std::map<unsigned, resume_point>::iterator it(e.resume_points.begin())
+                                             , end(e.resume_points.end());
+
+    // temporaries are local to a basic block; rename them in the blocks
+    // containing the resume points
+    for(; end != it; ++it) {
+        resume_point &rp(it->second);
+        if(rp.temps.empty()) {
+            continue;
+        }
+
+        simple_instr *first(rp.at->prev);
+        while(0 != first->prev
+           && LABEL_OP != first->prev->opcode
+           && !ends_block(first->prev)) {
+            first = first->prev;
+        }
+
+        for(simple_instr *in(first);
+            0 != in && LABEL_OP != in->opcode;
+            in = in->next) {
+            for_each_var_def(rename_reg, in, e.pseudos);
+            for_each_var_use(rename_reg, in, e.pseudos);
+            if(ends_block(in)) {
+                break;
+            }
+        }
+    }
+
+    for(it = e.resume_points.begin(); end != it; ++it) {
+        resume_point &rp(it->second);
+        if(rp.needs_label) {
+            simple_instr *label(new_instr(LABEL_OP, 0));
+            label->next = label->prev = 0;
+            label->u.label.lab = rp.label;
+            instr::insert_before(label, rp.at);
+        }
+    }
+}
+
+/// the number of instructions interpreted
+static unsigned steps_taken(const interpreter_budget &budget) throw() {
+    return budget.steps + budget.slice - budget.fuel;
+}
+
+/// cleanup the registers in memory, and free all expressions
+static void cleanup_state(interpreter_state &s) throw() {
+    stats::count("eval.steps", steps_taken(s.budget));
+    if(0U != s.expressions.num_shared) {
+        stats::count("eval.shared", s.expressions.num_shared);
     }
+    s.budget.steps = s.budget.slice = s.budget.fuel = 0U;
 
+    s.code.clear();
+    s.mbr_targets.clear();
+    s.loops.clear();
+    s.memory.clear();
     s.registers.clear();
+    s.slot_regs.clear();
+    s.expressions.clear();
+}
+
+/// get a limit for the interpreter from the environment
+static unsigned budget_limit(const char *flag, unsigned default_limit) throw() {
+    const char *val(getenv(flag));
+    if(0 == val) {
+        return default_limit;
+    }
+    return static_cast<unsigned>(strtoul(val, 0, 10));
+}
+
+/// initialize the state of an interpreter
+static void init_state(interpreter_state &s, summary_map &summaries) throw() {
+    s.pc = 0U;
+    s.bp = NO_INSTR;
+    s.did_return = false;
+    s.out_of_budget = false;
+    s.return_val.kind = abstract_value::BIG_VALUE;
+    s.return_val.type = abstract_value::UNKNOWN;
+    s.return_val.reg_type = 0;
+    s.return_val.value.expr = 0;
+    s.error = 0;
+    s.ret = 0;
+    s.summaries = &summaries;
+    s.summarizing = NO_LOOP;
+    s.iteration_done = false;
+    s.loop_condition = s.return_val;
+
+    interpreter_budget &budget(s.budget);
+    budget.max_steps = budget_limit(
+        "ECE540_EVAL_MAX_STEPS", interpreter_budget::DEFAULT_MAX_STEPS);
+    budget.max_values = budget_limit(
+        "ECE540_EVAL_MAX_VALUES", interpreter_budget::DEFAULT_MAX_VALUES);
+    budget.max_ms = budget_limit(
+        "ECE540_EVAL_MAX_MS", interpreter_budget::DEFAULT_MAX_MS);
+    budget.max_growth = budget_limit(
+        "ECE540_EVAL_MAX_GROWTH", interpreter_budget::DEFAULT_MAX_GROWTH);
+    budget.steps = 0U;
+    budget.slice = budget.fuel = 1U;
+    gettimeofday(&(budget.start), 0);
 }
 
 /// try to interpret some "straight line" of code, up until the first branch
@@ -1047,144 +3042,171 @@ eval::breakpoint_status abstract_evaluator_bp(
     simple_instr *break_point
 ) throw() {
     interpreter_state s;
-    s.pc = first_instr;
-    s.did_return = false;
-    s.return_val = 0;
-    s.error = 0;
-    s.bp = break_point;
+    init_state(s, o.force_get<summary_map>());
     eval::breakpoint_status status(eval::UNKNOWN);
 
-    setup_interpreter(s);
+    setup_interpreter(s, first_instr, break_point, 0);
 
     for(;;) {
         try {
-            while(interpret_instruction(s)) { /* loop a doop */ }
+            run_interpreter(s);
             status = eval::RETURNED;
         } catch(stop_interpreter &) {
 
-            // we've hit a breakpoint or a return
-            if(0 == s.error) {
+            // we've hit a breakpoint or a return, or we've spent too long
+            // interpreting
+            if(0 == s.error || s.out_of_budget) {
                 break;
             }
 
             // we've hit a different type of error
 
             simple_reg *defd_var(0);
-            switch(s.error->opcode) {
+            switch(s.error->in->opcode) {
 
             /// we've hit a branch that we can't walk through
             case BTRUE_OP: case BFALSE_OP: case MBR_OP:
                 break;
 
             /// we've hit a CALL/LOAD op; force a value to be unknown if it sets to
-            /// a register
+            /// a register. Unknown calls might write to any memory.
             case CALL_OP: case LOAD_OP:
-                if(for_each_var_def(s.error, defd_var)) {
-                    dec_ref(s.registers[defd_var]);
-                    s.registers[defd_var] = new symbolic_value(defd_var);
+                if(for_each_var_def(s.error->in, defd_var)) {
+                    s.registers[s.error->dst] = make_symbol(defd_var);
+                }
+                if(CALL_OP == s.error->in->opcode) {
+                    s.memory.clear();
                 }
                 continue;
 
-            /// we've hit a store op; continue
-            case STR_OP: continue;
+            /// we've hit a store op that might write anywhere; forget
+            /// everything in memory and continue
+            case STR_OP: case MCPY_OP:
+                s.memory.clear();
+                continue;
 
             /// not sure what happened; let's just give up
             default: break;
             }
         }
+
+        // we've returned, or hit something that we can't walk through
+        break;
     }
 
+    // a branch that can't be walked through also stops the interpreter with
+    // the program counter after it, which might be the breakpoint
+    const bool reached_breakpoint(
+        0 == s.error && !s.out_of_budget && s.pc == s.bp);
     cleanup_state(s);
 
     // we've reached a breakpoint
-    if(s.pc == s.bp) {
+    if(reached_breakpoint) {
         return eval::REACHED_BREAKPOINT;
     }
 
     return status;
 }
 
-/// attempt to perform an abstract interpretation of a function
-void abstract_evaluator(optimizer &o) throw() {
+/// attempt to perform an abstract interpretation of a function. If the whole
+/// function can't be interpreted, then it is partially evaluated: the paths
+/// through the function are specialized for what is known about them, and
+/// where a path can't be interpreted any further, it goes back to the
+/// original code.
+void abstract_evaluator(
+    optimizer &o,
+    summary_map &summaries,
+    loop_map &loops
+) throw() {
     if(0 != getenv("ECE540_DISABLE_EVAL")) {
         return;
     }
 
+    loop_map *summarizable_loops(&loops);
+    if(0 != getenv("ECE540_DISABLE_EVAL_LOOPS")) {
+        summarizable_loops = 0;
+    }
+
     simple_instr *first_instr(o.first_instruction());
-    simple_instr *ret_instr(0);
     simple_instr dummy_first;
-    simple_instr *last(&dummy_first);
 
     interpreter_state s;
-    s.pc = first_instr;
-    s.did_return = false;
-    s.return_val = 0;
-    s.error = 0;
-    s.bp = 0;
-
-    if(setup_interpreter(s)) {
-        try {
-            while(interpret_instruction(s)) { /* loop a doop */ }
-        } catch(stop_interpreter &) {
-            cleanup_state(s);
-            return;
-        }
-    }
-
-    if(!s.did_return) {
-        cleanup_state(s);
-        return;
-    }
-
-    // create the return instruction
-    ret_instr = new_instr(RET_OP, s.ret->type);
-    ret_instr->prev = 0;
-    ret_instr->next = 0;
-
-    // a return with no val or a value that is too big to generate code for;
-    // clear out the first instruction, add the thing in
-    if(0 == s.return_val
-    || abstract_value::BIG_VALUE == s.return_val->kind) {
-        first_instr->opcode = NOP_OP;
-        instr::insert_after(ret_instr, first_instr);
-        cleanup_state(s);
-        return;
-    }
-
-    // put all constants on an even footing in terms of the refcount telling
-    // use how many times they are used
-    inc_ref(s.return_val);
+    init_state(s, summaries);
+    setup_interpreter(s, first_instr, 0, summarizable_loops);
+
+    // okay, we can do code gen now! this has to happen before the state is
+    // cleaned up, as that frees the expressions
+    memset(&dummy_first, 0, sizeof dummy_first);
+
+    emitter e;
+    e.last = &dummy_first;
+    e.allow_residual = 0 == getenv("ECE540_DISABLE_EVAL_RESIDUAL");
+    e.num_emitted = 0U;
+    e.num_stores = 0U;
+    e.num_forks = 0U;
+    e.num_fallbacks = 0U;
+
+    const bool specialized(specialize(s, e, 0U));
+    const unsigned steps(steps_taken(s.budget));
+    const unsigned max_growth(s.budget.max_growth);
     cleanup_state(s);
 
-    // okay, we can do code gen now!
-    memset(last, 0, sizeof *last);
-
-    try {
-        ret_instr->u.base.src1 = emit_dispatch(&last, s.return_val);
-    } catch(stop_interpreter &) {
-        free_instr(ret_instr);
-        dec_ref(s.return_val);
+    // only keep residual code if it replaces many more instructions than it
+    // adds; the interpreter counts copies and constants that coalescing and
+    // constant propagation would mostly remove anyway, and going back into
+    // the middle of a loop gets in the way of the loop optimizations
+    if(!specialized
+    || max_growth < e.num_emitted
+    || ((0U != e.num_forks || 0U != e.num_fallbacks)
+        && steps < MIN_RESIDUAL_GAIN * e.num_emitted)) {
         return;
     }
 
-    dec_ref(s.return_val);
-
     // notify the optimizer that we've done some substantial things
     o.changed_block();
     o.changed_def();
     o.changed_use();
 
-    // clear out the first instruction
-    first_instr->opcode = NOP_OP;
-    first_instr->next = first_instr->prev = 0;
+    if(0U != e.num_stores) {
+        stats::count("eval.stores", e.num_stores);
+    }
+    if(0U != e.num_forks) {
+        stats::count("eval.forks", e.num_forks);
+    }
+    if(0U != e.num_fallbacks) {
+        stats::count("eval.fallbacks", e.num_fallbacks);
+    }
+    if(0U != e.num_forks || 0U != e.num_fallbacks) {
+        stats::count("eval.residual");
+    }
 
-    if(&dummy_first == last) {
-        instr::insert_after(ret_instr, first_instr);
-    } else {
+    // keep the original code after the specialized code if some path goes
+    // back to it; the first instruction is moved, as it begins the procedure
+    simple_instr *rest(first_instr->next);
+    if(0U != e.num_fallbacks) {
+        simple_instr *orig(new_instr(first_instr->opcode, first_instr->type));
+        memcpy(orig, first_instr, sizeof *orig);
+        orig->prev = e.last;
+        orig->next = rest;
+        if(0 != rest) {
+            rest->prev = orig;
+        }
+        e.last->next = orig;
 
-        first_instr->next = dummy_first.next->next;
-        instr::insert_after(dummy_first.next, first_instr);
-        instr::insert_after(ret_instr, last);
+        std::map<unsigned, resume_point>::iterator it(e.resume_points.begin())
+                                                 , end(e.resume_points.end());
+        for(; end != it; ++it) {
+            if(first_instr == it->second.at) {
+                it->second.at = orig;
+            }
+        }
     }
-}
 
+    // clear out the first instruction
+    first_instr->opcode = NOP_OP;
+    first_instr->next = dummy_first.next;
+    first_instr->prev = 0;
+    dummy_first.next->prev = first_instr;
+
+    add_resume_points(e);
+}
@@ -22,98 +22,12 @@ extern "C" {
 #include "include/instr.h"
 
 #include "include/use_def.h"
+#include "include/alias.h"
+#include "include/summary.h"
 
 #include "include/opt/licm.h"
 #include "include/opt/eval.h"
 
-/// go find the exit nodes of the loop
-static void find_loop_exit_bbs(
-    loop &loop,
-    std::vector<basic_block *> &loop_exits
-) throw() {
-    std::set<basic_block *>::const_iterator it(loop.body.begin())
-                                          , end(loop.body.end());
-
-    for(; it != end; ++it) {
-        const basic_block *bb(*it);
-
-        if(0 == bb->last) {
-            continue;
-        }
-
-        switch(bb->last->opcode) {
-
-        // we only care if one of their successors is not in the loop's body
-        case BTRUE_OP: case BFALSE_OP: case MBR_OP: {
-            const std::set<basic_block *> &succ(bb->successors());
-            std::set<basic_block *>::const_iterator succ_it(succ.begin())
-                                                  , succ_end(succ.end());
-
-            for(; succ_it != succ_end; ++succ_it) {
-                if(0U == loop.body.count(*succ_it)) {
-                    loop_exits.push_back(*succ_it);
-                }
-            }
-
-            break;
-        }
-
-        // note: by definition, a fall-through or direct jump cannot
-        //       be an exit of the loop, as each only has one successor
-        default:
-            assert(1U == bb->successors().size());
-            break;
-        }
-    }
-}
-
-/// imposes a total ordering on loops; this takes advantage of the fact that
-/// nested loops must strictly have fewer basic blocks than their enclosing
-/// loops
-struct loop_less {
-public:
-    bool operator()(const loop *a, const loop *b) const throw() {
-        if(a == b) {
-            return false;
-        }
-
-        const size_t a_size(a->body.size() + a->tails.size());
-        const size_t b_size(b->body.size() + b->tails.size());
-
-        if(a_size < b_size) {
-            return true;
-        } else if(b_size < a_size) {
-            return false;
-        } else {
-            return a < b;
-        }
-    }
-};
-
-/// order the loops so that we visit nested loops before we visit their
-/// enclosing loops; this will make it so that hopefully stuff can be hoisted
-/// out of multiple loops at once. this is tricky because the loop_map totally
-/// orders the loops by their basic block points, but the loops themselves only
-/// respect a partial order, and so must be re-ordered. The re-ordered is based
-/// on lexicographic order of loop size and loop head pointer.
-static bool add_loop_to_set(loop &l, std::set<loop *, loop_less> &ordered_loops) throw() {
-    ordered_loops.insert(&l);
-    return true;
-}
-static void order_loops(
-    loop_map &loops,
-    std::vector<loop *> &ordered_loops
-) throw() {
-    const unsigned num_loops(static_cast<unsigned>(loops.size()));
-    ordered_loops.reserve(num_loops);
-    std::set<loop *, loop_less> loop_set;
-    loops.for_each_loop(add_loop_to_set, loop_set);
-    ordered_loops.insert(ordered_loops.begin(),
-        loop_set.begin(),
-        loop_set.end()
-    );
-}
-
 /// apply a function to each basic blook in a loop
 template <typename T0>
 static void for_each_basic_block(
@@ -206,8 +120,57 @@ public:
 
     dominator_map *doms;
     bool instruction_is_invariant;
+
+    // memory written to within the loop
+    loop *l;
+    alias_map *aliases;
+    std::set<simple_reg *> *loop_defs;
+    std::vector<memory_access> *loop_writes;
+    bool writes_unknown_memory;
+    summary_map *summaries;
 };
 
+/// collect the memory written by instructions in the loop
+static void find_loop_writes(basic_block *bb, invariant_tracker &it) throw() {
+    if(0 == bb->last) {
+        return;
+    }
+
+    summary_map &summaries(*(it.summaries));
+    for(simple_instr *in(bb->first); in != bb->last->next; in = in->next) {
+        memory_access access;
+        if(find_memory_write(in, access)) {
+            find_loop_address(*(it.l), *(it.loop_defs), access);
+            it.loop_writes->push_back(access);
+
+        } else if(CALL_OP == in->opcode) {
+            const procedure_summary *callee(summaries.find(in));
+            if(0 == callee || !callee->is_read_only()) {
+                it.writes_unknown_memory = true;
+            }
+        }
+    }
+}
+
+/// check if a load reads memory that no instruction in the loop can write to
+static bool load_is_invariant(simple_instr *in, invariant_tracker &it) throw() {
+    if(it.writes_unknown_memory) {
+        return false;
+    }
+
+    memory_access access;
+    find_memory_read(in, access);
+    find_loop_address(*(it.l), *(it.loop_defs), access);
+
+    const std::vector<memory_access> &writes(*(it.loop_writes));
+    for(unsigned i(0U); i < writes.size(); ++i) {
+        if(it.aliases->may_alias(access, writes[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static void check_used_var_invariant(
     simple_reg *var,
     simple_reg **,
@@ -257,8 +220,8 @@ static void find_invariant_ins(basic_block *bb, invariant_tracker &it) throw() {
             }
 
             // if we're loading from memory, that might mean there's a store
-            // elsewhere that could potentially affect this
-            if(LOAD_OP == in->opcode) {
+            // elsewhere in the loop that could potentially affect this
+            if(LOAD_OP == in->opcode && !load_is_invariant(in, it)) {
                 continue;
             }
 
@@ -577,8 +540,9 @@ static simple_instr *straight_line_begin(basic_block *bb) throw() {
         } else {
             basic_block *prev_bb(*(bb->predecessors().begin()));
 
-            // the successor doesn't flow directly to bb
-            if(1U < prev_bb->successors().size()) {
+            // the successor doesn't flow directly to bb, or it's the empty
+            // entry block
+            if(1U < prev_bb->successors().size() || 0 == prev_bb->first) {
                 break;
             }
 
@@ -634,7 +598,13 @@ static basic_block *find_first_branch_bb(
 }
 
 /// try to prove that a loop will execute its body
-static bool try_prove_loop_will_run(optimizer &o, loop &loop) throw() {
+bool try_prove_loop_will_run(
+    optimizer &o,
+    loop &loop,
+    basic_block *&first_branch_bb
+) throw() {
+
+    first_branch_bb = 0;
 
     // try to prove that this loop will execute
     bool will_provably_run(false);
@@ -658,6 +628,7 @@ static bool try_prove_loop_will_run(optimizer &o, loop &loop) throw() {
         return false; // shouldn't happen
     }
 
+    first_branch_bb = first_branch_block;
     simple_instr *breakpoint(first_branch_block->last);
 
     // MBR's are too tricky to follow
@@ -694,21 +665,33 @@ static bool try_prove_loop_will_run(optimizer &o, loop &loop) throw() {
     // this particular exit
 
     // try to reach the breakpoint by symbollically evaluating
-    // a prefix of blocks to the loop up until the breakpoint
+    // a prefix of blocks to the loop up until the breakpoint; the pre-header
+    // always flows into the head, so it can be part of the prefix
+    basic_block *prefix_end(loop.head);
+    if(0 != loop.pre_header && 0 != loop.pre_header->first) {
+        prefix_end = loop.pre_header;
+    }
+
     return eval::REACHED_BREAKPOINT == abstract_evaluator_bp(
         o,
-        straight_line_begin(loop.head),
+        straight_line_begin(prefix_end),
         breakpoint
     );
 }
 
 /// hoist code out of an individual loop
-static bool hoist_code(optimizer &o, cfg &flow, def_use_map &dum, dominator_map &dm, loop &loop) throw() {
+static bool hoist_code(
+    optimizer &o,
+    cfg &flow,
+    def_use_map &dum,
+    dominator_map &dm,
+    alias_map &aliases,
+    loop &loop
+) throw() {
 
     // get all exits of the loop; we need to make sure the definitions of variables
     // dominate the exits
-    std::vector<basic_block *> loop_exits;
-    find_loop_exit_bbs(loop, loop_exits);
+    std::vector<basic_block *> &loop_exits(loop.exits);
 
     // go identify how many definitions of each variable there are
     variable_counter counter;
@@ -733,6 +716,17 @@ static bool hoist_code(optimizer &o, cfg &flow, def_use_map &dum, dominator_map
     it.invariant_regs = &invariant_regs;
     size_t old_num_ins(0U), old_num_regs(0U);
 
+    // go find all memory written to in the loop, so that we can decide which
+    // loads are invariant
+    std::set<simple_reg *> loop_defs;
+    std::vector<memory_access> loop_writes;
+    it.l = &loop;
+    it.aliases = &aliases;
+    it.loop_defs = &loop_defs;
+    it.loop_writes = &loop_writes;
+    it.writes_unknown_memory = false;
+    it.summaries = &(o.force_get<summary_map>());
+
     // any variable that isn't defined inside the loop is considered
     // loop invariant
     std::map<simple_reg *, unsigned>::iterator zd_it(num_defs.begin())
@@ -741,9 +735,13 @@ static bool hoist_code(optimizer &o, cfg &flow, def_use_map &dum, dominator_map
         if(0U == zd_it->second) {
             //printf("/* %s is invariant on entering */\n", r(zd_it->first));
             invariant_regs.insert(zd_it->first);
+        } else {
+            loop_defs.insert(zd_it->first);
         }
     }
 
+    for_each_basic_block(loop, find_loop_writes, it);
+
     // loop until we can't find any new invariant instructions or registers
     do {
         old_num_ins = invariant_ins.size();
@@ -779,7 +777,8 @@ static bool hoist_code(optimizer &o, cfg &flow, def_use_map &dum, dominator_map
     // then kill any invariant instruction that:
     //  a) doesn't dominate the exit of the CFG; or
     //  b) has no uses outside after the loop
-    if(!try_prove_loop_will_run(o, loop)) {
+    basic_block *first_branch_bb(0);
+    if(!try_prove_loop_will_run(o, loop, first_branch_bb)) {
         // case a)
         keep_defs_dominating_exit(it, dm(flow.exit()));
 
@@ -851,18 +850,14 @@ void hoist_loop_invariant_code(optimizer &o, cfg &flow, loop_map &lm) throw() {
         return;
     }
 
-    std::vector<loop *> loops;
-    order_loops(lm, loops);
-
-    for(unsigned i(0U); i < loops.size(); ++i) {
-        loop *ll(loops[i]);
-    }
+    const std::vector<loop *> &loops(lm.inner_to_outer());
 
     dominator_map &dm(o.force_get<dominator_map>());
     bool updated(false);
     for(unsigned i(0U); i < loops.size(); ++i) {
         def_use_map &dum(o.force_get<def_use_map>());
-        if(hoist_code(o, flow, dum, dm, *(loops[i]))) {
+        alias_map &aliases(o.force_get<alias_map>());
+        if(hoist_code(o, flow, dum, dm, aliases, *(loops[i]))) {
             updated = true;
         }
     }
@@ -0,0 +1,207 @@
+/*
+ * ns.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <set>
+#include <vector>
+#include <cstdlib>
+
+#include "include/opt/ns.h"
+#include "include/cfg.h"
+#include "include/instr.h"
+#include "include/loop.h"
+#include "include/optimizer.h"
+#include "include/stats.h"
+
+enum {
+    DEFAULT_MAX_GROWTH = 64U,
+
+    /// splitting an entry can turn its successors into entries, so the
+    /// irreducible loops are found again after each round of splitting
+    MAX_ROUNDS = 16U
+};
+
+struct split_state {
+public:
+
+    /// the last instruction of the procedure; copied blocks go after it
+    simple_instr *last;
+
+    /// number of instructions copied so far, and the most that can be
+    unsigned growth;
+    unsigned max_growth;
+
+    unsigned num_split;
+};
+
+/// is a block entered from outside of a loop by falling into it, rather than
+/// by a branch/jump?
+static bool is_fallen_into(const irreducible_loop &l, basic_block *bb) throw() {
+    basic_block *prev(bb->prev);
+    return 0U != bb->predecessors().count(prev)
+        && 0U == l.body.count(prev)
+        && prev->falls_through();
+}
+
+/// find the last instruction of the procedure, if nothing falls through it
+static simple_instr *find_last_instr(cfg &flow) throw() {
+    simple_instr *last(0);
+    for(basic_block *bb(flow.entry()); 0 != bb; bb = bb->next) {
+        if(0 != bb->last) {
+            last = bb->last;
+        }
+    }
+
+    if(0 == last
+    || (instr::can_default_fall_through(last) && !instr::is_return(last))) {
+        return 0;
+    }
+    return last;
+}
+
+/// copy an entry of a loop to the end of the procedure, and make all
+/// branches/jumps from outside of the loop go to the copy. The copy is
+/// outside of the loop, so the entry is no longer an entry (but the copy's
+/// successors might become entries).
+static bool split_entry(
+    split_state &s,
+    const irreducible_loop &l,
+    basic_block *bb
+) throw() {
+    const unsigned size(bb->code_size());
+    if(s.max_growth < s.growth + size
+    || !instr::is_label(bb->first)
+    || MBR_OP == bb->last->opcode) {
+        return false;
+    }
+
+    // the copy needs to jump to where the block falls through to
+    simple_sym *fall_through(0);
+    if(bb->falls_through()) {
+        if(!instr::is_label(bb->next->first)) {
+            return false;
+        }
+        fall_through = bb->next->first->u.label.lab;
+    }
+
+    simple_sym *label(bb->first->u.label.lab);
+    simple_instr *copy_label(new_instr(LABEL_OP, 0));
+    copy_label->u.label.lab = new_label();
+    instr::insert_after(copy_label, s.last);
+
+    s.last = bb->copy_after(copy_label);
+    if(0 != fall_through) {
+        simple_instr *jmp(new_instr(JMP_OP, 0));
+        jmp->u.bj.target = fall_through;
+        jmp->u.bj.src = 0;
+        instr::insert_after(jmp, s.last);
+        s.last = jmp;
+    }
+
+    const std::set<basic_block *> &preds(bb->predecessors());
+    std::set<basic_block *>::const_iterator it(preds.begin()), end(preds.end());
+    for(; it != end; ++it) {
+        if(0U == l.body.count(*it)) {
+            instr::replace_symbol((*it)->last, label, copy_label->u.label.lab);
+        }
+    }
+
+    s.growth += size;
+    ++s.num_split;
+    return true;
+}
+
+/// split all entries of a loop but one. The entry that is kept (the new head
+/// of the loop) is the one that is fallen into from outside of the loop, if
+/// any, as falling into a copy isn't possible; otherwise it's the biggest
+/// entry, so that the least code is copied.
+static bool split_loop(split_state &s, const irreducible_loop &l) throw() {
+    basic_block *head(0);
+    for(unsigned i(0U); i < l.entries.size(); ++i) {
+        basic_block *bb(l.entries[i]);
+        if(!is_fallen_into(l, bb)) {
+            continue;
+        } else if(0 != head) {
+            return false;
+        }
+        head = bb;
+    }
+
+    if(0 == head) {
+        head = l.entries[0];
+        for(unsigned i(1U); i < l.entries.size(); ++i) {
+            if(head->code_size() < l.entries[i]->code_size()) {
+                head = l.entries[i];
+            }
+        }
+    }
+
+    bool split(false);
+    for(unsigned i(0U); i < l.entries.size(); ++i) {
+        if(head != l.entries[i] && split_entry(s, l, l.entries[i])) {
+            split = true;
+        }
+    }
+    return split;
+}
+
+/// make irreducible loops reducible by node splitting. Each entry of an
+/// irreducible loop, except for one, is copied, and the edges into the entry
+/// from outside of the loop are moved to the copy. The loops are found again
+/// after each round of splitting, until none are left or until the number of
+/// copied instructions reaches ECE540_NS_MAX_GROWTH (default 64). This looks
+/// at the CFG directly rather than at the loop map, as finding loops adds
+/// pre-headers, which can themselves end up in irreducible loops.
+void split_irreducible_loops(optimizer &o, cfg &flow) throw() {
+    if(0 != getenv("ECE540_DISABLE_NS")) {
+        return;
+    }
+
+    split_state s;
+    s.growth = 0U;
+    s.max_growth = DEFAULT_MAX_GROWTH;
+    s.num_split = 0U;
+
+    const char *max_growth(getenv("ECE540_NS_MAX_GROWTH"));
+    if(0 != max_growth) {
+        s.max_growth = static_cast<unsigned>(strtoul(max_growth, 0, 10));
+    }
+
+    for(unsigned round(0U); round < MAX_ROUNDS; ++round) {
+        std::vector<irreducible_loop> irreducible;
+        find_irreducible_loops(flow, irreducible);
+        s.last = find_last_instr(flow);
+        if(irreducible.empty() || 0 == s.last) {
+            break;
+        }
+
+        bool split(false);
+        for(unsigned i(0U); i < irreducible.size(); ++i) {
+            if(split_loop(s, irreducible[i])) {
+                split = true;
+            }
+        }
+
+        if(!split) {
+            break;
+        }
+
+        o.changed_block();
+        o.changed_def();
+        o.changed_use();
+
+        // rebuild the CFG in place
+        o.force_get<cfg>();
+    }
+
+    if(0U != s.num_split) {
+        stats::count("ns.split", s.num_split);
+    }
+}
@@ -0,0 +1,189 @@
+/*
+ * rle.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <vector>
+#include <cstdlib>
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include "include/opt/rle.h"
+#include "include/alias.h"
+#include "include/cfg.h"
+#include "include/optimizer.h"
+#include "include/summary.h"
+#include "include/data_flow/var_def.h"
+
+/// a value in memory that we also have in a register; either because we
+/// loaded it or because we stored it.
+struct rle_entry {
+public:
+    memory_access access;
+
+    /// the register holding the value in memory
+    simple_reg *value(void) const throw() {
+        if(LOAD_OP == access.in->opcode) {
+            return access.in->u.base.dst;
+        }
+        return access.in->u.base.src2;
+    }
+};
+
+struct rle_state {
+public:
+    alias_map *aliases;
+    summary_map *summaries;
+    optimizer *o;
+};
+
+/// check if a register can stand in for the destination of a load
+static bool same_type(simple_reg *a, simple_reg *b) throw() {
+    return a->var->type == b->var->type
+        || (a->var->type->base == b->var->type->base
+            && a->var->type->len == b->var->type->len);
+}
+
+/// remove every entry that might be clobbered by a write to memory
+static void kill_aliased_entries(
+    std::vector<rle_entry> &entries,
+    const memory_access &write,
+    const alias_map &aliases
+) throw() {
+    for(unsigned i(0); i < entries.size(); ) {
+        if(aliases.may_alias(entries[i].access, write)) {
+            entries[i] = entries.back();
+            entries.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+/// replace redundant loads within a basic block. This goes forward through
+/// the basic block remembering which memory locations have known values in
+/// registers; a load from one of those locations becomes a copy.
+static bool replace_redundant_loads(basic_block *bb, rle_state &s) throw() {
+    if(0 == bb->last) {
+        return true;
+    }
+
+    std::vector<rle_entry> entries;
+
+    for(simple_instr *in(bb->first), *end(bb->last->next);
+        in != end;
+        in = in->next) {
+
+        rle_entry entry;
+        bool add_entry(false);
+
+        switch(in->opcode) {
+        case LOAD_OP: {
+            find_memory_read(in, entry.access);
+            find_local_address(entry.access);
+
+            std::vector<rle_entry>::iterator it(entries.begin())
+                                           , it_end(entries.end());
+            for(; it != it_end; ++it) {
+                if(s.aliases->must_alias(it->access, entry.access)
+                && same_type(it->value(), in->u.base.dst)) {
+                    break;
+                }
+            }
+
+            if(it == it_end) {
+                add_entry = true;
+                break;
+            }
+
+            // the register already holds the value, e.g. the load reads back
+            // what was just stored from the same register
+            if(it->value() == in->u.base.dst) {
+                in->opcode = NOP_OP;
+                s.o->changed_def();
+                s.o->changed_use();
+                break;
+            }
+
+            // make sure not to over-use a temporary register
+            if(TEMP_REG == it->value()->kind) {
+                bb->replace_temp_reg(it->value());
+            }
+
+            in->opcode = CPY_OP;
+            in->u.base.src1 = it->value();
+            in->u.base.src2 = 0;
+
+            s.o->changed_use();
+            break;
+        }
+
+        case STR_OP: case MCPY_OP: {
+            memory_access write;
+            find_memory_write(in, write);
+            find_local_address(write);
+            kill_aliased_entries(entries, write, *(s.aliases));
+
+            if(STR_OP == in->opcode) {
+                entry.access = write;
+                add_entry = true;
+            }
+            break;
+        }
+
+        // calls to procedures that might write to memory clobber everything
+        case CALL_OP: {
+            const procedure_summary *callee(s.summaries->find(in));
+            if(0 == callee || !callee->is_read_only()) {
+                entries.clear();
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        // kill entries whose value register is redefined
+        simple_reg *reg(0);
+        if(for_each_var_def(in, reg)) {
+            for(unsigned i(0); i < entries.size(); ) {
+                if(entries[i].value() == reg) {
+                    entries[i] = entries.back();
+                    entries.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+        }
+
+        if(add_entry) {
+            entries.push_back(entry);
+        }
+    }
+
+    return true;
+}
+
+/// replace loads of values already in registers with copies
+void eliminate_redundant_loads(
+    optimizer &o,
+    cfg &flow,
+    alias_map &aliases,
+    summary_map &summaries
+) throw() {
+    if(0 != getenv("ECE540_DISABLE_RLE")) {
+        return;
+    }
+
+    rle_state state;
+    state.aliases = &aliases;
+    state.summaries = &summaries;
+    state.o = &o;
+
+    flow.for_each_basic_block(&replace_redundant_loads, state);
+}
@@ -0,0 +1,291 @@
+/*
+ * sb.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <set>
+#include <cstdlib>
+
+#include "include/opt/sb.h"
+#include "include/cfg.h"
+#include "include/instr.h"
+#include "include/optimizer.h"
+#include "include/stats.h"
+
+enum {
+    DEFAULT_MAX_TAIL_SIZE = 8U,
+    MAX_SUPERBLOCK_SIZE = 64U
+};
+
+struct superblock_state {
+public:
+    dominator_map *doms;
+
+    /// blocks whose instructions were moved or whose ends were changed
+    /// during this pass; the CFG is out of date for these
+    std::set<basic_block *> touched;
+
+    /// largest block that will be duplicated
+    unsigned max_tail_size;
+
+    unsigned num_merged;
+    unsigned num_duplicated;
+};
+
+/// the label that begins a block, if any
+static simple_sym *block_label(basic_block *bb) throw() {
+    if(0 == bb || 0 == bb->first || LABEL_OP != bb->first->opcode) {
+        return 0;
+    }
+    return bb->first->u.label.lab;
+}
+
+/// does a block end with an unconditional jump to another block?
+static bool jumps_to_block(basic_block *pred, basic_block *bb) throw() {
+    simple_sym *lab(block_label(bb));
+    return 0 != lab
+        && 0 != pred->last
+        && JMP_OP == pred->last->opcode
+        && lab == pred->last->u.bj.target;
+}
+
+/// find the label of the block that a block falls through to, or 0 if the
+/// block never falls through. Returns false if the block falls through to
+/// something that can't be jumped to (i.e. off the end of the procedure).
+static bool find_fall_through(basic_block *bb, simple_sym *&lab) throw() {
+    lab = 0;
+    if(!instr::can_default_fall_through(bb->last)
+    || instr::is_return(bb->last)) {
+        return true;
+    }
+    lab = block_label(bb->next);
+    return 0 != lab;
+}
+
+/// add a jump to a label after some instruction
+static simple_instr *add_jump(simple_instr *after, simple_sym *lab) throw() {
+    simple_instr *jmp(new_instr(JMP_OP, 0));
+    jmp->u.bj.target = lab;
+    jmp->u.bj.src = 0;
+    instr::insert_after(jmp, after);
+    return jmp;
+}
+
+/// is a block the head of a loop, or the source of a back edge?
+static bool is_loop_edge(superblock_state &s, basic_block *bb) throw() {
+    const std::set<basic_block *> &preds(bb->predecessors());
+    std::set<basic_block *>::const_iterator it(preds.begin()), end(preds.end());
+    for(; it != end; ++it) {
+        if(0U != (*s.doms)(*it).count(bb)) {
+            return true;
+        }
+    }
+
+    const std::set<basic_block *> &succs(bb->successors());
+    dominator_set &bb_doms((*s.doms)(bb));
+    for(it = succs.begin(), end = succs.end(); it != end; ++it) {
+        if(0U != bb_doms.count(*it)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// move a block that is only reached by a jump from its predecessor to the
+/// place of that jump, e.g.:
+///
+///         jmp L2                  L2:
+///         ...         becomes     <body>
+///     L2:                         jmp L3
+///         <body>                  ...
+///     L3:                     L3:
+///
+/// the label of the moved block is no longer used, so the two blocks become
+/// one when the CFG is rebuilt.
+static bool merge_block(superblock_state &s, basic_block *pred, basic_block *bb) throw() {
+    simple_sym *fall_through(0);
+    if(pred == bb
+    || 0U != s.touched.count(pred)
+    || 0U != s.touched.count(bb)
+    || !jumps_to_block(pred, bb)
+    || !find_fall_through(bb, fall_through)) {
+        return false;
+    }
+
+    simple_instr *jmp(pred->last);
+
+    // the jump is to the next block; killing it is enough
+    if(jmp->next != bb->first) {
+
+        // unlink the block's instructions; nothing falls into this block,
+        // so the block before it must have ended with a jump or return
+        simple_instr *first(bb->first), *last(bb->last);
+        if(0 != first->prev) {
+            first->prev->next = last->next;
+        }
+        if(0 != last->next) {
+            last->next->prev = first->prev;
+        }
+
+        // and link them in after the jump
+        first->prev = jmp;
+        last->next = jmp->next;
+        if(0 != jmp->next) {
+            jmp->next->prev = last;
+        }
+        jmp->next = first;
+
+        if(0 != fall_through) {
+            add_jump(last, fall_through);
+        }
+    }
+
+    jmp->opcode = NOP_OP;
+
+    s.touched.insert(pred);
+    s.touched.insert(bb);
+    ++s.num_merged;
+    return true;
+}
+
+/// can a block be duplicated into the blocks that jump to it?
+static bool can_duplicate(superblock_state &s, basic_block *bb) throw() {
+    if(0 == bb->last
+    || 0U != s.touched.count(bb)
+    || 2U > bb->predecessors().size()
+    || s.max_tail_size < bb->code_size()) {
+        return false;
+    }
+
+    // only blocks that end the region; duplicating blocks that end with a
+    // conditional branch can blow up the size of the code
+    for(simple_instr *in(bb->first), *end(bb->last->next);
+        in != end;
+        in = in->next) {
+
+        switch(in->opcode) {
+        case BTRUE_OP: case BFALSE_OP: case MBR_OP: case CALL_OP:
+            return false;
+        default:
+            break;
+        }
+    }
+
+    // keep the shapes of loops intact
+    return !is_loop_edge(s, bb);
+}
+
+/// duplicate a small block into a block that jumps to it, e.g.:
+///
+///         jmp L2                  <body>
+///         ...         becomes     jmp L3
+///     L2:                         ...
+///         <body>              L2:
+///     L3:                         <body>
+///                             L3:
+///
+/// this makes the block that ends with the jump longer, at the expense of
+/// code size.
+static bool duplicate_block(
+    superblock_state &s,
+    basic_block *pred,
+    basic_block *bb,
+    simple_sym *fall_through
+) throw() {
+    if(pred == bb
+    || 0U != s.touched.count(pred)
+    || !jumps_to_block(pred, bb)
+    || MAX_SUPERBLOCK_SIZE < pred->code_size() + bb->code_size()) {
+        return false;
+    }
+
+    simple_instr *jmp(pred->last);
+    simple_instr *last(bb->copy_after(jmp));
+
+    if(0 != fall_through) {
+        add_jump(last, fall_through);
+    }
+
+    jmp->opcode = NOP_OP;
+
+    s.touched.insert(pred);
+    ++s.num_duplicated;
+    return true;
+}
+
+/// merge or duplicate a block into its predecessors
+static bool grow_superblocks(basic_block *bb, superblock_state &s) throw() {
+    if(0 == bb->first) {
+        return true;
+    }
+
+    const std::set<basic_block *> &preds(bb->predecessors());
+
+    if(1U == preds.size()) {
+        merge_block(s, *(preds.begin()), bb);
+        return true;
+    }
+
+    simple_sym *fall_through(0);
+    if(!can_duplicate(s, bb) || !find_fall_through(bb, fall_through)) {
+        return true;
+    }
+
+    std::set<basic_block *>::const_iterator it(preds.begin()), end(preds.end());
+    for(; it != end; ++it) {
+        duplicate_block(s, *it, bb, fall_through);
+    }
+
+    return true;
+}
+
+/// grow basic blocks so that the local optimizations see longer regions.
+///
+/// the blocks built by the CFG end at every label that is jumped to, so two
+/// blocks that always execute one after the other stay separate when the
+/// second one is reached by a jump. Such blocks are moved up to the jump.
+/// Small blocks that are reached by jumps from several places (e.g. the join
+/// of an if/else) are duplicated into the blocks that jump to them (tail
+/// duplication), so that each path through them becomes one longer block
+/// (a superblock). Without a profile, every join that is reached by a jump
+/// is treated as being on a frequent path.
+void form_superblocks(optimizer &o, cfg &flow, dominator_map &doms) throw() {
+    if(0 != getenv("ECE540_DISABLE_SB")) {
+        return;
+    }
+
+    superblock_state s;
+    s.doms = &doms;
+    s.max_tail_size = DEFAULT_MAX_TAIL_SIZE;
+    s.num_merged = 0U;
+    s.num_duplicated = 0U;
+
+    const char *max_tail_size(getenv("ECE540_SB_MAX_TAIL_SIZE"));
+    if(0 != max_tail_size) {
+        s.max_tail_size = static_cast<unsigned>(strtoul(max_tail_size, 0, 10));
+    }
+
+    flow.for_each_basic_block(&grow_superblocks, s);
+
+    if(0U == s.num_merged && 0U == s.num_duplicated) {
+        return;
+    }
+
+    if(0U != s.num_merged) {
+        stats::count("sb.merged", s.num_merged);
+    }
+    if(0U != s.num_duplicated) {
+        stats::count("sb.duplicated", s.num_duplicated);
+    }
+
+    o.changed_block();
+    o.changed_def();
+    o.changed_use();
+}
@@ -0,0 +1,558 @@
+/*
+ * sr.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+extern "C" {
+#   include <simple.h>
+}
+
+#include <vector>
+#include <set>
+#include <map>
+#include <cstdlib>
+
+#include "include/opt/sr.h"
+#include "include/alias.h"
+#include "include/cfg.h"
+#include "include/instr.h"
+#include "include/loop.h"
+#include "include/optimizer.h"
+#include "include/summary.h"
+#include "include/data_flow/var_def.h"
+#include "include/data_flow/dom.h"
+#include "include/opt/licm.h"
+
+/// a memory location inside of a loop that might be kept in a register
+struct sr_candidate {
+public:
+    memory_access location;
+    simple_type *type; // type of the value held in memory
+    std::vector<simple_instr *> loads;
+    std::vector<simple_instr *> stores;
+    std::set<basic_block *> blocks; // blocks containing the loads/stores
+};
+
+/// everything we know about the memory accesses in a loop
+struct sr_state {
+public:
+    loop *l;
+    alias_map *aliases;
+    summary_map *summaries;
+
+    std::set<simple_reg *> loop_defs;
+    std::vector<memory_access> accesses;
+    std::vector<basic_block *> access_bbs;
+    std::vector<sr_candidate> candidates;
+
+    bool calls_read_memory;
+    bool calls_write_memory;
+    bool has_return;
+
+    // see is_always_accessed
+    bool will_run;
+    std::vector<basic_block *> leaving_bbs;
+};
+
+/// the register holding the value read or written by a load/store
+static simple_reg *value_reg(simple_instr *in) throw() {
+    if(LOAD_OP == in->opcode) {
+        return in->u.base.dst;
+    }
+    return in->u.base.src2;
+}
+
+/// collect all registers defined in the loop
+static void find_loop_defs(basic_block *bb, sr_state &s) throw() {
+    for(simple_instr *in(bb->first), *end(bb->last->next);
+        in != end;
+        in = in->next) {
+
+        simple_reg *reg(0);
+        if(for_each_var_def(in, reg)) {
+            s.loop_defs.insert(reg);
+        }
+    }
+}
+
+/// collect all memory accesses and calls in the loop
+static void find_loop_accesses(basic_block *bb, sr_state &s) throw() {
+    for(simple_instr *in(bb->first), *end(bb->last->next);
+        in != end;
+        in = in->next) {
+
+        memory_access access;
+
+        switch(in->opcode) {
+        case LOAD_OP: case STR_OP: case MCPY_OP:
+            if(find_memory_read(in, access)) {
+                find_loop_address(*(s.l), s.loop_defs, access);
+                s.accesses.push_back(access);
+                s.access_bbs.push_back(bb);
+            }
+            if(find_memory_write(in, access)) {
+                find_loop_address(*(s.l), s.loop_defs, access);
+                s.accesses.push_back(access);
+                s.access_bbs.push_back(bb);
+            }
+            break;
+
+        case CALL_OP: {
+            const procedure_summary *callee(s.summaries->find(in));
+            if(0 == callee || !callee->is_read_only()) {
+                s.calls_write_memory = true;
+            }
+            if(0 == callee || !callee->is_pure()) {
+                s.calls_read_memory = true;
+            }
+            break;
+        }
+
+        case RET_OP:
+            s.has_return = true;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+/// group the loads and stores of the loop by the memory location that they
+/// access; only locations with known, loop-invariant addresses are kept
+static void find_candidates(sr_state &s) throw() {
+    for(unsigned i(0); i < s.accesses.size(); ++i) {
+        const memory_access &access(s.accesses[i]);
+        if(MCPY_OP == access.in->opcode
+        || !access.address.is_valid
+        || 0 == access.address.base
+        || 0U == access.size) {
+            continue;
+        }
+
+        simple_type *type(value_reg(access.in)->var->type);
+        std::vector<sr_candidate>::iterator it(s.candidates.begin())
+                                          , end(s.candidates.end());
+        for(; it != end; ++it) {
+            if(s.aliases->must_alias(it->location, access)
+            && it->type->base == type->base
+            && it->type->len == type->len) {
+                break;
+            }
+        }
+
+        if(it == end) {
+            sr_candidate candidate;
+            candidate.location = access;
+            candidate.type = type;
+            s.candidates.push_back(candidate);
+            it = s.candidates.end() - 1;
+        }
+
+        it->blocks.insert(s.access_bbs[i]);
+        if(LOAD_OP == access.in->opcode) {
+            it->loads.push_back(access.in);
+        } else {
+            it->stores.push_back(access.in);
+        }
+    }
+}
+
+/// check if a memory access belongs to a candidate
+static bool is_candidate_access(const sr_candidate &c, simple_instr *in) throw() {
+    for(unsigned i(0); i < c.loads.size(); ++i) {
+        if(in == c.loads[i]) {
+            return true;
+        }
+    }
+    for(unsigned i(0); i < c.stores.size(); ++i) {
+        if(in == c.stores[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// check if nothing else in the loop can touch the memory of a candidate
+static bool is_isolated(const sr_state &s, const sr_candidate &c) throw() {
+    if(s.calls_write_memory || (!c.stores.empty() && s.calls_read_memory)) {
+        return false;
+    }
+
+    for(unsigned i(0); i < s.accesses.size(); ++i) {
+        const memory_access &access(s.accesses[i]);
+        if(!is_candidate_access(c, access.in)
+        && s.aliases->may_alias(c.location, access)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// check if one block dominates all of some other blocks
+static bool dominates_all(
+    dominator_map &dm,
+    basic_block *dom_bb,
+    const std::vector<basic_block *> &bbs
+) throw() {
+    for(unsigned i(0U); i < bbs.size(); ++i) {
+        if(!dm(bbs[i]).count(dom_bb)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// check if the loop touches the memory of a candidate on every path out of
+/// it. Otherwise, loading it in the pre-header (and storing it at the exits)
+/// could touch memory that the loop never would, e.g. if the loop runs zero
+/// times or the access is conditional.
+///
+/// Either some block that accesses the memory dominates all exits, or the
+/// loop provably runs and such a block dominates the tails and every other
+/// block that can leave the loop; the first iteration then can't leave
+/// before the access, and later iterations come from a tail.
+static bool is_always_accessed(
+    dominator_map &dm,
+    const sr_state &s,
+    const sr_candidate &c
+) throw() {
+    std::set<basic_block *>::const_iterator it(c.blocks.begin())
+                                          , end(c.blocks.end());
+    if(!s.l->exits.empty()) {
+        for(; it != end; ++it) {
+            if(dominates_all(dm, *it, s.l->exits)) {
+                return true;
+            }
+        }
+    }
+
+    if(!s.will_run) {
+        return false;
+    }
+
+    for(it = c.blocks.begin(); it != end; ++it) {
+        if(dominates_all(dm, *it, s.l->tails)
+        && dominates_all(dm, *it, s.leaving_bbs)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// find the blocks of a loop, other than the one that the proof that the
+/// loop runs went past, that have a successor outside of the loop
+static void find_leaving_bbs(sr_state &s, basic_block *first_branch_bb) throw() {
+    std::set<basic_block *>::iterator it(s.l->body.begin())
+                                    , end(s.l->body.end());
+    for(; it != end; ++it) {
+        if(first_branch_bb == *it) {
+            continue;
+        }
+
+        const std::set<basic_block *> &succs((*it)->successors());
+        std::set<basic_block *>::const_iterator succ_it(succs.begin())
+                                              , succ_end(succs.end());
+        for(; succ_it != succ_end; ++succ_it) {
+            if(0U == s.l->body.count(*succ_it)) {
+                s.leaving_bbs.push_back(*it);
+                break;
+            }
+        }
+    }
+}
+
+/// find the last definition of a register in a basic block
+static simple_instr *find_last_def(basic_block *bb, simple_reg *reg) throw() {
+    for(simple_instr *in(bb->last), *end(bb->first->prev);
+        in != end;
+        in = in->prev) {
+
+        simple_reg *defd_reg(0);
+        if(for_each_var_def(in, defd_reg) && reg == defd_reg) {
+            return in;
+        }
+    }
+    return 0;
+}
+
+/// get the register that currently holds the value of a leaf of a symbolic
+/// address
+static simple_reg *leaf_reg(const address_leaf &leaf) throw() {
+    simple_reg *reg(leaf.reg);
+    if(0 != leaf.def) {
+        for_each_var_def(const_cast<simple_instr *>(leaf.def), reg);
+    }
+    return reg;
+}
+
+/// check if every leaf of an address still holds the value it had when the
+/// address was computed at the end of the pre-header
+static bool can_compute_address(basic_block *pre_header, const symbolic_address &addr) throw() {
+    std::map<address_leaf, int>::const_iterator it(addr.terms.begin())
+                                              , end(addr.terms.end());
+    for(; it != end; ++it) {
+        simple_reg *reg(leaf_reg(it->first));
+        if(it->first.def != find_last_def(pre_header, reg)
+        || (0 == it->first.def && TEMP_REG == reg->kind)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// add an instruction to the end of a basic block
+static void append(basic_block *bb, simple_instr *in) throw() {
+    instr::insert_after(in, bb->last);
+    bb->last = in;
+}
+
+/// compute a symbolic address at the end of the pre-header
+static simple_reg *compute_address(basic_block *pre_header, const symbolic_address &addr) throw() {
+    simple_reg *sum(new_register(simple_type_addr, TEMP_REG));
+    simple_instr *in(new_instr(LDC_OP, simple_type_addr));
+    in->u.ldc.dst = sum;
+    in->u.ldc.value.format = IMMED_SYMBOL;
+    in->u.ldc.value.u.s.symbol = addr.base;
+    in->u.ldc.value.u.s.offset = addr.offset;
+    append(pre_header, in);
+
+    std::map<address_leaf, int>::const_iterator it(addr.terms.begin())
+                                              , end(addr.terms.end());
+    for(; it != end; ++it) {
+        simple_reg *reg(leaf_reg(it->first));
+
+        // the leaf is a temporary register, which can only be used once
+        if(TEMP_REG == reg->kind) {
+            pre_header->replace_temp_reg(reg);
+            reg = leaf_reg(it->first);
+        }
+
+        // scale the leaf
+        if(1 != it->second) {
+            simple_reg *scale(new_register(simple_type_signed, TEMP_REG));
+            in = new_instr(LDC_OP, simple_type_signed);
+            in->u.ldc.dst = scale;
+            in->u.ldc.value.format = IMMED_INT;
+            in->u.ldc.value.u.ival = it->second;
+            append(pre_header, in);
+
+            simple_reg *scaled(new_register(simple_type_signed, TEMP_REG));
+            in = new_instr(MUL_OP, simple_type_signed);
+            in->u.base.dst = scaled;
+            in->u.base.src1 = reg;
+            in->u.base.src2 = scale;
+            append(pre_header, in);
+            reg = scaled;
+        }
+
+        simple_reg *next_sum(new_register(simple_type_addr, TEMP_REG));
+        in = new_instr(ADD_OP, simple_type_addr);
+        in->u.base.dst = next_sum;
+        in->u.base.src1 = sum;
+        in->u.base.src2 = reg;
+        append(pre_header, in);
+        sum = next_sum;
+    }
+
+    simple_reg *addr_reg(new_register(simple_type_addr, PSEUDO_REG));
+    in = new_instr(CPY_OP, simple_type_addr);
+    in->u.base.dst = addr_reg;
+    in->u.base.src1 = sum;
+    append(pre_header, in);
+
+    return addr_reg;
+}
+
+/// find the blocks into which we need to store a promoted value back to
+/// memory; returns false if some exit can also be reached from outside of the
+/// loop
+static bool find_exit_bbs(
+    cfg &flow,
+    loop &l,
+    std::set<basic_block *> &exit_bbs
+) throw() {
+    const std::vector<basic_block *> &loop_exits(l.exits);
+
+    for(unsigned i(0); i < loop_exits.size(); ++i) {
+        basic_block *bb(loop_exits[i]);
+        if(flow.exit() == bb
+        || 0 == bb->first
+        || !instr::is_label(bb->first)) {
+            return false;
+        }
+
+        const std::set<basic_block *> &preds(bb->predecessors());
+        std::set<basic_block *>::const_iterator it(preds.begin())
+                                              , end(preds.end());
+        for(; it != end; ++it) {
+            if(0U == l.body.count(*it)) {
+                return false;
+            }
+        }
+
+        exit_bbs.insert(bb);
+    }
+    return true;
+}
+
+/// keep a memory location in a register for the duration of a loop: load it
+/// in the pre-header, replace the loads/stores in the loop with copies, and
+/// store it back at each exit
+static void promote(
+    loop &l,
+    const sr_candidate &c,
+    const std::set<basic_block *> &exit_bbs
+) throw() {
+    basic_block *pre_header(l.pre_header);
+    simple_reg *addr_reg(compute_address(pre_header, c.location.address));
+    simple_reg *val_reg(new_register(c.type, PSEUDO_REG));
+
+    simple_instr *in(new_instr(LOAD_OP, c.type));
+    in->u.base.dst = val_reg;
+    in->u.base.src1 = addr_reg;
+    in->u.base.src2 = 0;
+    append(pre_header, in);
+
+    for(unsigned i(0); i < c.loads.size(); ++i) {
+        in = c.loads[i];
+        in->opcode = CPY_OP;
+        in->u.base.src1 = val_reg;
+        in->u.base.src2 = 0;
+    }
+
+    for(unsigned i(0); i < c.stores.size(); ++i) {
+        in = c.stores[i];
+        in->opcode = CPY_OP;
+        in->type = c.type;
+        in->u.base.dst = val_reg;
+        in->u.base.src1 = in->u.base.src2;
+        in->u.base.src2 = 0;
+    }
+
+    if(c.stores.empty()) {
+        return;
+    }
+
+    std::set<basic_block *>::const_iterator it(exit_bbs.begin())
+                                          , end(exit_bbs.end());
+    for(; it != end; ++it) {
+        basic_block *bb(*it);
+        in = new_instr(STR_OP, c.type);
+        in->u.base.dst = 0;
+        in->u.base.src1 = addr_reg;
+        in->u.base.src2 = val_reg;
+        instr::insert_after(in, bb->first);
+        if(bb->last == bb->first) {
+            bb->last = in;
+        }
+    }
+}
+
+/// apply a function to each basic block in a loop
+static void for_each_loop_bb(
+    loop &l,
+    void (*func)(basic_block *, sr_state &),
+    sr_state &s
+) throw() {
+    std::set<basic_block *>::iterator it(l.body.begin())
+                                    , end(l.body.end());
+    for(; it != end; ++it) {
+        if(0 != (*it)->last) {
+            func(*it, s);
+        }
+    }
+}
+
+/// replace memory locations in a loop with registers
+static bool replace_scalars(
+    optimizer &o,
+    cfg &flow,
+    dominator_map &dm,
+    alias_map &aliases,
+    summary_map &summaries,
+    loop &l
+) throw() {
+    sr_state s;
+    s.l = &l;
+    s.aliases = &aliases;
+    s.summaries = &summaries;
+    s.calls_read_memory = false;
+    s.calls_write_memory = false;
+    s.has_return = false;
+    s.will_run = false;
+
+    if(0 == l.pre_header || 0 == l.pre_header->last) {
+        return false;
+    }
+
+    for_each_loop_bb(l, find_loop_defs, s);
+    for_each_loop_bb(l, find_loop_accesses, s);
+
+    if(s.has_return || s.calls_write_memory) {
+        return false;
+    }
+
+    find_candidates(s);
+    if(s.candidates.empty()) {
+        return false;
+    }
+
+    basic_block *first_branch_bb(0);
+    s.will_run = try_prove_loop_will_run(o, l, first_branch_bb);
+    if(s.will_run) {
+        find_leaving_bbs(s, first_branch_bb);
+    }
+
+    std::set<basic_block *> exit_bbs;
+    const bool can_store(find_exit_bbs(flow, l, exit_bbs));
+    bool changed(false);
+
+    for(unsigned i(0); i < s.candidates.size(); ++i) {
+        const sr_candidate &c(s.candidates[i]);
+        if((!c.stores.empty() && !can_store)
+        || !is_always_accessed(dm, s, c)
+        || !is_isolated(s, c)
+        || !can_compute_address(l.pre_header, c.location.address)) {
+            continue;
+        }
+
+        promote(l, c, exit_bbs);
+        changed = true;
+    }
+
+    return changed;
+}
+
+/// keep memory locations accessed in loops in registers
+void replace_loop_scalars(
+    optimizer &o,
+    cfg &flow,
+    loop_map &lm,
+    alias_map &aliases,
+    summary_map &summaries
+) throw() {
+    if(0 != getenv("ECE540_DISABLE_SR")) {
+        return;
+    }
+
+    const std::vector<loop *> &loops(lm.inner_to_outer());
+
+    // promotion only adds instructions to existing blocks, so the dominators
+    // stay valid across loops
+    dominator_map &dm(o.get<dominator_map>());
+    bool updated(false);
+    for(unsigned i(0U); i < loops.size(); ++i) {
+        if(replace_scalars(o, flow, dm, aliases, summaries, *(loops[i]))) {
+            updated = true;
+        }
+    }
+
+    if(updated) {
+        o.changed_def();
+        o.changed_use();
+        o.changed_block();
+    }
+}
@@ -10,9 +10,10 @@
 
 #include "include/optimizer.h"
 
-optimizer::optimizer(simple_instr *in) throw()
+optimizer::optimizer(simple_instr *in, summary_map &summaries_) throw()
     : instructions(in)
     , flow_graph(in)
+    , summaries(summaries_)
 {
     // make sure to get the potentially updated first instruction (forced to be
     // a label)
@@ -29,8 +30,7 @@ optimizer::optimizer(simple_instr *in) throw()
 
 cfg &optimizer::get(optimizer &self, tag<cfg>, bool is_forced) throw() {
     if(self.dirty.cfg || is_forced) {
-        self.flow_graph.~cfg();
-        new (&(self.flow_graph)) cfg(self.instructions);
+        self.flow_graph.rebuild(self.instructions);
         self.dirty.cfg = false;
 
         // propagate
@@ -39,6 +39,10 @@ cfg &optimizer::get(optimizer &self, tag<cfg>, bool is_forced) throw() {
         self.dirty.var_use = true;
         self.dirty.var_def = true;
         self.dirty.loops = true;
+        self.dirty.aliases = true;
+    } else {
+        // the graph might have been edited in place
+        self.flow_graph.update_reachability();
     }
     return self.flow_graph;
 }
@@ -89,6 +93,15 @@ loop_map &optimizer::get(optimizer &self, tag<loop_map>, bool is_forced) throw()
     if(self.dirty.loops || is_forced) {
         find_loops(self.flow_graph, self.dominators, self.loops);
         self.dirty.loops = false;
+
+        // finding loops adds pre-headers to the CFG, so anything computed
+        // over the old blocks is out of date
+        if(0U != self.loops.size()) {
+            self.dirty.ae = true;
+            self.dirty.var_def = true;
+            self.dirty.var_use = true;
+            self.dirty.aliases = true;
+        }
     }
     return self.loops;
 }
@@ -111,6 +124,21 @@ def_use_map &optimizer::get(optimizer &self, tag<def_use_map>, bool is_forced) t
     return self.du_chain;
 }
 
+/// procedure summaries are never out of date w.r.t. the current procedure, as
+/// they only describe other procedures
+summary_map &optimizer::get(optimizer &self, tag<summary_map>, bool) throw() {
+    return self.summaries;
+}
+
+alias_map &optimizer::get(optimizer &self, tag<alias_map>, bool is_forced) throw() {
+    var_use_map &var_uses(get(self, tag<var_use_map>(), false));
+    if(self.dirty.aliases || is_forced) {
+        find_aliases(self.flow_graph, var_uses, self.aliases);
+        self.dirty.aliases = false;
+    }
+    return self.aliases;
+}
+
 /// dependency injector with no dependent arguments
 void optimizer::inject0(void (*callback)(optimizer &), optimizer &self) throw() {
     callback(self);
@@ -131,6 +159,7 @@ optimizer::pass optimizer::add_pass(void (*func)(optimizer &)) throw() {
 void optimizer::changed_def(void) throw() {
     dirty.ae = true;
     dirty.var_def = true;
+    dirty.aliases = true;
     changed_something = true;
 }
 
@@ -138,6 +167,7 @@ void optimizer::changed_use(void) throw() {
     dirty.ae = true;
     dirty.ud = true;
     dirty.var_use = true;
+    dirty.aliases = true;
     changed_something = true;
 }
 
@@ -146,6 +176,15 @@ void optimizer::changed_block(void) throw() {
     changed_something = true;
 }
 
+/// signal that the CFG was edited in place (see cfg::remove_edge, etc.), so
+/// it is still valid but everything computed from it is out of date
+void optimizer::changed_graph(void) throw() {
+    dirty.doms = true;
+    dirty.loops = true;
+    changed_def();
+    changed_use();
+}
+
 /// signal that a NOP has been removed; this is a special case to prevent
 /// infinite loops between the CFG aggressively replacing unused labels with
 /// NOPs and the deadcode eliminator removing NOPs. This dirties the CFG data
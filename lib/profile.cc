@@ -0,0 +1,304 @@
+/*
+ * profile.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "include/profile.h"
+#include "include/cfg.h"
+#include "include/instr.h"
+#include "include/diag.h"
+#include "include/summary.h"
+
+namespace profile {
+
+    enum {
+        /// the number of counters in the runtime; this must match
+        /// ECE540_PROFILE_NUM_COUNTERS in proj_tests/ece540_profile.h
+        NUM_COUNTERS = 65536U,
+
+        /// size (in bytes) of a counter
+        COUNTER_SIZE = 4U
+    };
+
+    /// the counters of the runtime, and the procedure that writes them out
+    static simple_sym *COUNTERS(0);
+    static simple_sym *DUMP(0);
+
+    /// the first counter of the next procedure
+    static unsigned NEXT_COUNTER(0U);
+
+    /// counts read back from ECE540_PROFILE_USE, indexed by counter
+    static std::vector<unsigned> COUNTS;
+    static bool IS_LOADED(false);
+
+    /// is a procedure part of the profiling runtime? These aren't counted.
+    static bool is_runtime(const char *proc_name) throw() {
+        return 0 == strncmp(proc_name, "ece540_profile_", 15U);
+    }
+
+    /// the signature of a procedure; a hash (FNV-1a) of its name and its
+    /// number of blocks that is never zero and fits in a signed counter
+    static unsigned signature(const char *proc_name, unsigned num_blocks) throw() {
+        uint32_t hash(2166136261U);
+        for(const char *c(proc_name); '\0' != *c; ++c) {
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619U;
+        }
+        hash = (hash ^ num_blocks) * 16777619U;
+        return (hash & 0x7FFFFFFFU) | 1U;
+    }
+
+    /// the basic blocks of a procedure, in order
+    static void find_blocks(cfg &flow, std::vector<basic_block *> &blocks) throw() {
+        for(basic_block *bb(flow.entry()->next); flow.exit() != bb; bb = bb->next) {
+            blocks.push_back(bb);
+        }
+    }
+
+    /// read the counts written by the runtime: one "counter count" pair per
+    /// line, for each counter that isn't zero
+    static void load(void) throw() {
+        if(IS_LOADED) {
+            return;
+        }
+        IS_LOADED = true;
+
+        const char *file_name(getenv("ECE540_PROFILE_USE"));
+        if(0 == file_name) {
+            return;
+        }
+
+        FILE *fp(fopen(file_name, "r"));
+        if(0 == fp) {
+            diag::warning("Unable to open the profile '%s'.", file_name);
+            return;
+        }
+
+        unsigned counter(0U), count(0U);
+        while(2 == fscanf(fp, "%u %u", &counter, &count)) {
+            if(NUM_COUNTERS <= counter) {
+                continue;
+            } else if(COUNTS.size() <= counter) {
+                COUNTS.resize(counter + 1U, 0U);
+            }
+            COUNTS[counter] = count;
+        }
+
+        fclose(fp);
+    }
+
+    /// make a new instruction after some instruction
+    static simple_instr *add_instr(
+        simple_instr *after,
+        simple_op op,
+        simple_type *type
+    ) throw() {
+        simple_instr *in(new_instr(op, type));
+        instr::insert_after(in, after);
+        return in;
+    }
+
+    /// load the address of a counter into a new register after some
+    /// instruction
+    static simple_instr *add_counter_address(
+        simple_instr *after,
+        unsigned counter,
+        simple_reg *&addr
+    ) throw() {
+        addr = new_register(simple_type_addr, TEMP_REG);
+        simple_instr *in(add_instr(after, LDC_OP, simple_type_addr));
+        in->u.ldc.dst = addr;
+        in->u.ldc.value.format = IMMED_SYMBOL;
+        in->u.ldc.value.u.s.symbol = COUNTERS;
+        in->u.ldc.value.u.s.offset = static_cast<int>(counter * COUNTER_SIZE);
+        return in;
+    }
+
+    /// store a procedure's signature into its first counter, after some
+    /// instruction
+    static simple_instr *add_signature(
+        simple_instr *after,
+        unsigned counter,
+        unsigned sig
+    ) throw() {
+        simple_reg *addr(0);
+        simple_reg *value(new_register(simple_type_signed, TEMP_REG));
+
+        simple_instr *in(add_counter_address(after, counter, addr));
+
+        in = add_instr(in, LDC_OP, simple_type_signed);
+        in->u.ldc.dst = value;
+        in->u.ldc.value.format = IMMED_INT;
+        in->u.ldc.value.u.ival = static_cast<int>(sig);
+
+        in = add_instr(in, STR_OP, simple_type_signed);
+        in->u.base.dst = 0;
+        in->u.base.src1 = addr;
+        in->u.base.src2 = value;
+        return in;
+    }
+
+    /// add one to a counter, after some instruction
+    static simple_instr *add_increment(simple_instr *after, unsigned counter) throw() {
+        simple_reg *addr(0);
+        simple_reg *old_count(new_register(simple_type_signed, TEMP_REG));
+        simple_reg *one(new_register(simple_type_signed, TEMP_REG));
+        simple_reg *new_count(new_register(simple_type_signed, TEMP_REG));
+
+        simple_instr *in(add_counter_address(after, counter, addr));
+
+        in = add_instr(in, LOAD_OP, simple_type_signed);
+        in->u.base.dst = old_count;
+        in->u.base.src1 = addr;
+        in->u.base.src2 = 0;
+
+        in = add_instr(in, LDC_OP, simple_type_signed);
+        in->u.ldc.dst = one;
+        in->u.ldc.value.format = IMMED_INT;
+        in->u.ldc.value.u.ival = 1;
+
+        in = add_instr(in, ADD_OP, simple_type_signed);
+        in->u.base.dst = new_count;
+        in->u.base.src1 = old_count;
+        in->u.base.src2 = one;
+
+        in = add_instr(in, STR_OP, simple_type_signed);
+        in->u.base.dst = 0;
+        in->u.base.src1 = addr;
+        in->u.base.src2 = new_count;
+        return in;
+    }
+
+    /// call the runtime to write out the counters, before some instruction
+    static void add_dump(simple_instr *before) throw() {
+        simple_reg *proc(new_register(simple_type_addr, TEMP_REG));
+
+        simple_instr *ldc(new_instr(LDC_OP, simple_type_addr));
+        ldc->u.ldc.dst = proc;
+        ldc->u.ldc.value.format = IMMED_SYMBOL;
+        ldc->u.ldc.value.u.s.symbol = DUMP;
+        ldc->u.ldc.value.u.s.offset = 0;
+
+        simple_instr *call(new_instr(CALL_OP, simple_type_void));
+        call->u.call.dst = 0;
+        call->u.call.proc = proc;
+        call->u.call.nargs = 0U;
+        call->u.call.args = 0;
+
+        instr::insert_before(ldc, before);
+        instr::insert_before(call, before);
+    }
+
+    /// does an instruction end the program?
+    static bool is_exit(const simple_instr *in, bool is_main) throw() {
+        if(is_main && instr::is_return(in)) {
+            return true;
+        } else if(CALL_OP != in->opcode) {
+            return false;
+        }
+        simple_sym *proc(summary_map::callee(in));
+        return 0 != proc && 0 == strcmp(proc->name, "exit");
+    }
+
+    bool is_generating(void) throw() {
+        return 0 != getenv("ECE540_PROFILE_GENERATE");
+    }
+
+    bool is_using(void) throw() {
+        return 0 != getenv("ECE540_PROFILE_USE");
+    }
+
+    void find_runtime(simple_instr *in) throw() {
+        for(; 0 != in; in = in->next) {
+            if(LDC_OP != in->opcode
+            || IMMED_SYMBOL != in->u.ldc.value.format) {
+                continue;
+            }
+
+            simple_sym *sym(in->u.ldc.value.u.s.symbol);
+            if(0 == strcmp(sym->name, "ece540_profile_counters")) {
+                COUNTERS = sym;
+            } else if(0 == strcmp(sym->name, "ece540_profile_dump")) {
+                DUMP = sym;
+            }
+        }
+    }
+
+    /// add a counter to the beginning of each block, store the signature of
+    /// the procedure when it is entered, and call the runtime to write out the
+    /// counters before the program ends
+    void instrument(const char *proc_name, cfg &flow) throw() {
+        if(is_runtime(proc_name)) {
+            return;
+        }
+
+        std::vector<basic_block *> blocks;
+        find_blocks(flow, blocks);
+
+        const unsigned num_blocks(static_cast<unsigned>(blocks.size()));
+        const unsigned first_counter(NEXT_COUNTER);
+        NEXT_COUNTER += 1U + num_blocks;
+
+        if(0U == num_blocks) {
+            return;
+        } else if(0 == COUNTERS || 0 == DUMP) {
+            diag::warning(
+                "Unable to instrument '%s'; the profiling runtime must come "
+                "first.", proc_name);
+            return;
+        } else if(NUM_COUNTERS < NEXT_COUNTER) {
+            diag::warning(
+                "Unable to instrument '%s'; out of profile counters.", proc_name);
+            return;
+        }
+
+        for(unsigned i(0U); i < num_blocks; ++i) {
+            simple_instr *in(blocks[i]->first);
+            if(0U == i) {
+                in = add_signature(
+                    in, first_counter, signature(proc_name, num_blocks));
+            }
+            add_increment(in, first_counter + 1U + i);
+        }
+
+        const bool is_main(0 == strcmp(proc_name, "main"));
+        for(simple_instr *in(blocks[0]->first); 0 != in; in = in->next) {
+            if(is_exit(in, is_main)) {
+                add_dump(in);
+            }
+        }
+    }
+
+    /// attach counts to the blocks of a procedure, if the profile has counts
+    /// for the procedure and they are for the same blocks
+    void attach(const char *proc_name, cfg &flow) throw() {
+        if(is_runtime(proc_name)) {
+            return;
+        }
+
+        std::vector<basic_block *> blocks;
+        find_blocks(flow, blocks);
+
+        const unsigned num_blocks(static_cast<unsigned>(blocks.size()));
+        const unsigned first_counter(NEXT_COUNTER);
+        NEXT_COUNTER += 1U + num_blocks;
+
+        load();
+        if(COUNTS.size() <= first_counter
+        || signature(proc_name, num_blocks) != COUNTS[first_counter]) {
+            return;
+        }
+
+        for(unsigned i(0U); i < num_blocks; ++i) {
+            const unsigned counter(first_counter + 1U + i);
+            flow.set_count(blocks[i], counter < COUNTS.size() ? COUNTS[counter] : 0U);
+        }
+    }
+}
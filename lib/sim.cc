@@ -0,0 +1,1533 @@
+/*
+ * sim.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "include/sim.h"
+#include "include/optimizer.h"
+#include "include/fold.h"
+
+#include "include/data_flow/var_use.h"
+
+namespace sim {
+
+    enum {
+        /// the versions of the program
+        BEFORE = 0U,
+        AFTER = 1U,
+        NUM_VERSIONS = 2U,
+
+        /// memory is made of pages that are zeroed when they are first used
+        PAGE_BITS = 12U,
+        PAGE_SIZE = 1U << PAGE_BITS,
+        NUM_PAGES = 1U << (32U - PAGE_BITS),
+
+        /// how deep calls can nest before the program is stopped
+        MAX_CALL_DEPTH = 10000U,
+
+        /// the longest string that the string procedures will look at
+        MAX_STRING_LENGTH = 1U << 20U,
+
+        /// the default number of instructions to run before the program is
+        /// stopped; this is changed with ECE540_SIM_MAX_STEPS
+        DEFAULT_MAX_STEPS = 100000000U,
+
+        /// the default number of times that each procedure is run on random
+        /// arguments; this is changed with ECE540_SIM_TRIALS
+        DEFAULT_NUM_TRIALS = 20U,
+
+        /// the number of instructions to run on random arguments before
+        /// giving up on a trial
+        MAX_TRIAL_STEPS = 1000000U,
+
+        /// the size of the memory that pointer arguments point to
+        ARG_BUFFER_SIZE = 4096U
+    };
+
+    /// symbols are in the bottom half of the address space, and the heap is
+    /// in the top half
+    static const uint32_t HEAP_BASE(0x80000000U);
+
+    /// the largest part of the address space that a symbol gets
+    static const uint32_t MAX_SYMBOL_SIZE(1U << 28U);
+
+    /// how a program stopped
+    typedef enum {
+        RUNNING,
+        RETURNED,
+        EXITED,
+        TRAPPED,
+        OUT_OF_STEPS
+    } status;
+
+    /// a decoded instruction. Registers are numbered within their procedure
+    /// (-1 means no register), symbols are numbered within the program, and
+    /// labels are replaced by the index of the instruction that they label.
+    struct instruction {
+    public:
+        simple_op op;
+        const simple_type *type;
+
+        int dst;
+        int src1;
+        int src2;
+        const simple_type *dst_type;
+        const simple_type *src1_type;
+        const simple_type *src2_type;
+
+        // LDC
+        fold::value value;
+        int symbol;
+
+        // JMP, BTRUE, BFALSE, and the default target of an MBR
+        unsigned target;
+
+        // MBR
+        int offset;
+        std::vector<unsigned> targets;
+
+        // CALL
+        std::vector<int> args;
+        std::vector<const simple_type *> arg_types;
+    };
+
+    /// a decoded procedure. Its parameters are its first registers.
+    struct procedure {
+    public:
+        std::string name;
+        std::vector<instruction> code;
+        unsigned num_regs;
+        unsigned num_params;
+        std::vector<const simple_type *> param_types;
+        const simple_type *return_type;
+    };
+
+    /// a symbol whose address is used by the program
+    struct symbol {
+    public:
+        std::string name;
+        bool is_proc;
+    };
+
+    /// the symbols of the program, in the order that they were found
+    static std::vector<symbol> SYMBOLS;
+    static std::map<simple_sym *, int> SYMBOL_IDS;
+
+    /// the procedures of each version of the program, and their ids by name
+    static std::vector<procedure *> PROCEDURES[NUM_VERSIONS];
+    static std::map<std::string, unsigned> PROCEDURE_IDS[NUM_VERSIONS];
+
+    /// the parameters of the procedure that is being optimized
+    static std::vector<simple_reg *> PARAMS;
+
+    /// a running program
+    struct machine {
+    public:
+        unsigned version;
+        status state;
+        std::string reason;
+        int exit_code;
+
+        // memory
+        std::vector<unsigned char *> pages;
+        std::vector<uint32_t> used_pages;
+        uint32_t symbol_size;
+        uint32_t heap_top;
+        std::map<uint32_t, uint32_t> allocations;
+
+        // counts
+        uint64_t steps;
+        uint64_t max_steps;
+        std::vector<uint64_t> op_counts;
+        std::vector<uint64_t> proc_counts;
+        unsigned depth;
+
+        // the calls to the C library that did I/O, and the calls to unknown
+        // procedures
+        std::vector<std::string> trace;
+        std::set<std::string> unknown;
+
+        uint32_t rand_state;
+
+        machine(unsigned) throw();
+        ~machine(void) throw();
+
+        /// forget everything that ran, and zero the memory
+        void reset(void) throw();
+    };
+
+    /// a call to a procedure of the C library
+    struct library_call {
+    public:
+        const char *name;
+        std::vector<fold::value> args;
+        std::vector<const simple_type *> arg_types;
+        fold::value result;
+    };
+
+    typedef bool (*library_procedure)(machine &, library_call &);
+
+    static fold::value zero_value(void) throw() {
+        fold::value val;
+        val.i = 0;
+        val.f = 0.0;
+        return val;
+    }
+
+    machine::machine(unsigned version_) throw()
+        : version(version_)
+        , state(RUNNING)
+        , exit_code(0)
+        , pages(NUM_PAGES, 0)
+        , symbol_size(MAX_SYMBOL_SIZE)
+        , heap_top(HEAP_BASE)
+        , steps(0U)
+        , max_steps(DEFAULT_MAX_STEPS)
+        , op_counts(LAST_OP, 0U)
+        , proc_counts(PROCEDURES[version_].size(), 0U)
+        , depth(0U)
+        , rand_state(1U)
+    {
+        // split the bottom half of the address space between the symbols;
+        // the first part is left out, so that null pointers can be caught
+        const uint32_t num_parts(static_cast<uint32_t>(SYMBOLS.size()) + 1U);
+        while(num_parts > HEAP_BASE / symbol_size && 16U < symbol_size) {
+            symbol_size /= 2U;
+        }
+
+        const char *max_steps_str(getenv("ECE540_SIM_MAX_STEPS"));
+        if(0 != max_steps_str && 0 < atol(max_steps_str)) {
+            max_steps = static_cast<uint64_t>(atol(max_steps_str));
+        }
+    }
+
+    machine::~machine(void) throw() {
+        reset();
+    }
+
+    void machine::reset(void) throw() {
+        for(unsigned i(0U); i < used_pages.size(); ++i) {
+            delete [] pages[used_pages[i]];
+            pages[used_pages[i]] = 0;
+        }
+        used_pages.clear();
+
+        state = RUNNING;
+        reason.clear();
+        exit_code = 0;
+        heap_top = HEAP_BASE;
+        allocations.clear();
+        steps = 0U;
+        std::fill(op_counts.begin(), op_counts.end(), 0U);
+        std::fill(proc_counts.begin(), proc_counts.end(), 0U);
+        depth = 0U;
+        trace.clear();
+        unknown.clear();
+        rand_state = 1U;
+    }
+
+    bool is_simulating(void) throw() {
+        return 0 != getenv("ECE540_SIMULATE");
+    }
+
+    /// order registers in the order that they were made
+    static bool register_less(const simple_reg *a, const simple_reg *b) throw() {
+        return a->num < b->num;
+    }
+
+    static const simple_type *type_of(const simple_reg *reg) throw() {
+        return 0 == reg ? 0 : reg->var->type;
+    }
+
+    /// state used to decode a procedure
+    struct decoder {
+    public:
+        procedure *proc;
+        std::map<simple_reg *, int> regs;
+        std::map<simple_sym *, unsigned> labels;
+    };
+
+    static int find_reg(decoder &d, simple_reg *reg) throw() {
+        if(0 == reg) {
+            return -1;
+        }
+
+        std::map<simple_reg *, int>::iterator it(d.regs.find(reg));
+        if(d.regs.end() != it) {
+            return it->second;
+        }
+
+        const int id(static_cast<int>(d.proc->num_regs++));
+        d.regs[reg] = id;
+        return id;
+    }
+
+    /// the index of the instruction of a label; jumping to a label that
+    /// isn't there ends the procedure
+    static unsigned find_label(decoder &d, simple_sym *label) throw() {
+        std::map<simple_sym *, unsigned>::iterator it(d.labels.find(label));
+        if(d.labels.end() == it) {
+            return static_cast<unsigned>(d.proc->code.size());
+        }
+        return it->second;
+    }
+
+    static int find_symbol(simple_sym *sym) throw() {
+        std::map<simple_sym *, int>::iterator it(SYMBOL_IDS.find(sym));
+        if(SYMBOL_IDS.end() != it) {
+            return it->second;
+        }
+
+        symbol s;
+        s.name = sym->name;
+        s.is_proc = PROC_SYM == sym->kind;
+
+        const int id(static_cast<int>(SYMBOLS.size()));
+        SYMBOLS.push_back(s);
+        SYMBOL_IDS[sym] = id;
+        return id;
+    }
+
+    /// decode the constant loaded by an LDC
+    static void decode_ldc(instruction &i, const simple_immed &imm) throw() {
+        switch(imm.format) {
+        case IMMED_INT:
+            if(fold::is_integral(i.dst_type)) {
+                i.value.i = fold::int_value(imm, i.dst_type);
+            } else {
+                i.value.i = imm.u.ival;
+            }
+            break;
+
+        case IMMED_FLOAT:
+            i.value.f = imm.u.fval;
+            if(32 == i.dst_type->len) {
+                i.value.f = static_cast<float>(i.value.f);
+            }
+            break;
+
+        case IMMED_SYMBOL:
+            i.symbol = find_symbol(imm.u.s.symbol);
+            i.value.i = imm.u.s.offset;
+            break;
+        }
+    }
+
+    /// decode the instructions of a procedure, so that they can be run after
+    /// the procedure is freed
+    static void decode(procedure &proc, simple_instr *first) throw() {
+        decoder d;
+        d.proc = &proc;
+        proc.num_regs = 0U;
+
+        for(unsigned p(0U); p < PARAMS.size(); ++p) {
+            find_reg(d, PARAMS[p]);
+            proc.param_types.push_back(type_of(PARAMS[p]));
+        }
+        proc.num_params = static_cast<unsigned>(PARAMS.size());
+        proc.return_type = 0;
+
+        unsigned num_instrs(0U);
+        for(simple_instr *in(first); 0 != in; in = in->next, ++num_instrs) {
+            if(LABEL_OP == in->opcode) {
+                d.labels[in->u.label.lab] = num_instrs;
+            }
+        }
+        proc.code.resize(num_instrs);
+
+        unsigned index(0U);
+        for(simple_instr *in(first); 0 != in; in = in->next, ++index) {
+            instruction &i(proc.code[index]);
+            i.op = in->opcode;
+            i.type = in->type;
+            i.dst = i.src1 = i.src2 = -1;
+            i.dst_type = i.src1_type = i.src2_type = 0;
+            i.value = zero_value();
+            i.symbol = -1;
+            i.target = 0U;
+            i.offset = 0;
+
+            switch(in->opcode) {
+            case NOP_OP: case LABEL_OP:
+                break;
+
+            case JMP_OP:
+                i.target = find_label(d, in->u.bj.target);
+                break;
+
+            case BTRUE_OP: case BFALSE_OP:
+                i.src1 = find_reg(d, in->u.bj.src);
+                i.src1_type = type_of(in->u.bj.src);
+                i.target = find_label(d, in->u.bj.target);
+                break;
+
+            case MBR_OP:
+                i.src1 = find_reg(d, in->u.mbr.src);
+                i.src1_type = type_of(in->u.mbr.src);
+                i.offset = in->u.mbr.offset;
+                i.target = find_label(d, in->u.mbr.deflab);
+                for(unsigned t(0U); t < in->u.mbr.ntargets; ++t) {
+                    i.targets.push_back(find_label(d, in->u.mbr.targets[t]));
+                }
+                break;
+
+            case LDC_OP:
+                i.dst = find_reg(d, in->u.ldc.dst);
+                i.dst_type = type_of(in->u.ldc.dst);
+                decode_ldc(i, in->u.ldc.value);
+                break;
+
+            case CALL_OP:
+                i.dst = find_reg(d, in->u.call.dst);
+                i.dst_type = type_of(in->u.call.dst);
+                i.src1 = find_reg(d, in->u.call.proc);
+                for(unsigned a(0U); a < in->u.call.nargs; ++a) {
+                    i.args.push_back(find_reg(d, in->u.call.args[a]));
+                    i.arg_types.push_back(type_of(in->u.call.args[a]));
+                }
+                break;
+
+            case RET_OP:
+                i.src1 = find_reg(d, in->u.base.src1);
+                i.src1_type = type_of(in->u.base.src1);
+                if(0 == proc.return_type) {
+                    proc.return_type = i.src1_type;
+                }
+                break;
+
+            default:
+                i.dst = find_reg(d, in->u.base.dst);
+                i.src1 = find_reg(d, in->u.base.src1);
+                i.src2 = find_reg(d, in->u.base.src2);
+                i.dst_type = type_of(in->u.base.dst);
+                i.src1_type = type_of(in->u.base.src1);
+                i.src2_type = type_of(in->u.base.src2);
+                break;
+            }
+        }
+    }
+
+    static void record(unsigned version, const char *proc_name, simple_instr *first) throw() {
+        procedure *proc(new procedure);
+        proc->name = proc_name;
+        decode(*proc, first);
+
+        PROCEDURE_IDS[version][proc->name] =
+            static_cast<unsigned>(PROCEDURES[version].size());
+        PROCEDURES[version].push_back(proc);
+    }
+
+    /// record a procedure before it's optimized, and find its parameters:
+    /// these are the pseudo registers that are live on entry
+    void record_before(const char *proc_name, optimizer &o) throw() {
+        if(!is_simulating()) {
+            return;
+        }
+
+        cfg &flow(o.get<cfg>());
+        var_use_map &var_uses(o.get<var_use_map>());
+
+        std::set<basic_block *> entry_bbs(flow.entry()->successors());
+        entry_bbs.insert(flow.entry());
+
+        std::set<simple_reg *> params;
+        std::set<basic_block *>::iterator bb_it(entry_bbs.begin())
+                                        , bb_end(entry_bbs.end());
+        for(; bb_it != bb_end; ++bb_it) {
+            var_use_set &live_in(var_uses(*bb_it));
+            var_use_set::iterator it(live_in.begin()), end(live_in.end());
+            for(; it != end; ++it) {
+                if(PSEUDO_REG == it->reg->kind) {
+                    params.insert(it->reg);
+                }
+            }
+        }
+
+        PARAMS.assign(params.begin(), params.end());
+        std::sort(PARAMS.begin(), PARAMS.end(), &register_less);
+
+        record(BEFORE, proc_name, o.first_instruction());
+    }
+
+    void record_after(const char *proc_name, optimizer &o) throw() {
+        if(!is_simulating()) {
+            return;
+        }
+        record(AFTER, proc_name, o.first_instruction());
+    }
+
+    /// stop the program
+    static bool stop(machine &m, status state, const char *reason) throw() {
+        if(RUNNING == m.state) {
+            m.state = state;
+            m.reason = reason;
+        }
+        return false;
+    }
+
+    static bool trap(machine &m, const char *what, const std::string &where) throw() {
+        return stop(m, TRAPPED, (std::string(what) + " in " + where).c_str());
+    }
+
+    static uint32_t address_of(const fold::value &val) throw() {
+        return static_cast<uint32_t>(val.i);
+    }
+
+    static uint32_t symbol_address(machine &m, int sym) throw() {
+        return static_cast<uint32_t>(sym + 1) * m.symbol_size;
+    }
+
+    /// the symbol at the beginning of which some address is, if any
+    static int symbol_at(machine &m, uint32_t addr) throw() {
+        if(HEAP_BASE <= addr || 0U != addr % m.symbol_size) {
+            return -1;
+        }
+
+        const uint32_t part(addr / m.symbol_size);
+        if(0U == part || SYMBOLS.size() < part) {
+            return -1;
+        }
+        return static_cast<int>(part - 1U);
+    }
+
+    static unsigned char *find_page(machine &m, uint32_t addr) throw() {
+        unsigned char *&page(m.pages[addr >> PAGE_BITS]);
+        if(0 == page) {
+            page = new unsigned char[PAGE_SIZE];
+            memset(page, 0, PAGE_SIZE);
+            m.used_pages.push_back(addr >> PAGE_BITS);
+        }
+        return page;
+    }
+
+    /// can some memory be accessed? The first part of the address space is
+    /// where null pointers point.
+    static bool can_access(machine &m, uint32_t addr, uint32_t size) throw() {
+        return m.symbol_size <= addr && addr <= ~size;
+    }
+
+    static void read_bytes(machine &m, uint32_t addr, unsigned char *bytes, uint32_t size) throw() {
+        while(0U < size) {
+            const uint32_t page_offset(addr & (PAGE_SIZE - 1U));
+            const uint32_t len(std::min(size, PAGE_SIZE - page_offset));
+            memcpy(bytes, find_page(m, addr) + page_offset, len);
+            addr += len;
+            bytes += len;
+            size -= len;
+        }
+    }
+
+    static void write_bytes(machine &m, uint32_t addr, const unsigned char *bytes, uint32_t size) throw() {
+        while(0U < size) {
+            const uint32_t page_offset(addr & (PAGE_SIZE - 1U));
+            const uint32_t len(std::min(size, PAGE_SIZE - page_offset));
+            memcpy(find_page(m, addr) + page_offset, bytes, len);
+            addr += len;
+            bytes += len;
+            size -= len;
+        }
+    }
+
+    /// the number of bytes in a value that can be loaded and stored
+    static uint32_t size_of(const simple_type *type) throw() {
+        if(fold::NO_ARITH == fold::arithmetic_of(type) || 0 != type->len % 8) {
+            return 0U;
+        }
+        return static_cast<uint32_t>(type->len / 8);
+    }
+
+    /// load a value from memory; values are little-endian
+    static bool load(
+        machine &m,
+        uint32_t addr,
+        const simple_type *type,
+        fold::value &val,
+        const std::string &where
+    ) throw() {
+        const uint32_t size(size_of(type));
+        if(0U == size) {
+            return trap(m, "load of an unknown type", where);
+        } else if(!can_access(m, addr, size)) {
+            return trap(m, "load from a bad address", where);
+        }
+
+        unsigned char bytes[8];
+        read_bytes(m, addr, bytes, size);
+
+        uint64_t bits(0U);
+        for(uint32_t b(size); b-- > 0U; ) {
+            bits = (bits << 8U) | bytes[b];
+        }
+
+        val = zero_value();
+        if(fold::FLOAT_ARITH != fold::arithmetic_of(type)) {
+            val.i = fold::normalize(static_cast<int64_t>(bits), type);
+        } else if(4U == size) {
+            const uint32_t bits32(static_cast<uint32_t>(bits));
+            float f(0.0f);
+            memcpy(&f, &bits32, sizeof f);
+            val.f = f;
+        } else {
+            memcpy(&(val.f), &bits, sizeof val.f);
+        }
+        return true;
+    }
+
+    /// store a value into memory
+    static bool store(
+        machine &m,
+        uint32_t addr,
+        const simple_type *type,
+        const fold::value &val,
+        const std::string &where
+    ) throw() {
+        const uint32_t size(size_of(type));
+        if(0U == size) {
+            return trap(m, "store of an unknown type", where);
+        } else if(!can_access(m, addr, size)) {
+            return trap(m, "store to a bad address", where);
+        }
+
+        uint64_t bits(static_cast<uint64_t>(val.i));
+        if(fold::FLOAT_ARITH != fold::arithmetic_of(type)) {
+            // nothing to convert
+        } else if(4U == size) {
+            const float f(static_cast<float>(val.f));
+            uint32_t bits32(0U);
+            memcpy(&bits32, &f, sizeof bits32);
+            bits = bits32;
+        } else {
+            memcpy(&bits, &(val.f), sizeof bits);
+        }
+
+        unsigned char bytes[8];
+        for(uint32_t b(0U); b < size; ++b, bits >>= 8U) {
+            bytes[b] = static_cast<unsigned char>(bits & 0xFFU);
+        }
+        write_bytes(m, addr, bytes, size);
+        return true;
+    }
+
+    /// copy memory; the two parts can overlap
+    static bool copy(machine &m, uint32_t dst, uint32_t src, uint32_t size) throw() {
+        if(!can_access(m, dst, size) || !can_access(m, src, size)) {
+            return false;
+        }
+        std::vector<unsigned char> bytes(size);
+        if(0U < size) {
+            read_bytes(m, src, &(bytes[0]), size);
+            write_bytes(m, dst, &(bytes[0]), size);
+        }
+        return true;
+    }
+
+    /// allocate memory from the heap; memory is never reused, so it is
+    /// always zeroed
+    static uint32_t allocate(machine &m, uint32_t size) throw() {
+        const uint32_t addr(m.heap_top);
+        const uint32_t rounded((size + 15U) & ~15U);
+        if(rounded < size || ~addr < rounded + 16U) {
+            return 0U;
+        }
+        m.heap_top += rounded + 16U;
+        m.allocations[addr] = size;
+        return addr;
+    }
+
+    /// read a nul-terminated string
+    static bool read_string(machine &m, uint32_t addr, std::string &str) throw() {
+        str.clear();
+        for(uint32_t len(0U); len < MAX_STRING_LENGTH; ++len, ++addr) {
+            if(!can_access(m, addr, 1U)) {
+                return false;
+            }
+
+            unsigned char c(0U);
+            read_bytes(m, addr, &c, 1U);
+            if('\0' == c) {
+                return true;
+            }
+            str.push_back(static_cast<char>(c));
+        }
+        return false;
+    }
+
+    static int64_t int_arg(const library_call &call, unsigned i) throw() {
+        if(call.args.size() <= i) {
+            return 0;
+        } else if(fold::FLOAT_ARITH == fold::arithmetic_of(call.arg_types[i])) {
+            return static_cast<int64_t>(call.args[i].f);
+        }
+        return call.args[i].i;
+    }
+
+    static double float_arg(const library_call &call, unsigned i) throw() {
+        if(call.args.size() <= i) {
+            return 0.0;
+        } else if(fold::FLOAT_ARITH == fold::arithmetic_of(call.arg_types[i])) {
+            return call.args[i].f;
+        }
+        return static_cast<double>(call.args[i].i);
+    }
+
+    static uint32_t address_arg(const library_call &call, unsigned i) throw() {
+        return static_cast<uint32_t>(int_arg(call, i));
+    }
+
+    /// add a call to the trace, e.g. "printf(4096, 1.5)"; the contents of
+    /// strings aren't known, so only the arguments themselves are recorded
+    static void add_to_trace(machine &m, const library_call &call) throw() {
+        std::string entry(call.name);
+        entry += "(";
+        for(unsigned i(0U); i < call.args.size(); ++i) {
+            char arg[64];
+            if(fold::FLOAT_ARITH == fold::arithmetic_of(call.arg_types[i])) {
+                sprintf(arg, "%s%g", 0U == i ? "" : ", ", call.args[i].f);
+            } else {
+                sprintf(arg, "%s%lld", 0U == i ? "" : ", ",
+                    static_cast<long long>(call.args[i].i));
+            }
+            entry += arg;
+        }
+        entry += ")";
+        m.trace.push_back(entry);
+    }
+
+    /// output, e.g. printf; the result is zero
+    static bool library_output(machine &m, library_call &call) throw() {
+        add_to_trace(m, call);
+        return true;
+    }
+
+    /// output of a character, e.g. putchar; the result is the character
+    static bool library_output_char(machine &m, library_call &call) throw() {
+        add_to_trace(m, call);
+        call.result.i = int_arg(call, 0U);
+        return true;
+    }
+
+    /// input, e.g. getchar or scanf; there is none, so the result is EOF
+    static bool library_input(machine &m, library_call &call) throw() {
+        add_to_trace(m, call);
+        call.result.i = -1;
+        return true;
+    }
+
+    /// input of a string, e.g. fgets; the result is a null pointer
+    static bool library_input_string(machine &m, library_call &call) throw() {
+        add_to_trace(m, call);
+        return true;
+    }
+
+    static bool library_fopen(machine &m, library_call &call) throw() {
+        add_to_trace(m, call);
+        call.result.i = allocate(m, 64U);
+        return true;
+    }
+
+    static bool library_malloc(machine &m, library_call &call) throw() {
+        call.result.i = allocate(m, address_arg(call, 0U));
+        return true;
+    }
+
+    static bool library_calloc(machine &m, library_call &call) throw() {
+        const uint64_t size(
+            static_cast<uint64_t>(address_arg(call, 0U)) * address_arg(call, 1U));
+        if(size <= 0xFFFFFFFFU) {
+            call.result.i = allocate(m, static_cast<uint32_t>(size));
+        }
+        return true;
+    }
+
+    static bool library_realloc(machine &m, library_call &call) throw() {
+        const uint32_t old_addr(address_arg(call, 0U));
+        const uint32_t size(address_arg(call, 1U));
+        const uint32_t addr(allocate(m, size));
+
+        std::map<uint32_t, uint32_t>::iterator it(m.allocations.find(old_addr));
+        if(0U != addr && m.allocations.end() != it) {
+            copy(m, addr, old_addr, std::min(size, it->second));
+        }
+        call.result.i = addr;
+        return true;
+    }
+
+    static bool library_free(machine &, library_call &) throw() {
+        return true;
+    }
+
+    static bool library_memset(machine &m, library_call &call) throw() {
+        const uint32_t addr(address_arg(call, 0U));
+        const uint32_t size(address_arg(call, 2U));
+        if(!can_access(m, addr, size)) {
+            return stop(m, TRAPPED, "memset of a bad address");
+        }
+
+        const std::vector<unsigned char> bytes(
+            size, static_cast<unsigned char>(int_arg(call, 1U)));
+        if(0U < size) {
+            write_bytes(m, addr, &(bytes[0]), size);
+        }
+        call.result.i = addr;
+        return true;
+    }
+
+    static bool library_memcpy(machine &m, library_call &call) throw() {
+        if(!copy(m, address_arg(call, 0U), address_arg(call, 1U), address_arg(call, 2U))) {
+            return stop(m, TRAPPED, "memcpy of a bad address");
+        }
+        call.result.i = address_arg(call, 0U);
+        return true;
+    }
+
+    static bool library_strlen(machine &m, library_call &call) throw() {
+        std::string str;
+        if(!read_string(m, address_arg(call, 0U), str)) {
+            return stop(m, TRAPPED, "strlen of a bad string");
+        }
+        call.result.i = static_cast<int64_t>(str.size());
+        return true;
+    }
+
+    static bool library_strcpy(machine &m, library_call &call) throw() {
+        std::string str;
+        const uint32_t addr(address_arg(call, 0U));
+        if(!read_string(m, address_arg(call, 1U), str)
+        || !can_access(m, addr, static_cast<uint32_t>(str.size()) + 1U)) {
+            return stop(m, TRAPPED, "strcpy of a bad string");
+        }
+
+        const uint32_t size(static_cast<uint32_t>(str.size()) + 1U);
+        write_bytes(m, addr, reinterpret_cast<const unsigned char *>(str.c_str()), size);
+        call.result.i = addr;
+        return true;
+    }
+
+    static bool library_strcmp(machine &m, library_call &call) throw() {
+        std::string a, b;
+        if(!read_string(m, address_arg(call, 0U), a)
+        || !read_string(m, address_arg(call, 1U), b)) {
+            return stop(m, TRAPPED, "strcmp of a bad string");
+        }
+        call.result.i = a.compare(b);
+        return true;
+    }
+
+    static bool library_atoi(machine &m, library_call &call) throw() {
+        std::string str;
+        if(!read_string(m, address_arg(call, 0U), str)) {
+            return stop(m, TRAPPED, "atoi of a bad string");
+        }
+        call.result.i = atoi(str.c_str());
+        return true;
+    }
+
+    static bool library_exit(machine &m, library_call &call) throw() {
+        m.exit_code = static_cast<int>(int_arg(call, 0U));
+        return stop(m, EXITED, "exit");
+    }
+
+    static bool library_abort(machine &m, library_call &) throw() {
+        return stop(m, TRAPPED, "abort");
+    }
+
+    static bool library_abs(machine &, library_call &call) throw() {
+        const int64_t x(int_arg(call, 0U));
+        call.result.i = 0 > x ? -x : x;
+        return true;
+    }
+
+    /// a procedure of the C library that is always zero, e.g. time
+    static bool library_zero(machine &, library_call &) throw() {
+        return true;
+    }
+
+    /// the random numbers are the same every run; rand is the example from
+    /// the C standard
+    static bool library_rand(machine &m, library_call &call) throw() {
+        m.rand_state = m.rand_state * 1103515245U + 12345U;
+        call.result.i = (m.rand_state / 65536U) % 32768U;
+        return true;
+    }
+
+    static bool library_srand(machine &m, library_call &call) throw() {
+        m.rand_state = static_cast<uint32_t>(int_arg(call, 0U));
+        return true;
+    }
+
+#define SIM_MATH_PROCEDURE(name, expr) \
+    static bool library_ ## name(machine &, library_call &call) throw() { \
+        const double x(float_arg(call, 0U)); \
+        const double y(float_arg(call, 1U)); \
+        (void) y; \
+        call.result.f = (expr); \
+        return true; \
+    }
+
+    SIM_MATH_PROCEDURE(fabs, fabs(x))
+    SIM_MATH_PROCEDURE(sqrt, sqrt(x))
+    SIM_MATH_PROCEDURE(sin, sin(x))
+    SIM_MATH_PROCEDURE(cos, cos(x))
+    SIM_MATH_PROCEDURE(tan, tan(x))
+    SIM_MATH_PROCEDURE(atan, atan(x))
+    SIM_MATH_PROCEDURE(exp, exp(x))
+    SIM_MATH_PROCEDURE(log, log(x))
+    SIM_MATH_PROCEDURE(log10, log10(x))
+    SIM_MATH_PROCEDURE(floor, floor(x))
+    SIM_MATH_PROCEDURE(ceil, ceil(x))
+    SIM_MATH_PROCEDURE(pow, pow(x, y))
+    SIM_MATH_PROCEDURE(atan2, atan2(x, y))
+
+#undef SIM_MATH_PROCEDURE
+
+    /// the procedures of the C library that are stubbed out
+    static std::map<std::string, library_procedure> LIBRARY;
+
+    static void init_library(void) throw() {
+        if(!LIBRARY.empty()) {
+            return;
+        }
+
+        const char *outputs[] = {
+            "printf", "fprintf", "sprintf", "puts", "fputs", "fwrite",
+            "fflush", "fclose", 0
+        };
+        const char *char_outputs[] = {"putchar", "putc", "fputc", 0};
+        const char *inputs[] = {
+            "scanf", "fscanf", "sscanf", "getchar", "getc", "fgetc", "fread", 0
+        };
+        const char *string_inputs[] = {"gets", "fgets", 0};
+        const char *zeros[] = {"time", "clock", "setbuf", "setvbuf", 0};
+
+        for(unsigned i(0U); 0 != outputs[i]; ++i) {
+            LIBRARY[outputs[i]] = &library_output;
+        }
+        for(unsigned i(0U); 0 != char_outputs[i]; ++i) {
+            LIBRARY[char_outputs[i]] = &library_output_char;
+        }
+        for(unsigned i(0U); 0 != inputs[i]; ++i) {
+            LIBRARY[inputs[i]] = &library_input;
+        }
+        for(unsigned i(0U); 0 != string_inputs[i]; ++i) {
+            LIBRARY[string_inputs[i]] = &library_input_string;
+        }
+        for(unsigned i(0U); 0 != zeros[i]; ++i) {
+            LIBRARY[zeros[i]] = &library_zero;
+        }
+
+        LIBRARY["fopen"] = &library_fopen;
+        LIBRARY["malloc"] = &library_malloc;
+        LIBRARY["calloc"] = &library_calloc;
+        LIBRARY["realloc"] = &library_realloc;
+        LIBRARY["free"] = &library_free;
+        LIBRARY["memset"] = &library_memset;
+        LIBRARY["memcpy"] = &library_memcpy;
+        LIBRARY["memmove"] = &library_memcpy;
+        LIBRARY["strlen"] = &library_strlen;
+        LIBRARY["strcpy"] = &library_strcpy;
+        LIBRARY["strcmp"] = &library_strcmp;
+        LIBRARY["atoi"] = &library_atoi;
+        LIBRARY["exit"] = &library_exit;
+        LIBRARY["abort"] = &library_abort;
+        LIBRARY["abs"] = &library_abs;
+        LIBRARY["labs"] = &library_abs;
+        LIBRARY["rand"] = &library_rand;
+        LIBRARY["srand"] = &library_srand;
+        LIBRARY["fabs"] = &library_fabs;
+        LIBRARY["sqrt"] = &library_sqrt;
+        LIBRARY["sin"] = &library_sin;
+        LIBRARY["cos"] = &library_cos;
+        LIBRARY["tan"] = &library_tan;
+        LIBRARY["atan"] = &library_atan;
+        LIBRARY["exp"] = &library_exp;
+        LIBRARY["log"] = &library_log;
+        LIBRARY["log10"] = &library_log10;
+        LIBRARY["floor"] = &library_floor;
+        LIBRARY["ceil"] = &library_ceil;
+        LIBRARY["pow"] = &library_pow;
+        LIBRARY["atan2"] = &library_atan2;
+    }
+
+    static bool run(machine &, unsigned, const std::vector<fold::value> &, fold::value &) throw();
+
+    /// call a procedure of the program, or of the C library
+    static bool call(
+        machine &m,
+        const procedure &proc,
+        const instruction &in,
+        std::vector<fold::value> &regs
+    ) throw() {
+        const int sym(symbol_at(m, address_of(regs[in.src1])));
+        if(0 > sym || !SYMBOLS[sym].is_proc) {
+            return trap(m, "call through a bad pointer", proc.name);
+        }
+
+        library_call lc;
+        lc.name = SYMBOLS[sym].name.c_str();
+        lc.result = zero_value();
+        lc.arg_types = in.arg_types;
+        for(unsigned a(0U); a < in.args.size(); ++a) {
+            lc.args.push_back(0 > in.args[a] ? zero_value() : regs[in.args[a]]);
+        }
+
+        std::map<std::string, unsigned>::const_iterator proc_it(
+            PROCEDURE_IDS[m.version].find(SYMBOLS[sym].name));
+        std::map<std::string, library_procedure>::const_iterator lib_it(
+            LIBRARY.find(SYMBOLS[sym].name));
+
+        if(PROCEDURE_IDS[m.version].end() != proc_it) {
+            if(!run(m, proc_it->second, lc.args, lc.result)) {
+                return false;
+            }
+        } else if(LIBRARY.end() != lib_it) {
+            if(!lib_it->second(m, lc)) {
+                return false;
+            }
+        } else {
+            m.unknown.insert(SYMBOLS[sym].name);
+        }
+
+        if(0 <= in.dst) {
+            regs[in.dst] = lc.result;
+        }
+        return true;
+    }
+
+    /// is the value of a branch condition true?
+    static bool is_true(const fold::value &val, const simple_type *type) throw() {
+        if(fold::FLOAT_ARITH == fold::arithmetic_of(type)) {
+            return 0.0 != val.f;
+        }
+        return 0 != val.i;
+    }
+
+    /// run a procedure; returns false if the program stopped
+    static bool run(
+        machine &m,
+        unsigned proc_id,
+        const std::vector<fold::value> &args,
+        fold::value &result
+    ) throw() {
+        const procedure &proc(*(PROCEDURES[m.version][proc_id]));
+        if(MAX_CALL_DEPTH <= m.depth) {
+            return trap(m, "too many nested calls", proc.name);
+        }
+
+        std::vector<fold::value> regs(proc.num_regs, zero_value());
+        for(unsigned p(0U); p < proc.num_params && p < args.size(); ++p) {
+            regs[p] = args[p];
+        }
+
+        ++m.depth;
+        const unsigned num_instrs(static_cast<unsigned>(proc.code.size()));
+        for(unsigned pc(0U); pc < num_instrs; ) {
+            const instruction &in(proc.code[pc++]);
+            if(LABEL_OP == in.op || NOP_OP == in.op) {
+                continue;
+            } else if(m.max_steps <= m.steps) {
+                stop(m, OUT_OF_STEPS, "too many instructions");
+                break;
+            }
+
+            ++m.steps;
+            ++m.op_counts[in.op];
+            ++m.proc_counts[proc_id];
+
+            switch(in.op) {
+            case LDC_OP:
+                regs[in.dst] = in.value;
+                if(0 <= in.symbol) {
+                    regs[in.dst].i = fold::normalize(
+                        symbol_address(m, in.symbol) + in.value.i, in.dst_type);
+                }
+                break;
+
+            case CPY_OP:
+                regs[in.dst] = regs[in.src1];
+                break;
+
+            case CVT_OP: case NEG_OP: case NOT_OP:
+                if(!fold::unary(in.op,
+                    in.src1_type, regs[in.src1],
+                    in.dst_type, regs[in.dst])) {
+                    trap(m, "undefined unary operation", proc.name);
+                }
+                break;
+
+            case LOAD_OP:
+                load(m, address_of(regs[in.src1]), in.dst_type, regs[in.dst], proc.name);
+                break;
+
+            case STR_OP:
+                store(m, address_of(regs[in.src1]), in.src2_type, regs[in.src2], proc.name);
+                break;
+
+            case MCPY_OP:
+                if(0 == in.type || !copy(m,
+                    address_of(regs[in.src1]), address_of(regs[in.src2]),
+                    static_cast<uint32_t>(in.type->len / 8))) {
+                    trap(m, "memory copy to or from a bad address", proc.name);
+                }
+                break;
+
+            case JMP_OP:
+                pc = in.target;
+                break;
+
+            case BTRUE_OP:
+                if(is_true(regs[in.src1], in.src1_type)) {
+                    pc = in.target;
+                }
+                break;
+
+            case BFALSE_OP:
+                if(!is_true(regs[in.src1], in.src1_type)) {
+                    pc = in.target;
+                }
+                break;
+
+            case MBR_OP: {
+                const int64_t k(regs[in.src1].i - in.offset);
+                if(0 <= k && static_cast<uint64_t>(k) < in.targets.size()) {
+                    pc = in.targets[static_cast<unsigned>(k)];
+                } else {
+                    pc = in.target;
+                }
+                break;
+            }
+
+            case RET_OP:
+                if(0 <= in.src1) {
+                    result = regs[in.src1];
+                }
+                --m.depth;
+                return true;
+
+            case CALL_OP:
+                call(m, proc, in, regs);
+                break;
+
+            // binary operators
+            default: {
+                fold::value right(regs[in.src2]);
+
+                // the machine only uses the low bits of a shift amount
+                if((LSL_OP == in.op || LSR_OP == in.op || ASR_OP == in.op)
+                && fold::is_integral(in.src1_type)
+                && fold::is_integral(in.src2_type)) {
+                    right.i &= fold::int_bits(in.src1_type) - 1;
+                }
+
+                if(!fold::binary(in.op,
+                    in.src1_type, regs[in.src1],
+                    in.src2_type, right,
+                    in.dst_type, regs[in.dst])) {
+                    trap(m, "undefined binary operation", proc.name);
+                }
+                break;
+            }
+            }
+
+            if(RUNNING != m.state) {
+                break;
+            }
+        }
+
+        --m.depth;
+        return RUNNING == m.state;
+    }
+
+    /// the change from one count to another, in percent
+    static double change(uint64_t before, uint64_t after) throw() {
+        if(0U == before) {
+            return 0.0;
+        }
+        return 100.0 * (static_cast<double>(after) - static_cast<double>(before))
+             / static_cast<double>(before);
+    }
+
+    /// run main, as if the program had no arguments but its name
+    static void simulate(machine &m, fold::value &result) throw() {
+        std::map<std::string, unsigned>::const_iterator it(
+            PROCEDURE_IDS[m.version].find("main"));
+        if(PROCEDURE_IDS[m.version].end() == it) {
+            stop(m, TRAPPED, "there is no main");
+            return;
+        }
+
+        const simple_type *addr_type(simple_type_addr);
+        const uint32_t addr_size(size_of(addr_type));
+        const uint32_t argv(allocate(m, 2U * addr_size));
+
+        fold::value arg(zero_value());
+        arg.i = allocate(m, 1U);
+        store(m, argv, addr_type, arg, "main");
+
+        std::vector<fold::value> args(2U, zero_value());
+        args[0].i = 1;
+        args[1].i = argv;
+
+        if(run(m, it->second, args, result)) {
+            m.state = RETURNED;
+            m.exit_code = static_cast<int>(result.i);
+        }
+    }
+
+    /// the next number (0 to 65535) of a random sequence; this is the same
+    /// generator as for rand
+    static uint32_t next_random(uint32_t &state) throw() {
+        state = state * 1103515245U + 12345U;
+        return (state / 65536U) % 65536U;
+    }
+
+    /// make the random arguments of a trial. Integers are mostly small, with
+    /// some edge cases thrown in, and pointers point to memory of their own
+    /// that is filled with small integers.
+    static void make_args(
+        machine &m,
+        const procedure &proc,
+        uint32_t seed,
+        std::vector<fold::value> &args,
+        std::string &description
+    ) throw() {
+        static const int64_t EDGES[] = {
+            0, 1, -1, 2, 255, 65535, 0x7FFFFFFF, -0x7FFFFFFF - 1
+        };
+
+        args.assign(proc.num_params, zero_value());
+        description.clear();
+
+        for(unsigned p(0U); p < proc.num_params; ++p) {
+            const simple_type *type(proc.param_types[p]);
+            const uint32_t r(next_random(seed));
+            char arg[64];
+
+            if(ADDRESS_TYPE == type->base) {
+                const uint32_t addr(allocate(m, ARG_BUFFER_SIZE));
+                for(uint32_t offset(0U); offset < ARG_BUFFER_SIZE; offset += 4U) {
+                    fold::value word(zero_value());
+                    word.i = static_cast<int64_t>(next_random(seed) % 41U) - 20;
+                    store(m, addr + offset, simple_type_signed, word, proc.name);
+                }
+                args[p].i = addr;
+                sprintf(arg, "&[%u bytes]", static_cast<unsigned>(ARG_BUFFER_SIZE));
+
+            } else if(fold::FLOAT_ARITH == fold::arithmetic_of(type)) {
+                args[p].f = (static_cast<double>(r % 81U) - 40.0) / 4.0;
+                sprintf(arg, "%g", args[p].f);
+
+            } else if(fold::is_integral(type)) {
+                int64_t val(static_cast<int64_t>(r % 41U) - 20);
+                if(0U == r % 4U) {
+                    val = EDGES[(r / 4U) % (sizeof EDGES / sizeof EDGES[0])];
+                }
+                args[p].i = fold::normalize(val, type);
+                sprintf(arg, "%lld", static_cast<long long>(args[p].i));
+
+            } else {
+                sprintf(arg, "0");
+            }
+
+            description += 0U == p ? "" : ", ";
+            description += arg;
+        }
+    }
+
+    /// describe how a program stopped
+    static std::string describe(
+        const machine &m,
+        const fold::value &result,
+        const simple_type *type
+    ) throw() {
+        char str[128];
+        switch(m.state) {
+        case RETURNED:
+            if(0 == type) {
+                sprintf(str, "returned");
+            } else if(fold::FLOAT_ARITH == fold::arithmetic_of(type)) {
+                sprintf(str, "returned %g", result.f);
+            } else {
+                sprintf(str, "returned %lld", static_cast<long long>(result.i));
+            }
+            return str;
+        case EXITED:
+            sprintf(str, "exited with %d", m.exit_code);
+            return str;
+        default:
+            return "stopped (" + m.reason + ")";
+        }
+    }
+
+    /// find the first address at which the memory of two programs differs
+    static bool find_memory_difference(
+        const machine &a,
+        const machine &b,
+        uint32_t &where
+    ) throw() {
+        static const unsigned char ZEROS[PAGE_SIZE] = {0};
+        const std::vector<uint32_t> *used[2] = {&(a.used_pages), &(b.used_pages)};
+
+        for(unsigned u(0U); u < 2U; ++u) {
+            for(unsigned i(0U); i < used[u]->size(); ++i) {
+                const uint32_t page((*used[u])[i]);
+                const unsigned char *a_bytes(0 == a.pages[page] ? ZEROS : a.pages[page]);
+                const unsigned char *b_bytes(0 == b.pages[page] ? ZEROS : b.pages[page]);
+                if(0 == memcmp(a_bytes, b_bytes, PAGE_SIZE)) {
+                    continue;
+                }
+
+                uint32_t offset(0U);
+                while(a_bytes[offset] == b_bytes[offset]) {
+                    ++offset;
+                }
+                where = (page << PAGE_BITS) | offset;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// compare what the two versions of a program did: how they stopped,
+    /// what they returned, their I/O calls and their memory
+    static bool compare(
+        const machine &before,
+        const fold::value &before_result,
+        const machine &after,
+        const fold::value &after_result,
+        const simple_type *return_type,
+        std::string &difference
+    ) throw() {
+        const std::string before_end(describe(before, before_result, return_type));
+        const std::string after_end(describe(after, after_result, return_type));
+        if(before_end != after_end) {
+            difference = before_end + " vs. " + after_end;
+            return false;
+        }
+
+        const unsigned num_calls(static_cast<unsigned>(
+            std::max(before.trace.size(), after.trace.size())));
+        for(unsigned i(0U); i < num_calls; ++i) {
+            const std::string b(i < before.trace.size() ? before.trace[i] : "nothing");
+            const std::string a(i < after.trace.size() ? after.trace[i] : "nothing");
+            if(b != a) {
+                char call[32];
+                sprintf(call, "I/O call %u: ", i);
+                difference = call + b + " vs. " + a;
+                return false;
+            }
+        }
+
+        uint32_t where(0U);
+        if(find_memory_difference(before, after, where)) {
+            char mem[64];
+            sprintf(mem, "memory at 0x%08x", where);
+            difference = mem;
+            return false;
+        }
+        return true;
+    }
+
+    /// run both versions of a procedure on random arguments; returns false
+    /// if they did different things
+    static bool check(
+        machine &before,
+        machine &after,
+        unsigned before_id,
+        unsigned after_id,
+        unsigned num_trials,
+        uint32_t &seed
+    ) throw() {
+        const procedure &proc(*(PROCEDURES[BEFORE][before_id]));
+        unsigned num_undefined(0U), num_too_long(0U), num_same(0U);
+        uint64_t before_steps(0U), after_steps(0U);
+
+        for(unsigned t(0U); t < num_trials; ++t) {
+            const uint32_t trial_seed(next_random(seed) * 65536U + next_random(seed));
+            std::vector<fold::value> before_args, after_args;
+            std::string args;
+
+            before.reset();
+            after.reset();
+            make_args(before, proc, trial_seed, before_args, args);
+            make_args(after, proc, trial_seed, after_args, args);
+
+            fold::value before_result(zero_value()), after_result(zero_value());
+            if(run(before, before_id, before_args, before_result)) {
+                before.state = RETURNED;
+            }
+            if(run(after, after_id, after_args, after_result)) {
+                after.state = RETURNED;
+            }
+
+            // what a procedure does after it traps is undefined, so the
+            // optimized version doesn't have to trap too
+            if(TRAPPED == before.state) {
+                ++num_undefined;
+                continue;
+            } else if(OUT_OF_STEPS == before.state || OUT_OF_STEPS == after.state) {
+                ++num_too_long;
+                continue;
+            }
+
+            std::string difference;
+            if(!compare(before, before_result, after, after_result,
+                        proc.return_type, difference)) {
+                fprintf(stderr, "sim: check %s: FAILED on (%s): %s\n",
+                    proc.name.c_str(), args.c_str(), difference.c_str());
+                return false;
+            }
+
+            ++num_same;
+            before_steps += before.steps;
+            after_steps += after.steps;
+        }
+
+        fprintf(stderr,
+            "sim: check %-22s %4u same %4u undefined %4u too long %+8.1f%%\n",
+            proc.name.c_str(), num_same, num_undefined, num_too_long,
+            change(before_steps, after_steps));
+        return true;
+    }
+
+    static void report_line(const char *what, uint64_t before, uint64_t after) throw() {
+        fprintf(stderr, "sim:   %-24s %12llu %12llu %+8.1f%%\n", what,
+            static_cast<unsigned long long>(before),
+            static_cast<unsigned long long>(after),
+            change(before, after));
+    }
+
+    /// run main on both versions, and report what ran; returns false if the
+    /// two versions did different things
+    static bool report_program(void) throw() {
+        machine before(BEFORE), after(AFTER);
+        fold::value before_result(zero_value()), after_result(zero_value());
+        simulate(before, before_result);
+        simulate(after, after_result);
+
+        const simple_type *return_type(
+            PROCEDURES[BEFORE][PROCEDURE_IDS[BEFORE]["main"]]->return_type);
+        const std::string before_end(describe(before, before_result, return_type));
+        const std::string after_end(describe(after, after_result, return_type));
+        fprintf(stderr, "sim: before: %s after %llu instructions\n",
+            before_end.c_str(), static_cast<unsigned long long>(before.steps));
+        fprintf(stderr, "sim: after: %s after %llu instructions\n",
+            after_end.c_str(), static_cast<unsigned long long>(after.steps));
+
+        bool is_same(true);
+        std::string difference;
+        if(TRAPPED == before.state) {
+            fprintf(stderr, "sim: the program trapped before it was optimized\n");
+        } else if(OUT_OF_STEPS == before.state || OUT_OF_STEPS == after.state) {
+            fprintf(stderr, "sim: the program ran for too long to compare\n");
+        } else if(compare(before, before_result, after, after_result,
+                          return_type, difference)) {
+            fprintf(stderr, "sim: the two versions did the same %u I/O calls\n",
+                static_cast<unsigned>(before.trace.size()));
+        } else {
+            fprintf(stderr, "sim: the two versions DIFFER: %s\n", difference.c_str());
+            is_same = false;
+        }
+
+        fprintf(stderr, "sim: %-26s %12s %12s %9s\n",
+            "by procedure", "before", "after", "change");
+        for(unsigned p(0U); p < PROCEDURES[BEFORE].size(); ++p) {
+            const std::string &name(PROCEDURES[BEFORE][p]->name);
+            std::map<std::string, unsigned>::const_iterator it(
+                PROCEDURE_IDS[AFTER].find(name));
+            report_line(name.c_str(), before.proc_counts[p],
+                PROCEDURE_IDS[AFTER].end() == it ? 0U : after.proc_counts[it->second]);
+        }
+
+        fprintf(stderr, "sim: %-26s %12s %12s %9s\n",
+            "by opcode", "before", "after", "change");
+        for(unsigned op(0U); op < LAST_OP; ++op) {
+            if(0U != before.op_counts[op] || 0U != after.op_counts[op]) {
+                report_line(simple_op_name(static_cast<simple_op>(op)),
+                    before.op_counts[op], after.op_counts[op]);
+            }
+        }
+
+        std::set<std::string> unknown(before.unknown);
+        unknown.insert(after.unknown.begin(), after.unknown.end());
+        if(!unknown.empty()) {
+            fprintf(stderr, "sim: calls to unknown procedures returned zero:");
+            std::set<std::string>::const_iterator it(unknown.begin());
+            for(; it != unknown.end(); ++it) {
+                fprintf(stderr, " %s", it->c_str());
+            }
+            fprintf(stderr, "\n");
+        }
+
+        report_line("total", before.steps, after.steps);
+        fprintf(stderr, "sim: cost %llu %llu\n",
+            static_cast<unsigned long long>(before.steps),
+            static_cast<unsigned long long>(after.steps));
+        return is_same;
+    }
+
+    /// run each procedure on random arguments; returns false if the two
+    /// versions of any procedure did different things
+    static bool report_procedures(void) throw() {
+        unsigned num_trials(DEFAULT_NUM_TRIALS);
+        uint32_t seed(1U);
+
+        const char *num_trials_str(getenv("ECE540_SIM_TRIALS"));
+        const char *seed_str(getenv("ECE540_SIM_SEED"));
+        if(0 != num_trials_str) {
+            num_trials = static_cast<unsigned>(atoi(num_trials_str));
+        }
+        if(0 != seed_str) {
+            seed = static_cast<uint32_t>(atol(seed_str));
+        }
+        if(0U == num_trials) {
+            return true;
+        }
+
+        machine before(BEFORE), after(AFTER);
+        before.max_steps = std::min(before.max_steps, static_cast<uint64_t>(MAX_TRIAL_STEPS));
+        after.max_steps = before.max_steps;
+
+        unsigned num_failed(0U);
+        for(unsigned p(0U); p < PROCEDURES[BEFORE].size(); ++p) {
+            std::map<std::string, unsigned>::const_iterator it(
+                PROCEDURE_IDS[AFTER].find(PROCEDURES[BEFORE][p]->name));
+            if(PROCEDURE_IDS[AFTER].end() != it
+            && !check(before, after, p, it->second, num_trials, seed)) {
+                ++num_failed;
+            }
+        }
+
+        fprintf(stderr, "sim: checked %u procedures, %u failed\n",
+            static_cast<unsigned>(PROCEDURES[BEFORE].size()), num_failed);
+        return 0U == num_failed;
+    }
+
+    bool report(void) throw() {
+        if(!is_simulating()) {
+            return true;
+        }
+
+        init_library();
+
+        bool is_same(true);
+        if(0U == PROCEDURE_IDS[BEFORE].count("main")) {
+            fprintf(stderr, "sim: there is no main, so the program wasn't run\n");
+        } else {
+            is_same = report_program();
+        }
+        return report_procedures() && is_same;
+    }
+}
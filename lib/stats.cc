@@ -0,0 +1,36 @@
+/*
+ * stats.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <map>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "include/stats.h"
+
+namespace stats {
+
+    /// counters for the procedure currently being optimized
+    static std::map<std::string, unsigned> COUNTERS;
+
+    /// add to a named counter
+    void count(const char *name, unsigned by) throw() {
+        COUNTERS[name] += by;
+    }
+
+    /// report (to stderr) and then reset all counters for a procedure
+    void report(const char *proc_name) throw() {
+        if(0 != getenv("ECE540_STATS")) {
+            std::map<std::string, unsigned>::const_iterator it(COUNTERS.begin())
+                                                          , end(COUNTERS.end());
+            for(; it != end; ++it) {
+                fprintf(stderr, "%s: %s %u\n", proc_name, it->first.c_str(), it->second);
+            }
+        }
+        COUNTERS.clear();
+    }
+}
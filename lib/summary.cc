@@ -0,0 +1,295 @@
+/*
+ * summary.cc
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ */
+
+#include <set>
+
+#include "include/summary.h"
+
+procedure_summary::procedure_summary(void) throw()
+    : reads_memory(false)
+    , writes_memory(false)
+    , may_loop(false)
+    , calls_unknown(false)
+    , returns_constant(false)
+{
+    return_value.format = IMMED_INT;
+    return_value.u.ival = 0;
+}
+
+bool procedure_summary::is_pure(void) const throw() {
+    return !calls_unknown && !reads_memory && !writes_memory;
+}
+
+bool procedure_summary::is_read_only(void) const throw() {
+    return !calls_unknown && !writes_memory;
+}
+
+bool procedure_summary::is_removable(void) const throw() {
+    return is_read_only() && !may_loop;
+}
+
+bool procedure_summary::is_constant(void) const throw() {
+    return is_pure() && !may_loop && returns_constant;
+}
+
+/// find the instruction that defines a register, looking backward from (but
+/// not including) a given instruction, and stopping at the beginning of the
+/// basic block.
+static const simple_instr *find_local_def(
+    const simple_instr *in,
+    const simple_reg *reg
+) throw() {
+    for(in = in->prev; 0 != in; in = in->prev) {
+        switch(in->opcode) {
+        case LABEL_OP:
+        case JMP_OP: case BTRUE_OP: case BFALSE_OP: case MBR_OP: case RET_OP:
+            return 0;
+
+        case LDC_OP:
+            if(reg == in->u.ldc.dst) {
+                return in;
+            }
+            break;
+
+        case CALL_OP:
+            if(reg == in->u.call.dst) {
+                return in;
+            }
+            break;
+
+        case NOP_OP: case STR_OP: case MCPY_OP:
+            break;
+
+        default:
+            if(reg == in->u.base.dst) {
+                return in;
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+/// check if two constants are the same
+static bool same_constant(const simple_immed &a, const simple_immed &b) throw() {
+    if(a.format != b.format) {
+        return false;
+    } else if(IMMED_INT == a.format) {
+        return a.u.ival == b.u.ival;
+    } else {
+        return a.u.fval == b.u.fval;
+    }
+}
+
+/// summarize a procedure, given its optimized instructions
+void summary_map::summarize(const char *name, simple_instr *first) throw() {
+    procedure_summary summary;
+    std::set<simple_sym *> seen_labels;
+    bool seen_return(false);
+    bool all_returns_constant(true);
+
+    for(simple_instr *in(first); 0 != in; in = in->next) {
+        switch(in->opcode) {
+        case LABEL_OP:
+            seen_labels.insert(in->u.label.lab);
+            break;
+
+        case LOAD_OP:
+            summary.reads_memory = true;
+            break;
+
+        case STR_OP:
+            summary.writes_memory = true;
+            break;
+
+        case MCPY_OP:
+            summary.reads_memory = true;
+            summary.writes_memory = true;
+            break;
+
+        // any backward branch might be a loop
+        case JMP_OP: case BTRUE_OP: case BFALSE_OP:
+            if(0 != seen_labels.count(in->u.bj.target)) {
+                summary.may_loop = true;
+            }
+            break;
+
+        case MBR_OP:
+            if(0 != seen_labels.count(in->u.mbr.deflab)) {
+                summary.may_loop = true;
+            }
+            for(unsigned i(0); i < in->u.mbr.ntargets; ++i) {
+                if(0 != seen_labels.count(in->u.mbr.targets[i])) {
+                    summary.may_loop = true;
+                }
+            }
+            break;
+
+        // inherit the side-effects of the callee
+        case CALL_OP: {
+            const procedure_summary *callee(find(in));
+            if(0 == callee) {
+                summary.calls_unknown = true;
+            } else {
+                summary.reads_memory = summary.reads_memory || callee->reads_memory;
+                summary.writes_memory = summary.writes_memory || callee->writes_memory;
+                summary.may_loop = summary.may_loop || callee->may_loop;
+                summary.calls_unknown = summary.calls_unknown || callee->calls_unknown;
+            }
+            break;
+        }
+
+        // check that every return returns the same constant
+        case RET_OP: {
+            const simple_instr *def(0);
+            if(0 != in->u.base.src1) {
+                def = find_local_def(in, in->u.base.src1);
+            }
+
+            if(0 == def
+            || LDC_OP != def->opcode
+            || IMMED_SYMBOL == def->u.ldc.value.format) {
+                all_returns_constant = false;
+
+            } else if(!seen_return) {
+                summary.return_value = def->u.ldc.value;
+
+            } else if(!same_constant(summary.return_value, def->u.ldc.value)) {
+                all_returns_constant = false;
+            }
+
+            seen_return = true;
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    summary.returns_constant = seen_return && all_returns_constant;
+    summaries[name] = summary;
+}
+
+/// find the summary for a procedure by name
+const procedure_summary *summary_map::find(const char *name) const throw() {
+    std::map<std::string, procedure_summary>::const_iterator it(
+        summaries.find(name));
+
+    if(summaries.end() == it) {
+        return 0;
+    }
+    return &(it->second);
+}
+
+/// find the summary of the procedure called by a CALL instruction
+const procedure_summary *summary_map::find(const simple_instr *in) const throw() {
+    simple_sym *proc(callee(in));
+    if(0 == proc) {
+        return 0;
+    }
+    return find(proc->name);
+}
+
+/// find the procedure whose address is loaded by an instruction
+static simple_sym *loaded_proc(const simple_instr *in) throw() {
+    if(LDC_OP != in->opcode
+    || IMMED_SYMBOL != in->u.ldc.value.format
+    || 0 != in->u.ldc.value.u.s.offset
+    || PROC_SYM != in->u.ldc.value.u.s.symbol->kind) {
+        return 0;
+    }
+    return in->u.ldc.value.u.s.symbol;
+}
+
+/// find the procedure whose address is in a register just before an
+/// instruction; copies within the same basic block are followed.
+static simple_sym *local_proc(const simple_instr *in, const simple_reg *reg) throw() {
+    for(const simple_instr *def(find_local_def(in, reg));
+        0 != def;
+        def = find_local_def(def, def->u.base.src1)) {
+
+        if(CPY_OP != def->opcode) {
+            return loaded_proc(def);
+        }
+    }
+    return 0;
+}
+
+/// find the procedure whose address is in a pseudo register by looking at
+/// every definition of the register in the procedure; all of them must load
+/// the same procedure
+static simple_sym *global_proc(const simple_instr *in, const simple_reg *reg) throw() {
+    while(0 != in->prev) {
+        in = in->prev;
+    }
+
+    simple_sym *proc(0);
+    for(; 0 != in; in = in->next) {
+        simple_sym *def_proc(0);
+        switch(in->opcode) {
+        case LDC_OP:
+            if(reg != in->u.ldc.dst) {
+                continue;
+            }
+            def_proc = loaded_proc(in);
+            break;
+
+        case CPY_OP:
+            if(reg != in->u.base.dst) {
+                continue;
+            }
+            def_proc = local_proc(in, in->u.base.src1);
+            break;
+
+        case CALL_OP:
+            if(reg != in->u.call.dst) {
+                continue;
+            }
+            return 0;
+
+        case NOP_OP: case LABEL_OP: case JMP_OP: case BTRUE_OP: case BFALSE_OP:
+        case MBR_OP: case RET_OP: case STR_OP: case MCPY_OP:
+            continue;
+
+        default:
+            if(reg != in->u.base.dst) {
+                continue;
+            }
+            return 0;
+        }
+
+        if(0 == def_proc || (0 != proc && proc != def_proc)) {
+            return 0;
+        }
+        proc = def_proc;
+    }
+
+    return proc;
+}
+
+/// find the symbol of the procedure called by a CALL instruction. Calls are
+/// made indirectly through a register; if that register is defined in the
+/// same basic block by loading the address of a procedure, or if every
+/// definition of the (pseudo) register loads the same procedure, then we
+/// know the callee.
+simple_sym *summary_map::callee(const simple_instr *in) throw() {
+    if(CALL_OP != in->opcode || 0 == in->u.call.proc) {
+        return 0;
+    }
+
+    simple_reg *reg(in->u.call.proc);
+    const simple_instr *def(find_local_def(in, reg));
+
+    if(0 != def) {
+        return local_proc(in, reg);
+    } else if(PSEUDO_REG == reg->kind) {
+        return global_proc(in, reg);
+    }
+
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "include/sim.h"
+
 extern void init_suif(int& argc, char * argv[]);
 extern void compile(char *infile, char *outfile);
 static void usage(char *progname);
@@ -26,6 +28,11 @@ main (int argc, char *argv[])
     }
 
     compile(infile, outfile);
+
+    /* run the program before and after it was optimized */
+    if (!sim::report()) {
+        return 1;
+    }
     return 0;
 }
 
@@ -0,0 +1,50 @@
+/*
+ * ece540_profile.h
+ *
+ *  Created on: Oct 18, 2026
+ *     Version: $Id$
+ *
+ * Runtime for programs that are profiled (see include/profile.h). Include
+ * this before anything else in the program, then compile the program with
+ * ECE540_PROFILE_GENERATE set. Running it writes the block counts to
+ * ece540.prof, which is read back by compiling with
+ * ECE540_PROFILE_USE=ece540.prof.
+ */
+
+#ifndef ECE540_PROFILE_H_
+#define ECE540_PROFILE_H_
+
+#include <stdio.h>
+
+/* this must match NUM_COUNTERS in lib/profile.cc */
+#define ECE540_PROFILE_NUM_COUNTERS 65536
+
+int ece540_profile_counters[ECE540_PROFILE_NUM_COUNTERS];
+
+/* write out the counters that aren't zero, as "counter count" lines; the
+ * instrumented program calls this before it ends */
+void ece540_profile_dump(void)
+{
+    FILE *f;
+    int i;
+
+    f = fopen("ece540.prof", "w");
+    if (f == 0)
+        return;
+
+    for (i = 0; i < ECE540_PROFILE_NUM_COUNTERS; i++)
+        if (ece540_profile_counters[i] != 0)
+            fprintf(f, "%d %d\n", i, ece540_profile_counters[i]);
+
+    fclose(f);
+}
+
+/* never called; this is where the compiler finds the symbols of the counters
+ * and of the dump procedure */
+void ece540_profile_symbols(void)
+{
+    ece540_profile_counters[0] = 0;
+    ece540_profile_dump();
+}
+
+#endif /* ECE540_PROFILE_H_ */
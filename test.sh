@@ -58,3 +58,31 @@ diff tests/t13.got tests/t13.exp
 diff tests/t14.got tests/t14.exp
 diff tests/t15.got tests/t15.exp
 
+
+# procedures written as text (tests/*.ir) are optimized in place of those of
+# an existing program, and the simulator compares them before and after
+sim_test() {
+    ECE540_SIMULATE=1 ECE540_IR_LOAD=tests/$1.ir timeout 60 ./project $2 2> tests/$1.got > /dev/null
+    diff tests/$1.got tests/$1.exp
+}
+
+sim_test summary_pure_call tests/13.tmp
+sim_test rle_dse proj_tests/arrays.tmp
+sim_test sr_loop proj_tests/arrays.tmp
+sim_test sr_zero_trip proj_tests/arrays.tmp
+sim_test cf_typed tests/1.tmp
+sim_test eval_loop tests/1.tmp
+sim_test eval_memory proj_tests/arrays.tmp
+sim_test eval_residual tests/1.tmp
+sim_test sb_diamond tests/1.tmp
+sim_test cfg_fold tests/1.tmp
+sim_test licm_nest tests/1.tmp
+sim_test ns_irreducible tests/1.tmp
+sim_test bp_rotate tests/1.tmp
+sim_test cf_add_zero_loop tests/1.tmp
+sim_test cf_xor_self tests/1.tmp
+sim_test rle_self_forward proj_tests/arrays.tmp
+sim_test cp_redefined_source tests/1.tmp
+sim_test coalesce tests/1.tmp
+sim_test cf_mbr tests/1.tmp
+sim_test cse_chain tests/1.tmp